@@ -17,12 +17,18 @@
 
 #include <iostream>
 #include <csignal>
+#include <cstdlib>
 #include <utility>
 #include <cstddef>
 #include <memory>
 #include <iterator>
 #include <algorithm>
 #include <climits>
+#include <limits>
+#include <chrono>
+#include <iomanip>
+#include <filesystem>
+#include <optional>
 #ifdef _WIN32
 #define NOMINMAX
 #include <Windows.h>
@@ -38,7 +44,6 @@
 #include <terra/logger/logger.h>
 #include <terra/logger/null_ostream.h>
 #include <terra/secutil/secure_erase.h>
-#include <terra/charutil/character_utilities.h>
 #include <terra/conio/ansi_capable.h>
 #ifdef AESCRYPT_ENABLE_LICENSE_MODULE
 #include <terra/aescrypt_lm/aescrypt_lm.h>
@@ -53,6 +58,23 @@
 #include "password_prompt.h"
 #include "encrypt_files.h"
 #include "decrypt_files.h"
+#include "unicode_fast_path.h"
+#include "batch_options.h"
+#include "system_resources.h"
+#include "option_values.h"
+#include "rate_limiter.h"
+#include "thread_priority.h"
+#include "concurrency_controller.h"
+#include "cpu_topology.h"
+#include "cooperative_batch.h"
+#include "s3_url.h"
+#include "batch_plan.h"
+#ifdef AESCRYPT_S3
+#include "s3_client.h"
+#endif
+#ifdef AESCRYPT_FAULT_INJECTION
+#include "fault_injection.h"
+#endif
 
 // It is assumed a character is 8 bits
 static_assert(CHAR_BIT == 8);
@@ -110,18 +132,19 @@ void SignalHandler(int signal_number)
         case SIGQUIT:
             terminate = true;
             break;
+
+        case SIGUSR2:
+            // Request that bandwidth limits be reloaded
+            process_control.reload_bandwidth = true;
+            break;
 #endif
         default:
             break;
     }
 
-    // If terminating, set the flag and notify all waiting threads
-    if (terminate)
-    {
-        std::lock_guard<std::mutex> lock(process_control.mutex);
-        process_control.terminate = true;
-        process_control.cv.notify_all();
-    }
+    // If terminating, request termination; this is async-signal-safe, as
+    // cancelling work in progress is left to another thread
+    if (terminate) process_control.RequestTermination();
 }
 
 /*
@@ -133,7 +156,9 @@ void SignalHandler(int signal_number)
  *      terminate in a sane way.
  *
  *  Parameters:
- *      None.
+ *      reload_signal [in]
+ *          If true, SIGUSR2 is handled to request that bandwidth limits be
+ *          reloaded (not supported on Windows).
  *
  *  Returns:
  *      Nothing.
@@ -141,7 +166,7 @@ void SignalHandler(int signal_number)
  *  Comments:
  *      None.
  */
-void InstallSignalHandlers()
+void InstallSignalHandlers([[maybe_unused]] bool reload_signal)
 {
 #ifdef _WIN32
     if (signal(SIGABRT, SignalHandler) == SIG_ERR)
@@ -188,6 +213,11 @@ void InstallSignalHandlers()
     {
         std::cerr << "Failed to install SIGTERM handler" << std::endl;
     }
+
+    if (reload_signal && (sigaction(SIGUSR2, &sa, nullptr) == -1))
+    {
+        std::cerr << "Failed to install SIGUSR2 handler" << std::endl;
+    }
 #endif
 }
 
@@ -332,6 +362,7 @@ EXAMPLES:
     aescrypt -e -p secret -o filename.txt.aes -
     aescrypt -g -s 128 -k /path/to/filename.key
     aescrypt -g -k /path/to/filename.key
+    aescrypt -g --count 1000 --keydir /path/to/keys
 
     OPTIONS           NAME        DESCRIPTION
 
@@ -341,13 +372,104 @@ MODE:
     -g, --generate   [generate  ] Generate a key file with random data
 
 FUNCTIONAL:
+        --affinity   [affinity  ] Pin each job to a processor ("core") or to
+                                  the processors of a NUMA node ("node"),
+                                  preferring performance cores (default is
+                                  none)
+        --bwlimit    [bwlimit   ] Limit the rate at which files are read and
+                                  written as READ[:WRITE] octets per second
+                                  (e.g., 50M or 50M:20M; 0 is unlimited)
+        --bwlimit-file [bwlimit-file]
+                                  File containing READ[:WRITE] limits that are
+                                  reloaded when SIGUSR2 is received
+        --coop-dir   [coop-dir  ] Work directory shared with other processes
+                                  (on this or other hosts) given the same
+                                  files, so each file is processed only once
+        --count      [count     ] Number of key files to generate into the
+                                  directory given by --keydir
+        --cpu-priority [cpu-priority]
+                                  CPU scheduling priority of the threads
+                                  performing encryption or decryption: normal,
+                                  batch, or idle (default is normal)
+        --deadline   [deadline  ] Time by which processing must finish, given
+                                  as a local time (HH:MM[:SS]) or a duration
+                                  (e.g., 90m or 1h30m); files that would
+                                  finish later are not started
+        --deferred-list [deferred-list]
+                                  File to which the names of files deferred
+                                  by --deadline are written, each ending with
+                                  a NUL (e.g., for use with xargs -0)
+        --flush-bytes [flush-bytes]
+                                  When encrypting, flush output after this
+                                  many octets are written (e.g., 64K)
+        --flush-interval [flush-interval]
+                                  When encrypting, flush output no more than
+                                  this many milliseconds after it is written
+                                  (useful when output is read through a pipe)
+        --io-class   [io-class  ] I/O scheduling class of the threads
+                                  performing encryption or decryption: idle or
+                                  best-effort[:N], where N is 0 to 7
     -i, --iterations [iterations] Number of KDF iterations (default is 300000)
+    -j, --jobs       [jobs      ] Number of files to encrypt or decrypt
+                                  concurrently, "auto" to use one per
+                                  available processor, or "adaptive" to adjust
+                                  based on observed throughput (default is 1)
     -k, --keyfile    [keyfile   ] The key file to use
-    -o, --outfile    [outfile   ] Output file when operating on a single file
+        --keydir     [keydir    ] Directory into which --count key files are
+                                  generated (named key-NNNNNN.key)
+        --keyfd      [keyfd     ] Read the key from the given open file
+                                  descriptor (e.g., a pipe from a parent)
+        --max-memory [max-memory] Memory budget for concurrent jobs (e.g.,
+                                  512M); container limits are also observed
+        --mmap-output [mmap-output]
+                                  When decrypting to new regular files, write
+                                  output by mapping each file into memory
+                                  (stdout and other files use streams)
+        --multi-stream [multi-stream]
+                                  When decrypting, each input holds AES Crypt
+                                  streams written back-to-back; each stream
+                                  is written to its own file unless -o is
+                                  given, in which case all are written to it
+    -o, --outfile    [outfile   ] Output file when operating on a single file;
+                                  when encrypting, s3://bucket/key uploads
+                                  the output to object storage
     -p, --password   [password  ] Password for encryption or decryption
+        --plan       [plan      ] Report the output size, estimated time, and
+                                  free space for the files without processing
+                                  them (processing rates are measured first)
+        --prefetch   [prefetch  ] Number of upcoming files to open and read
+                                  ahead while processing files (default is 0)
     -q, --quiet      [quiet     ] Do not produce progress output to stdout
+        --s3-connections [s3-connections]
+                                  Number of concurrent object storage requests
+                                  per file (default is 4)
+        --s3-part-size [s3-part-size]
+                                  Size of each part uploaded to or range
+                                  downloaded from object storage, 5M to 1G
+                                  (default is 8M)
     -s, --keysize    [keysize   ] The key size in octets to use with --generate
                                   (default is 64 octets; 384 bits of entropy)
+        --scrub      [scrub     ] When decrypting, check the integrity of each
+                                  file without writing output, continuing
+                                  past failures (default is --jobs auto);
+                                  version 3 files are checked without
+                                  decrypting them
+        --small-files [small-files]
+                                  Queue files smaller than SIZE separately,
+                                  given as SIZE[:JOBS], with JOBS concurrent
+                                  jobs reserved for them (default is one
+                                  quarter of the jobs)
+        --verified-output [verified-output]
+                                  When decrypting to stdout, hold the output
+                                  (in memory up to what the memory budget
+                                  leaves after processing, default 256M,
+                                  then in a temporary file) until the file
+                                  is verified, so altered files produce no
+                                  output
+        --verify-after [verify-after]
+                                  When encrypting, decrypt the output as it
+                                  is written and fail if it does not match
+                                  the input
 
 DEBUGGING:
     -l, --logging    [logging   ] Enable logging output to stderr
@@ -361,6 +483,10 @@ COMMENTS:
     * Exactly one MODE must be selected (encrypt, decrypt, or generate)
     * If a password or key file is not specified, user will be prompted
     * One may read/write from/to stdin/stdout using "-" as the filename
+    * When decrypting, s3://bucket/key downloads a file from object storage
+    * Object storage requires a build with the aescrypt_cli_S3 option and
+      AWS_ENDPOINT_URL=http://host:port; requests are not encrypted, so use
+      it only with local or test object storage
     * By default, .aes will be added when encrypting, removed when decrypting
     * One may use -o to specify the output file if operating on a single file)";
 
@@ -413,20 +539,45 @@ std::pair<bool, bool> ParseOptions(Terra::ProgramOptions::Parser &parser,
     // clang-format off
     const Terra::ProgramOptions::Options options =
     {
-    //    Name        Short  Long          Multi   Argument
-        { "decrypt",    "d", "decrypt",    false,  false },
-        { "encrypt",    "e", "encrypt",    false,  false },
-        { "generate",   "g", "generate",   false,  false },
-        { "help",       "h", "help",       false,  false },
-        { "keyfile",    "k", "keyfile",    false,  true  },
-        { "keysize",    "s", "keysize",    false,  true  },
-        { "iterations", "i", "iterations", false,  true  },
-        { "logging",    "l", "logging",    false,  false },
-        { "outfile",    "o", "outfile",    false,  true  },
-        { "password",   "p", "password",   false,  true  },
-        { "question",   "?", "",           false,  false },
-        { "quiet",      "q", "quiet",      false,  false },
-        { "version",    "v", "version",    false,  false }
+    //    Name          Short  Long            Multi   Argument
+        { "affinity",      "", "affinity",     false,  true  },
+        { "bwlimit",       "", "bwlimit",      false,  true  },
+        { "bwlimit-file",  "", "bwlimit-file", false,  true  },
+        { "coop-dir",      "", "coop-dir",     false,  true  },
+        { "count",         "", "count",        false,  true  },
+        { "cpu-priority",  "", "cpu-priority", false,  true  },
+        { "deadline",      "", "deadline",     false,  true  },
+        { "decrypt",      "d", "decrypt",      false,  false },
+        { "deferred-list", "", "deferred-list", false, true  },
+        { "encrypt",      "e", "encrypt",      false,  false },
+        { "flush-bytes",   "", "flush-bytes",  false,  true  },
+        { "flush-interval", "", "flush-interval", false, true },
+        { "generate",     "g", "generate",     false,  false },
+        { "help",         "h", "help",         false,  false },
+        { "io-class",      "", "io-class",     false,  true  },
+        { "iterations",   "i", "iterations",   false,  true  },
+        { "jobs",         "j", "jobs",         false,  true  },
+        { "keydir",        "", "keydir",       false,  true  },
+        { "keyfd",         "", "keyfd",        false,  true  },
+        { "keyfile",      "k", "keyfile",      false,  true  },
+        { "keysize",      "s", "keysize",      false,  true  },
+        { "logging",      "l", "logging",      false,  false },
+        { "max-memory",    "", "max-memory",   false,  true  },
+        { "mmap-output",   "", "mmap-output",  false,  false },
+        { "multi-stream",  "", "multi-stream", false,  false },
+        { "outfile",      "o", "outfile",      false,  true  },
+        { "password",     "p", "password",     false,  true  },
+        { "plan",          "", "plan",         false,  false },
+        { "prefetch",      "", "prefetch",     false,  true  },
+        { "question",     "?", "",             false,  false },
+        { "quiet",        "q", "quiet",        false,  false },
+        { "s3-connections", "", "s3-connections", false, true },
+        { "s3-part-size",  "", "s3-part-size", false,  true  },
+        { "scrub",         "", "scrub",        false,  false },
+        { "small-files",   "", "small-files",  false,  true  },
+        { "verified-output", "", "verified-output", false, false },
+        { "verify-after",  "", "verify-after", false,  false },
+        { "version",      "v", "version",      false,  false }
     };
     // clang-format on
 
@@ -544,7 +695,35 @@ int main(int argc, char *argv[])
     Terra::Logger::LoggerPointer logger;        // Logger for debugging
     std::vector<SecureString> filenames;        // Filenames to encrypt/decrypt
     std::size_t stdin_filenames_seen{};         // Count of input files "-"
+    std::size_t s3_filenames_seen{};            // Count of input objects
     std::size_t key_size{Default_Key_File_Size};// Default generated key length
+    SecureString key_directory;                 // Directory for generated keys
+    std::size_t key_count{};                    // Number of keys to generate
+    int key_fd{-1};                             // Descriptor to read key from
+    std::size_t requested_jobs{1};              // Concurrent jobs (0 = auto)
+    bool adaptive_jobs{};                       // Adapt concurrent jobs?
+    bool plan{};                                // Only plan processing?
+    std::uint64_t max_memory{};                 // Memory budget (0 = none)
+    BatchOptions batch_options;                 // Batch processing options
+    std::uint64_t read_rate{};                  // Read limit (0 = none)
+    std::uint64_t write_rate{};                 // Write limit (0 = none)
+    std::string bandwidth_file;                 // Bandwidth limits file
+    std::optional<std::chrono::steady_clock::time_point> deadline;
+    std::string deferred_list;                  // Files deferred by deadline
+    std::unique_ptr<BandwidthLimiter> bandwidth_limiter; // I/O rate limiter
+    std::unique_ptr<ConcurrencyController> concurrency_controller;
+    AffinityMode affinity_mode{AffinityMode::None}; // Job placement
+    std::size_t small_file_jobs{};              // Small file jobs (0 = auto)
+    std::string cooperative_directory;          // Shared work directory
+    std::unique_ptr<CooperativeBatch> cooperative_batch;
+#ifdef AESCRYPT_S3
+    std::unique_ptr<S3Client> s3_client;        // Object storage client
+#endif
+    std::unique_ptr<BatchDeadline> batch_deadline; // Deadline (optional)
+    FileBackend file_backend;                   // Opens files for I/O
+#ifdef AESCRYPT_FAULT_INJECTION
+    std::unique_ptr<FaultInjectionBackend> fault_backend; // Testing only
+#endif
     bool quiet = false;                         // Suppress progress output
     Terra::Logger::NullOStream null_stream;     // For no logging output
 
@@ -609,6 +788,9 @@ int main(int argc, char *argv[])
                 // Check if this filename is "-"
                 if (file == std::string("-")) stdin_filenames_seen++;
 
+                // Check if this filename is an object URL
+                if (IsS3URL(file)) s3_filenames_seen++;
+
                 // Store name in a secure container
                 filenames.push_back(static_cast<SecureString>(file));
 
@@ -707,7 +889,7 @@ int main(int argc, char *argv[])
             }
 
             // Verify the string is valid UTF-8
-            bool valid_encoding = Terra::CharUtil::IsUTF8Valid(
+            bool valid_encoding = IsUTF8ValidFast(
                 {reinterpret_cast<const std::uint8_t *>(user_password.data()),
                  user_password.size()});
 
@@ -755,6 +937,98 @@ int main(int argc, char *argv[])
             }
         }
 
+        // Was a file descriptor from which to read the key specified?
+        if (options_parser.OptionGiven("keyfd"))
+        {
+            // Not valid when generating keys
+            if (mode == AESCryptMode::KeyGenerate)
+            {
+                std::cerr << "Key descriptor cannot be used when generating "
+                             "a key"
+                          << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            // Ensure a password or key file is not also specified
+            if (!password.empty() || !key_file.empty())
+            {
+                std::cerr << "Key descriptor cannot be used with a password "
+                             "or key file"
+                          << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            options_parser.GetOptionValue("keyfd",
+                                          key_fd,
+                                          0,
+                                          std::numeric_limits<int>::max());
+
+            // The key cannot be read from stdin if stdin is an input file
+            if ((key_fd == 0) && (stdin_filenames_seen > 0))
+            {
+                std::cerr << "Key descriptor cannot be stdin when stdin is "
+                             "used for input"
+                          << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+
+        // Was a directory for generating multiple key files specified?
+        if (options_parser.OptionGiven("keydir"))
+        {
+            // Only valid with generate mode
+            if (mode != AESCryptMode::KeyGenerate)
+            {
+                std::cerr << "Key directory only valid when generating key "
+                             "files"
+                          << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            // A key file name and key directory are mutually exclusive
+            if (!key_file.empty())
+            {
+                std::cerr << "Key file and key directory cannot both be "
+                             "specified"
+                          << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            // Get the user-provided key directory
+            key_directory = options_parser.GetOptionString("keydir");
+
+            // If the length is zero, that is invalid
+            if (key_directory.empty())
+            {
+                std::cerr << "Key directory argument cannot be empty"
+                          << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+
+        // The number of key files to generate
+        if (options_parser.OptionGiven("count"))
+        {
+            // Only valid when generating into a key directory
+            if (key_directory.empty())
+            {
+                std::cerr << "Key count requires a key directory (--keydir)"
+                          << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            options_parser.GetOptionValue("count",
+                                          key_count,
+                                          Min_Key_File_Count,
+                                          Max_Key_File_Count);
+        }
+        else if (!key_directory.empty())
+        {
+            std::cerr << "Key directory requires a key count (--count)"
+                      << std::endl;
+            return EXIT_FAILURE;
+        }
+
         // The key file size parameter is valid only when generating
         if (options_parser.OptionGiven("keysize"))
         {
@@ -788,6 +1062,473 @@ int main(int argc, char *argv[])
                                           KDF_Max_Iterations);
         }
 
+        // The number of files to process concurrently
+        if (options_parser.OptionGiven("jobs"))
+        {
+            // Only valid when encrypting or decrypting
+            if (mode == AESCryptMode::KeyGenerate)
+            {
+                std::cerr << "Jobs value valid only when encrypting or "
+                             "decrypting"
+                          << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            // "auto" selects one job per available processor, while
+            // "adaptive" adjusts the number of jobs as files are processed
+            if (options_parser.GetOptionString("jobs") == "auto")
+            {
+                requested_jobs = 0;
+            }
+            else if (options_parser.GetOptionString("jobs") == "adaptive")
+            {
+                adaptive_jobs = true;
+            }
+            else
+            {
+                options_parser.GetOptionValue("jobs",
+                                              requested_jobs,
+                                              Min_Concurrent_Jobs,
+                                              Max_Concurrent_Jobs);
+            }
+        }
+
+        // The number of upcoming files to open and read ahead
+        if (options_parser.OptionGiven("prefetch"))
+        {
+            // Only valid when encrypting or decrypting
+            if (mode == AESCryptMode::KeyGenerate)
+            {
+                std::cerr << "Prefetch valid only when encrypting or "
+                             "decrypting"
+                          << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            options_parser.GetOptionValue("prefetch",
+                                          batch_options.prefetch_depth,
+                                          Min_Prefetch_Depth,
+                                          Max_Prefetch_Depth);
+        }
+
+        // Was an object storage multipart upload part size specified?
+        if (options_parser.OptionGiven("s3-part-size"))
+        {
+            // Only valid when encrypting or decrypting
+            if (mode == AESCryptMode::KeyGenerate)
+            {
+                std::cerr << "S3 part size valid only when encrypting or "
+                             "decrypting"
+                          << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            auto value =
+                ParseSize(options_parser.GetOptionString("s3-part-size"));
+            if (!value || (*value < Min_S3_Part_Size) ||
+                (*value > Max_S3_Part_Size))
+            {
+                std::cerr << "Invalid S3 part size (5M to 1G)" << std::endl;
+                return EXIT_FAILURE;
+            }
+            batch_options.s3_part_size = static_cast<std::size_t>(*value);
+        }
+
+        // The number of concurrent object storage requests per file
+        if (options_parser.OptionGiven("s3-connections"))
+        {
+            // Only valid when encrypting or decrypting
+            if (mode == AESCryptMode::KeyGenerate)
+            {
+                std::cerr << "S3 connections valid only when encrypting or "
+                             "decrypting"
+                          << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            options_parser.GetOptionValue("s3-connections",
+                                          batch_options.s3_connections,
+                                          Min_S3_Connections,
+                                          Max_S3_Connections);
+        }
+
+        // Was a time limit for flushing encrypted output specified?
+        if (options_parser.OptionGiven("flush-interval"))
+        {
+            // Only valid when encrypting
+            if (mode != AESCryptMode::Encrypt)
+            {
+                std::cerr << "Flush interval valid only when encrypting"
+                          << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            std::size_t flush_interval{};
+            options_parser.GetOptionValue("flush-interval",
+                                          flush_interval,
+                                          Min_Flush_Interval,
+                                          Max_Flush_Interval);
+            batch_options.flush_interval =
+                std::chrono::milliseconds(flush_interval);
+        }
+
+        // Was a size limit for flushing encrypted output specified?
+        if (options_parser.OptionGiven("flush-bytes"))
+        {
+            // Only valid when encrypting
+            if (mode != AESCryptMode::Encrypt)
+            {
+                std::cerr << "Flush bytes valid only when encrypting"
+                          << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            auto value =
+                ParseSize(options_parser.GetOptionString("flush-bytes"));
+            if (!value || (*value < Min_Flush_Bytes) ||
+                (*value > Max_Flush_Bytes))
+            {
+                std::cerr << "Invalid flush bytes (16 to 1G)" << std::endl;
+                return EXIT_FAILURE;
+            }
+            batch_options.flush_bytes = static_cast<std::size_t>(*value);
+        }
+
+        // Was a memory budget specified?
+        if (options_parser.OptionGiven("max-memory"))
+        {
+            // Only valid when encrypting or decrypting
+            if (mode == AESCryptMode::KeyGenerate)
+            {
+                std::cerr << "Memory budget valid only when encrypting or "
+                             "decrypting"
+                          << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            auto value =
+                ParseSize(options_parser.GetOptionString("max-memory"));
+            if (!value || (*value == 0))
+            {
+                std::cerr << "Invalid memory budget (e.g., 512M or 2G)"
+                          << std::endl;
+                return EXIT_FAILURE;
+            }
+            max_memory = *value;
+        }
+
+        // Was a bandwidth limit specified?
+        if (options_parser.OptionGiven("bwlimit"))
+        {
+            // Only valid when encrypting or decrypting
+            if (mode == AESCryptMode::KeyGenerate)
+            {
+                std::cerr << "Bandwidth limit valid only when encrypting or "
+                             "decrypting"
+                          << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            auto limits =
+                ParseBandwidthLimit(options_parser.GetOptionString("bwlimit"));
+            if (!limits)
+            {
+                std::cerr << "Invalid bandwidth limit (e.g., 50M or 50M:20M)"
+                          << std::endl;
+                return EXIT_FAILURE;
+            }
+            read_rate = limits->first;
+            write_rate = limits->second;
+        }
+
+        // Was a file containing bandwidth limits specified?
+        if (options_parser.OptionGiven("bwlimit-file"))
+        {
+            // Only valid when encrypting or decrypting
+            if (mode == AESCryptMode::KeyGenerate)
+            {
+                std::cerr << "Bandwidth limit file valid only when encrypting "
+                             "or decrypting"
+                          << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            bandwidth_file = options_parser.GetOptionString("bwlimit-file");
+
+            // If the length is zero, that is invalid
+            if (bandwidth_file.empty())
+            {
+                std::cerr << "Bandwidth limit file argument cannot be empty"
+                          << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+
+        // Must processing finish by a deadline?
+        if (options_parser.OptionGiven("deadline"))
+        {
+            // Only valid when encrypting or decrypting
+            if (mode == AESCryptMode::KeyGenerate)
+            {
+                std::cerr << "Deadline valid only when encrypting or "
+                             "decrypting"
+                          << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            const auto remaining =
+                ParseDeadline(options_parser.GetOptionString("deadline"));
+            if (!remaining)
+            {
+                std::cerr << "Invalid deadline (e.g., 23:30, 90m, or 1h30m)"
+                          << std::endl;
+                return EXIT_FAILURE;
+            }
+            deadline = std::chrono::steady_clock::now() + *remaining;
+
+            // The files deferred must be recorded
+            if (!options_parser.OptionGiven("deferred-list"))
+            {
+                std::cerr << "A deferred list must be given with a deadline"
+                          << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+
+        // Where are the names of files deferred by the deadline written?
+        if (options_parser.OptionGiven("deferred-list"))
+        {
+            // Only valid with a deadline
+            if (!deadline)
+            {
+                std::cerr << "Deferred list valid only with a deadline"
+                          << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            deferred_list = options_parser.GetOptionString("deferred-list");
+
+            // If the length is zero, that is invalid
+            if (deferred_list.empty())
+            {
+                std::cerr << "Deferred list argument cannot be empty"
+                          << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+
+        // Was an I/O scheduling class specified?
+        if (options_parser.OptionGiven("io-class"))
+        {
+            // Only valid when encrypting or decrypting
+            if (mode == AESCryptMode::KeyGenerate)
+            {
+                std::cerr << "I/O class valid only when encrypting or "
+                             "decrypting"
+                          << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            if (!ParseIOClass(options_parser.GetOptionString("io-class"),
+                              batch_options.thread_priority))
+            {
+                std::cerr << "Invalid I/O class (idle or best-effort[:N], "
+                             "where N is 0 to 7)"
+                          << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+
+        // Was a CPU scheduling priority specified?
+        if (options_parser.OptionGiven("cpu-priority"))
+        {
+            // Only valid when encrypting or decrypting
+            if (mode == AESCryptMode::KeyGenerate)
+            {
+                std::cerr << "CPU priority valid only when encrypting or "
+                             "decrypting"
+                          << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            auto cpu_priority = ParseCPUPriority(
+                options_parser.GetOptionString("cpu-priority"));
+            if (!cpu_priority)
+            {
+                std::cerr << "Invalid CPU priority (normal, batch, or idle)"
+                          << std::endl;
+                return EXIT_FAILURE;
+            }
+            batch_options.thread_priority.cpu_priority = *cpu_priority;
+        }
+
+        // Was a work directory shared with other processes specified?
+        if (options_parser.OptionGiven("coop-dir"))
+        {
+            // Only valid when encrypting or decrypting
+            if (mode == AESCryptMode::KeyGenerate)
+            {
+                std::cerr << "Cooperative work directory valid only when "
+                             "encrypting or decrypting"
+                          << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            // Each process must write outputs named after its input files
+            if (options_parser.OptionGiven("outfile") ||
+                (stdin_filenames_seen > 0))
+            {
+                std::cerr << "Cooperative work directory cannot be used with "
+                             "an output file or stdin"
+                          << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            cooperative_directory = options_parser.GetOptionString("coop-dir");
+
+            // If the length is zero, that is invalid
+            if (cooperative_directory.empty())
+            {
+                std::cerr << "Cooperative work directory argument cannot be "
+                             "empty"
+                          << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+
+        // Was a processor affinity mode specified?
+        if (options_parser.OptionGiven("affinity"))
+        {
+            // Only valid when encrypting or decrypting
+            if (mode == AESCryptMode::KeyGenerate)
+            {
+                std::cerr << "Affinity valid only when encrypting or "
+                             "decrypting"
+                          << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            auto mode_value =
+                ParseAffinityMode(options_parser.GetOptionString("affinity"));
+            if (!mode_value)
+            {
+                std::cerr << "Invalid affinity (none, core, or node)"
+                          << std::endl;
+                return EXIT_FAILURE;
+            }
+            affinity_mode = *mode_value;
+        }
+
+        // Were small files to be queued separately?
+        if (options_parser.OptionGiven("small-files"))
+        {
+            // Only valid when encrypting or decrypting
+            if (mode == AESCryptMode::KeyGenerate)
+            {
+                std::cerr << "Small files valid only when encrypting or "
+                             "decrypting"
+                          << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            auto small_files =
+                ParseSmallFiles(options_parser.GetOptionString("small-files"));
+            if (!small_files)
+            {
+                std::cerr << "Invalid small files value (e.g., 1M or 1M:2)"
+                          << std::endl;
+                return EXIT_FAILURE;
+            }
+            batch_options.small_file_size = small_files->first;
+            small_file_jobs = small_files->second;
+        }
+
+        // Input may be downloaded from object storage when decrypting
+        if ((s3_filenames_seen > 0) && (mode != AESCryptMode::Decrypt))
+        {
+            std::cerr << "Input from object storage is supported only when "
+                         "decrypting"
+                      << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        // Does each input hold several streams written back-to-back?
+        if (options_parser.OptionGiven("multi-stream"))
+        {
+            // Only valid when decrypting
+            if (mode != AESCryptMode::Decrypt)
+            {
+                std::cerr << "Multiple streams valid only when decrypting"
+                          << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            // Object storage input is not split into streams
+            if (s3_filenames_seen > 0)
+            {
+                std::cerr << "Multiple streams cannot be read from object "
+                             "storage"
+                          << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            batch_options.multi_stream = true;
+        }
+
+        // Should encrypted output be verified as it is written?
+        if (options_parser.OptionGiven("verify-after"))
+        {
+            // Only valid when encrypting
+            if (mode != AESCryptMode::Encrypt)
+            {
+                std::cerr << "Verify after valid only when encrypting"
+                          << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            batch_options.verify_after = true;
+        }
+
+        // Should files only be checked for integrity?
+        if (options_parser.OptionGiven("scrub"))
+        {
+            // Only valid when decrypting
+            if (mode != AESCryptMode::Decrypt)
+            {
+                std::cerr << "Scrub valid only when decrypting" << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            // Scrubbing produces no output
+            if (options_parser.OptionGiven("outfile") ||
+                batch_options.multi_stream)
+            {
+                std::cerr << "Scrub cannot be used with an output file or "
+                             "multiple streams"
+                          << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            // Files are checked concurrently unless told otherwise
+            if (!options_parser.OptionGiven("jobs")) requested_jobs = 0;
+
+            batch_options.scrub = true;
+        }
+
+        // Should processing only be planned?
+        if (options_parser.OptionGiven("plan"))
+        {
+            // Only valid when encrypting or decrypting
+            if (mode == AESCryptMode::KeyGenerate)
+            {
+                std::cerr << "Plan valid only when encrypting or decrypting"
+                          << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            plan = true;
+        }
+
         // Was an output file specified?
         if (options_parser.OptionGiven("outfile"))
         {
@@ -821,12 +1562,32 @@ int main(int argc, char *argv[])
 
             // If the output file is stdout, take note
             if (output_file == SecureString("-")) using_stdout = true;
+
+            // Output may be uploaded to object storage when encrypting
+            if (IsS3URL(static_cast<std::string>(output_file)))
+            {
+                if (mode != AESCryptMode::Encrypt)
+                {
+                    std::cerr << "Output to object storage is supported only "
+                                 "when encrypting"
+                              << std::endl;
+                    return EXIT_FAILURE;
+                }
+                if (!ParseS3URL(static_cast<std::string>(output_file)))
+                {
+                    std::cerr << "Invalid object URL (e.g., s3://bucket/key)"
+                              << std::endl;
+                    return EXIT_FAILURE;
+                }
+            }
         }
         else
         {
             // If stdin was specified in the file list, complain that no
-            // output file was specified
-            if (stdin_filenames_seen > 0)
+            // output file was specified (streams split from stdin are
+            // named by number and scrubbing produces no output)
+            if ((stdin_filenames_seen > 0) && !batch_options.multi_stream &&
+                !batch_options.scrub)
             {
                 std::cerr << "Since stdin is used for input, an output "
                              "filename must be specified (may be \"-\")"
@@ -835,6 +1596,48 @@ int main(int argc, char *argv[])
             }
         }
 
+#ifndef AESCRYPT_S3
+        // Object storage support is built only if requested, since
+        // requests are not encrypted
+        if (IsS3URL(static_cast<std::string>(output_file)) ||
+            (s3_filenames_seen > 0))
+        {
+            std::cerr << "Object storage is not supported by this build "
+                         "(see the aescrypt_cli_S3 build option)"
+                      << std::endl;
+            return EXIT_FAILURE;
+        }
+#endif
+
+        // Should output files be written by mapping them into memory?
+        if (options_parser.OptionGiven("mmap-output"))
+        {
+            // Only valid when decrypting
+            if (mode != AESCryptMode::Decrypt)
+            {
+                std::cerr << "Mapped output valid only when decrypting"
+                          << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            batch_options.mmap_output = true;
+        }
+
+        // Should output to stdout be held until it is verified?
+        if (options_parser.OptionGiven("verified-output"))
+        {
+            // Only valid when decrypting to stdout
+            if ((mode != AESCryptMode::Decrypt) || !using_stdout)
+            {
+                std::cerr << "Verified output valid only when decrypting to "
+                             "stdout"
+                          << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            batch_options.verified_output = true;
+        }
+
         // Was logging requested?
         if (options_parser.OptionGiven("logging"))
         {
@@ -873,6 +1676,18 @@ int main(int argc, char *argv[])
     // If generating a key file, do that now
     if (mode == AESCryptMode::KeyGenerate)
     {
+        // If generating into a directory, produce all of the key files
+        if (!key_directory.empty())
+        {
+            if (!GenerateKeyFiles(logger, key_directory, key_size, key_count))
+            {
+                std::cerr << "Unable to generate the key files" << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            return EXIT_SUCCESS;
+        }
+
         // Ensure a key file was given
         if (key_file.empty())
         {
@@ -904,8 +1719,46 @@ int main(int argc, char *argv[])
         }
     }
 
-    // Prompt for a password if one was not provided
-    if (password.empty())
+    // If a key file descriptor was provided, read the key from it
+    if (key_fd >= 0)
+    {
+        // Read the key (converting it to a password)
+        password = ReadKeyFileDescriptor(logger, key_fd);
+
+        // If the password is empty, that is a problem
+        if (password.empty())
+        {
+            std::cerr << "Unable to get a key from the key descriptor"
+                      << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Files are opened through the file backend, with faults injected if
+    // requested via the environment in builds that support it (for testing)
+    batch_options.io_backend = &file_backend;
+#ifdef AESCRYPT_FAULT_INJECTION
+    if (const char *faults = std::getenv(Fault_Injection_Variable);
+        (faults != nullptr) && (*faults != '\0'))
+    {
+        const auto fault_settings = ParseFaultSettings(faults);
+        if (!fault_settings)
+        {
+            std::cerr << "Invalid fault injection settings in "
+                      << Fault_Injection_Variable << std::endl;
+            return EXIT_FAILURE;
+        }
+        fault_backend = std::make_unique<FaultInjectionBackend>(
+            logger,
+            file_backend,
+            *fault_settings);
+        batch_options.io_backend = fault_backend.get();
+    }
+#endif
+
+    // Prompt for a password if one was not provided (planning does not
+    // process files, so it needs none)
+    if (password.empty() && !plan)
     {
 #ifdef _WIN32
         if (using_stdout)
@@ -968,42 +1821,238 @@ int main(int argc, char *argv[])
     }
 #endif
 
+    // Size concurrent processing to fit the available resources, including
+    // the parts held for object storage transfers; with adaptive
+    // concurrency, this is the most jobs that will be tried
+    batch_options.object_storage =
+        IsS3URL(static_cast<std::string>(output_file)) ||
+        (s3_filenames_seen > 0);
+    const SystemResources resources = GetSystemResources(logger);
+    if (adaptive_jobs)
+    {
+        requested_jobs = std::min(
+            resources.cpu_count * Adaptive_Jobs_Per_Processor,
+            Max_Concurrent_Jobs);
+    }
+    if (!SizeBatchResources(logger,
+                            resources,
+                            requested_jobs,
+                            max_memory,
+                            filenames.size(),
+                            batch_options))
+    {
+        std::cerr << "Memory budget is too small to process files"
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // Reserve jobs for small files, leaving at least one for large files
+    if (batch_options.small_file_size > 0)
+    {
+        if (small_file_jobs == 0)
+        {
+            small_file_jobs = std::max<std::size_t>(batch_options.jobs / 4, 1);
+        }
+        batch_options.small_file_jobs =
+            std::min(small_file_jobs, batch_options.jobs - 1);
+    }
+
+    // Extensions inserted into the header of each encrypted stream
+    const std::vector<std::pair<std::string, std::string>> extensions =
+    {
+        {"CREATED_BY", Project_Name + " " + Project_Version}
+    };
+
+    // If only planning, report the plan without processing any files
+    if (plan)
+    {
+        return PlanBatch(logger,
+                         (mode == AESCryptMode::Encrypt),
+                         batch_options,
+                         iterations,
+                         extensions,
+                         filenames,
+                         output_file)
+                   ? EXIT_SUCCESS
+                   : EXIT_FAILURE;
+    }
+
+    // Determine the processors on which each job runs, if requested
+    if (affinity_mode != AffinityMode::None)
+    {
+        batch_options.worker_cpus =
+            AssignWorkerCPUs(logger, GetCPUTopology(logger), affinity_mode);
+    }
+
+    // Create the controller to adapt the number of concurrent jobs
+    if (adaptive_jobs && (batch_options.jobs > 1))
+    {
+        concurrency_controller =
+            std::make_unique<ConcurrencyController>(logger,
+                                                    batch_options.jobs);
+        batch_options.concurrency_controller = concurrency_controller.get();
+    }
+
+    // Create the deadline by which processing must finish, if requested
+    if (deadline)
+    {
+        batch_deadline = std::make_unique<BatchDeadline>(logger, *deadline);
+        batch_options.deadline = batch_deadline.get();
+    }
+
+    // Join other processes sharing the work directory, if requested
+    if (!cooperative_directory.empty())
+    {
+        try
+        {
+            std::filesystem::create_directories(cooperative_directory);
+        }
+        catch (const std::exception &e)
+        {
+            logger->error << "Unable to create cooperative work directory "
+                             "(err="
+                          << e.what() << ")" << std::flush;
+            std::cerr << "Unable to create cooperative work directory: "
+                      << cooperative_directory << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        cooperative_batch =
+            std::make_unique<CooperativeBatch>(logger,
+                                               process_control,
+                                               cooperative_directory,
+                                               filenames);
+        batch_options.cooperative_batch = cooperative_batch.get();
+    }
+
+#ifdef AESCRYPT_S3
+    // Create the object storage client if output is uploaded or input is
+    // downloaded
+    if (IsS3URL(static_cast<std::string>(output_file)) ||
+        (s3_filenames_seen > 0))
+    {
+        std::string error;
+
+        const auto s3_config = GetS3Config(error);
+        if (!s3_config)
+        {
+            std::cerr << "Unable to use object storage: " << error
+                      << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        s3_client = std::make_unique<S3Client>(logger,
+                                               process_control,
+                                               *s3_config);
+        batch_options.s3_client = s3_client.get();
+    }
+#endif
+
+    // Create the bandwidth limiter shared by all jobs, if requested
+    if (options_parser.OptionGiven("bwlimit") || !bandwidth_file.empty())
+    {
+        bandwidth_limiter = std::make_unique<BandwidthLimiter>(logger,
+                                                               process_control,
+                                                               read_rate,
+                                                               write_rate,
+                                                               bandwidth_file);
+
+        // Without --bwlimit, the initial limits come from the limits file
+        if (!options_parser.OptionGiven("bwlimit") &&
+            !bandwidth_limiter->Reload())
+        {
+            std::cerr << "Unable to read bandwidth limits from file: "
+                      << bandwidth_file << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        batch_options.bandwidth_limiter = bandwidth_limiter.get();
+    }
+
     // Install signal handlers to ensure proper cleanup if user aborts
-    InstallSignalHandlers();
+    InstallSignalHandlers(!bandwidth_file.empty());
 
     try
     {
+        bool result{};
+
         // If encrypting, do that now
         if (mode == AESCryptMode::Encrypt)
         {
-            // Create extensions vector to be inserted into stream header
-            const std::vector<std::pair<std::string, std::string>> extensions =
+            // Encrypt files, disabling progress updates as appropriate
+            result = EncryptFiles(logger,
+                                  process_control,
+                                  batch_options,
+                                  (quiet || using_stdout),
+                                  password,
+                                  iterations,
+                                  filenames,
+                                  output_file,
+                                  extensions);
+        }
+        else
+        {
+            // Decrypt files, disabling progress updates as appropriate
+            result = DecryptFiles(logger,
+                                  process_control,
+                                  batch_options,
+                                  (quiet || using_stdout),
+                                  password,
+                                  filenames,
+                                  output_file);
+        }
+
+        // Record the files deferred by the deadline for a later batch
+        if (batch_deadline)
+        {
+            const std::size_t deferred = batch_deadline->Deferred().size();
+
+            if (!batch_deadline->WriteDeferred(deferred_list, filenames))
+            {
+                std::cerr << "Unable to write deferred list: "
+                          << deferred_list << std::endl;
+                result = false;
+            }
+            else if ((deferred > 0) && !quiet && !using_stdout)
             {
-                {"CREATED_BY", Project_Name + " " + Project_Version}
-            };
+                std::cout << "Deferred " << deferred << " file(s) to "
+                          << deferred_list << std::endl;
+            }
+        }
 
-            // Encrypt files, disabling progress updates as appropriate
-            bool encrypt_result = EncryptFiles(logger,
-                                               process_control,
-                                               (quiet || using_stdout),
-                                               password,
-                                               iterations,
-                                               filenames,
-                                               output_file,
-                                               extensions);
+        // Report the time spent waiting to observe bandwidth limits
+        if (bandwidth_limiter)
+        {
+            const std::chrono::duration<double> throttled =
+                bandwidth_limiter->ThrottledTime();
+
+            logger->info << "Time spent throttled: " << throttled.count()
+                         << " seconds" << std::flush;
 
-            return (encrypt_result ? EXIT_SUCCESS : EXIT_FAILURE);
+            if (!quiet && !using_stdout)
+            {
+                std::cout << "Time spent throttled: " << std::fixed
+                          << std::setprecision(1) << throttled.count()
+                          << " seconds" << std::endl;
+            }
         }
 
-        // Decrypt files, disabling progress updates as appropriate
-        auto decrypt_result = DecryptFiles(logger,
-                                           process_control,
-                                           (quiet || using_stdout),
-                                           password,
-                                           filenames,
-                                           output_file);
+        // Report the concurrency that performed best for use in later runs
+        if (concurrency_controller)
+        {
+            logger->info << "Best observed concurrency: "
+                         << concurrency_controller->BestJobs() << " jobs"
+                         << std::flush;
+
+            if (!quiet && !using_stdout)
+            {
+                std::cout << "Best observed concurrency: "
+                          << concurrency_controller->BestJobs() << " jobs"
+                          << std::endl;
+            }
+        }
 
-        return (decrypt_result ? EXIT_SUCCESS : EXIT_FAILURE);
+        return (result ? EXIT_SUCCESS : EXIT_FAILURE);
     }
     catch (const std::exception &e)
     {
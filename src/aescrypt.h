@@ -34,5 +34,56 @@ constexpr std::size_t Default_Key_File_Size = 64;   // 384 bits of entropy
 constexpr std::size_t Min_Key_File_Size = 43;       // 258 bits of entropy
 constexpr std::size_t Max_Key_File_Size = 4096;     // 24576 bits of entropy
 
-// Size in octets of buffer for file I/O
+// Define the maximum size of a key file (or key descriptor data) to read
+constexpr std::size_t Max_Key_Read_Size = 16'777'216;
+
+// Define the range for the number of key files that may be generated at once
+constexpr std::size_t Min_Key_File_Count = 1;
+constexpr std::size_t Max_Key_File_Count = 1'000'000;
+
+// Size in octets of buffer for file I/O (and the minimum to which buffers
+// may be reduced to fit within a memory budget)
 constexpr std::size_t Buffered_IO_Size = 131'072;
+constexpr std::size_t Min_Buffered_IO_Size = 16'384;
+
+// Size in octets of the buffer for file I/O when scrubbing, as input is
+// only read and larger reads reduce the number of system calls
+constexpr std::size_t Scrub_IO_Size = 4'194'304;
+
+// Range of the number of files that may be processed concurrently
+constexpr std::size_t Min_Concurrent_Jobs = 1;
+constexpr std::size_t Max_Concurrent_Jobs = 1024;
+
+// With adaptive concurrency, the most jobs that may be tried per processor
+constexpr std::size_t Adaptive_Jobs_Per_Processor = 2;
+
+// Range of the number of files that may be opened ahead of processing and
+// the number of octets at the start of each file to prefetch
+constexpr std::size_t Min_Prefetch_Depth = 0;
+constexpr std::size_t Max_Prefetch_Depth = 256;
+constexpr std::size_t Prefetch_Read_Size = 4'194'304;
+
+// Range and default of the size of each part of a multipart upload to
+// object storage (all parts but the last must be at least 5 MiB); parts are
+// held in memory, so the maximum is well below the 5 GiB that is permitted
+constexpr std::size_t Min_S3_Part_Size = 5'242'880;
+constexpr std::size_t Default_S3_Part_Size = 8'388'608;
+constexpr std::size_t Max_S3_Part_Size = 1'073'741'824;
+
+// Range and default of the number of concurrent object storage requests
+// made for each file
+constexpr std::size_t Min_S3_Connections = 1;
+constexpr std::size_t Default_S3_Connections = 4;
+constexpr std::size_t Max_S3_Connections = 64;
+
+// Range of the time in milliseconds that encrypted output may wait before
+// being flushed and of the number of octets after which it is flushed (at
+// least one AES block)
+constexpr std::size_t Min_Flush_Interval = 1;
+constexpr std::size_t Max_Flush_Interval = 3'600'000;
+constexpr std::size_t Min_Flush_Bytes = 16;
+constexpr std::size_t Max_Flush_Bytes = 1'073'741'824;
+
+// The most ciphertext held in memory to be decrypted when verifying output
+// as it is written
+constexpr std::size_t Verify_Queue_Size = 4'194'304;
@@ -0,0 +1,302 @@
+/*
+ *  batch_deadline.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file implements the BatchDeadline object, which decides whether
+ *      a file may be started given the time by which a batch must finish.
+ *
+ *  Portability Issues:
+ *      None.
+ */
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include "batch_deadline.h"
+
+/*
+ *  BatchDeadline::BatchDeadline()
+ *
+ *  Description:
+ *      Constructor for the BatchDeadline object.
+ *
+ *  Parameters:
+ *      parent_logger [in]
+ *          A parent logger to which the child logger would direct logging
+ *          messages.
+ *
+ *      deadline [in]
+ *          The time by which processing must finish.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+BatchDeadline::BatchDeadline(const Terra::Logger::LoggerPointer &parent_logger,
+                             std::chrono::steady_clock::time_point deadline) :
+    logger{std::make_shared<Terra::Logger::Logger>(parent_logger, "DEAD")},
+    deadline{deadline},
+    octets{0},
+    busy{0},
+    shortest{0},
+    files{0},
+    reached{false}
+{
+}
+
+/*
+ *  BatchDeadline::Admit()
+ *
+ *  Description:
+ *      Determine whether a file may be started, which is the case if it is
+ *      projected to finish by the deadline.
+ *
+ *  Parameters:
+ *      size [in]
+ *          The size of the file, or the largest possible value if unknown.
+ *
+ *  Returns:
+ *      True if the file may be started, false if it, and every file after
+ *      it, is to be deferred.
+ *
+ *  Comments:
+ *      This may be called concurrently by multiple jobs.
+ */
+bool BatchDeadline::Admit(std::uint64_t size)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (reached) return false;
+
+    const auto now = std::chrono::steady_clock::now();
+    const auto projected = Project(size);
+
+    if (now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                  projected) <=
+        deadline)
+    {
+        return true;
+    }
+
+    reached = true;
+
+    logger->info << "File projected to take " << projected.count()
+                 << " s would finish after the deadline; deferring "
+                    "remaining files"
+                 << std::flush;
+
+    return false;
+}
+
+/*
+ *  BatchDeadline::Completed()
+ *
+ *  Description:
+ *      Record the time taken to process a file, which refines the
+ *      projections for the files that follow.
+ *
+ *  Parameters:
+ *      size [in]
+ *          The size of the file, or the largest possible value if unknown.
+ *
+ *      elapsed [in]
+ *          The time taken to process the file.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      Files of unknown size contribute only to the shortest time.
+ */
+void BatchDeadline::Completed(std::uint64_t size,
+                              std::chrono::steady_clock::duration elapsed)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    const std::chrono::duration<double> seconds = elapsed;
+
+    shortest = (files == 0) ? seconds : std::min(shortest, seconds);
+    files++;
+
+    if (size != std::numeric_limits<std::uint64_t>::max())
+    {
+        octets += size;
+        busy += seconds;
+    }
+}
+
+/*
+ *  BatchDeadline::Reached()
+ *
+ *  Description:
+ *      Determine whether files are no longer being started.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      True once a file has been deferred.
+ *
+ *  Comments:
+ *      None.
+ */
+bool BatchDeadline::Reached()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    return reached;
+}
+
+/*
+ *  BatchDeadline::Defer()
+ *
+ *  Description:
+ *      Record that a file was deferred to a later batch.
+ *
+ *  Parameters:
+ *      index [in]
+ *          The index of the file in the batch.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+void BatchDeadline::Defer(std::size_t index)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    deferred.push_back(index);
+}
+
+/*
+ *  BatchDeadline::Deferred()
+ *
+ *  Description:
+ *      Return the files deferred to a later batch.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      The indices of the deferred files in ascending order.
+ *
+ *  Comments:
+ *      None.
+ */
+std::vector<std::size_t> BatchDeadline::Deferred()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    std::vector<std::size_t> indices = deferred;
+    std::sort(indices.begin(), indices.end());
+
+    return indices;
+}
+
+/*
+ *  BatchDeadline::WriteDeferred()
+ *
+ *  Description:
+ *      Write the names of the deferred files to the given list file, each
+ *      terminated by a NUL character.
+ *
+ *  Parameters:
+ *      list_file [in]
+ *          The name of the list file, which is replaced.
+ *
+ *      filenames [in]
+ *          The names of the files in the batch.
+ *
+ *  Returns:
+ *      True if the list was written, false if not.
+ *
+ *  Comments:
+ *      The list is written even if empty, so that a list left by an
+ *      earlier batch does not cause files to be processed again.  The list
+ *      is suitable for use with "xargs -0".
+ */
+bool BatchDeadline::WriteDeferred(const std::string &list_file,
+                                  const std::vector<SecureString> &filenames)
+{
+    const std::vector<std::size_t> indices = Deferred();
+    std::ofstream ofs;
+
+    try
+    {
+        ofs.open(std::filesystem::path(
+                     std::u8string(list_file.cbegin(), list_file.cend())),
+                 std::ios::out | std::ios::binary | std::ios::trunc);
+    }
+    catch (const std::exception &e)
+    {
+        logger->error << "Exception opening deferred list: " << list_file
+                      << " (err=" << e.what() << ")" << std::flush;
+        return false;
+    }
+    catch (...)
+    {
+        logger->error << "Exception opening deferred list: " << list_file
+                      << std::flush;
+        return false;
+    }
+    if (!ofs.good() || !ofs.is_open()) return false;
+
+    for (const std::size_t index : indices)
+    {
+        const SecureString &filename = filenames[index];
+        ofs.write(filename.data(),
+                  static_cast<std::streamsize>(filename.size()));
+        ofs.put('\0');
+    }
+
+    ofs.close();
+    if (ofs.fail()) return false;
+
+    logger->info << "Deferred " << indices.size() << " files to "
+                 << list_file << std::flush;
+
+    return true;
+}
+
+/*
+ *  BatchDeadline::Project()
+ *
+ *  Description:
+ *      Project the time to process a file of the given size.
+ *
+ *  Parameters:
+ *      size [in]
+ *          The size of the file, or the largest possible value if unknown.
+ *
+ *  Returns:
+ *      The projected time, which is zero until a file has completed.
+ *
+ *  Comments:
+ *      The mutex must be locked when calling this function.
+ */
+std::chrono::duration<double> BatchDeadline::Project(std::uint64_t size) const
+{
+    if (files == 0) return std::chrono::duration<double>(0);
+
+    // Without a size or an observed throughput, use the shortest time
+    if ((size == std::numeric_limits<std::uint64_t>::max()) || (octets == 0))
+    {
+        return shortest;
+    }
+
+    return std::max(shortest,
+                    busy * (static_cast<double>(size) /
+                            static_cast<double>(octets)));
+}
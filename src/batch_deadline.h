@@ -0,0 +1,67 @@
+/*
+ *  batch_deadline.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file defines the BatchDeadline object, which decides whether a
+ *      file may be started given the time by which a batch must finish.
+ *
+ *      The time to process a file is projected from the files completed so
+ *      far: the file's size divided by the observed throughput, but no less
+ *      than the shortest time observed for any file (which approximates the
+ *      fixed cost, such as key derivation).  Until a file completes, files
+ *      are started as long as the deadline has not passed.  Once a file is
+ *      projected to finish after the deadline, no further files are started.
+ *      The names of the files deferred may be written to a list, each
+ *      terminated by a NUL, for processing in a later batch.
+ *
+ *  Portability Issues:
+ *      None.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <terra/logger/logger.h>
+#include "secure_containers.h"
+
+// Decides whether files may be started before a batch's deadline
+class BatchDeadline
+{
+    public:
+        BatchDeadline(const Terra::Logger::LoggerPointer &parent_logger,
+                      std::chrono::steady_clock::time_point deadline);
+        ~BatchDeadline() = default;
+
+        bool Admit(std::uint64_t size);
+        void Completed(std::uint64_t size,
+                       std::chrono::steady_clock::duration elapsed);
+        bool Reached();
+        void Defer(std::size_t index);
+        std::vector<std::size_t> Deferred();
+        bool WriteDeferred(const std::string &list_file,
+                           const std::vector<SecureString> &filenames);
+
+    protected:
+        std::chrono::duration<double> Project(std::uint64_t size) const;
+
+        Terra::Logger::LoggerPointer logger;
+        std::chrono::steady_clock::time_point deadline;
+        std::mutex mutex;
+        std::uint64_t octets;                   // Octets in completed files
+        std::chrono::duration<double> busy;     // Time spent on those files
+        std::chrono::duration<double> shortest; // Shortest time for a file
+        std::size_t files;                      // Files completed
+        bool reached;                           // No more files are started
+        std::vector<std::size_t> deferred;      // Indices of deferred files
+};
@@ -0,0 +1,63 @@
+/*
+ *  batch_options.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This header defines the BatchOptions structure that controls how a
+ *      set of files is processed when encrypting or decrypting.
+ *
+ *  Portability Issues:
+ *      None.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <chrono>
+#include <vector>
+#include "aescrypt.h"
+#include "rate_limiter.h"
+#include "thread_priority.h"
+#include "concurrency_controller.h"
+#include "cpu_topology.h"
+#include "cooperative_batch.h"
+#include "s3_client.h"
+#include "batch_deadline.h"
+#include "io_backend.h"
+#include "output_spool.h"
+
+// Options controlling the processing of a set of files
+struct BatchOptions
+{
+    std::size_t jobs{1};                        // Files processed concurrently
+    std::size_t io_buffer_size{Buffered_IO_Size};// Size of each I/O buffer
+    BandwidthLimiter *bandwidth_limiter{};      // Shared limiter (optional)
+    ThreadPriority thread_priority;             // Priority of worker threads
+    ConcurrencyController *concurrency_controller{};// Adaptive jobs (optional)
+    std::vector<std::vector<int>> worker_cpus;  // Processors for each job
+    std::uint64_t small_file_size{};            // Small file limit (0 = none)
+    std::size_t small_file_jobs{};              // Jobs reserved for small files
+    std::size_t prefetch_depth{};               // Files to open ahead
+    CooperativeBatch *cooperative_batch{};      // Shared work (optional)
+    const S3Client *s3_client{};                // Object storage (optional)
+    std::size_t s3_part_size{Default_S3_Part_Size};// Multipart upload part size
+    std::size_t s3_connections{Default_S3_Connections};// Concurrent requests
+    bool object_storage{};                      // Any file is an object
+    std::chrono::milliseconds flush_interval{}; // Output flush time (0 = none)
+    std::size_t flush_bytes{};                  // Output flush size (0 = none)
+    bool multi_stream{};                        // Input has several streams
+    bool verify_after{};                        // Verify output by decrypting
+    bool scrub{};                               // Check integrity only
+    bool verified_output{};                     // Hold stdout until verified
+    std::uint64_t spool_memory{Default_Spool_Memory};// Memory for held output
+    bool mmap_output{};                         // Map output files to write
+    BatchDeadline *deadline{};                  // Batch deadline (optional)
+    IOBackend *io_backend{};                    // Opens files for I/O
+};
@@ -0,0 +1,663 @@
+/*
+ *  batch_plan.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file implements a function that plans the processing of a set
+ *      of files without processing them, estimating the output produced,
+ *      the time required, and whether there is space for the output.
+ *
+ *  Portability Issues:
+ *      The filesystem holding each output directory is found by walking up
+ *      to the mount point on POSIX systems and by asking for the volume
+ *      mount point on Windows.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <optional>
+#include <queue>
+#include <sstream>
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <sys/stat.h>
+#endif
+#include <terra/aescrypt/engine/encryptor.h>
+#include <terra/aescrypt/engine/decryptor.h>
+#include "batch_plan.h"
+#include "sink_stream.h"
+#include "s3_url.h"
+
+namespace
+{
+
+// Amount of sample data encrypted and decrypted to measure throughput
+constexpr std::size_t Calibration_Size = 16'777'216;
+
+// Size of an AES block, to which encrypted output is padded
+constexpr std::uint64_t AES_Block_Size = 16;
+
+// Rates measured by processing sample data in memory
+struct Calibration
+{
+    double kdf_seconds{};                       // Time to derive keys
+    double octets_per_second{};                 // Rate of a single job
+    std::uint64_t overhead{};                   // Header and trailer octets
+};
+
+// Output to be written to a single filesystem
+struct FilesystemUsage
+{
+    std::uint64_t required{};                   // Octets to be written
+    std::size_t files{};                        // Output files
+};
+
+/*
+ *  Calibrate()
+ *
+ *  Description:
+ *      Measure the time required to derive keys and the rate at which data
+ *      is processed by encrypting (and, if decrypting, decrypting) sample
+ *      data in memory.
+ *
+ *  Parameters:
+ *      logger [in]
+ *          The logger to which logging output will be sent.
+ *
+ *      encrypting [in]
+ *          True if files would be encrypted, false if decrypted.
+ *
+ *      iterations [in]
+ *          The number of KDF iterations to use.
+ *
+ *      extensions [in]
+ *          The extensions placed in each encrypted stream.
+ *
+ *      calibration [out]
+ *          The measured rates and the size of the header and trailer of an
+ *          encrypted stream.
+ *
+ *  Returns:
+ *      True if the measurements were made, false if not.
+ *
+ *  Comments:
+ *      Empty input encrypts to the header, one block of padding, and the
+ *      trailer, so the size of that output gives the exact overhead.
+ */
+bool Calibrate(
+    const Terra::Logger::LoggerPointer &logger,
+    bool encrypting,
+    std::uint32_t iterations,
+    const std::vector<std::pair<std::string, std::string>> &extensions,
+    Calibration &calibration)
+{
+    using namespace Terra::AESCrypt::Engine;
+
+    const std::u8string password = u8"calibration";
+    const std::string sample(Calibration_Size, '\0');
+    std::istringstream empty_plaintext;
+    std::istringstream sample_plaintext(sample);
+    std::ostringstream empty_ciphertext;
+    std::ostringstream sample_ciphertext;
+    std::chrono::steady_clock::time_point start;
+
+    auto seconds_since = [&]() -> double
+    {
+        return std::chrono::duration<double>(
+                   std::chrono::steady_clock::now() - start)
+            .count();
+    };
+
+    // Encrypt empty input, which measures the cost of key derivation
+    Encryptor encryptor(logger);
+    start = std::chrono::steady_clock::now();
+    if (encryptor.Encrypt(password,
+                          iterations,
+                          empty_plaintext,
+                          empty_ciphertext,
+                          extensions,
+                          {},
+                          0) != EncryptResult::Success)
+    {
+        return false;
+    }
+    calibration.kdf_seconds = seconds_since();
+
+    // Encrypt the sample data
+    start = std::chrono::steady_clock::now();
+    if (encryptor.Encrypt(password,
+                          iterations,
+                          sample_plaintext,
+                          sample_ciphertext,
+                          extensions,
+                          {},
+                          0) != EncryptResult::Success)
+    {
+        return false;
+    }
+    double sample_seconds = seconds_since();
+
+    const std::string empty_stream = empty_ciphertext.str();
+    if (empty_stream.size() < AES_Block_Size) return false;
+    calibration.overhead = empty_stream.size() - AES_Block_Size;
+
+    // When decrypting, measure decryption of the same streams
+    if (!encrypting)
+    {
+        Decryptor decryptor(logger);
+        std::istringstream empty_input(empty_stream);
+        std::istringstream sample_input(sample_ciphertext.str());
+        NullOStream plaintext;
+
+        start = std::chrono::steady_clock::now();
+        if (decryptor.Decrypt(password, empty_input, plaintext, {}, 0) !=
+            DecryptResult::Success)
+        {
+            return false;
+        }
+        calibration.kdf_seconds = seconds_since();
+
+        start = std::chrono::steady_clock::now();
+        if (decryptor.Decrypt(password, sample_input, plaintext, {}, 0) !=
+            DecryptResult::Success)
+        {
+            return false;
+        }
+        sample_seconds = seconds_since();
+    }
+
+    calibration.octets_per_second =
+        static_cast<double>(Calibration_Size) /
+        std::max(sample_seconds - calibration.kdf_seconds, 1e-6);
+
+    logger->info << "Calibrated key derivation at "
+                 << calibration.kdf_seconds << " s and throughput at "
+                 << calibration.octets_per_second << " octets/s"
+                 << std::flush;
+
+    return true;
+}
+
+/*
+ *  FilesystemRoot()
+ *
+ *  Description:
+ *      Determine the mount point of the filesystem holding the given
+ *      directory.
+ *
+ *  Parameters:
+ *      directory [in]
+ *          The directory, which must exist.
+ *
+ *  Returns:
+ *      The mount point, or no value if it could not be determined.
+ *
+ *  Comments:
+ *      The mount point identifies the filesystem, so output to directories
+ *      on the same filesystem is totaled.
+ */
+std::optional<std::filesystem::path> FilesystemRoot(
+    const std::filesystem::path &directory)
+{
+    std::filesystem::path path = std::filesystem::canonical(directory);
+
+#ifdef _WIN32
+    wchar_t volume[MAX_PATH + 1]{};
+    if (!GetVolumePathNameW(path.c_str(), volume, MAX_PATH + 1)) return {};
+
+    return std::filesystem::path(volume);
+#else
+    struct stat status{};
+    if (stat(path.c_str(), &status) != 0) return {};
+
+    // Walk up while the parent is on the same device
+    while (path.has_parent_path() && (path.parent_path() != path))
+    {
+        struct stat parent_status{};
+        if ((stat(path.parent_path().c_str(), &parent_status) != 0) ||
+            (parent_status.st_dev != status.st_dev))
+        {
+            break;
+        }
+        path = path.parent_path();
+    }
+
+    return path;
+#endif
+}
+
+/*
+ *  EstimateWallTime()
+ *
+ *  Description:
+ *      Estimate the time to process files given the time for each, with
+ *      each job taking the next file once it finishes the previous one.
+ *
+ *  Parameters:
+ *      file_seconds [in]
+ *          The time to process each file, in the order processed.
+ *
+ *      jobs [in]
+ *          The number of concurrent jobs.
+ *
+ *  Returns:
+ *      The time at which the last job finishes.
+ *
+ *  Comments:
+ *      None.
+ */
+double EstimateWallTime(const std::vector<double> &file_seconds,
+                        std::size_t jobs)
+{
+    std::priority_queue<double, std::vector<double>, std::greater<double>>
+        finish_times;
+    double wall_time{};
+
+    for (std::size_t i = 0; i < std::max<std::size_t>(jobs, 1); i++)
+    {
+        finish_times.push(0.0);
+    }
+
+    for (const double seconds : file_seconds)
+    {
+        const double finish = finish_times.top() + seconds;
+        finish_times.pop();
+        finish_times.push(finish);
+        wall_time = std::max(wall_time, finish);
+    }
+
+    return wall_time;
+}
+
+/*
+ *  FormatSize()
+ *
+ *  Description:
+ *      Format a number of octets for display.
+ *
+ *  Parameters:
+ *      octets [in]
+ *          The number of octets.
+ *
+ *  Returns:
+ *      The number of octets followed, if large, by an approximation using
+ *      binary units (e.g., "1610612736 octets (1.5 GiB)").
+ *
+ *  Comments:
+ *      None.
+ */
+std::string FormatSize(std::uint64_t octets)
+{
+    static const char *units[] = {"KiB", "MiB", "GiB", "TiB", "PiB"};
+    std::ostringstream oss;
+
+    oss << octets << " octets";
+
+    if (octets >= 1024)
+    {
+        double value = static_cast<double>(octets) / 1024.0;
+        std::size_t unit = 0;
+        while ((value >= 1024.0) && (unit + 1 < std::size(units)))
+        {
+            value /= 1024.0;
+            unit++;
+        }
+        oss << " (" << std::fixed << std::setprecision(1) << value << " "
+            << units[unit] << ")";
+    }
+
+    return oss.str();
+}
+
+/*
+ *  FormatDuration()
+ *
+ *  Description:
+ *      Format a duration for display as hours, minutes, and seconds.
+ *
+ *  Parameters:
+ *      seconds [in]
+ *          The duration in seconds.
+ *
+ *  Returns:
+ *      The duration as H:MM:SS, rounded up to a whole second.
+ *
+ *  Comments:
+ *      None.
+ */
+std::string FormatDuration(double seconds)
+{
+    const auto total = static_cast<std::uint64_t>(std::ceil(seconds));
+    std::ostringstream oss;
+
+    oss << (total / 3600) << ":" << std::setfill('0') << std::setw(2)
+        << ((total / 60) % 60) << ":" << std::setw(2) << (total % 60);
+
+    return oss.str();
+}
+
+/*
+ *  StripAESExtension()
+ *
+ *  Description:
+ *      Remove the .aes extension (in any case) from the given name.
+ *
+ *  Parameters:
+ *      name [in]
+ *          The name of an encrypted file or object.
+ *
+ *  Returns:
+ *      The name without the extension, or an empty string if the name does
+ *      not end with .aes or consists only of it.
+ *
+ *  Comments:
+ *      None.
+ */
+SecureString StripAESExtension(const SecureString &name)
+{
+    if (name.size() <= 4) return {};
+
+    SecureString extension = name.substr(name.size() - 4);
+    std::transform(extension.begin(),
+                   extension.end(),
+                   extension.begin(),
+                   [](char c) -> char
+                   {
+                       return ((c >= 'A') && (c <= 'Z')) ? (c - 'A' + 'a')
+                                                         : c;
+                   });
+    if (extension != ".aes") return {};
+
+    return name.substr(0, name.size() - 4);
+}
+
+} // namespace
+
+/*
+ *  PlanBatch()
+ *
+ *  Description:
+ *      This function will examine the given files and report the output
+ *      that encrypting or decrypting them would produce, an estimate of the
+ *      time required, and the free space on each filesystem to which output
+ *      would be written.  Nothing is written to any file.
+ *
+ *  Parameters:
+ *      parent_logger [in]
+ *          A parent logger to which the child logger would direct logging
+ *          messages.
+ *
+ *      encrypting [in]
+ *          True if the files would be encrypted, false if decrypted.
+ *
+ *      batch_options [in]
+ *          Options controlling how the files would be processed, including
+ *          the number of concurrent jobs.
+ *
+ *      iterations [in]
+ *          The number of KDF iterations used when encrypting (and assumed
+ *          when decrypting).
+ *
+ *      extensions [in]
+ *          The extensions that would be placed in each encrypted stream.
+ *
+ *      filenames [in]
+ *          The names of the files to process.
+ *
+ *      output_file [in]
+ *          The name of the output file if output would go to a single file.
+ *
+ *  Returns:
+ *      True if the files could be processed, false if an input is missing,
+ *      an output exists, or there is insufficient space for the output.
+ *
+ *  Comments:
+ *      The size of encrypted output is exact.  The size of decrypted output
+ *      is bounded by the size of the input, since the padding removed is
+ *      known only once decrypted.  The time estimate does not account for
+ *      bandwidth limits or the storage, which may be slower than the
+ *      processors.
+ */
+bool PlanBatch(
+    const Terra::Logger::LoggerPointer &parent_logger,
+    bool encrypting,
+    const BatchOptions &batch_options,
+    std::uint32_t iterations,
+    const std::vector<std::pair<std::string, std::string>> &extensions,
+    const std::vector<SecureString> &filenames,
+    const SecureString &output_file)
+{
+    Calibration calibration;
+    std::uint64_t input_octets{};
+    std::uint64_t output_octets{};
+    std::size_t unknown_sizes{};
+    std::vector<double> file_seconds;
+    std::map<std::filesystem::path, FilesystemUsage> usage;
+    bool result = true;
+
+    // Create a child logger
+    Terra::Logger::LoggerPointer logger =
+        std::make_shared<Terra::Logger::Logger>(parent_logger, "PLAN");
+
+    // Measure the rates at which files are processed
+    if (!Calibrate(logger, encrypting, iterations, extensions, calibration))
+    {
+        std::cerr << "Unable to measure processing rates" << std::endl;
+        return false;
+    }
+
+    for (const auto &in_file : filenames)
+    {
+        const bool object = IsS3URL(static_cast<std::string>(in_file));
+        std::optional<std::uint64_t> input_size;
+        std::uint64_t output_size{};
+        SecureString out_file;
+
+        // Determine the size of the input, which is unknown for stdin and
+        // objects
+        if ((in_file != "-") && !object)
+        {
+            try
+            {
+                SecureU8String u8name(in_file.cbegin(), in_file.cend());
+                input_size =
+                    std::filesystem::file_size(std::filesystem::path(u8name));
+            }
+            catch (const std::exception &e)
+            {
+                logger->error << "Unable to determine size of " << in_file
+                              << " (err=" << e.what() << ")" << std::flush;
+                std::cerr << "Unable to open input file: " << in_file
+                          << std::endl;
+                result = false;
+                continue;
+            }
+        }
+        else
+        {
+            unknown_sizes++;
+        }
+
+        // Encrypted output is exact, while decrypted output is at most the
+        // size of the input
+        if (input_size)
+        {
+            input_octets += *input_size;
+            output_size =
+                encrypting
+                    ? calibration.overhead +
+                          ((*input_size / AES_Block_Size) + 1) * AES_Block_Size
+                    : *input_size;
+        }
+
+        // Estimate the time to process the file
+        file_seconds.push_back(
+            calibration.kdf_seconds +
+            static_cast<double>(input_size.value_or(0)) /
+                calibration.octets_per_second);
+
+        // Determine where output is written (if anywhere)
+        std::filesystem::path directory;
+        bool check_existing = true;
+        if (batch_options.scrub) continue;
+        if (!output_file.empty())
+        {
+            out_file = output_file;
+        }
+        else if (encrypting)
+        {
+            out_file = in_file + ".aes";
+        }
+        else if (batch_options.multi_stream)
+        {
+            // Streams are written to files named within the input directory
+            out_file = in_file;
+            check_existing = false;
+        }
+        else if (object)
+        {
+            const auto location =
+                ParseS3URL(static_cast<std::string>(in_file));
+            if (location)
+            {
+                const std::string &key = location->key;
+                out_file = StripAESExtension(
+                    key.substr(key.find_last_of('/') + 1).c_str());
+            }
+        }
+        else
+        {
+            out_file = StripAESExtension(in_file);
+        }
+
+        if (out_file.empty())
+        {
+            std::cerr << "Unable to name the output file for: " << in_file
+                      << std::endl;
+            result = false;
+            continue;
+        }
+
+        // Output to stdout or object storage needs no local space
+        if ((out_file == "-") || IsS3URL(static_cast<std::string>(out_file)))
+        {
+            output_octets += output_size;
+            continue;
+        }
+
+        try
+        {
+            SecureU8String u8name(out_file.cbegin(), out_file.cend());
+            const std::filesystem::path out_path =
+                std::filesystem::absolute(std::filesystem::path(u8name));
+
+            if (check_existing && std::filesystem::exists(out_path))
+            {
+                std::cerr << "Target output file already exists: "
+                          << out_file << std::endl;
+                result = false;
+            }
+
+            directory = out_path.parent_path();
+            const auto root = FilesystemRoot(directory);
+            if (!root)
+            {
+                std::cerr << "Unable to determine the filesystem for: "
+                          << out_file << std::endl;
+                result = false;
+                continue;
+            }
+
+            usage[*root].required += output_size;
+            usage[*root].files++;
+            output_octets += output_size;
+        }
+        catch (const std::exception &e)
+        {
+            logger->error << "Unable to examine output directory for "
+                          << out_file << " (err=" << e.what() << ")"
+                          << std::flush;
+            std::cerr << "Unable to examine the output directory for: "
+                      << out_file << std::endl;
+            result = false;
+        }
+    }
+
+    // Report the plan
+    std::ostringstream report;
+    report << "Plan for " << (encrypting ? "encrypting " : "decrypting ")
+           << filenames.size() << " file(s)" << std::endl
+           << "    Input:          " << FormatSize(input_octets) << std::endl;
+    if (!batch_options.scrub)
+    {
+        report << "    Output:         " << (encrypting ? "" : "at most ")
+               << FormatSize(output_octets) << std::endl;
+    }
+    if (unknown_sizes > 0)
+    {
+        report << "    Unknown sizes:  " << unknown_sizes
+               << " input(s) from stdin or object storage not included"
+               << std::endl;
+    }
+    report << "    Key derivation: " << std::fixed << std::setprecision(3)
+           << calibration.kdf_seconds << " s per file (" << iterations
+           << " iterations" << (encrypting ? "" : " assumed") << ")"
+           << std::endl
+           << "    Throughput:     " << std::setprecision(1)
+           << (calibration.octets_per_second / 1'048'576.0)
+           << " MiB/s per job" << std::endl
+           << "    Jobs:           " << batch_options.jobs << std::endl
+           << "    Estimated time: "
+           << FormatDuration(EstimateWallTime(file_seconds, batch_options.jobs))
+           << std::endl;
+
+    // Report the space on each filesystem receiving output
+    for (const auto &[root, filesystem] : usage)
+    {
+        std::uint64_t available{};
+        try
+        {
+            available = std::filesystem::space(root).available;
+        }
+        catch (const std::exception &e)
+        {
+            logger->error << "Unable to determine free space on " << root
+                          << " (err=" << e.what() << ")" << std::flush;
+            std::cerr << "Unable to determine free space on: "
+                      << root.string() << std::endl;
+            result = false;
+            continue;
+        }
+
+        report << "    Filesystem " << root.string() << ": "
+               << filesystem.files << " output file(s) need "
+               << FormatSize(filesystem.required) << ", "
+               << FormatSize(available) << " available" << std::endl;
+
+        if (filesystem.required > available)
+        {
+            std::cerr << "Insufficient space for output on: " << root.string()
+                      << std::endl;
+            result = false;
+        }
+    }
+
+    std::cout << report.str() << std::flush;
+
+    return result;
+}
@@ -0,0 +1,79 @@
+/*
+ *  batch_plan.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file defines a function that plans the processing of a set of
+ *      files without processing them, estimating the output produced, the
+ *      time required, and whether there is space for the output.
+ *
+ *  Portability Issues:
+ *      None.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include <terra/logger/logger.h>
+#include "secure_containers.h"
+#include "batch_options.h"
+
+/*
+ *  PlanBatch()
+ *
+ *  Description:
+ *      This function will examine the given files and report the output
+ *      that encrypting or decrypting them would produce, an estimate of the
+ *      time required, and the free space on each filesystem to which output
+ *      would be written.  Nothing is written to any file.
+ *
+ *  Parameters:
+ *      parent_logger [in]
+ *          A parent logger to which the child logger would direct logging
+ *          messages.
+ *
+ *      encrypting [in]
+ *          True if the files would be encrypted, false if decrypted.
+ *
+ *      batch_options [in]
+ *          Options controlling how the files would be processed, including
+ *          the number of concurrent jobs.
+ *
+ *      iterations [in]
+ *          The number of KDF iterations used when encrypting (and assumed
+ *          when decrypting).
+ *
+ *      extensions [in]
+ *          The extensions that would be placed in each encrypted stream.
+ *
+ *      filenames [in]
+ *          The names of the files to process.
+ *
+ *      output_file [in]
+ *          The name of the output file if output would go to a single file.
+ *
+ *  Returns:
+ *      True if the files could be processed, false if an input is missing,
+ *      an output exists, or there is insufficient space for the output.
+ *
+ *  Comments:
+ *      The time is estimated using rates measured by encrypting (and, if
+ *      decrypting, decrypting) sample data in memory.
+ */
+bool PlanBatch(
+    const Terra::Logger::LoggerPointer &parent_logger,
+    bool encrypting,
+    const BatchOptions &batch_options,
+    std::uint32_t iterations,
+    const std::vector<std::pair<std::string, std::string>> &extensions,
+    const std::vector<SecureString> &filenames,
+    const SecureString &output_file);
@@ -0,0 +1,346 @@
+/*
+ *  concurrency_controller.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file implements the ConcurrencyController object, which adjusts
+ *      the number of files processed concurrently by hill-climbing on the
+ *      measured aggregate write throughput.
+ *
+ *  Portability Issues:
+ *      None.
+ */
+
+#include <algorithm>
+#include "concurrency_controller.h"
+
+namespace
+{
+
+// Number of jobs with which processing starts
+constexpr std::size_t Initial_Jobs = 2;
+
+// Interval over which throughput is measured before each adjustment
+constexpr std::chrono::milliseconds Sample_Interval{1000};
+
+// Relative change in throughput considered significant
+constexpr double Throughput_Threshold = 0.05;
+
+// Jobs are removed if the tail write latency exceeds the lowest tail latency
+// observed by this factor (and is at least Min_Backoff_Latency)
+constexpr double Latency_Backoff_Factor = 4.0;
+constexpr std::chrono::milliseconds Min_Backoff_Latency{1};
+
+// After backing off due to latency, the number of intervals before more
+// jobs are tried again
+constexpr std::size_t Backoff_Hold_Intervals = 10;
+
+// Maximum number of write latencies retained per interval
+constexpr std::size_t Max_Latency_Samples = 4096;
+
+} // namespace
+
+/*
+ *  ConcurrencyController::ConcurrencyController()
+ *
+ *  Description:
+ *      Constructor for the ConcurrencyController object.
+ *
+ *  Parameters:
+ *      parent_logger [in]
+ *          A parent logger to which the child logger would direct logging
+ *          messages.
+ *
+ *      max_jobs [in]
+ *          The maximum number of jobs that may run concurrently.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+ConcurrencyController::ConcurrencyController(
+    const Terra::Logger::LoggerPointer &parent_logger,
+    std::size_t max_jobs) :
+    logger{std::make_shared<Terra::Logger::Logger>(parent_logger, "ADPT")},
+    max_jobs{std::max<std::size_t>(max_jobs, 1)},
+    stopped{false},
+    active_jobs{std::min(Initial_Jobs, this->max_jobs)},
+    direction{1},
+    interval_start{Clock::now()},
+    interval_octets{0},
+    last_throughput{0.0},
+    best_throughput{0.0},
+    best_jobs{active_jobs},
+    baseline_latency{Clock::duration::max()},
+    job_ceiling{this->max_jobs},
+    hold_intervals{0}
+{
+    latencies.reserve(Max_Latency_Samples);
+
+    logger->info << "Adaptive concurrency starting with " << active_jobs
+                 << " of at most " << this->max_jobs << " jobs" << std::flush;
+}
+
+/*
+ *  ConcurrencyController::RecordWrite()
+ *
+ *  Description:
+ *      Record the completion of a write operation.
+ *
+ *  Parameters:
+ *      octets [in]
+ *          The number of octets written.
+ *
+ *      latency [in]
+ *          The time taken to perform the write.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+void ConcurrencyController::RecordWrite(std::size_t octets,
+                                        Clock::duration latency)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    interval_octets += octets;
+    if (latencies.size() < Max_Latency_Samples) latencies.push_back(latency);
+}
+
+/*
+ *  ConcurrencyController::AwaitTurn()
+ *
+ *  Description:
+ *      Called by a job before it starts processing a file, this waits until
+ *      the job is among those permitted to run.
+ *
+ *  Parameters:
+ *      job [in]
+ *          The job number, starting at zero.
+ *
+ *  Returns:
+ *      True if the job may process a file, false if processing has been
+ *      stopped and the job should exit.
+ *
+ *  Comments:
+ *      None.
+ */
+bool ConcurrencyController::AwaitTurn(std::size_t job)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    cv.wait(lock, [&]() -> bool { return stopped || (job < active_jobs); });
+
+    return !stopped;
+}
+
+/*
+ *  ConcurrencyController::Regulate()
+ *
+ *  Description:
+ *      Wait for the current measurement interval to end and then adjust the
+ *      number of active jobs.  This should be called repeatedly by the
+ *      thread overseeing the jobs until processing is stopped.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      True if processing continues, false if processing has been stopped.
+ *      This returns early if processing is stopped.
+ *
+ *  Comments:
+ *      None.
+ */
+bool ConcurrencyController::Regulate()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    cv.wait_until(lock,
+                  interval_start + Sample_Interval,
+                  [&]() -> bool { return stopped; });
+    if (stopped) return false;
+
+    const Clock::time_point now = Clock::now();
+    Adjust(interval_octets, now - interval_start);
+
+    interval_start = now;
+    interval_octets = 0;
+    latencies.clear();
+
+    return true;
+}
+
+/*
+ *  ConcurrencyController::Stop()
+ *
+ *  Description:
+ *      Stop processing, releasing any jobs waiting for their turn.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      This is called when there are no more files to process, when
+ *      processing of a file fails, or when termination is requested.
+ */
+void ConcurrencyController::Stop()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    stopped = true;
+    cv.notify_all();
+}
+
+/*
+ *  ConcurrencyController::BestJobs()
+ *
+ *  Description:
+ *      Return the number of jobs that produced the highest throughput.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      The number of concurrent jobs, which may be used for later runs.
+ *
+ *  Comments:
+ *      None.
+ */
+std::size_t ConcurrencyController::BestJobs() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    return best_jobs;
+}
+
+/*
+ *  ConcurrencyController::Adjust()
+ *
+ *  Description:
+ *      Adjust the number of active jobs based on the throughput and write
+ *      latency observed over the last interval.
+ *
+ *  Parameters:
+ *      octets [in]
+ *          The number of octets written during the interval.
+ *
+ *      interval [in]
+ *          The length of the interval.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      The mutex must be locked by the caller.
+ */
+void ConcurrencyController::Adjust(std::uint64_t octets,
+                                   Clock::duration interval)
+{
+    // If nothing was written (e.g., keys are being derived), hold steady
+    if ((octets == 0) || (interval <= Clock::duration::zero())) return;
+
+    const double throughput =
+        static_cast<double>(octets) /
+        std::chrono::duration<double>(interval).count();
+    const std::size_t previous_jobs = active_jobs;
+
+    // Determine the tail (95th percentile) write latency
+    Clock::duration tail_latency = Clock::duration::zero();
+    if (!latencies.empty())
+    {
+        auto tail = latencies.begin() +
+                    static_cast<std::ptrdiff_t>(latencies.size() * 95 / 100);
+        std::nth_element(latencies.begin(), tail, latencies.end());
+        tail_latency = *tail;
+        baseline_latency = std::min(baseline_latency, tail_latency);
+    }
+
+    // Determine if writes are queuing in the storage system
+    const bool latency_growing =
+        !latencies.empty() && (tail_latency > Min_Backoff_Latency) &&
+        (std::chrono::duration<double>(tail_latency).count() >
+         std::chrono::duration<double>(baseline_latency).count() *
+             Latency_Backoff_Factor);
+
+    // Record the job count producing the best throughput
+    if (!latency_growing && (throughput > best_throughput))
+    {
+        best_throughput = throughput;
+        best_jobs = previous_jobs;
+    }
+
+    // Once the hold expires, allow more jobs to be tried again
+    if ((hold_intervals > 0) && (--hold_intervals == 0)) job_ceiling = max_jobs;
+
+    if (latency_growing && (active_jobs > 1))
+    {
+        // Back off and do not try this many jobs again for a while
+        direction = -1;
+        job_ceiling = --active_jobs;
+        hold_intervals = Backoff_Hold_Intervals;
+    }
+    else if (throughput > last_throughput * (1.0 + Throughput_Threshold))
+    {
+        // The last change helped, so continue in the same direction
+        Step();
+    }
+    else if (throughput < last_throughput * (1.0 - Throughput_Threshold))
+    {
+        // The last change hurt, so reverse direction
+        direction = -direction;
+        Step();
+    }
+
+    last_throughput = throughput;
+
+    logger->info << "Throughput " << static_cast<std::uint64_t>(throughput)
+                 << " octets/s with " << previous_jobs << " jobs (tail write "
+                 << "latency "
+                 << std::chrono::duration_cast<std::chrono::microseconds>(
+                        tail_latency)
+                        .count()
+                 << "us)" << std::flush;
+
+    if (active_jobs != previous_jobs)
+    {
+        logger->info << "Adjusting concurrency to " << active_jobs << " jobs"
+                     << std::flush;
+        cv.notify_all();
+    }
+}
+
+/*
+ *  ConcurrencyController::Step()
+ *
+ *  Description:
+ *      Add or remove a job according to the current direction, observing
+ *      the limits on the number of jobs.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      The mutex must be locked by the caller.
+ */
+void ConcurrencyController::Step()
+{
+    if ((direction > 0) && (active_jobs < job_ceiling)) active_jobs++;
+    if ((direction < 0) && (active_jobs > 1)) active_jobs--;
+}
@@ -0,0 +1,69 @@
+/*
+ *  concurrency_controller.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file defines the ConcurrencyController object, which adjusts
+ *      the number of files processed concurrently by hill-climbing on the
+ *      measured aggregate write throughput.  It starts with few jobs,
+ *      adds jobs while throughput improves, and removes jobs when
+ *      throughput falls or the tail latency of writes grows.
+ *
+ *  Portability Issues:
+ *      None.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <terra/logger/logger.h>
+
+// Adjusts the number of concurrent jobs based on observed throughput
+class ConcurrencyController
+{
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        ConcurrencyController(
+            const Terra::Logger::LoggerPointer &parent_logger,
+            std::size_t max_jobs);
+        ~ConcurrencyController() = default;
+
+        void RecordWrite(std::size_t octets, Clock::duration latency);
+        bool AwaitTurn(std::size_t job);
+        bool Regulate();
+        void Stop();
+        std::size_t BestJobs() const;
+
+    protected:
+        void Adjust(std::uint64_t octets, Clock::duration interval);
+        void Step();
+
+        Terra::Logger::LoggerPointer logger;
+        const std::size_t max_jobs;
+        mutable std::mutex mutex;
+        std::condition_variable cv;
+        bool stopped;                           // No more files to process
+        std::size_t active_jobs;                // Jobs permitted to run
+        int direction;                          // +1 adding, -1 removing
+        Clock::time_point interval_start;       // Start of the interval
+        std::uint64_t interval_octets;          // Octets written in interval
+        std::vector<Clock::duration> latencies; // Write latencies in interval
+        double last_throughput;                 // Prior throughput (octets/s)
+        double best_throughput;                 // Best throughput observed
+        std::size_t best_jobs;                  // Jobs at best throughput
+        Clock::duration baseline_latency;       // Lowest tail latency seen
+        std::size_t job_ceiling;                // Most jobs currently tried
+        std::size_t hold_intervals;             // Intervals until ceiling lifts
+};
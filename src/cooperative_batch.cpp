@@ -0,0 +1,664 @@
+/*
+ *  cooperative_batch.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file implements the CooperativeBatch object, which allows several
+ *      processes sharing a work directory to process the same list of files
+ *      with each file processed by only one of them.
+ *
+ *  Portability Issues:
+ *      None.
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+#include "cooperative_batch.h"
+#include "error_string.h"
+
+namespace
+{
+
+// Interval at which held leases are touched and unfinished files polled
+constexpr std::chrono::seconds Heartbeat_Interval{5};
+
+// Age beyond which a lease that has not been touched is abandoned
+constexpr std::chrono::seconds Lease_Timeout{60};
+
+/*
+ *  ItemID()
+ *
+ *  Description:
+ *      Return the identifier of the given file, which is the 64-bit FNV-1a
+ *      hash of its name in hexadecimal.
+ *
+ *  Parameters:
+ *      filename [in]
+ *          The name of the file.
+ *
+ *  Returns:
+ *      The identifier used to name files in the work directory.
+ *
+ *  Comments:
+ *      None.
+ */
+std::string ItemID(const SecureString &filename)
+{
+    std::uint64_t hash = 0xcbf29ce484222325;
+    std::ostringstream oss;
+
+    for (char c : filename)
+    {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 0x100000001b3;
+    }
+
+    oss << std::hex << std::setw(16) << std::setfill('0') << hash;
+
+    return oss.str();
+}
+
+/*
+ *  GetIdentity()
+ *
+ *  Description:
+ *      Return a string identifying this process among those cooperating.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      The host name and process ID.
+ *
+ *  Comments:
+ *      None.
+ */
+std::string GetIdentity()
+{
+    std::string host;
+
+#ifdef _WIN32
+    const char *computer_name = std::getenv("COMPUTERNAME");
+    if (computer_name != nullptr) host = computer_name;
+
+    return host + ":" + std::to_string(_getpid());
+#else
+    char host_name[256]{};
+    if (gethostname(host_name, sizeof(host_name) - 1) == 0) host = host_name;
+
+    return host + ":" + std::to_string(getpid());
+#endif
+}
+
+/*
+ *  CreateExclusive()
+ *
+ *  Description:
+ *      Create the given file, failing if it already exists, and write the
+ *      given contents to it.
+ *
+ *  Parameters:
+ *      path [in]
+ *          The file to create.
+ *
+ *      contents [in]
+ *          The contents to write.
+ *
+ *  Returns:
+ *      Zero if the file was created, or the system error number if not
+ *      (EEXIST if the file already exists).  If the contents could not be
+ *      written in full, the file is removed.
+ *
+ *  Comments:
+ *      The "x" mode of fopen() is atomic with respect to other processes,
+ *      including those on other hosts for file systems such as NFSv3 and
+ *      later.
+ */
+int CreateExclusive(const std::filesystem::path &path,
+                    const std::string &contents)
+{
+#ifdef _WIN32
+    std::FILE *fp = _wfopen(path.c_str(), L"wx");
+#else
+    std::FILE *fp = std::fopen(path.c_str(), "wx");
+#endif
+    if (fp == nullptr) return (errno != 0) ? errno : EIO;
+
+    // Write the contents, noting the first error (if any)
+    errno = 0;
+    int error{};
+    if (std::fwrite(contents.data(), 1, contents.size(), fp) !=
+        contents.size())
+    {
+        error = (errno != 0) ? errno : EIO;
+    }
+    if ((std::fclose(fp) != 0) && (error == 0))
+    {
+        error = (errno != 0) ? errno : EIO;
+    }
+
+    // Remove a file that may be truncated; EEXIST is reserved to indicate
+    // that another process created the file
+    if (error != 0)
+    {
+        std::error_code error_code;
+        std::filesystem::remove(path, error_code);
+
+        return (error == EEXIST) ? EIO : error;
+    }
+
+    return 0;
+}
+
+} // namespace
+
+/*
+ *  CooperativeBatch::CooperativeBatch()
+ *
+ *  Description:
+ *      Constructor for the CooperativeBatch object, which starts the thread
+ *      that touches held leases.
+ *
+ *  Parameters:
+ *      parent_logger [in]
+ *          A parent logger to which the child logger would direct logging
+ *          messages.
+ *
+ *      process_control [in]
+ *          A structure used to control execution.  Waiting for files held
+ *          by other processes ends when termination is requested.
+ *
+ *      directory [in]
+ *          The work directory shared by cooperating processes, which must
+ *          exist.
+ *
+ *      filenames [in]
+ *          The names of the files to process.  This must remain valid for
+ *          the lifetime of this object.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+CooperativeBatch::CooperativeBatch(
+    const Terra::Logger::LoggerPointer &parent_logger,
+    ProcessControl &process_control,
+    const std::filesystem::path &directory,
+    const std::vector<SecureString> &filenames) :
+    logger{std::make_shared<Terra::Logger::Logger>(parent_logger, "COOP")},
+    process_control{process_control},
+    directory{directory},
+    filenames{filenames},
+    identity{GetIdentity()},
+    stop{false},
+    finished(filenames.size(), false)
+{
+    item_ids.reserve(filenames.size());
+    for (const auto &filename : filenames) item_ids.push_back(ItemID(filename));
+
+    logger->info << "Cooperating as " << identity << " using work directory "
+                 << directory.string() << std::flush;
+
+    heartbeat_thread = std::thread(&CooperativeBatch::Heartbeat, this);
+}
+
+/*
+ *  CooperativeBatch::~CooperativeBatch()
+ *
+ *  Description:
+ *      Destructor for the CooperativeBatch object, which stops the heartbeat
+ *      thread and releases any leases still held.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+CooperativeBatch::~CooperativeBatch()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+        cv.notify_all();
+    }
+
+    if (heartbeat_thread.joinable()) heartbeat_thread.join();
+
+    while (!leases.empty()) Release(leases.begin()->first);
+}
+
+/*
+ *  CooperativeBatch::Claim()
+ *
+ *  Description:
+ *      Attempt to claim the given file for processing by this process.
+ *
+ *  Parameters:
+ *      index [in]
+ *          The index of the file to claim.
+ *
+ *  Returns:
+ *      Acquired if the file was claimed, Reclaimed if a lease abandoned by
+ *      another process was claimed (so output it left may be replaced),
+ *      Unavailable if the file is finished or held by another process, or
+ *      Error if the work directory could not be updated.
+ *
+ *  Comments:
+ *      Once claimed, the file must be completed or released.
+ */
+CooperativeBatch::ClaimResult CooperativeBatch::Claim(std::size_t index)
+{
+    std::size_t generation = 0;
+    std::error_code error_code;
+
+    if (Finished(index)) return ClaimResult::Unavailable;
+
+    // Find the generation of the lease to create
+    while (std::filesystem::exists(LeasePath(index, generation), error_code))
+    {
+        generation++;
+    }
+
+    // If the file is leased, the lease must have been abandoned
+    if (generation > 0)
+    {
+        const auto touched =
+            std::filesystem::last_write_time(LeasePath(index, generation - 1),
+                                             error_code);
+        if (error_code ||
+            (std::filesystem::file_time_type::clock::now() - touched <
+             Lease_Timeout))
+        {
+            return ClaimResult::Unavailable;
+        }
+    }
+
+    // Claim the file by creating the lease; only one process can succeed
+    const int error = CreateExclusive(LeasePath(index, generation),
+                                      identity + "\n");
+    if (error == EEXIST) return ClaimResult::Unavailable;
+    if (error != 0)
+    {
+        logger->error << "Unable to create lease in work directory: "
+                      << LeasePath(index, generation).string() << " ("
+                      << GetErrorString(error) << ")" << std::flush;
+        std::cerr << "Unable to create lease in work directory: "
+                  << LeasePath(index, generation).string() << std::endl;
+        return ClaimResult::Error;
+    }
+
+    // The file might have been finished just before the lease was created
+    if (Finished(index))
+    {
+        std::filesystem::remove(LeasePath(index, generation), error_code);
+        return ClaimResult::Unavailable;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        leases[index] = generation;
+    }
+
+    if (generation > 0)
+    {
+        logger->warning << "Reclaimed abandoned file: " << filenames[index]
+                        << std::flush;
+        return ClaimResult::Reclaimed;
+    }
+
+    return ClaimResult::Acquired;
+}
+
+/*
+ *  CooperativeBatch::ClaimUnfinished()
+ *
+ *  Description:
+ *      Once there are no more files to take, this is called to claim any
+ *      file not yet finished, reclaiming files abandoned by other processes.
+ *      This waits while other processes hold leases on unfinished files.
+ *
+ *  Parameters:
+ *      index [out]
+ *          The index of the file claimed.
+ *
+ *  Returns:
+ *      Acquired or Reclaimed if a file was claimed, Unavailable if all
+ *      files are finished (or held by this process) or termination was
+ *      requested, or Error if the work directory could not be updated.
+ *
+ *  Comments:
+ *      None.
+ */
+CooperativeBatch::ClaimResult CooperativeBatch::ClaimUnfinished(
+    std::size_t &index)
+{
+    while (true)
+    {
+        bool unfinished = false;
+
+        for (std::size_t i = 0; i < filenames.size(); i++)
+        {
+            // Skip files held by this process
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (leases.count(i) > 0) continue;
+            }
+
+            if (Finished(i)) continue;
+
+            unfinished = true;
+
+            const ClaimResult result = Claim(i);
+            if ((result == ClaimResult::Acquired) ||
+                (result == ClaimResult::Reclaimed))
+            {
+                index = i;
+                return result;
+            }
+            if (result == ClaimResult::Error) return result;
+        }
+
+        if (!unfinished) return ClaimResult::Unavailable;
+
+        // Wait for other processes to make progress
+        if (process_control.WaitFor(Heartbeat_Interval))
+        {
+            return ClaimResult::Unavailable;
+        }
+    }
+}
+
+/*
+ *  CooperativeBatch::Complete()
+ *
+ *  Description:
+ *      Record that processing of a claimed file is finished and remove its
+ *      lease.
+ *
+ *  Parameters:
+ *      index [in]
+ *          The index of the file.
+ *
+ *      success [in]
+ *          True if the file was processed successfully, false if not.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      If the lease was lost to another process, the file is left to that
+ *      process.
+ */
+void CooperativeBatch::Complete(std::size_t index, bool success)
+{
+    std::size_t generation{};
+    std::error_code error_code;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = leases.find(index);
+        if (it == leases.end()) return;
+        generation = it->second;
+        leases.erase(it);
+    }
+
+    if (LeaseLost(index, generation))
+    {
+        logger->warning << "Lease lost on " << filenames[index]
+                        << "; leaving it to the process that reclaimed it"
+                        << std::flush;
+        return;
+    }
+
+    // Record the outcome before removing leases so the file is never seen
+    // as both unleased and unfinished
+    const int error = CreateExclusive(
+        ItemPath(index, success ? ".done" : ".failed"),
+        identity + "\n");
+    if ((error != 0) && (error != EEXIST))
+    {
+        logger->error << "Unable to record completion of " << filenames[index]
+                      << " (" << GetErrorString(error) << ")" << std::flush;
+    }
+
+    // Remove lease generations from the newest so they remain contiguous
+    for (std::size_t i = generation + 1; i > 0; i--)
+    {
+        std::filesystem::remove(LeasePath(index, i - 1), error_code);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    finished[index] = true;
+}
+
+/*
+ *  CooperativeBatch::Release()
+ *
+ *  Description:
+ *      Release a claimed file without finishing it (e.g., upon termination)
+ *      so another process may claim it without waiting for the lease to
+ *      time out.
+ *
+ *  Parameters:
+ *      index [in]
+ *          The index of the file.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+void CooperativeBatch::Release(std::size_t index)
+{
+    std::size_t generation{};
+    std::error_code error_code;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = leases.find(index);
+        if (it == leases.end()) return;
+        generation = it->second;
+        leases.erase(it);
+    }
+
+    // Only the lease this process created is removed; any older generation
+    // is abandoned and may be reclaimed immediately
+    if (!LeaseLost(index, generation))
+    {
+        std::filesystem::remove(LeasePath(index, generation), error_code);
+    }
+}
+
+/*
+ *  CooperativeBatch::ItemPath()
+ *
+ *  Description:
+ *      Return the path of a file in the work directory for the given file.
+ *
+ *  Parameters:
+ *      index [in]
+ *          The index of the file.
+ *
+ *      suffix [in]
+ *          The suffix appended to the file's identifier (e.g., ".done").
+ *
+ *  Returns:
+ *      The path in the work directory.
+ *
+ *  Comments:
+ *      None.
+ */
+std::filesystem::path CooperativeBatch::ItemPath(
+    std::size_t index,
+    const std::string &suffix) const
+{
+    return directory / (item_ids[index] + suffix);
+}
+
+/*
+ *  CooperativeBatch::LeasePath()
+ *
+ *  Description:
+ *      Return the path of the given lease generation for the given file.
+ *
+ *  Parameters:
+ *      index [in]
+ *          The index of the file.
+ *
+ *      generation [in]
+ *          The lease generation.
+ *
+ *  Returns:
+ *      The path of the lease file.
+ *
+ *  Comments:
+ *      None.
+ */
+std::filesystem::path CooperativeBatch::LeasePath(
+    std::size_t index,
+    std::size_t generation) const
+{
+    return ItemPath(index, ".lease." + std::to_string(generation));
+}
+
+/*
+ *  CooperativeBatch::Finished()
+ *
+ *  Description:
+ *      Determine whether the given file is finished (successfully or not).
+ *
+ *  Parameters:
+ *      index [in]
+ *          The index of the file.
+ *
+ *  Returns:
+ *      True if the file is finished, false if not.
+ *
+ *  Comments:
+ *      Since a file never becomes unfinished, the result is remembered to
+ *      avoid checking the work directory again.
+ */
+bool CooperativeBatch::Finished(std::size_t index)
+{
+    std::error_code error_code;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (finished[index]) return true;
+    }
+
+    if (!std::filesystem::exists(ItemPath(index, ".done"), error_code) &&
+        !std::filesystem::exists(ItemPath(index, ".failed"), error_code))
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    finished[index] = true;
+
+    return true;
+}
+
+/*
+ *  CooperativeBatch::LeaseLost()
+ *
+ *  Description:
+ *      Determine whether a lease held by this process was lost, either
+ *      because it was removed or because another process reclaimed it.
+ *
+ *  Parameters:
+ *      index [in]
+ *          The index of the file.
+ *
+ *      generation [in]
+ *          The generation of the lease held.
+ *
+ *  Returns:
+ *      True if the lease was lost, false if not.
+ *
+ *  Comments:
+ *      None.
+ */
+bool CooperativeBatch::LeaseLost(std::size_t index,
+                                 std::size_t generation) const
+{
+    std::error_code error_code;
+
+    return !std::filesystem::exists(LeasePath(index, generation),
+                                    error_code) ||
+           std::filesystem::exists(LeasePath(index, generation + 1),
+                                   error_code);
+}
+
+/*
+ *  CooperativeBatch::Heartbeat()
+ *
+ *  Description:
+ *      Touch each held lease periodically so other processes can see that
+ *      this process is alive, until this object is destroyed.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+void CooperativeBatch::Heartbeat()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (!cv.wait_for(lock, Heartbeat_Interval, [&]() { return stop; }))
+    {
+        // Touch the leases with the mutex unlocked
+        const auto held = leases;
+        lock.unlock();
+
+        for (const auto &[index, generation] : held)
+        {
+            std::error_code error_code;
+
+            std::filesystem::last_write_time(
+                LeasePath(index, generation),
+                std::filesystem::file_time_type::clock::now(),
+                error_code);
+            if (error_code || LeaseLost(index, generation))
+            {
+                // Report this only if the lease was not just completed
+                std::lock_guard<std::mutex> held_lock(mutex);
+                if (leases.count(index) > 0)
+                {
+                    logger->warning << "Unable to renew lease on "
+                                    << filenames[index] << std::flush;
+                }
+            }
+        }
+
+        lock.lock();
+    }
+}
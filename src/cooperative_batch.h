@@ -0,0 +1,94 @@
+/*
+ *  cooperative_batch.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file defines the CooperativeBatch object, which allows several
+ *      processes, on one or more hosts sharing a file system, to process
+ *      the same list of files with each file processed by only one of them.
+ *
+ *      Files are claimed using lease files in a shared work directory.  A
+ *      file is identified by a hash of its name as given on the command
+ *      line, so all processes must be given the same names.  For a file
+ *      with identifier ID, the work directory may contain:
+ *
+ *          ID.lease.N  Lease generation N, created exclusively to claim
+ *                      the file and touched periodically while it is held
+ *          ID.done     Marker indicating the file was processed
+ *          ID.failed   Marker indicating processing of the file failed
+ *
+ *      A lease not touched within the lease timeout was abandoned (e.g.,
+ *      the process holding it died) and is reclaimed by exclusively creating
+ *      the next generation, so only one process can reclaim it.
+ *
+ *  Portability Issues:
+ *      Leases are compared with the local clock, so the clocks of cooperating
+ *      hosts should be synchronized to well within the lease timeout.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <filesystem>
+#include <terra/logger/logger.h>
+#include "secure_containers.h"
+#include "process_control.h"
+
+// Shares the processing of a list of files among cooperating processes
+class CooperativeBatch
+{
+    public:
+        enum class ClaimResult
+        {
+            Acquired,                           // File claimed
+            Reclaimed,                          // Abandoned file claimed
+            Unavailable,                        // Finished or held elsewhere
+            Error                               // Work directory error
+        };
+
+        CooperativeBatch(const Terra::Logger::LoggerPointer &parent_logger,
+                         ProcessControl &process_control,
+                         const std::filesystem::path &directory,
+                         const std::vector<SecureString> &filenames);
+        ~CooperativeBatch();
+
+        ClaimResult Claim(std::size_t index);
+        ClaimResult ClaimUnfinished(std::size_t &index);
+        void Complete(std::size_t index, bool success);
+        void Release(std::size_t index);
+
+    protected:
+        std::filesystem::path ItemPath(std::size_t index,
+                                       const std::string &suffix) const;
+        std::filesystem::path LeasePath(std::size_t index,
+                                        std::size_t generation) const;
+        bool Finished(std::size_t index);
+        bool LeaseLost(std::size_t index, std::size_t generation) const;
+        void Heartbeat();
+
+        Terra::Logger::LoggerPointer logger;
+        ProcessControl &process_control;
+        std::filesystem::path directory;
+        const std::vector<SecureString> &filenames;
+        std::string identity;                   // Host and process ID
+        std::vector<std::string> item_ids;      // Identifier of each file
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool stop;
+        std::map<std::size_t, std::size_t> leases; // Held lease generations
+        std::vector<bool> finished;             // Files known to be finished
+        std::thread heartbeat_thread;
+};
@@ -0,0 +1,456 @@
+/*
+ *  cpu_topology.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file implements functions to discover the processor topology
+ *      and to pin the threads processing files to processors.
+ *
+ *  Portability Issues:
+ *      Topology discovery and thread pinning are supported only on Linux.
+ *      Elsewhere, no topology is reported and threads are not pinned.
+ */
+
+#include <algorithm>
+#include <charconv>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#ifdef __linux__
+#include <sched.h>
+#endif
+#include "cpu_topology.h"
+#include "error_string.h"
+
+namespace
+{
+
+#ifdef __linux__
+// Location of NUMA node information
+constexpr char Node_Directory[] = "/sys/devices/system/node";
+
+// List of performance cores on hybrid processors
+constexpr char Performance_CPUs[] = "/sys/devices/cpu_core/cpus";
+
+/*
+ *  ParseCPUList()
+ *
+ *  Description:
+ *      Parse a list of processors in the kernel's format (e.g., "0-3,8").
+ *
+ *  Parameters:
+ *      list [in]
+ *          The list to parse.
+ *
+ *  Returns:
+ *      The processors in the list, which is empty if the list is invalid.
+ *
+ *  Comments:
+ *      None.
+ */
+std::vector<int> ParseCPUList(const std::string &list)
+{
+    std::vector<int> cpus;
+    std::istringstream ranges(list);
+    std::string range;
+
+    while (std::getline(ranges, range, ','))
+    {
+        int first{};
+        int last{};
+
+        // Remove any trailing whitespace (e.g., newline)
+        range.erase(range.find_last_not_of(" \t\r\n") + 1);
+        if (range.empty()) continue;
+
+        const char *end = range.data() + range.size();
+        auto [next, error] = std::from_chars(range.data(), end, first);
+        if (error != std::errc()) return {};
+        last = first;
+
+        if ((next != end) && (*next == '-'))
+        {
+            auto [range_end, range_error] =
+                std::from_chars(next + 1, end, last);
+            if ((range_error != std::errc()) || (range_end != end)) return {};
+        }
+        else if (next != end)
+        {
+            return {};
+        }
+
+        for (int cpu = first; cpu <= last; cpu++) cpus.push_back(cpu);
+    }
+
+    return cpus;
+}
+
+/*
+ *  ReadCPUList()
+ *
+ *  Description:
+ *      Read a list of processors from the given file, keeping only those
+ *      that are usable.
+ *
+ *  Parameters:
+ *      path [in]
+ *          The file to read.
+ *
+ *      usable [in]
+ *          The processors usable by the process (sorted).
+ *
+ *  Returns:
+ *      The usable processors in the list, which is empty if the file could
+ *      not be read.
+ *
+ *  Comments:
+ *      None.
+ */
+std::vector<int> ReadCPUList(const std::filesystem::path &path,
+                             const std::vector<int> &usable)
+{
+    std::ifstream stream(path);
+    std::string line;
+    std::vector<int> cpus;
+
+    if (!stream.is_open() || !std::getline(stream, line)) return cpus;
+
+    for (int cpu : ParseCPUList(line))
+    {
+        if (std::binary_search(usable.begin(), usable.end(), cpu))
+        {
+            cpus.push_back(cpu);
+        }
+    }
+
+    return cpus;
+}
+#endif
+
+/*
+ *  FormatCPUList()
+ *
+ *  Description:
+ *      Format a list of processors in the kernel's format (e.g., "0-3,8").
+ *
+ *  Parameters:
+ *      cpus [in]
+ *          The processors (sorted).
+ *
+ *  Returns:
+ *      The formatted list.
+ *
+ *  Comments:
+ *      None.
+ */
+std::string FormatCPUList(const std::vector<int> &cpus)
+{
+    std::string list;
+
+    for (std::size_t i = 0; i < cpus.size();)
+    {
+        std::size_t j = i;
+        while ((j + 1 < cpus.size()) && (cpus[j + 1] == cpus[j] + 1)) j++;
+
+        if (!list.empty()) list += ",";
+        list += std::to_string(cpus[i]);
+        if (j > i) list += "-" + std::to_string(cpus[j]);
+
+        i = j + 1;
+    }
+
+    return list;
+}
+
+/*
+ *  PreferPerformance()
+ *
+ *  Description:
+ *      Return the performance cores within the given set of processors, or
+ *      the given set if it contains no performance cores.
+ *
+ *  Parameters:
+ *      cpus [in]
+ *          The set of processors (sorted).
+ *
+ *      performance_cpus [in]
+ *          The performance cores (sorted), which is empty if the processor
+ *          is not a hybrid processor.
+ *
+ *  Returns:
+ *      The preferred processors.
+ *
+ *  Comments:
+ *      None.
+ */
+std::vector<int> PreferPerformance(const std::vector<int> &cpus,
+                                   const std::vector<int> &performance_cpus)
+{
+    std::vector<int> preferred;
+
+    std::set_intersection(cpus.begin(),
+                          cpus.end(),
+                          performance_cpus.begin(),
+                          performance_cpus.end(),
+                          std::back_inserter(preferred));
+
+    return preferred.empty() ? cpus : preferred;
+}
+
+} // namespace
+
+/*
+ *  ParseAffinityMode()
+ *
+ *  Description:
+ *      Parse an affinity mode given as "none", "core", or "node".
+ *
+ *  Parameters:
+ *      value [in]
+ *          The string to parse.
+ *
+ *  Returns:
+ *      The affinity mode, or no value if the string is not valid.
+ *
+ *  Comments:
+ *      None.
+ */
+std::optional<AffinityMode> ParseAffinityMode(const std::string &value)
+{
+    if (value == "none") return AffinityMode::None;
+    if (value == "core") return AffinityMode::Core;
+    if (value == "node") return AffinityMode::Node;
+
+    return {};
+}
+
+/*
+ *  GetCPUTopology()
+ *
+ *  Description:
+ *      Determine the processors usable by this process, how they are grouped
+ *      into NUMA nodes, and which are performance cores on a hybrid
+ *      processor.
+ *
+ *  Parameters:
+ *      logger [in]
+ *          The logger to which logging output will be sent.
+ *
+ *  Returns:
+ *      The processor topology.  If it cannot be determined, the list of
+ *      processors is empty.
+ *
+ *  Comments:
+ *      The topology is logged.
+ */
+CPUTopology GetCPUTopology(const Terra::Logger::LoggerPointer &logger)
+{
+    CPUTopology topology;
+
+#ifdef __linux__
+    // Determine the usable processors from the affinity mask
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set) != 0)
+    {
+        LogSystemError(logger, "Unable to get the processor affinity mask");
+        return topology;
+    }
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+    {
+        if (CPU_ISSET(cpu, &cpu_set)) topology.cpus.push_back(cpu);
+    }
+
+    // Determine the processors in each NUMA node
+    try
+    {
+        std::vector<std::pair<int, std::filesystem::path>> node_paths;
+
+        for (const auto &entry :
+             std::filesystem::directory_iterator(Node_Directory))
+        {
+            const std::string name = entry.path().filename().string();
+            int node{};
+
+            if (name.rfind("node", 0) != 0) continue;
+            auto [end, error] = std::from_chars(name.data() + 4,
+                                                name.data() + name.size(),
+                                                node);
+            if ((error != std::errc()) || (end != name.data() + name.size()))
+            {
+                continue;
+            }
+
+            node_paths.emplace_back(node, entry.path() / "cpulist");
+        }
+
+        std::sort(node_paths.begin(), node_paths.end());
+
+        for (const auto &[node, path] : node_paths)
+        {
+            auto cpus = ReadCPUList(path, topology.cpus);
+            if (!cpus.empty()) topology.nodes.push_back(std::move(cpus));
+        }
+    }
+    catch (const std::exception &e)
+    {
+        logger->info << "NUMA node information is unavailable (err="
+                     << e.what() << ")" << std::flush;
+        topology.nodes.clear();
+    }
+
+    // Determine the performance cores of a hybrid processor
+    topology.performance_cpus = ReadCPUList(Performance_CPUs, topology.cpus);
+#endif
+
+    // Log the topology
+    logger->info << "Processor topology: usable processors "
+                 << FormatCPUList(topology.cpus) << std::flush;
+    for (std::size_t i = 0; i < topology.nodes.size(); i++)
+    {
+        logger->info << "Processor topology: node " << i << " processors "
+                     << FormatCPUList(topology.nodes[i]) << std::flush;
+    }
+    if (!topology.performance_cpus.empty())
+    {
+        logger->info << "Processor topology: performance cores "
+                     << FormatCPUList(topology.performance_cpus)
+                     << std::flush;
+    }
+
+    return topology;
+}
+
+/*
+ *  AssignWorkerCPUs()
+ *
+ *  Description:
+ *      Determine the processors on which each job may run for the given
+ *      affinity mode.
+ *
+ *  Parameters:
+ *      logger [in]
+ *          The logger to which logging output will be sent.
+ *
+ *      topology [in]
+ *          The processor topology.
+ *
+ *      affinity_mode [in]
+ *          How jobs are to be placed on processors.
+ *
+ *  Returns:
+ *      A list of processor sets.  Job N runs on set (N modulo the number of
+ *      sets).  The list is empty if jobs are not to be pinned.
+ *
+ *  Comments:
+ *      On hybrid processors, performance cores are preferred, since each
+ *      job's work (notably key derivation) is processor intensive.
+ */
+std::vector<std::vector<int>> AssignWorkerCPUs(
+    const Terra::Logger::LoggerPointer &logger,
+    const CPUTopology &topology,
+    AffinityMode affinity_mode)
+{
+    std::vector<std::vector<int>> worker_cpus;
+
+    if ((affinity_mode == AffinityMode::None) || topology.cpus.empty())
+    {
+        if (affinity_mode != AffinityMode::None)
+        {
+            logger->warning << "Processor topology is unknown; threads will "
+                               "not be pinned"
+                            << std::flush;
+        }
+        return worker_cpus;
+    }
+
+    if (affinity_mode == AffinityMode::Core)
+    {
+        // One processor per job, with performance cores assigned first
+        std::vector<int> ordered = topology.performance_cpus;
+        for (int cpu : topology.cpus)
+        {
+            if (!std::binary_search(topology.performance_cpus.begin(),
+                                    topology.performance_cpus.end(),
+                                    cpu))
+            {
+                ordered.push_back(cpu);
+            }
+        }
+
+        for (int cpu : ordered) worker_cpus.push_back({cpu});
+    }
+    else
+    {
+        // One node per job, in turn; without NUMA information, there is a
+        // single node containing all usable processors
+        if (topology.nodes.empty())
+        {
+            worker_cpus.push_back(
+                PreferPerformance(topology.cpus, topology.performance_cpus));
+        }
+        for (const auto &node : topology.nodes)
+        {
+            worker_cpus.push_back(
+                PreferPerformance(node, topology.performance_cpus));
+        }
+    }
+
+    for (std::size_t i = 0; i < worker_cpus.size(); i++)
+    {
+        logger->info << "Processor set " << i << " for jobs: "
+                     << FormatCPUList(worker_cpus[i]) << std::flush;
+    }
+
+    return worker_cpus;
+}
+
+/*
+ *  PinThread()
+ *
+ *  Description:
+ *      Restrict the calling thread to the given processors.  Threads it
+ *      subsequently creates inherit the restriction.
+ *
+ *  Parameters:
+ *      logger [in]
+ *          The logger to which logging output will be sent.
+ *
+ *      cpus [in]
+ *          The processors on which the thread may run.
+ *
+ *  Returns:
+ *      True if the thread was pinned, false if not.
+ *
+ *  Comments:
+ *      None.
+ */
+bool PinThread(const Terra::Logger::LoggerPointer &logger,
+               [[maybe_unused]] const std::vector<int> &cpus)
+{
+#ifdef __linux__
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (int cpu : cpus) CPU_SET(cpu, &cpu_set);
+
+    // A process ID of zero refers to the calling thread
+    if (sched_setaffinity(0, sizeof(cpu_set), &cpu_set) != 0)
+    {
+        LogSystemError(logger, "Unable to set the processor affinity");
+        return false;
+    }
+
+    return true;
+#else
+    logger->warning << "Processor affinity is not supported on this platform"
+                    << std::flush;
+
+    return false;
+#endif
+}
@@ -0,0 +1,134 @@
+/*
+ *  cpu_topology.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file defines functions to discover the processor topology
+ *      (usable processors, NUMA nodes, and the performance cores of hybrid
+ *      processors) and to pin the threads processing files to processors.
+ *
+ *  Portability Issues:
+ *      Topology discovery and thread pinning are supported only on Linux.
+ *      Elsewhere, no topology is reported and threads are not pinned.
+ */
+
+#pragma once
+
+#include <optional>
+#include <string>
+#include <vector>
+#include <terra/logger/logger.h>
+
+// How threads processing files are placed on processors
+enum class AffinityMode
+{
+    None,
+    Core,
+    Node
+};
+
+// Processor topology observed by the process
+struct CPUTopology
+{
+    std::vector<int> cpus;                      // Usable processors
+    std::vector<std::vector<int>> nodes;        // Usable processors per node
+    std::vector<int> performance_cpus;          // Hybrid performance cores
+};
+
+/*
+ *  ParseAffinityMode()
+ *
+ *  Description:
+ *      Parse an affinity mode given as "none", "core", or "node".
+ *
+ *  Parameters:
+ *      value [in]
+ *          The string to parse.
+ *
+ *  Returns:
+ *      The affinity mode, or no value if the string is not valid.
+ *
+ *  Comments:
+ *      None.
+ */
+std::optional<AffinityMode> ParseAffinityMode(const std::string &value);
+
+/*
+ *  GetCPUTopology()
+ *
+ *  Description:
+ *      Determine the processors usable by this process, how they are grouped
+ *      into NUMA nodes, and which are performance cores on a hybrid
+ *      processor.
+ *
+ *  Parameters:
+ *      logger [in]
+ *          The logger to which logging output will be sent.
+ *
+ *  Returns:
+ *      The processor topology.  If it cannot be determined, the list of
+ *      processors is empty.
+ *
+ *  Comments:
+ *      The topology is logged.
+ */
+CPUTopology GetCPUTopology(const Terra::Logger::LoggerPointer &logger);
+
+/*
+ *  AssignWorkerCPUs()
+ *
+ *  Description:
+ *      Determine the processors on which each job may run for the given
+ *      affinity mode.
+ *
+ *  Parameters:
+ *      logger [in]
+ *          The logger to which logging output will be sent.
+ *
+ *      topology [in]
+ *          The processor topology.
+ *
+ *      affinity_mode [in]
+ *          How jobs are to be placed on processors.
+ *
+ *  Returns:
+ *      A list of processor sets.  Job N runs on set (N modulo the number of
+ *      sets).  The list is empty if jobs are not to be pinned.
+ *
+ *  Comments:
+ *      On hybrid processors, performance cores are preferred, since each
+ *      job's work (notably key derivation) is processor intensive.
+ */
+std::vector<std::vector<int>> AssignWorkerCPUs(
+    const Terra::Logger::LoggerPointer &logger,
+    const CPUTopology &topology,
+    AffinityMode affinity_mode);
+
+/*
+ *  PinThread()
+ *
+ *  Description:
+ *      Restrict the calling thread to the given processors.  Threads it
+ *      subsequently creates inherit the restriction.
+ *
+ *  Parameters:
+ *      logger [in]
+ *          The logger to which logging output will be sent.
+ *
+ *      cpus [in]
+ *          The processors on which the thread may run.
+ *
+ *  Returns:
+ *      True if the thread was pinned, false if not.
+ *
+ *  Comments:
+ *      None.
+ */
+bool PinThread(const Terra::Logger::LoggerPointer &logger,
+               const std::vector<int> &cpus);
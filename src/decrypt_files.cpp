@@ -17,13 +17,29 @@
 
 #include <iostream>
 #include <filesystem>
-#include <fstream>
 #include <thread>
 #include <mutex>
+#include <optional>
+#include <memory>
+#include <sstream>
+#include <iomanip>
+#include <span>
+#include <string_view>
 #include <terra/aescrypt/engine/decryptor.h>
 #include "decrypt_files.h"
 #include "error_string.h"
 #include "aescrypt.h"
+#include "file_batch.h"
+#include "throttled_stream.h"
+#include "thread_priority.h"
+#ifdef AESCRYPT_S3
+#include "s3_client.h"
+#include "s3_stream.h"
+#endif
+#include "stream_splitter.h"
+#include "sink_stream.h"
+#include "output_spool.h"
+#include "stream_scrubber.h"
 
 namespace
 {
@@ -91,6 +107,10 @@ bool HasAESExtension(const SecureString &filename)
  *          decryption is in progress, it will gracefully terminate
  *          decryption and allow the program to exit.
  *
+ *      thread_priority [in]
+ *          The I/O and CPU scheduling priority to apply to the thread
+ *          performing decryption.
+ *
  *      quiet [in]
  *          If true, the program will not emit messages to the terminal, except
  *          for error messages (which are directed to stderr).
@@ -116,6 +136,7 @@ bool HasAESExtension(const SecureString &filename)
 bool DecryptStream(
     const Terra::Logger::LoggerPointer &logger,
     ProcessControl &process_control,
+    const ThreadPriority &thread_priority,
     bool quiet,
     const SecureU8String &password,
     const std::size_t input_size,
@@ -123,8 +144,6 @@ bool DecryptStream(
     std::ostream &ostream)
 {
     Terra::AESCrypt::Engine::DecryptResult decrypt_result{};
-    bool decryption_complete{};
-    bool cancel_decryption{};
 
     using namespace Terra::AESCrypt::Engine;
 
@@ -156,10 +175,22 @@ bool DecryptStream(
     // Create an AES Crypt Engine Decryptor object
     Decryptor decryptor(logger);
 
+    // Cancel decryption if termination is requested while in progress
+    auto cancel_handler = std::make_unique<ScopedCancelHandler>(
+        process_control,
+        [&]()
+        {
+            std::cerr << "Request cancelled; cleaning up..." << std::endl;
+            decryptor.Cancel();
+        });
+
     // Decrypt the stream via a separate thread
     std::thread decrypt_thread(
         [&]()
         {
+            // Lower the priority of this thread only, if requested
+            ApplyThreadPriority(logger, thread_priority);
+
             // Decrypt the current input stream
             decrypt_result = decryptor.Decrypt(
                 static_cast<std::u8string>(password),
@@ -167,42 +198,17 @@ bool DecryptStream(
                 ostream,
                 meter_updater,
                 update_interval);
-
-            // Lock the mutex to assign result
-            std::lock_guard<std::mutex> lock(process_control.mutex);
-            decryption_complete = true;
-            process_control.cv.notify_all();
         });
 
-    // Lock the mutex
-    std::unique_lock<std::mutex> lock(process_control.mutex);
-
-    // Wait for decryption to complete or to be told to terminate
-    process_control.cv.wait(lock,
-                            [&]() -> bool
-                            {
-                                return decryption_complete ||
-                                       process_control.terminate;
-                            });
-
-    // If the process should terminate, cancel decryption if still going
-    cancel_decryption = process_control.terminate && (!decryption_complete);
-
-    // Unlock the mutex
-    lock.unlock();
+    // Wait for the decryption thread to exit, which it does promptly if
+    // cancelled because termination was requested
+    decrypt_thread.join();
 
     // Clear the progress meter
     progress_meter.Stop();
 
-    // If the process should terminate, can decryption if still working
-    if (cancel_decryption)
-    {
-        std::cerr << "Request cancelled; cleaning up..." << std::endl;
-        decryptor.Cancel();
-    }
-
-    // Wait for the decryption thread to exit
-    decrypt_thread.join();
+    // Stop cancelling decryption if termination is requested
+    cancel_handler.reset();
 
     // If decryption failed for reasons other than cancellation, report why
     if ((decrypt_result != DecryptResult::Success) &&
@@ -216,20 +222,84 @@ bool DecryptStream(
     return decrypt_result == DecryptResult::Success;
 }
 
-} // namespace
+/*
+ *  CheckStream()
+ *
+ *  Description:
+ *      This function will check the integrity of the given version 3 AES
+ *      Crypt input stream without decrypting it.
+ *
+ *  Parameters:
+ *      logger [in]
+ *          The logger to which logging output will be sent.
+ *
+ *      process_control [in]
+ *          A structure used by the main thread and worker thread to control
+ *          execution.  If termination is requested, checking stops.
+ *
+ *      thread_priority [in]
+ *          The I/O and CPU scheduling priority to apply to the thread
+ *          performing the check.
+ *
+ *      password [in]
+ *          The password (in UTF-8 encoding) used to encrypt the stream.
+ *
+ *      istream [in]
+ *          Input stream from which ciphertext is read.
+ *
+ *      buffer [in]
+ *          The buffer into which ciphertext is read.
+ *
+ *  Returns:
+ *      True if the stream is intact, false if not.
+ *
+ *  Comments:
+ *      None.
+ */
+bool CheckStream(const Terra::Logger::LoggerPointer &logger,
+                 ProcessControl &process_control,
+                 const ThreadPriority &thread_priority,
+                 const SecureU8String &password,
+                 std::istream &istream,
+                 std::span<char> buffer)
+{
+    ScrubResult scrub_result{};
+
+    // Check the stream via a separate thread, like decryption
+    std::thread check_thread(
+        [&]()
+        {
+            // Lower the priority of this thread only, if requested
+            ApplyThreadPriority(logger, thread_priority);
+
+            scrub_result = ScrubStream(logger,
+                                       process_control,
+                                       password,
+                                       istream,
+                                       buffer);
+        });
+    check_thread.join();
+
+    // If the check failed for reasons other than cancellation, report why
+    if ((scrub_result != ScrubResult::Success) &&
+        (scrub_result != ScrubResult::Cancelled))
+    {
+        std::cerr << "Error checking file: " << scrub_result << std::endl;
+        return false;
+    }
+
+    return scrub_result == ScrubResult::Success;
+}
 
 /*
- *  DecryptFiles()
+ *  DecryptFile()
  *
  *  Description:
- *      This function will take a list of filenames and decrypt them serially.
- *      All files are decrypted using the same password and the output will
- *      either be to a new file with a .aes extension or to stdout.
+ *      This function will decrypt a single file.
  *
  *  Parameters:
- *      parent_logger [in]
- *          A parent logger to which the child logger would direct logging
- *          messages.
+ *      logger [in]
+ *          The logger to which logging output will be sent.
  *
  *      process_control [in]
  *          A structure used by the main thread and worker thread to control
@@ -237,343 +307,1024 @@ bool DecryptStream(
  *          decryption is in progress, it will gracefully terminate
  *          decryption and allow the program to exit.
  *
+ *      batch_options [in]
+ *          Options controlling processing, including the bandwidth limiter
+ *          and concurrency controller (if any) through which data passes.
+ *
  *      quiet [in]
  *          If true, the program will not emit messages to the terminal, except
  *          for error messages (which are directed to stderr).
  *
+ *      hide_progress [in]
+ *          If true, the progress meter will not be displayed.
+ *
  *      password [in]
  *          The password (in UTF-8 encoding) to use to decrypt files.
  *
- *      filenames [in]
- *          A vector of filenames to decrypt.
+ *      in_file [in]
+ *          The name of the file to decrypt, "-" for stdin, or the URL of an
+ *          object in object storage (s3://bucket/key).
  *
  *      output_file [in]
  *          The name of the output file if output is going to a single file.
- *          This MUST NOT be specified if there is more than one file in
- *          the list of filenames. That requirement is not checked here.
+ *          If empty, the output file is named by removing .aes from in_file
+ *          or, for an object, from the last component of its key.
+ *
+ *      buffers [in]
+ *          The buffers to use for file I/O.
+ *
+ *      replace_output [in]
+ *          If true, an existing output file is replaced, as it was left by
+ *          an abandoned attempt to process this file.
+ *
+ *      prefetched_source [in]
+ *          The source from which to read in_file if it was already opened
+ *          (e.g., by the prefetcher), else nullptr.
  *
  *  Returns:
  *      True if decryption is successful, false if not.
  *
  *  Comments:
- *      None.
+ *      An object is downloaded using concurrent ranged requests, and
+ *      decrypted output is produced as the ranges arrive in order.  When
+ *      scrubbing, only the integrity of the input is checked: a version 3
+ *      file is checked without decrypting it, while other input is decrypted
+ *      and the output discarded.
  */
-bool DecryptFiles(
-    const Terra::Logger::LoggerPointer &parent_logger,
+bool DecryptFile(
+    const Terra::Logger::LoggerPointer &logger,
     ProcessControl &process_control,
+    const BatchOptions &batch_options,
     const bool quiet,
+    const bool hide_progress,
     const SecureU8String &password,
-    const std::vector<SecureString> &filenames,
-    const SecureString &output_file)
+    const SecureString &in_file,
+    const SecureString &output_file,
+    IOBuffers &buffers,
+    const bool replace_output,
+    std::unique_ptr<Source> prefetched_source)
 {
     SecureString out_file;
-    bool stdout_used = (output_file == "-");
-
-    // Secure buffer for file I/O
-    SecureVector<char> read_buffer(Buffered_IO_Size, 0);
-    SecureVector<char> write_buffer(Buffered_IO_Size, 0);
+    std::size_t file_size{};
+    std::unique_ptr<Source> source;
+    std::optional<std::istream> source_istream;
+#ifdef AESCRYPT_S3
+    std::optional<S3DownloadStream> s3_istream;
+#endif
+    std::unique_ptr<Sink> sink;
+    std::optional<std::ostream> sink_ostream;
+    bool remove_on_fail{};
 
-    // Create a child logger
-    Terra::Logger::LoggerPointer logger =
-        std::make_shared<Terra::Logger::Logger>(parent_logger, "FILE");
+    logger->info << "Decrypting: " << in_file << std::flush;
 
-    // If an output file is not specified, ensure all filenames end in .aes
-    if (output_file.empty())
+    // If this file is an object, start downloading it
+#ifdef AESCRYPT_S3
+    if (IsS3URL(static_cast<std::string>(in_file)))
     {
-        for (const auto &in_file : filenames)
+        const auto location = ParseS3URL(static_cast<std::string>(in_file));
+        if (!location || (batch_options.s3_client == nullptr))
         {
-            try
+            std::cerr << "Invalid object URL: " << in_file << std::endl;
+            return false;
+        }
+
+        s3_istream.emplace(logger,
+                           *batch_options.s3_client,
+                           *location,
+                           batch_options.s3_part_size,
+                           batch_options.s3_connections);
+        if (!s3_istream->Open())
+        {
+            std::cerr << "Unable to open object: " << in_file << std::endl;
+            return false;
+        }
+        file_size = static_cast<std::size_t>(s3_istream->Size());
+
+        // Current output filename is the key's last component with .aes
+        // stripped off (there is no output when scrubbing)
+        if (output_file.empty() && !batch_options.scrub)
+        {
+            const std::string &key = location->key;
+            out_file = key.substr(key.find_last_of('/') + 1).c_str();
+            out_file.resize(out_file.size() - 4);
+
+            // If the filename is empty, the object must have been named .aes
+            if (out_file.empty())
             {
-                if (!HasAESExtension(in_file))
-                {
-                    logger->error << "Input file does not end with .aes: "
-                                << in_file << std::flush;
-                    std::cerr << "Input file does not end with .aes and no "
-                                 "output file was specified: "
-                              << in_file << std::endl;
-                    return false;
-                }
+                std::cerr << "To decrypt an object named .aes, one must "
+                             "specify an output file"
+                          << std::endl;
+                return false;
             }
-            catch (const std::exception &e)
+        }
+        else
+        {
+            out_file = output_file;
+        }
+    }
+    else
+#endif
+    if (in_file != "-")
+    {
+        // Filenames should be in UTF-8 format, so form a UTF-8 string type
+        // for use with open() and file_size()
+        SecureU8String u8name(in_file.cbegin(), in_file.cend());
+
+        try
+        {
+            // Attempt to get the file size
+            file_size =
+                std::filesystem::file_size(std::filesystem::path(u8name));
+        }
+        catch (const std::filesystem::filesystem_error &e)
+        {
+            logger->warning << "Unable to determine input file size "
+                               "(file system err="
+                            << e.what() << ")" << std::flush;
+        }
+        catch (const std::exception &e)
+        {
+            logger->warning << "Unable to determine input file size (err="
+                            << e.what() << ")" << std::flush;
+        }
+        catch (...)
+        {
+            logger->warning << "Unable to determine input file size"
+                            << std::flush;
+        }
+
+        // Open the input file for reading, unless already open
+        source = prefetched_source
+                     ? std::move(prefetched_source)
+                     : batch_options.io_backend->OpenSource(logger, in_file);
+        if (!source)
+        {
+            LogSystemError(logger,
+                           std::string("Unable to open input file: ") +
+                               static_cast<std::string>(in_file));
+            std::cerr << "Unable to open input file: " << in_file
+                      << std::endl;
+            return false;
+        }
+        source_istream.emplace(source->Buffer());
+
+        // Current output filename is the input name with .aes stripped off
+        // (there is no output when scrubbing)
+        if (output_file.empty() && !batch_options.scrub)
+        {
+            // Name the output file by stripping off .aes
+            out_file = in_file;
+            out_file.resize(out_file.size() - 4);
+
+            // If the filename is empty, it must have been named .aes
+            if (out_file.empty())
             {
-                logger->error << "Exception trying to determine if filename "
-                                 "has .aes extension"
-                              << std::flush;
-                std::cerr << "Exception trying to determine if filename has "
-                             ".aes extension"
+                std::cerr << "To decrypt a file named .aes, one must "
+                             "specify an output file"
                           << std::endl;
                 return false;
             }
         }
+        else
+        {
+            out_file = output_file;
+        }
+    }
+    else
+    {
+        out_file = output_file;
     }
 
-    logger->info << "Decryption process starting" << std::flush;
+    // Data passes through a throttled stream if bandwidth is limited or
+    // writes are measured to adapt concurrency
+    const bool throttled_io =
+        (batch_options.bandwidth_limiter != nullptr) ||
+        (batch_options.concurrency_controller != nullptr);
+
+    // Assign the input file stream
+#ifdef AESCRYPT_S3
+    std::istream &file_istream =
+        (s3_istream ? *s3_istream
+                    : ((in_file == "-") ? std::cin : *source_istream));
+#else
+    std::istream &file_istream =
+        ((in_file == "-") ? std::cin : *source_istream);
+#endif
 
-    // Iterate over each file and decrypt it
-    for (const auto &in_file : filenames)
+    // Set the buffer to use for reading (a throttled stream has its own)
+    if (!throttled_io)
+    {
+        file_istream.rdbuf()->pubsetbuf(
+            buffers.read_buffer.data(),
+            static_cast<std::streamsize>(buffers.read_buffer.size()));
+    }
+    else
     {
-        std::size_t file_size{};
-        std::ifstream ifs;
-        std::ofstream ofs;
-        bool remove_on_fail{};
+        file_istream.rdbuf()->pubsetbuf(nullptr, 0);
+    }
+
+    // When scrubbing a version 3 file, check its integrity without
+    // decrypting it (the write buffer, otherwise unused, receives input)
+    const bool check_only =
+        batch_options.scrub && source_istream &&
+        (PeekStreamVersion(file_istream) == Scrub_Stream_Version);
 
-        logger->info << "Decrypting: " << in_file << std::flush;
+    // Open the output stream, unless scrubbing, when output is discarded
+    std::optional<NullOStream> null_ostream;
+    std::optional<OutputSpool> spool;
+    std::optional<std::ostream> spool_ostream;
+    if (batch_options.scrub)
+    {
+        null_ostream.emplace();
 
-        // If this file is NOT stdin, get the file size
-        if (in_file != "-")
+        // Emit the file name as a single write, as other jobs may be writing
+        if (!quiet)
         {
-            // Filenames should be in UTF-8 format, so form a UTF-8 string type
-            // for use with open() and file_size()
-            SecureU8String u8name(in_file.cbegin(), in_file.cend());
+            std::cout << (std::string("Scrubbing: ") +
+                          static_cast<std::string>(in_file) + "\n")
+                      << std::flush;
+        }
+    }
+    else if (out_file != "-")
+    {
+        // Filenames should be in UTF-8 format, so form a UTF-8 string type
+        // for use with open()
+        SecureU8String u8name(out_file.cbegin(), out_file.cend());
 
-            try
-            {
-                // Attempt to get the file size
-                file_size =
-                    std::filesystem::file_size(std::filesystem::path(u8name));
-            }
-            catch (const std::filesystem::filesystem_error &e)
-            {
-                logger->warning << "Unable to determine input file size "
-                                   "(file system err="
-                                << e.what() << ")" << std::flush;
-            }
-            catch (const std::exception &e)
-            {
-                logger->warning << "Unable to determine input file size (err="
-                                << e.what() << ")" << std::flush;
-            }
-            catch (...)
-            {
-                logger->warning << "Unable to determine input file size"
-                                << std::flush;
-            }
+        try
+        {
+            // Get the file status
+            std::filesystem::file_status file_status =
+                std::filesystem::status(std::filesystem::path(u8name));
 
-            try
-            {
-                // Open the input file for reading
-                ifs.open(std::filesystem::path(u8name),
-                         std::ios::in | std::ios::binary);
-            }
-            catch (const std::filesystem::filesystem_error &e)
-            {
-                logger->error << "Exception opening input file "
-                                 "(file system err="
-                              << e.what() << ")" << std::flush;
-            }
-            catch (const std::exception &e)
+            // If the output file does not exist, attempt to remove later
+            // (Do not remove by default so as to not attempt to remove
+            // things like character special devices.)
+            if (!std::filesystem::exists(file_status))
             {
-                logger->error << "Exception opening input file (err="
-                              << e.what() << ")" << std::flush;
-            }
-            catch (...)
-            {
-                logger->error << "Exception opening input file" << std::flush;
-            }
-            if (!ifs.good() || !ifs.is_open())
-            {
-                LogSystemError(logger,
-                               std::string("Unable to open input file: ") +
-                                   static_cast<std::string>(in_file));
-                std::cerr << "Unable to open input file: " << in_file
-                          << std::endl;
-                return false;
+                remove_on_fail = true;
             }
 
-            // Current output filename is the input name with .aes stripped off
-            if (output_file.empty())
+            // Does a regular file having this output file name exist?
+            if (std::filesystem::is_regular_file(file_status))
             {
-                // Name the output file by stripping off .aes
-                out_file = in_file;
-                out_file.resize(out_file.size() - 4);
-
-                // If the filename is empty, it must have been named .aes
-                if (out_file.empty())
+                if (!replace_output)
                 {
-                    std::cerr << "To decrypt a file named .aes, one must "
-                                 "specify an output file"
-                              << std::endl;
+                    std::cerr << "Target output file already exists: "
+                              << out_file << std::endl;
                     return false;
                 }
+
+                // Remove the output left by an abandoned attempt
+                logger->warning << "Replacing output file left by an "
+                                   "abandoned attempt: "
+                                << out_file << std::flush;
+                std::filesystem::remove(std::filesystem::path(u8name));
+                remove_on_fail = true;
             }
-            else
-            {
-                out_file = output_file;
-            }
+        }
+        catch (const std::filesystem::filesystem_error &e)
+        {
+            logger->error << "Exception checking output file existence: "
+                          << out_file << " (file system err=" << e.what()
+                          << ")" << std::flush;
+            std::cerr << "Unable to open output file: " << out_file
+                      << std::endl;
+            return false;
+        }
+        catch (const std::exception &e)
+        {
+            logger->error << "Exception checking output file existence: "
+                          << out_file << " (err=" << e.what() << ")"
+                          << std::flush;
+            std::cerr << "Unable to open output file: " << out_file
+                      << std::endl;
+            return false;
+        }
+        catch (...)
+        {
+            logger->error << "Exception checking output file existence: "
+                          << out_file << std::flush;
+            std::cerr << "Unable to open output file: " << out_file
+                      << std::endl;
+            return false;
+        }
+
+        // Open the output file for writing, mapping it into memory if
+        // requested when it is a new file whose size is bounded by the
+        // size of the input (which is otherwise unknown)
+        if (batch_options.mmap_output && remove_on_fail && (file_size > 0))
+        {
+            sink = batch_options.io_backend->OpenMappedSink(logger,
+                                                            out_file,
+                                                            file_size);
         }
         else
         {
-            out_file = output_file;
+            sink = batch_options.io_backend->OpenSink(logger, out_file);
+        }
+        if (!sink)
+        {
+            LogSystemError(logger,
+                           std::string("Unable to open output file: ") +
+                               static_cast<std::string>(out_file));
+            std::cerr << "Unable to open output file: " << out_file
+                      << std::endl;
+            return false;
+        }
+        sink_ostream.emplace(sink->Buffer());
+
+        // Emit the file name as a single write, as other jobs may be writing
+        if (!quiet)
+        {
+            std::cout << (std::string("Decrypting: ") +
+                          static_cast<std::string>(in_file) + "\n")
+                      << std::flush;
+        }
+    }
+
+    else if (batch_options.verified_output)
+    {
+        // Hold output written to stdout until the stream is verified
+        spool.emplace(logger, batch_options.spool_memory);
+        if (!spool->Open())
+        {
+            LogSystemError(logger, "Unable to create output spool");
+            std::cerr << "Unable to hold output until it is verified"
+                      << std::endl;
+            return false;
         }
+        spool_ostream.emplace(&*spool);
+    }
+
+    // Assign the output file stream
+    std::ostream &file_ostream =
+        (null_ostream ? *null_ostream
+                      : (spool ? *spool_ostream
+                               : ((out_file == "-") ? std::cout
+                                                    : *sink_ostream)));
+
+    // Set the buffer to use for writing (a throttled stream has its own)
+    std::streambuf *output_buffer =
+        (sink ? sink->Buffer() : (spool ? &*spool : nullptr));
+    if (output_buffer && !throttled_io)
+    {
+        output_buffer->pubsetbuf(
+            buffers.write_buffer.data(),
+            static_cast<std::streamsize>(buffers.write_buffer.size()));
+    }
+    else if (output_buffer)
+    {
+        output_buffer->pubsetbuf(nullptr, 0);
+    }
+
+    // Create the throttled streams, if used
+    std::optional<ThrottledIStream> throttled_istream;
+    std::optional<ThrottledOStream> throttled_ostream;
+    if (throttled_io)
+    {
+        throttled_istream.emplace(file_istream.rdbuf(),
+                                  batch_options.bandwidth_limiter,
+                                  batch_options.concurrency_controller,
+                                  buffers.read_buffer);
+        if (!check_only)
+        {
+            throttled_ostream.emplace(file_ostream.rdbuf(),
+                                      batch_options.bandwidth_limiter,
+                                      batch_options.concurrency_controller,
+                                      buffers.write_buffer);
+        }
+    }
+    std::istream &istream =
+        (throttled_istream ? *throttled_istream : file_istream);
+    std::ostream &ostream =
+        (throttled_ostream ? *throttled_ostream : file_ostream);
 
-        // Assign the input file stream
-        std::istream &istream = ((in_file == "-") ? std::cin : ifs);
+    // Check or decrypt the input stream to the output stream
+    bool result = check_only ? CheckStream(logger,
+                                           process_control,
+                                           batch_options.thread_priority,
+                                           password,
+                                           istream,
+                                           buffers.write_buffer)
+                             : DecryptStream(logger,
+                                             process_control,
+                                             batch_options.thread_priority,
+                                             hide_progress,
+                                             password,
+                                             file_size,
+                                             istream,
+                                             ostream);
 
-        // Set the buffer to use for reading
-        istream.rdbuf()->pubsetbuf(
-            read_buffer.data(),
-            static_cast<std::streamsize>(read_buffer.size()));
+    // Write any data held by the throttled output stream
+    if (throttled_ostream) throttled_ostream->flush();
 
-        // Open the output stream
-        if (out_file != "-")
+#ifdef AESCRYPT_S3
+    // A failed download ends the input early, so report it
+    if (s3_istream && s3_istream->Failed())
+    {
+        std::cerr << "Unable to download object: " << in_file << std::endl;
+        result = false;
+    }
+#endif
+
+    // Release output held until the stream was verified, or discard it
+    if (spool && result && !spool->Release(process_control))
+    {
+        if (!process_control.Terminating())
         {
-            // Filenames should be in UTF-8 format, so form a UTF-8 string type
-            // for use with open()
+            std::cerr << "Unable to write verified output to stdout"
+                      << std::endl;
+        }
+        result = false;
+    }
+    else if (spool && !result)
+    {
+        logger->warning << "Discarding output of " << in_file
+                        << " that was not verified" << std::flush;
+    }
+
+    // When scrubbing, name each file that failed, as files are checked
+    // concurrently and checking continues after a failure
+    if (batch_options.scrub && !result && !process_control.Terminating())
+    {
+        std::cerr << "Integrity check failed: " << in_file << std::endl;
+    }
+
+    // Close any open files; there may be delay in closing the output
+    // file if it is large and transmission is over a network
+    if (source) source->Close();
+    if (sink && !sink->Close() && result)
+    {
+        LogSystemError(logger,
+                       std::string("Unable to write output file: ") +
+                           static_cast<std::string>(out_file));
+        std::cerr << "Unable to write output file: " << out_file << std::endl;
+        result = false;
+    }
+
+    // Did decryption fail?
+    if (!result)
+    {
+        // Remove the partial output file if possible
+        if (remove_on_fail)
+        {
+            // Filenames should be in UTF-8 format, so form a UTF-8 string
+            // type use with remove()
             SecureU8String u8name(out_file.cbegin(), out_file.cend());
 
             try
             {
-                // Get the file status
-                std::filesystem::file_status file_status =
-                    std::filesystem::status(std::filesystem::path(u8name));
-
-                // If the output file does not exist, attempt to remove later
-                // (Do not remove by default so as to not attempt to remove
-                // things like character special devices.)
-                if (!std::filesystem::exists(file_status))
-                {
-                    remove_on_fail = true;
-                }
-
-                // Does a regular file having this output file name exist?
-                if (std::filesystem::is_regular_file(file_status))
-                {
-                    std::cerr << "Target output file already exists: "
-                              << out_file << std::endl;
-                    return false;
-                }
+                std::filesystem::remove(std::filesystem::path(u8name));
             }
             catch (const std::filesystem::filesystem_error &e)
             {
-                logger->error << "Exception checking output file existence: "
-                              << out_file << " (file system err=" << e.what()
-                              << ")" << std::flush;
-                std::cerr << "Unable to open output file: " << out_file
-                          << std::endl;
-                return false;
+                logger->error << "Unable to remove output file: "
+                              << out_file << " (file system err="
+                              << e.what() << ")" << std::flush;
+                std::cerr << "Unable to remove output file" << std::endl;
             }
             catch (const std::exception &e)
             {
-                logger->error << "Exception checking output file existence: "
+                logger->error << "Unable to remove output file: "
                               << out_file << " (err=" << e.what() << ")"
                               << std::flush;
-                std::cerr << "Unable to open output file: " << out_file
-                          << std::endl;
-                return false;
+                std::cerr << "Unable to remove output file" << std::endl;
             }
             catch (...)
             {
-                logger->error << "Exception checking output file existence: "
+                logger->error << "Unable to remove output file: "
                               << out_file << std::flush;
-                std::cerr << "Unable to open output file: " << out_file
-                          << std::endl;
-                return false;
+                std::cerr << "Unable to remove output file" << std::endl;
             }
+        }
 
-            try
-            {
-                // Open the output file for writing
-                ofs.open(std::filesystem::path(u8name),
-                         std::ios::out | std::ios::binary);
-            }
-            catch (const std::filesystem::filesystem_error &e)
-            {
-                logger->error << "Exception opening output file: " << out_file
-                              << " (file system err=" << e.what() << ")"
-                              << std::flush;
-            }
-            catch (const std::exception &e)
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ *  OpenStreamOutput()
+ *
+ *  Description:
+ *      Open the file to which a stream decrypted from multi-stream input is
+ *      written, refusing to replace an existing file.
+ *
+ *  Parameters:
+ *      logger [in]
+ *          The logger to which logging output will be sent.
+ *
+ *      out_file [in]
+ *          The name of the output file.
+ *
+ *      replace_output [in]
+ *          If true, an existing output file is replaced, as it was left by
+ *          an abandoned attempt to process the input.
+ *
+ *      io_backend [in]
+ *          The backend through which the file is opened.
+ *
+ *  Returns:
+ *      The opened file, or nullptr if it could not be opened.
+ *
+ *  Comments:
+ *      None.
+ */
+std::unique_ptr<Sink> OpenStreamOutput(
+    const Terra::Logger::LoggerPointer &logger,
+    const SecureString &out_file,
+    const bool replace_output,
+    IOBackend &io_backend)
+{
+    // Filenames should be in UTF-8 format, so form a UTF-8 string type
+    SecureU8String u8name(out_file.cbegin(), out_file.cend());
+
+    try
+    {
+        if (std::filesystem::exists(std::filesystem::path(u8name)) &&
+            !replace_output)
+        {
+            std::cerr << "Target output file already exists: " << out_file
+                      << std::endl;
+            return nullptr;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        logger->error << "Exception checking output file existence: "
+                      << out_file << " (err=" << e.what() << ")"
+                      << std::flush;
+    }
+    catch (...)
+    {
+        logger->error << "Exception checking output file existence: "
+                      << out_file << std::flush;
+    }
+
+    auto sink = io_backend.OpenSink(logger, out_file);
+    if (!sink)
+    {
+        LogSystemError(logger,
+                       std::string("Unable to open output file: ") +
+                           static_cast<std::string>(out_file));
+        std::cerr << "Unable to open output file: " << out_file << std::endl;
+    }
+
+    return sink;
+}
+
+/*
+ *  StreamOutputName()
+ *
+ *  Description:
+ *      Name the file to which a stream decrypted from multi-stream input is
+ *      written.
+ *
+ *  Parameters:
+ *      in_file [in]
+ *          The name of the input file, or "-" for stdin.
+ *
+ *      stream [in]
+ *          The AES Crypt stream being decrypted.
+ *
+ *      number [in]
+ *          The position of the stream in the input, starting from 1.
+ *
+ *  Returns:
+ *      The name of the output file.
+ *
+ *  Comments:
+ *      If the stream has a FILENAME extension, the last component of its
+ *      value names the file in the directory of the input.  Otherwise, the
+ *      file is named for the input (with .aes removed) and the number of
+ *      the stream (e.g., backup.000001).  Input from stdin is named
+ *      "stream" in the current directory.
+ */
+SecureString StreamOutputName(const SecureString &in_file,
+                              std::span<const char> stream,
+                              std::size_t number)
+{
+    std::filesystem::path base;
+
+    try
+    {
+        // Name outputs for the input with .aes stripped off
+        SecureString base_name = (in_file == "-") ? SecureString("stream")
+                                                  : in_file;
+        if (HasAESExtension(base_name)) base_name.resize(base_name.size() - 4);
+        base = std::filesystem::path(
+            SecureU8String(base_name.cbegin(), base_name.cend()));
+
+        // Use the name given by the stream, but only within the directory
+        auto filename = StreamSplitter::FindExtension(stream, "FILENAME");
+        if (filename)
+        {
+            std::filesystem::path name =
+                std::filesystem::path(std::u8string(filename->cbegin(),
+                                                    filename->cend()))
+                    .filename();
+            if (!name.empty() && (name != ".") && (name != ".."))
             {
-                logger->error << "Exception opening output file: " << out_file
-                              << " (err=" << e.what() << ")" << std::flush;
+                std::u8string u8name =
+                    (base.parent_path() / name).u8string();
+                return SecureString(u8name.cbegin(), u8name.cend());
             }
-            catch (...)
+        }
+    }
+    catch (...)
+    {
+        // Fall back to numbering the stream
+    }
+
+    std::ostringstream oss;
+    oss << "." << std::setw(6) << std::setfill('0') << number;
+    std::u8string u8name = base.u8string();
+
+    return SecureString(u8name.cbegin(), u8name.cend()) + oss.str().c_str();
+}
+
+/*
+ *  DecryptStreams()
+ *
+ *  Description:
+ *      This function will decrypt each of the AES Crypt streams written
+ *      back-to-back in a single file.
+ *
+ *  Parameters:
+ *      logger [in]
+ *          The logger to which logging output will be sent.
+ *
+ *      process_control [in]
+ *          A structure used by the main thread and worker thread to control
+ *          execution.  For example, if the user pressed CTRL-C while
+ *          decryption is in progress, it will stop after the current stream.
+ *
+ *      io_backend [in]
+ *          The backend through which files are opened.
+ *
+ *      quiet [in]
+ *          If true, the program will not emit messages to the terminal, except
+ *          for error messages (which are directed to stderr).
+ *
+ *      password [in]
+ *          The password (in UTF-8 encoding) to use to decrypt the streams.
+ *
+ *      in_file [in]
+ *          The name of the file containing the streams, or "-" for stdin.
+ *
+ *      output_file [in]
+ *          The name of the output file ("-" for stdout) to which all of the
+ *          streams are written in order.  If empty, each stream is written
+ *          to its own file as named by StreamOutputName().
+ *
+ *      buffers [in]
+ *          The buffers to use for file I/O.
+ *
+ *      replace_output [in]
+ *          If true, existing output files are replaced, as they were left by
+ *          an abandoned attempt to process this file.
+ *
+ *      prefetched_source [in]
+ *          The source from which to read in_file if it was already opened
+ *          (e.g., by the prefetcher), else nullptr.
+ *
+ *  Returns:
+ *      True if every stream was decrypted, false if not.
+ *
+ *  Comments:
+ *      Each stream is held in memory, along with its plaintext, so that no
+ *      output is written for a stream that fails to decrypt.  If a stream
+ *      fails to decrypt, it is extended to the next boundary and decrypted
+ *      again, as the boundary that ended it may have been false.  A stream
+ *      that fails either way is reported and skipped.
+ */
+bool DecryptStreams(const Terra::Logger::LoggerPointer &logger,
+                    ProcessControl &process_control,
+                    IOBackend &io_backend,
+                    const bool quiet,
+                    const SecureU8String &password,
+                    const SecureString &in_file,
+                    const SecureString &output_file,
+                    IOBuffers &buffers,
+                    const bool replace_output,
+                    std::unique_ptr<Source> prefetched_source)
+{
+    std::unique_ptr<Source> source;
+    std::optional<std::istream> source_istream;
+    std::unique_ptr<Sink> sink;
+    std::optional<std::ostream> sink_ostream;
+    std::vector<char> stream;
+    std::vector<char> extension;
+    std::size_t number{};
+    bool result = true;
+
+    using namespace Terra::AESCrypt::Engine;
+
+    logger->info << "Decrypting streams: " << in_file << std::flush;
+
+    // Open the input file
+    if (in_file != "-")
+    {
+        source = prefetched_source ? std::move(prefetched_source)
+                                   : io_backend.OpenSource(logger, in_file);
+        if (!source)
+        {
+            LogSystemError(logger,
+                           std::string("Unable to open input file: ") +
+                               static_cast<std::string>(in_file));
+            std::cerr << "Unable to open input file: " << in_file
+                      << std::endl;
+            return false;
+        }
+        source_istream.emplace(source->Buffer());
+    }
+    std::istream &file_istream =
+        ((in_file == "-") ? std::cin : *source_istream);
+
+    // Open the output file if all streams are written to it
+    if (!output_file.empty() && (output_file != "-"))
+    {
+        sink =
+            OpenStreamOutput(logger, output_file, replace_output, io_backend);
+        if (!sink) return false;
+        sink_ostream.emplace(sink->Buffer());
+    }
+    std::ostream &concatenated_ostream =
+        ((output_file == "-") ? std::cout : *sink_ostream);
+
+    // Decrypt a stream into the given plaintext buffer
+    auto decrypt = [&](const std::vector<char> &ciphertext,
+                       std::ostringstream &plaintext) -> DecryptResult
+    {
+        Decryptor decryptor(logger);
+        std::istringstream iss(std::string(ciphertext.begin(),
+                                           ciphertext.end()));
+
+        return decryptor.Decrypt(static_cast<std::u8string>(password),
+                                 iss,
+                                 plaintext,
+                                 {},
+                                 0);
+    };
+
+    StreamSplitter splitter(file_istream, buffers.read_buffer.size());
+
+    while (true)
+    {
+        // Stop if the process is terminating
+        if (process_control.Terminating())
+        {
+            result = false;
+            break;
+        }
+
+        // Get the next stream
+        if (!splitter.Next(stream)) break;
+        number++;
+
+        std::ostringstream plaintext;
+        DecryptResult decrypt_result = decrypt(stream, plaintext);
+
+        // If the stream did not decrypt, the boundary found may have been
+        // within ciphertext, so try extending it to the next boundary
+        if ((decrypt_result != DecryptResult::Success) &&
+            splitter.PeekExtension(extension))
+        {
+            std::vector<char> extended = stream;
+            extended.insert(extended.end(), extension.begin(), extension.end());
+
+            std::ostringstream extended_plaintext;
+            if (decrypt(extended, extended_plaintext) ==
+                DecryptResult::Success)
             {
-                logger->error << "Exception opening output file: " << out_file
-                              << std::flush;
+                logger->warning << "Stream " << number << " of " << in_file
+                                << " contained a false stream boundary"
+                                << std::flush;
+                splitter.Discard(extension.size());
+                stream.swap(extended);
+                plaintext.swap(extended_plaintext);
+                decrypt_result = DecryptResult::Success;
             }
-            if (!ofs.good() || !ofs.is_open())
+        }
+
+        if (decrypt_result != DecryptResult::Success)
+        {
+            std::cerr << "Error decrypting stream " << number << " of "
+                      << in_file << ": " << decrypt_result << std::endl;
+            result = false;
+            continue;
+        }
+
+        const std::string_view view = plaintext.view();
+
+        // Append the plaintext to the concatenated output
+        if (!output_file.empty())
+        {
+            concatenated_ostream.write(
+                view.data(),
+                static_cast<std::streamsize>(view.size()));
+            if (!concatenated_ostream.good())
             {
-                LogSystemError(logger,
-                               std::string("Unable to open output file: ") +
-                                   static_cast<std::string>(out_file));
-                std::cerr << "Unable to open output file: " << out_file
+                std::cerr << "Unable to write output file: " << output_file
                           << std::endl;
-                return false;
+                result = false;
+                break;
             }
+            continue;
+        }
 
-            if (!quiet) std::cout << "Decrypting: " << in_file << std::endl;
+        // Write the plaintext to its own file
+        SecureString out_file = StreamOutputName(in_file, stream, number);
+        auto stream_sink =
+            OpenStreamOutput(logger, out_file, replace_output, io_backend);
+        if (!stream_sink)
+        {
+            result = false;
+            continue;
+        }
+        const std::streamsize written = stream_sink->Buffer()->sputn(
+            view.data(),
+            static_cast<std::streamsize>(view.size()));
+        if (!stream_sink->Close() ||
+            (written != static_cast<std::streamsize>(view.size())))
+        {
+            std::cerr << "Unable to write output file: " << out_file
+                      << std::endl;
+            result = false;
+            continue;
+        }
+
+        // Emit the file name as a single write, as other jobs may be writing
+        if (!quiet)
+        {
+            std::cout << (std::string("Decrypted: ") +
+                          static_cast<std::string>(out_file) + "\n")
+                      << std::flush;
         }
+    }
+
+    // Report any error reading the input
+    if (splitter.Failed())
+    {
+        std::cerr << "Error reading input file: " << in_file << std::endl;
+        result = false;
+    }
 
-        // Assign the output file stream
-        std::ostream &ostream = ((out_file == "-") ? std::cout : ofs);
+    if (output_file == "-") std::cout.flush();
+    if (source) source->Close();
+    if (sink && !sink->Close() && result)
+    {
+        std::cerr << "Unable to write output file: " << output_file
+                  << std::endl;
+        result = false;
+    }
 
-        // Set the buffer to use for writing
-        ofs.rdbuf()->pubsetbuf(
-            write_buffer.data(),
-            static_cast<std::streamsize>(write_buffer.size()));
+    logger->info << "Decrypted " << number << " streams from " << in_file
+                 << std::flush;
 
-        // Decrypt the input stream to the output stream
-        bool result = DecryptStream(logger,
-                                    process_control,
-                                    (quiet || stdout_used),
-                                    password,
-                                    file_size,
-                                    istream,
-                                    ostream);
+    return result;
+}
 
-        // Close any open files; there may be delay in closing the output
-        // file if it is large and transmission is over a network
-        if (ifs.is_open()) ifs.close();
-        if (ofs.is_open())
-        {
-            ofs.flush();
-            ofs.close();
-        }
+} // namespace
+
+/*
+ *  DecryptFiles()
+ *
+ *  Description:
+ *      This function will take a list of filenames and decrypt them.
+ *      All files are decrypted using the same password and the output will
+ *      either be to a new file with a .aes extension or to stdout.
+ *
+ *  Parameters:
+ *      parent_logger [in]
+ *          A parent logger to which the child logger would direct logging
+ *          messages.
+ *
+ *      process_control [in]
+ *          A structure used by the main thread and worker thread to control
+ *          execution.  For example, if the user pressed CTRL-C while
+ *          decryption is in progress, it will gracefully terminate
+ *          decryption and allow the program to exit.
+ *
+ *      batch_options [in]
+ *          Options controlling how many files are decrypted concurrently and
+ *          the size of the I/O buffers.
+ *
+ *      quiet [in]
+ *          If true, the program will not emit messages to the terminal, except
+ *          for error messages (which are directed to stderr).
+ *
+ *      password [in]
+ *          The password (in UTF-8 encoding) to use to decrypt files.
+ *
+ *      filenames [in]
+ *          A vector of filenames to decrypt.
+ *
+ *      output_file [in]
+ *          The name of the output file if output is going to a single file.
+ *          This MUST NOT be specified if there is more than one file in
+ *          the list of filenames. That requirement is not checked here.
+ *
+ *  Returns:
+ *      True if decryption is successful, false if not.
+ *
+ *  Comments:
+ *      None.
+ */
+bool DecryptFiles(
+    const Terra::Logger::LoggerPointer &parent_logger,
+    ProcessControl &process_control,
+    const BatchOptions &batch_options,
+    const bool quiet,
+    const SecureU8String &password,
+    const std::vector<SecureString> &filenames,
+    const SecureString &output_file)
+{
+    // Hide progress meters if writing to stdout or processing concurrently
+    const bool hide_progress =
+        quiet || (output_file == "-") || (batch_options.jobs > 1);
+
+    // Create a child logger
+    Terra::Logger::LoggerPointer logger =
+        std::make_shared<Terra::Logger::Logger>(parent_logger, "FILE");
 
-        // Did decryption fail?
-        if (!result)
+    // If an output file is not specified, ensure all filenames end in .aes
+    // (scrubbing produces no output, so any file may be checked)
+    if (output_file.empty() && !batch_options.scrub)
+    {
+        for (const auto &in_file : filenames)
         {
-            // Remove the partial output file if possible
-            if (remove_on_fail)
-            {
-                // Filenames should be in UTF-8 format, so form a UTF-8 string
-                // type use with remove()
-                SecureU8String u8name(out_file.cbegin(), out_file.cend());
+            // Streams read from stdin are named without an extension
+            if (batch_options.multi_stream && (in_file == "-")) continue;
 
-                try
-                {
-                    std::filesystem::remove(std::filesystem::path(u8name));
-                }
-                catch (const std::filesystem::filesystem_error &e)
-                {
-                    logger->error << "Unable to remove output file: "
-                                  << out_file << " (file system err="
-                                  << e.what() << ")" << std::flush;
-                    std::cerr << "Unable to remove output file" << std::endl;
-                }
-                catch (const std::exception &e)
-                {
-                    logger->error << "Unable to remove output file: "
-                                  << out_file << " (err=" << e.what() << ")"
-                                  << std::flush;
-                    std::cerr << "Unable to remove output file" << std::endl;
-                }
-                catch (...)
+            try
+            {
+                if (!HasAESExtension(in_file))
                 {
-                    logger->error << "Unable to remove output file: "
-                                  << out_file << std::flush;
-                    std::cerr << "Unable to remove output file" << std::endl;
+                    logger->error << "Input file does not end with .aes: "
+                                << in_file << std::flush;
+                    std::cerr << "Input file does not end with .aes and no "
+                                 "output file was specified: "
+                              << in_file << std::endl;
+                    return false;
                 }
             }
-
-            return false;
+            catch (const std::exception &e)
+            {
+                logger->error << "Exception trying to determine if filename "
+                                 "has .aes extension"
+                              << std::flush;
+                std::cerr << "Exception trying to determine if filename has "
+                             ".aes extension"
+                          << std::endl;
+                return false;
+            }
         }
-
-        // If termination requested, return
-        if (process_control.terminate) return false;
     }
 
+    logger->info << "Decryption process starting" << std::flush;
+
+    // Decrypt each of the files
+    bool result = ProcessFileBatch(
+        logger,
+        process_control,
+        batch_options,
+        filenames,
+        [&](std::size_t index,
+            IOBuffers &buffers,
+            bool replace_output,
+            std::unique_ptr<Source> source) -> bool
+        {
+            if (batch_options.multi_stream)
+            {
+                return DecryptStreams(logger,
+                                      process_control,
+                                      *batch_options.io_backend,
+                                      quiet,
+                                      password,
+                                      filenames[index],
+                                      output_file,
+                                      buffers,
+                                      replace_output,
+                                      std::move(source));
+            }
+
+            return DecryptFile(logger,
+                               process_control,
+                               batch_options,
+                               quiet,
+                               hide_progress,
+                               password,
+                               filenames[index],
+                               output_file,
+                               buffers,
+                               replace_output,
+                               std::move(source));
+        });
+    if (!result) return false;
+
     logger->info << "Decryption process complete" << std::flush;
 
     return true;
@@ -23,12 +23,13 @@
 #include <terra/logger/logger.h>
 #include "secure_containers.h"
 #include "process_control.h"
+#include "batch_options.h"
 
 /*
  *  DecryptFiles()
  *
  *  Description:
- *      This function will take a list of filenames and decrypt them serially.
+ *      This function will take a list of filenames and decrypt them.
  *      All files are decrypted using the same password and the output will
  *      either be to a new file without the .aes extension or to stdout.
  *
@@ -43,6 +44,10 @@
  *          decryption is in progress, it will gracefully terminate
  *          decryption and allow the program to exit.
  *
+ *      batch_options [in]
+ *          Options controlling how many files are decrypted concurrently and
+ *          the size of the I/O buffers.
+ *
  *      quiet [in]
  *          If true, the program will not emit messages to the terminal, except
  *          for error messages (which are directed to stderr).
@@ -66,6 +71,7 @@
  */
 bool DecryptFiles(const Terra::Logger::LoggerPointer &parent_logger,
                   ProcessControl &process_control,
+                  const BatchOptions &batch_options,
                   const bool quiet,
                   const SecureU8String &password,
                   const std::vector<SecureString> &filenames,
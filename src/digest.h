@@ -0,0 +1,219 @@
+/*
+ *  digest.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file defines functions to compute SHA-256 message digests and
+ *      HMAC-SHA256 message authentication codes using the Terra crypto
+ *      library (the same library the AES Crypt Engine uses), and functions
+ *      to encode binary values as hexadecimal or base64 text.  These are
+ *      used to sign and check requests made to object storage services, to
+ *      compare data, and to check the integrity of AES Crypt streams.
+ *
+ *  Portability Issues:
+ *      None.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <array>
+#include <span>
+#include <string>
+#include <string_view>
+#include <terra/crypto/hashing/sha256.h>
+#include <terra/crypto/hashing/hmac.h>
+
+// A SHA-256 message digest (or HMAC-SHA256 message authentication code)
+using SHA256Digest = std::array<std::uint8_t, 32>;
+
+/*
+ *  FinalizeSHA256()
+ *
+ *  Description:
+ *      Finalize the given SHA-256 computation and return the digest.
+ *
+ *  Parameters:
+ *      sha256 [in/out]
+ *          The SHA-256 object into which data was input.
+ *
+ *  Returns:
+ *      The message digest.
+ *
+ *  Comments:
+ *      No further data may be input until the object is reset.
+ */
+inline SHA256Digest FinalizeSHA256(Terra::Crypto::Hashing::SHA256 &sha256)
+{
+    SHA256Digest digest{};
+
+    sha256.Finalize();
+    sha256.Result(digest);
+
+    return digest;
+}
+
+/*
+ *  ComputeSHA256()
+ *
+ *  Description:
+ *      Compute the SHA-256 message digest of the given data.
+ *
+ *  Parameters:
+ *      data [in]
+ *          The data over which to compute the message digest.
+ *
+ *  Returns:
+ *      The message digest.
+ *
+ *  Comments:
+ *      None.
+ */
+inline SHA256Digest ComputeSHA256(std::span<const std::uint8_t> data)
+{
+    Terra::Crypto::Hashing::SHA256 sha256;
+
+    sha256.Input(data);
+
+    return FinalizeSHA256(sha256);
+}
+
+/*
+ *  ComputeSHA256()
+ *
+ *  Description:
+ *      Compute the SHA-256 message digest of the given data.
+ *
+ *  Parameters:
+ *      data [in]
+ *          The data over which to compute the message digest.
+ *
+ *  Returns:
+ *      The message digest.
+ *
+ *  Comments:
+ *      None.
+ */
+inline SHA256Digest ComputeSHA256(std::string_view data)
+{
+    Terra::Crypto::Hashing::SHA256 sha256;
+
+    sha256.Input(data);
+
+    return FinalizeSHA256(sha256);
+}
+
+/*
+ *  ComputeHMACSHA256()
+ *
+ *  Description:
+ *      Compute the HMAC-SHA256 message authentication code of the given data
+ *      using the given key.
+ *
+ *  Parameters:
+ *      key [in]
+ *          The key.
+ *
+ *      data [in]
+ *          The data over which to compute the message authentication code.
+ *
+ *  Returns:
+ *      The message authentication code.
+ *
+ *  Comments:
+ *      None.
+ */
+inline SHA256Digest ComputeHMACSHA256(std::span<const std::uint8_t> key,
+                                      std::string_view data)
+{
+    Terra::Crypto::Hashing::HMAC hmac(
+        Terra::Crypto::Hashing::HashAlgorithm::SHA256,
+        key);
+    SHA256Digest result{};
+
+    hmac.Input(data);
+    hmac.Finalize();
+    hmac.Result(result);
+
+    return result;
+}
+
+/*
+ *  HexEncode()
+ *
+ *  Description:
+ *      Encode the given data as lowercase hexadecimal text.
+ *
+ *  Parameters:
+ *      data [in]
+ *          The data to encode.
+ *
+ *  Returns:
+ *      The encoded text.
+ *
+ *  Comments:
+ *      None.
+ */
+inline std::string HexEncode(std::span<const std::uint8_t> data)
+{
+    constexpr char Digits[] = "0123456789abcdef";
+    std::string text;
+
+    text.reserve(data.size() * 2);
+
+    for (std::uint8_t octet : data)
+    {
+        text.push_back(Digits[octet >> 4]);
+        text.push_back(Digits[octet & 0x0f]);
+    }
+
+    return text;
+}
+
+/*
+ *  Base64Encode()
+ *
+ *  Description:
+ *      Encode the given data as base64 text (per RFC 4648), with padding.
+ *
+ *  Parameters:
+ *      data [in]
+ *          The data to encode.
+ *
+ *  Returns:
+ *      The encoded text.
+ *
+ *  Comments:
+ *      None.
+ */
+inline std::string Base64Encode(std::span<const std::uint8_t> data)
+{
+    constexpr char Alphabet[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string text;
+
+    text.reserve(((data.size() + 2) / 3) * 4);
+
+    for (std::size_t i = 0; i < data.size(); i += 3)
+    {
+        const std::size_t count = std::min<std::size_t>(3, data.size() - i);
+        std::uint32_t group = static_cast<std::uint32_t>(data[i]) << 16;
+        if (count > 1) group |= static_cast<std::uint32_t>(data[i + 1]) << 8;
+        if (count > 2) group |= static_cast<std::uint32_t>(data[i + 2]);
+
+        text.push_back(Alphabet[(group >> 18) & 0x3f]);
+        text.push_back(Alphabet[(group >> 12) & 0x3f]);
+        text.push_back((count > 1) ? Alphabet[(group >> 6) & 0x3f] : '=');
+        text.push_back((count > 2) ? Alphabet[group & 0x3f] : '=');
+    }
+
+    return text;
+}
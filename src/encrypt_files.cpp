@@ -17,14 +17,24 @@
 
 #include <iostream>
 #include <filesystem>
-#include <fstream>
 #include <thread>
 #include <mutex>
 #include <cstdint>
+#include <optional>
+#include <memory>
 #include <terra/aescrypt/engine/encryptor.h>
 #include "encrypt_files.h"
 #include "error_string.h"
 #include "aescrypt.h"
+#include "file_batch.h"
+#include "throttled_stream.h"
+#include "flushing_stream.h"
+#include "encryption_verifier.h"
+#include "thread_priority.h"
+#ifdef AESCRYPT_S3
+#include "s3_client.h"
+#include "s3_stream.h"
+#endif
 
 namespace
 {
@@ -46,6 +56,10 @@ namespace
  *          encryption is in progress, it will gracefully terminate
  *          encryption and allow the program to exit.
  *
+ *      thread_priority [in]
+ *          The I/O and CPU scheduling priority to apply to the thread
+ *          performing encryption.
+ *
  *      quiet [in]
  *          If true, the program will not emit messages to the terminal, except
  *          for error messages (which are directed to stderr).
@@ -79,6 +93,7 @@ namespace
 bool EncryptStream(
     const Terra::Logger::LoggerPointer &logger,
     ProcessControl &process_control,
+    const ThreadPriority &thread_priority,
     bool quiet,
     const SecureU8String &password,
     const std::uint32_t iterations,
@@ -88,8 +103,6 @@ bool EncryptStream(
     std::ostream &ostream)
 {
     Terra::AESCrypt::Engine::EncryptResult encrypt_result{};
-    bool encryption_complete{};
-    bool cancel_encryption{};
 
     using namespace Terra::AESCrypt::Engine;
 
@@ -121,10 +134,22 @@ bool EncryptStream(
     // Create an AES Crypt Engine Encryptor object
     Encryptor encryptor(logger);
 
+    // Cancel encryption if termination is requested while in progress
+    auto cancel_handler = std::make_unique<ScopedCancelHandler>(
+        process_control,
+        [&]()
+        {
+            std::cerr << "Request cancelled; cleaning up..." << std::endl;
+            encryptor.Cancel();
+        });
+
     // Encrypt the stream via a separate thread
     std::thread encrypt_thread(
         [&]()
         {
+            // Lower the priority of this thread only, if requested
+            ApplyThreadPriority(logger, thread_priority);
+
             // Encrypt the current input stream
             encrypt_result = encryptor.Encrypt(
                 static_cast<std::u8string>(password),
@@ -135,42 +160,17 @@ bool EncryptStream(
                 meter_updater,
                 input_size /
                     Terra::ConIO::ProgressMeter::Default_Maximum_Width);
-
-            // Lock the mutex to assign result
-            std::lock_guard<std::mutex> lock(process_control.mutex);
-            encryption_complete = true;
-            process_control.cv.notify_all();
         });
 
-    // Lock the mutex
-    std::unique_lock<std::mutex> lock(process_control.mutex);
-
-    // Wait for encryption to complete or to be told to terminate
-    process_control.cv.wait(lock,
-                            [&]() -> bool
-                            {
-                                return encryption_complete ||
-                                       process_control.terminate;
-                            });
-
-    // If the process should terminate, cancel encrytion if still going
-    cancel_encryption = process_control.terminate && (!encryption_complete);
-
-    // Unlock the mutex
-    lock.unlock();
+    // Wait for the encryption thread to exit, which it does promptly if
+    // cancelled because termination was requested
+    encrypt_thread.join();
 
     // Clear the progress meter
     progress_meter.Stop();
 
-    // If the process should terminate, can encryption if still working
-    if (cancel_encryption)
-    {
-        std::cerr << "Request cancelled; cleaning up..." << std::endl;
-        encryptor.Cancel();
-    }
-
-    // Wait for the encryption thread to exit
-    encrypt_thread.join();
+    // Stop cancelling encryption if termination is requested
+    cancel_handler.reset();
 
     // If encryption failed for reasons other than cancellation, report why
     if ((encrypt_result != EncryptResult::Success) &&
@@ -184,20 +184,15 @@ bool EncryptStream(
     return encrypt_result == EncryptResult::Success;
 }
 
-} // namespace
-
 /*
- *  EncryptFiles()
+ *  EncryptFile()
  *
  *  Description:
- *      This function will take a list of filenames and encrypt them serially.
- *      All files are encrypted using the same password and the output will
- *      either be to a new file with a .aes extension or to stdout.
+ *      This function will encrypt a single file.
  *
  *  Parameters:
- *      parent_logger [in]
- *          A parent logger to which the child logger would direct logging
- *          messages.
+ *      logger [in]
+ *          The logger to which logging output will be sent.
  *
  *      process_control [in]
  *          A structure used by the main thread and worker thread to control
@@ -205,313 +200,563 @@ bool EncryptStream(
  *          encryption is in progress, it will gracefully terminate
  *          encryption and allow the program to exit.
  *
+ *      batch_options [in]
+ *          Options controlling processing, including the bandwidth limiter
+ *          and concurrency controller (if any) through which data passes.
+ *
  *      quiet [in]
  *          If true, the program will not emit messages to the terminal, except
  *          for error messages (which are directed to stderr).
  *
+ *      hide_progress [in]
+ *          If true, the progress meter will not be displayed.
+ *
  *      password [in]
  *          The password (in UTF-8 encoding) to use to encrypt files.
  *
  *      iterations [in]
  *          The number of iterations to use with the KDF function.
  *
- *      filenames [in]
- *          A vector of filenames to encrypt.
+ *      in_file [in]
+ *          The name of the file to encrypt, or "-" for stdin.
  *
  *      output_file [in]
  *          The name of the output file if output is going to a single file.
- *          This should not be specified if there is more than one file in
- *          the list of filenames. That requirement is not checked here.
+ *          If empty, the output file is named by appending .aes to in_file.
+ *          An object URL (s3://bucket/key) uploads the output as that
+ *          object using batch_options.s3_client.
  *
  *      extensions [in]
  *          A list of name/value string pairs that are inserted into the
  *          head of the AES Crypt output stream.  These are neither encrypted
  *          nor authenticated.
  *
+ *      buffers [in]
+ *          The buffers to use for file I/O.
+ *
+ *      replace_output [in]
+ *          If true, an existing output file is replaced, as it was left by
+ *          an abandoned attempt to process this file.
+ *
+ *      prefetched_source [in]
+ *          The source from which to read in_file if it was already opened
+ *          (e.g., by the prefetcher), else nullptr.
+ *
  *  Returns:
  *      True if encryption is successful, false if not.
  *
  *  Comments:
  *      None.
  */
-bool EncryptFiles(
-    const Terra::Logger::LoggerPointer &parent_logger,
+bool EncryptFile(
+    const Terra::Logger::LoggerPointer &logger,
     ProcessControl &process_control,
+    const BatchOptions &batch_options,
     const bool quiet,
+    const bool hide_progress,
     const SecureU8String &password,
     const std::uint32_t iterations,
-    const std::vector<SecureString> &filenames,
+    const SecureString &in_file,
     const SecureString &output_file,
-    const std::vector<std::pair<std::string, std::string>> &extensions)
+    const std::vector<std::pair<std::string, std::string>> &extensions,
+    IOBuffers &buffers,
+    const bool replace_output,
+    std::unique_ptr<Source> prefetched_source)
 {
     SecureString out_file;
-    bool stdout_used = (output_file == "-");
-
-    // Secure buffer for file I/O
-    SecureVector<char> read_buffer(Buffered_IO_Size, 0);
-    SecureVector<char> write_buffer(Buffered_IO_Size, 0);
-
-    // Create a child logger
-    Terra::Logger::LoggerPointer logger =
-        std::make_shared<Terra::Logger::Logger>(parent_logger, "FILE");
+    std::size_t file_size{};
+    std::unique_ptr<Source> source;
+    std::optional<std::istream> source_istream;
+    std::unique_ptr<Sink> sink;
+    std::optional<std::ostream> sink_ostream;
+    bool remove_on_fail{};
 
-    logger->info << "Encryption process starting" << std::flush;
+    logger->info << "Encrypting: " << in_file << std::flush;
 
-    // Iterate over each file and encrypt it
-    for (const auto &in_file : filenames)
+    // If this file is NOT stdin, get the file size
+    if (in_file != "-")
     {
-        std::size_t file_size{};
-        std::ifstream ifs;
-        std::ofstream ofs;
-        bool remove_on_fail{};
+        // Filenames should be in UTF-8 format, so form a UTF-8 string type
+        // for use with open() and file_size()
+        SecureU8String u8name(in_file.cbegin(), in_file.cend());
 
-        logger->info << "Encrypting: " << in_file << std::flush;
+        try
+        {
+            // Attempt to get the file size
+            file_size =
+                std::filesystem::file_size(std::filesystem::path(u8name));
+        }
+        catch (const std::filesystem::filesystem_error &e)
+        {
+            logger->warning << "Unable to determine input file size "
+                               "(file system err="
+                            << e.what() << ")" << std::flush;
+        }
+        catch (const std::exception &e)
+        {
+            logger->warning << "Unable to determine input file size (err="
+                            << e.what() << ")" << std::flush;
+        }
+        catch (...)
+        {
+            logger->warning << "Unable to determine input file size"
+                            << std::flush;
+        }
 
-        // If this file is NOT stdin, get the file size
-        if (in_file != "-")
+        // Open the input file for reading, unless already open
+        source = prefetched_source
+                     ? std::move(prefetched_source)
+                     : batch_options.io_backend->OpenSource(logger, in_file);
+        if (!source)
         {
-            // Filenames should be in UTF-8 format, so form a UTF-8 string type
-            // for use with open() and file_size()
-            SecureU8String u8name(in_file.cbegin(), in_file.cend());
+            LogSystemError(logger,
+                           std::string("Unable to open input file: ") +
+                               static_cast<std::string>(in_file));
+            std::cerr << "Unable to open input file: " << in_file
+                      << std::endl;
+            return false;
+        }
 
-            try
-            {
-                // Attempt to get the file size
-                file_size =
-                    std::filesystem::file_size(std::filesystem::path(u8name));
-            }
-            catch (const std::filesystem::filesystem_error &e)
-            {
-                logger->warning << "Unable to determine input file size "
-                                   "(file system err="
-                                << e.what() << ")" << std::flush;
-            }
-            catch (const std::exception &e)
-            {
-                logger->warning << "Unable to determine input file size (err="
-                                << e.what() << ")" << std::flush;
-            }
-            catch (...)
-            {
-                logger->warning << "Unable to determine input file size"
-                                << std::flush;
-            }
+        source_istream.emplace(source->Buffer());
 
-            try
-            {
-                // Open the input file for reading
-                ifs.open(std::filesystem::path(u8name),
-                         std::ios::in | std::ios::binary);
-            }
-            catch (const std::filesystem::filesystem_error &e)
-            {
-                logger->error << "Exception opening input file "
-                                 "(file system err="
-                              << e.what() << ")" << std::flush;
-            }
-            catch (const std::exception &e)
-            {
-                logger->error << "Exception opening input file (err="
-                              << e.what() << ")" << std::flush;
-            }
-            catch (...)
-            {
-                logger->error << "Exception opening input file" << std::flush;
-            }
-            if (!ifs.good() || !ifs.is_open())
-            {
-                LogSystemError(logger,
-                               std::string("Unable to open input file: ") +
-                                   static_cast<std::string>(in_file));
-                std::cerr << "Unable to open input file: " << in_file
-                          << std::endl;
-                return false;
-            }
-
-            // Current output filename will be the input filename + .aes
-            if (output_file.empty())
-            {
-                out_file = in_file + ".aes";
-            }
-            else
-            {
-                out_file = output_file;
-            }
+        // Current output filename will be the input filename + .aes
+        if (output_file.empty())
+        {
+            out_file = in_file + ".aes";
         }
         else
         {
             out_file = output_file;
         }
+    }
+    else
+    {
+        out_file = output_file;
+    }
 
-        // Assign the input file stream
-        std::istream &istream = ((in_file == "-") ? std::cin : ifs);
+    // Data passes through a throttled stream if bandwidth is limited or
+    // writes are measured to adapt concurrency
+    const bool throttled_io =
+        (batch_options.bandwidth_limiter != nullptr) ||
+        (batch_options.concurrency_controller != nullptr);
 
-        // Set the buffer to use for reading
-        istream.rdbuf()->pubsetbuf(
-            read_buffer.data(),
-            static_cast<std::streamsize>(read_buffer.size()));
+    // Assign the input file stream
+    std::istream &file_istream =
+        ((in_file == "-") ? std::cin : *source_istream);
 
-        // Open the output stream
-        if (out_file != "-")
+    // Set the buffer to use for reading (a throttled stream has its own)
+    if (!throttled_io)
+    {
+        file_istream.rdbuf()->pubsetbuf(
+            buffers.read_buffer.data(),
+            static_cast<std::streamsize>(buffers.read_buffer.size()));
+    }
+    else
+    {
+        file_istream.rdbuf()->pubsetbuf(nullptr, 0);
+    }
+
+    // Open the output stream, which is an upload if the output is an object
+#ifdef AESCRYPT_S3
+    std::optional<S3UploadStream> s3_ostream;
+    if (IsS3URL(static_cast<std::string>(out_file)))
+    {
+        const auto location = ParseS3URL(static_cast<std::string>(out_file));
+        if (!location || (batch_options.s3_client == nullptr))
         {
-            // Filenames should be in UTF-8 format, so form a UTF-8 string type
-            // for use with open()
-            SecureU8String u8name(out_file.cbegin(), out_file.cend());
+            std::cerr << "Invalid object URL: " << out_file << std::endl;
+            return false;
+        }
 
-            try
+        s3_ostream.emplace(logger,
+                           *batch_options.s3_client,
+                           *location,
+                           batch_options.s3_part_size,
+                           batch_options.s3_connections);
+        if (!s3_ostream->Open())
+        {
+            std::cerr << "Unable to start upload: " << out_file << std::endl;
+            return false;
+        }
+
+        // Emit the file name as a single write, as other jobs may be writing
+        if (!quiet)
+        {
+            std::cout << (std::string("Encrypting: ") +
+                          static_cast<std::string>(in_file) + "\n")
+                      << std::flush;
+        }
+    }
+    else
+#endif
+    if (out_file != "-")
+    {
+        // Filenames should be in UTF-8 format, so form a UTF-8 string type
+        // for use with open()
+        SecureU8String u8name(out_file.cbegin(), out_file.cend());
+
+        try
+        {
+            // Get the file status
+            std::filesystem::file_status file_status =
+                std::filesystem::status(std::filesystem::path(u8name));
+
+            // If the output file does not exist, attempt to remove later
+            // (Do not remove by default so as to not attempt to remove
+            // things like character special devices.)
+            if (!std::filesystem::exists(file_status))
             {
-                // Get the file status
-                std::filesystem::file_status file_status =
-                    std::filesystem::status(std::filesystem::path(u8name));
-
-                // If the output file does not exist, attempt to remove later
-                // (Do not remove by default so as to not attempt to remove
-                // things like character special devices.)
-                if (!std::filesystem::exists(file_status))
-                {
-                    remove_on_fail = true;
-                }
+                remove_on_fail = true;
+            }
 
-                // Does a regular file having this output file name exist?
-                if (std::filesystem::is_regular_file(file_status))
+            // Does a regular file having this output file name exist?
+            if (std::filesystem::is_regular_file(file_status))
+            {
+                if (!replace_output)
                 {
                     std::cerr << "Target output file already exists: "
                               << out_file << std::endl;
                     return false;
                 }
+
+                // Remove the output left by an abandoned attempt
+                logger->warning << "Replacing output file left by an "
+                                   "abandoned attempt: "
+                                << out_file << std::flush;
+                std::filesystem::remove(std::filesystem::path(u8name));
+                remove_on_fail = true;
             }
-            catch (const std::filesystem::filesystem_error &e)
-            {
-                logger->error << "Exception checking output file existence: "
-                              << out_file << "(file system err=" << e.what()
-                              << ")" << std::flush;
-                std::cerr << "Unable to open output file: " << out_file
-                          << std::endl;
-                return false;
-            }
-            catch (const std::exception &e)
-            {
-                logger->error << "Exception checking output file existence: "
-                              << out_file << "(err=" << e.what() << ")"
-                              << std::flush;
-                std::cerr << "Unable to open output file: " << out_file
-                          << std::endl;
-                return false;
-            }
-            catch (...)
-            {
-                logger->error << "Exception checking output file existence: "
-                              << out_file << std::flush;
-                std::cerr << "Unable to open output file: " << out_file
-                          << std::endl;
-                return false;
-            }
+        }
+        catch (const std::filesystem::filesystem_error &e)
+        {
+            logger->error << "Exception checking output file existence: "
+                          << out_file << "(file system err=" << e.what()
+                          << ")" << std::flush;
+            std::cerr << "Unable to open output file: " << out_file
+                      << std::endl;
+            return false;
+        }
+        catch (const std::exception &e)
+        {
+            logger->error << "Exception checking output file existence: "
+                          << out_file << "(err=" << e.what() << ")"
+                          << std::flush;
+            std::cerr << "Unable to open output file: " << out_file
+                      << std::endl;
+            return false;
+        }
+        catch (...)
+        {
+            logger->error << "Exception checking output file existence: "
+                          << out_file << std::flush;
+            std::cerr << "Unable to open output file: " << out_file
+                      << std::endl;
+            return false;
+        }
+
+        // Open the output file for writing
+        sink = batch_options.io_backend->OpenSink(logger, out_file);
+        if (!sink)
+        {
+            LogSystemError(logger,
+                           std::string("Unable to open output file: ") +
+                               static_cast<std::string>(out_file));
+            std::cerr << "Unable to open output file: " << out_file
+                      << std::endl;
+            return false;
+        }
+        sink_ostream.emplace(sink->Buffer());
+
+        // Emit the file name as a single write, as other jobs may be writing
+        if (!quiet)
+        {
+            std::cout << (std::string("Encrypting: ") +
+                          static_cast<std::string>(in_file) + "\n")
+                      << std::flush;
+        }
+    }
+
+    // Assign the output file stream
+#ifdef AESCRYPT_S3
+    std::ostream &file_ostream =
+        (s3_ostream ? *s3_ostream
+                    : ((out_file == "-") ? std::cout : *sink_ostream));
+#else
+    std::ostream &file_ostream =
+        ((out_file == "-") ? std::cout : *sink_ostream);
+#endif
+
+    // Set the buffer to use for writing (a throttled stream has its own)
+    if (sink && !throttled_io)
+    {
+        sink->Buffer()->pubsetbuf(
+            buffers.write_buffer.data(),
+            static_cast<std::streamsize>(buffers.write_buffer.size()));
+    }
+    else if (sink)
+    {
+        sink->Buffer()->pubsetbuf(nullptr, 0);
+    }
+
+    // Create the throttled streams, if used
+    std::optional<ThrottledIStream> throttled_istream;
+    std::optional<ThrottledOStream> throttled_ostream;
+    if (throttled_io)
+    {
+        throttled_istream.emplace(file_istream.rdbuf(),
+                                  batch_options.bandwidth_limiter,
+                                  batch_options.concurrency_controller,
+                                  buffers.read_buffer);
+        throttled_ostream.emplace(file_ostream.rdbuf(),
+                                  batch_options.bandwidth_limiter,
+                                  batch_options.concurrency_controller,
+                                  buffers.write_buffer);
+    }
+    std::istream &istream =
+        (throttled_istream ? *throttled_istream : file_istream);
+    std::ostream &buffered_ostream =
+        (throttled_ostream ? *throttled_ostream : file_ostream);
+
+    // Create the flushing stream if there is a flush policy
+    std::optional<FlushingOStream> flushing_ostream;
+    if ((batch_options.flush_interval.count() > 0) ||
+        (batch_options.flush_bytes > 0))
+    {
+        flushing_ostream.emplace(buffered_ostream.rdbuf(),
+                                 batch_options.flush_interval,
+                                 batch_options.flush_bytes);
+    }
+    std::ostream &unverified_ostream =
+        (flushing_ostream ? *flushing_ostream : buffered_ostream);
+
+    // Create the verifier if the output is to be verified as it is written
+    std::optional<EncryptionVerifier> verifier;
+    std::optional<std::istream> verified_istream;
+    std::optional<std::ostream> verified_ostream;
+    if (batch_options.verify_after)
+    {
+        verifier.emplace(logger,
+                         password,
+                         istream.rdbuf(),
+                         unverified_ostream.rdbuf(),
+                         buffers.read_buffer.size(),
+                         Verify_Queue_Size);
+        verified_istream.emplace(verifier->Plaintext());
+        verified_ostream.emplace(verifier->Ciphertext());
+    }
+    std::istream &plaintext_istream =
+        (verified_istream ? *verified_istream : istream);
+    std::ostream &ostream =
+        (verified_ostream ? *verified_ostream : unverified_ostream);
+
+    // Encrypt the input stream to the output stream
+    bool result = EncryptStream(logger,
+                                process_control,
+                                batch_options.thread_priority,
+                                hide_progress,
+                                password,
+                                iterations,
+                                extensions,
+                                file_size,
+                                plaintext_istream,
+                                ostream);
+
+    // Verify that the ciphertext decrypts to the plaintext read
+    if (verifier && result)
+    {
+        ostream.flush();
+        if (!verifier->Verify())
+        {
+            std::cerr << "Verification failed: " << out_file << std::endl;
+            result = false;
+        }
+    }
+
+    // Flush the output and report how long data waited to be flushed
+    if (flushing_ostream)
+    {
+        flushing_ostream->flush();
+        logger->info << "Output flushed " << flushing_ostream->Flushes()
+                     << " times; maximum latency "
+                     << flushing_ostream->MaximumLatency().count() << " us"
+                     << std::flush;
+    }
+
+    // Write any data held by the throttled output stream
+    if (throttled_ostream) throttled_ostream->flush();
+
+#ifdef AESCRYPT_S3
+    // Complete the upload, or abort it if encryption failed
+    if (s3_ostream)
+    {
+        if (!result)
+        {
+            s3_ostream->Abort();
+        }
+        else if (!s3_ostream->Close())
+        {
+            std::cerr << "Unable to complete upload: " << out_file
+                      << std::endl;
+            result = false;
+        }
+    }
+#endif
+
+    // Close any open files; there may be delay in closing the output
+    // file if it is large and transmission is over a network
+    if (source) source->Close();
+    if (sink && !sink->Close() && result)
+    {
+        LogSystemError(logger,
+                       std::string("Unable to write output file: ") +
+                           static_cast<std::string>(out_file));
+        std::cerr << "Unable to write output file: " << out_file << std::endl;
+        result = false;
+    }
+
+    // Did encryption fail?
+    if (!result)
+    {
+        // Remove the partial output file if possible
+        if (remove_on_fail)
+        {
+            // Filenames should be in UTF-8 format, so form a UTF-8 string
+            // type use with remove()
+            SecureU8String u8name(out_file.cbegin(), out_file.cend());
 
             try
             {
-                // Open the output file for writing
-                ofs.open(std::filesystem::path(u8name),
-                         std::ios::out | std::ios::binary);
+                std::filesystem::remove(std::filesystem::path(u8name));
             }
             catch (const std::filesystem::filesystem_error &e)
             {
-                logger->error << "Exception opening output file: " << out_file
-                              << " (file system err=" << e.what() << ")"
-                              << std::flush;
+                logger->error << "Unable to remove output file: "
+                              << out_file << " (file system err="
+                              << e.what() << ")" << std::flush;
+                std::cerr << "Unable to remove output file" << std::endl;
             }
             catch (const std::exception &e)
             {
-                logger->error << "Exception opening output file: " << out_file
-                              << " (err=" << e.what() << ")" << std::flush;
-            }
-            catch (...)
-            {
-                logger->error << "Exception opening output file: " << out_file
+                logger->error << "Unable to remove output file: "
+                              << out_file << " (err=" << e.what() << ")"
                               << std::flush;
+                std::cerr << "Unable to remove output file" << std::endl;
             }
-            if (!ofs.good() || !ofs.is_open())
+            catch (...)
             {
-                LogSystemError(logger,
-                               std::string("Unable to open output file: ") +
-                                   static_cast<std::string>(out_file));
-                std::cerr << "Unable to open output file: " << out_file
-                          << std::endl;
-                return false;
+                logger->error << "Unable to remove output file: "
+                              << out_file << std::flush;
+                std::cerr << "Unable to remove output file" << std::endl;
             }
-
-            if (!quiet) std::cout << "Encrypting: " << in_file << std::endl;
         }
 
-        // Assign the output file stream
-        std::ostream &ostream = ((out_file == "-") ? std::cout : ofs);
-
-        // Set the buffer to use for writing
-        ofs.rdbuf()->pubsetbuf(
-            write_buffer.data(),
-            static_cast<std::streamsize>(write_buffer.size()));
-
-        // Encrypt the input stream to the output stream
-        bool result = EncryptStream(logger,
-                                    process_control,
-                                    (quiet || stdout_used),
-                                    password,
-                                    iterations,
-                                    extensions,
-                                    file_size,
-                                    istream,
-                                    ostream);
-
-        // Close any open files; there may be delay in closing the output
-        // file if it is large and transmission is over a network
-        if (ifs.is_open()) ifs.close();
-        if (ofs.is_open())
-        {
-            ofs.flush();
-            ofs.close();
-        }
+        return false;
+    }
 
-        // Did encryption fail?
-        if (!result)
-        {
-            // Remove the partial output file if possible
-            if (remove_on_fail)
-            {
-                // Filenames should be in UTF-8 format, so form a UTF-8 string
-                // type use with remove()
-                SecureU8String u8name(out_file.cbegin(), out_file.cend());
+    return true;
+}
 
-                try
-                {
-                    std::filesystem::remove(std::filesystem::path(u8name));
-                }
-                catch (const std::filesystem::filesystem_error &e)
-                {
-                    logger->error << "Unable to remove output file: "
-                                  << out_file << " (file system err="
-                                  << e.what() << ")" << std::flush;
-                    std::cerr << "Unable to remove output file" << std::endl;
-                }
-                catch (const std::exception &e)
-                {
-                    logger->error << "Unable to remove output file: "
-                                  << out_file << " (err=" << e.what() << ")"
-                                  << std::flush;
-                    std::cerr << "Unable to remove output file" << std::endl;
-                }
-                catch (...)
-                {
-                    logger->error << "Unable to remove output file: "
-                                  << out_file << std::flush;
-                    std::cerr << "Unable to remove output file" << std::endl;
-                }
-            }
+} // namespace
 
-            return false;
-        }
+/*
+ *  EncryptFiles()
+ *
+ *  Description:
+ *      This function will take a list of filenames and encrypt them.
+ *      All files are encrypted using the same password and the output will
+ *      either be to a new file with a .aes extension or to stdout.
+ *
+ *  Parameters:
+ *      parent_logger [in]
+ *          A parent logger to which the child logger would direct logging
+ *          messages.
+ *
+ *      process_control [in]
+ *          A structure used by the main thread and worker thread to control
+ *          execution.  For example, if the user pressed CTRL-C while
+ *          encryption is in progress, it will gracefully terminate
+ *          encryption and allow the program to exit.
+ *
+ *      batch_options [in]
+ *          Options controlling how many files are encrypted concurrently and
+ *          the size of the I/O buffers.
+ *
+ *      quiet [in]
+ *          If true, the program will not emit messages to the terminal, except
+ *          for error messages (which are directed to stderr).
+ *
+ *      password [in]
+ *          The password (in UTF-8 encoding) to use to encrypt files.
+ *
+ *      iterations [in]
+ *          The number of iterations to use with the KDF function.
+ *
+ *      filenames [in]
+ *          A vector of filenames to encrypt.
+ *
+ *      output_file [in]
+ *          The name of the output file if output is going to a single file.
+ *          This should not be specified if there is more than one file in
+ *          the list of filenames. That requirement is not checked here.
+ *
+ *      extensions [in]
+ *          A list of name/value string pairs that are inserted into the
+ *          head of the AES Crypt output stream.  These are neither encrypted
+ *          nor authenticated.
+ *
+ *  Returns:
+ *      True if encryption is successful, false if not.
+ *
+ *  Comments:
+ *      None.
+ */
+bool EncryptFiles(
+    const Terra::Logger::LoggerPointer &parent_logger,
+    ProcessControl &process_control,
+    const BatchOptions &batch_options,
+    const bool quiet,
+    const SecureU8String &password,
+    const std::uint32_t iterations,
+    const std::vector<SecureString> &filenames,
+    const SecureString &output_file,
+    const std::vector<std::pair<std::string, std::string>> &extensions)
+{
+    // Hide progress meters if writing to stdout or processing concurrently
+    const bool hide_progress =
+        quiet || (output_file == "-") || (batch_options.jobs > 1);
 
-        // If termination requested, return
-        if (process_control.terminate) return false;
-    }
+    // Create a child logger
+    Terra::Logger::LoggerPointer logger =
+        std::make_shared<Terra::Logger::Logger>(parent_logger, "FILE");
+
+    logger->info << "Encryption process starting" << std::flush;
+
+    // Encrypt each of the files
+    bool result = ProcessFileBatch(
+        logger,
+        process_control,
+        batch_options,
+        filenames,
+        [&](std::size_t index,
+            IOBuffers &buffers,
+            bool replace_output,
+            std::unique_ptr<Source> source) -> bool
+        {
+            return EncryptFile(logger,
+                               process_control,
+                               batch_options,
+                               quiet,
+                               hide_progress,
+                               password,
+                               iterations,
+                               filenames[index],
+                               output_file,
+                               extensions,
+                               buffers,
+                               replace_output,
+                               std::move(source));
+        });
+    if (!result) return false;
 
     logger->info << "Encryption process complete" << std::flush;
 
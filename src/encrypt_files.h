@@ -25,12 +25,13 @@
 #include <terra/logger/logger.h>
 #include "secure_containers.h"
 #include "process_control.h"
+#include "batch_options.h"
 
 /*
  *  EncryptFiles()
  *
  *  Description:
- *      This function will take a list of filenames and encrypt them serially.
+ *      This function will take a list of filenames and encrypt them.
  *      All files are encrypted using the same password and the output will
  *      either be to a new file with a .aes extension or to stdout.
  *
@@ -45,6 +46,10 @@
  *          encryption is in progress, it will gracefully terminate
  *          encryption and allow the program to exit.
  *
+ *      batch_options [in]
+ *          Options controlling how many files are encrypted concurrently and
+ *          the size of the I/O buffers.
+ *
  *      quiet [in]
  *          If true, the program will not emit messages to the terminal, except
  *          for error messages (which are directed to stderr).
@@ -77,6 +82,7 @@
 bool EncryptFiles(
     const Terra::Logger::LoggerPointer &parent_logger,
     ProcessControl &process_control,
+    const BatchOptions &batch_options,
     const bool quiet,
     const SecureU8String &password,
     const std::uint32_t iterations,
@@ -0,0 +1,437 @@
+/*
+ *  encryption_verifier.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file implements the EncryptionVerifier object, which verifies
+ *      that the ciphertext produced while encrypting a file decrypts to the
+ *      plaintext that was read, and the stream buffers it uses.
+ *
+ *  Portability Issues:
+ *      None.
+ */
+
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include "encryption_verifier.h"
+
+/*
+ *  DigestStreamBuf::DigestStreamBuf()
+ *
+ *  Description:
+ *      Constructor for the DigestStreamBuf object.
+ *
+ *  Parameters:
+ *      stream_buffer [in]
+ *          The stream buffer from which data is read.
+ *
+ *      buffer_size [in]
+ *          The amount of data to read from the stream buffer at once.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+DigestStreamBuf::DigestStreamBuf(std::streambuf *stream_buffer,
+                                 std::size_t buffer_size) :
+    stream_buffer{stream_buffer},
+    buffer(std::max<std::size_t>(buffer_size, 1))
+{
+}
+
+/*
+ *  DigestStreamBuf::underflow()
+ *
+ *  Description:
+ *      Read more data from the wrapped stream buffer, including it in the
+ *      digest.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      The next character, or EOF if there is no more data.
+ *
+ *  Comments:
+ *      None.
+ */
+DigestStreamBuf::int_type DigestStreamBuf::underflow()
+{
+    if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+
+    std::streamsize length =
+        stream_buffer->sgetn(buffer.data(),
+                             static_cast<std::streamsize>(buffer.size()));
+    if (length <= 0) return traits_type::eof();
+
+    sha256.Input(std::string_view(buffer.data(),
+                                  static_cast<std::size_t>(length)));
+
+    setg(buffer.data(), buffer.data(), buffer.data() + length);
+
+    return traits_type::to_int_type(*gptr());
+}
+
+/*
+ *  TeeQueueStreamBuf::TeeQueueStreamBuf()
+ *
+ *  Description:
+ *      Constructor for the TeeQueueStreamBuf object.
+ *
+ *  Parameters:
+ *      stream_buffer [in]
+ *          The stream buffer to which data written is passed.
+ *
+ *      queue_limit [in]
+ *          The most data that may be queued to be read.  Writers wait until
+ *          queued data is read if this is exceeded.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+TeeQueueStreamBuf::TeeQueueStreamBuf(std::streambuf *stream_buffer,
+                                     std::size_t queue_limit) :
+    stream_buffer{stream_buffer},
+    queue_limit{queue_limit},
+    queued{0},
+    closed{false},
+    reading{true}
+{
+}
+
+/*
+ *  TeeQueueStreamBuf::Close()
+ *
+ *  Description:
+ *      Indicate that no more data will be written, so the reader sees the
+ *      end of the data once the queue is empty.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+void TeeQueueStreamBuf::Close()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    closed = true;
+    cv.notify_all();
+}
+
+/*
+ *  TeeQueueStreamBuf::StopReading()
+ *
+ *  Description:
+ *      Indicate that queued data will no longer be read, so that writers do
+ *      not wait for the queue to drain.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      Data written afterward is passed to the wrapped stream buffer, but
+ *      is not queued.
+ */
+void TeeQueueStreamBuf::StopReading()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    reading = false;
+    queue.clear();
+    queued = 0;
+    cv.notify_all();
+}
+
+/*
+ *  TeeQueueStreamBuf::underflow()
+ *
+ *  Description:
+ *      Make the next queued data available for reading, waiting for data to
+ *      be written if necessary.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      The next character, or EOF once the queue is empty and closed.
+ *
+ *  Comments:
+ *      None.
+ */
+TeeQueueStreamBuf::int_type TeeQueueStreamBuf::underflow()
+{
+    if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+
+    std::unique_lock<std::mutex> lock(mutex);
+
+    cv.wait(lock, [&]() -> bool { return !queue.empty() || closed; });
+    if (queue.empty()) return traits_type::eof();
+
+    current = std::move(queue.front());
+    queue.pop_front();
+    queued -= current.size();
+    cv.notify_all();
+
+    lock.unlock();
+
+    setg(current.data(), current.data(), current.data() + current.size());
+
+    return traits_type::to_int_type(*gptr());
+}
+
+/*
+ *  TeeQueueStreamBuf::overflow()
+ *
+ *  Description:
+ *      Write a single character.
+ *
+ *  Parameters:
+ *      c [in]
+ *          The character to write.
+ *
+ *  Returns:
+ *      The character written, or EOF on failure.
+ *
+ *  Comments:
+ *      None.
+ */
+TeeQueueStreamBuf::int_type TeeQueueStreamBuf::overflow(int_type c)
+{
+    if (traits_type::eq_int_type(c, traits_type::eof()))
+    {
+        return traits_type::not_eof(c);
+    }
+
+    const char character = traits_type::to_char_type(c);
+
+    return (xsputn(&character, 1) == 1) ? c : traits_type::eof();
+}
+
+/*
+ *  TeeQueueStreamBuf::xsputn()
+ *
+ *  Description:
+ *      Write a sequence of characters to the wrapped stream buffer and queue
+ *      them to be read.
+ *
+ *  Parameters:
+ *      s [in]
+ *          The characters to write.
+ *
+ *      count [in]
+ *          The number of characters to write.
+ *
+ *  Returns:
+ *      The number of characters written to the wrapped stream buffer.
+ *
+ *  Comments:
+ *      Only the characters accepted by the wrapped stream buffer are
+ *      queued.
+ */
+std::streamsize TeeQueueStreamBuf::xsputn(const char_type *s,
+                                          std::streamsize count)
+{
+    std::streamsize written = stream_buffer->sputn(s, count);
+    if (written <= 0) return written;
+
+    std::unique_lock<std::mutex> lock(mutex);
+
+    cv.wait(lock,
+            [&]() -> bool { return !reading || (queued < queue_limit); });
+    if (reading)
+    {
+        queue.emplace_back(s, s + written);
+        queued += static_cast<std::size_t>(written);
+        cv.notify_all();
+    }
+
+    return written;
+}
+
+/*
+ *  TeeQueueStreamBuf::sync()
+ *
+ *  Description:
+ *      Synchronize the wrapped stream buffer.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Zero on success, -1 on failure.
+ *
+ *  Comments:
+ *      None.
+ */
+int TeeQueueStreamBuf::sync()
+{
+    return stream_buffer->pubsync();
+}
+
+/*
+ *  EncryptionVerifier::EncryptionVerifier()
+ *
+ *  Description:
+ *      Constructor for the EncryptionVerifier object, which starts the
+ *      thread that decrypts the ciphertext.
+ *
+ *  Parameters:
+ *      parent_logger [in]
+ *          A parent logger to which the child logger would direct logging
+ *          messages.
+ *
+ *      password [in]
+ *          The password (in UTF-8 encoding) used to encrypt.
+ *
+ *      source [in]
+ *          The stream buffer from which plaintext is read.
+ *
+ *      destination [in]
+ *          The stream buffer to which ciphertext is written.
+ *
+ *      buffer_size [in]
+ *          The amount of plaintext to read from the source at once.
+ *
+ *      queue_limit [in]
+ *          The most ciphertext to hold for the Decryptor.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      The Encryptor should read from Plaintext() and write to
+ *      Ciphertext(), then Verify() should be called.
+ */
+EncryptionVerifier::EncryptionVerifier(
+    const Terra::Logger::LoggerPointer &parent_logger,
+    const SecureU8String &password,
+    std::streambuf *source,
+    std::streambuf *destination,
+    std::size_t buffer_size,
+    std::size_t queue_limit) :
+    logger{std::make_shared<Terra::Logger::Logger>(parent_logger, "VRFY")},
+    password{password},
+    plaintext_buffer(source, buffer_size),
+    ciphertext_buffer(destination, queue_limit),
+    decryptor(logger),
+    decrypt_result{}
+{
+    decrypt_thread = std::thread(&EncryptionVerifier::Decrypt, this);
+}
+
+/*
+ *  EncryptionVerifier::~EncryptionVerifier()
+ *
+ *  Description:
+ *      Destructor for the EncryptionVerifier object, which cancels
+ *      decryption if Verify() was not called.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+EncryptionVerifier::~EncryptionVerifier()
+{
+    if (decrypt_thread.joinable())
+    {
+        decryptor.Cancel();
+        ciphertext_buffer.Close();
+        decrypt_thread.join();
+    }
+}
+
+/*
+ *  EncryptionVerifier::Verify()
+ *
+ *  Description:
+ *      Wait for all of the ciphertext to be decrypted and compare the
+ *      result with the plaintext.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      True if the ciphertext decrypted successfully to the plaintext read,
+ *      false if not.
+ *
+ *  Comments:
+ *      This must be called once the Encryptor has finished writing.
+ */
+bool EncryptionVerifier::Verify()
+{
+    ciphertext_buffer.Close();
+    decrypt_thread.join();
+
+    if (decrypt_result != Terra::AESCrypt::Engine::DecryptResult::Success)
+    {
+        logger->error << "Ciphertext failed to decrypt: " << decrypt_result
+                      << std::flush;
+        return false;
+    }
+
+    if (plaintext_buffer.Digest() != decrypted_buffer.GetSink().Digest())
+    {
+        logger->error << "Decrypted ciphertext does not match the plaintext"
+                      << std::flush;
+        return false;
+    }
+
+    logger->info << "Ciphertext verified" << std::flush;
+
+    return true;
+}
+
+/*
+ *  EncryptionVerifier::Decrypt()
+ *
+ *  Description:
+ *      Decrypt the queued ciphertext.  This is run by the decrypting
+ *      thread.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      If the Decryptor stops before reading all of the ciphertext, the
+ *      queue is discarded so the Encryptor does not wait.
+ */
+void EncryptionVerifier::Decrypt()
+{
+    std::istream ciphertext_istream(&ciphertext_buffer);
+    std::ostream decrypted_ostream(&decrypted_buffer);
+
+    decrypt_result =
+        decryptor.Decrypt(static_cast<std::u8string>(password),
+                          ciphertext_istream,
+                          decrypted_ostream,
+                          {},
+                          0);
+
+    ciphertext_buffer.StopReading();
+}
@@ -0,0 +1,123 @@
+/*
+ *  encryption_verifier.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file defines the EncryptionVerifier object, which verifies that
+ *      the ciphertext produced while encrypting a file decrypts to the
+ *      plaintext that was read, without reading the output again.
+ *
+ *      The plaintext read by the Encryptor passes through a SHA-256 digest.
+ *      The ciphertext written by the Encryptor is passed to the output and
+ *      also queued in memory for a Decryptor running concurrently on
+ *      another thread, whose output passes through a second SHA-256 digest.
+ *      Once encryption completes, the Decryptor must succeed (which verifies
+ *      the HMAC) and the two digests must match.
+ *
+ *      The amount of ciphertext queued is limited, so encryption waits if
+ *      the Decryptor falls behind.
+ *
+ *  Portability Issues:
+ *      None.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <streambuf>
+#include <istream>
+#include <ostream>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <terra/logger/logger.h>
+#include <terra/aescrypt/engine/decryptor.h>
+#include "secure_containers.h"
+#include "digest.h"
+#include "sink_stream.h"
+
+// Stream buffer that computes the digest of data read through it from
+// another stream buffer
+class DigestStreamBuf : public std::streambuf
+{
+    public:
+        DigestStreamBuf(std::streambuf *stream_buffer,
+                        std::size_t buffer_size);
+        ~DigestStreamBuf() = default;
+
+        SHA256Digest Digest() { return FinalizeSHA256(sha256); }
+
+    protected:
+        int_type underflow() override;
+
+        std::streambuf *stream_buffer;
+        std::vector<char> buffer;
+        Terra::Crypto::Hashing::SHA256 sha256;
+};
+
+// Stream buffer that passes data written to it to another stream buffer
+// and queues it to be read through this stream buffer on another thread
+class TeeQueueStreamBuf : public std::streambuf
+{
+    public:
+        TeeQueueStreamBuf(std::streambuf *stream_buffer,
+                          std::size_t queue_limit);
+        ~TeeQueueStreamBuf() = default;
+
+        void Close();
+        void StopReading();
+
+    protected:
+        int_type underflow() override;
+        int_type overflow(int_type c) override;
+        std::streamsize xsputn(const char_type *s,
+                               std::streamsize count) override;
+        int sync() override;
+
+        std::streambuf *stream_buffer;
+        std::size_t queue_limit;
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::deque<std::vector<char>> queue;
+        std::size_t queued;                     // Octets in the queue
+        bool closed;                            // No more data is written
+        bool reading;                           // Queued data is being read
+        std::vector<char> current;              // Data being read
+};
+
+// Verifies the output of an Encryptor by decrypting it concurrently
+class EncryptionVerifier
+{
+    public:
+        EncryptionVerifier(const Terra::Logger::LoggerPointer &parent_logger,
+                           const SecureU8String &password,
+                           std::streambuf *source,
+                           std::streambuf *destination,
+                           std::size_t buffer_size,
+                           std::size_t queue_limit);
+        ~EncryptionVerifier();
+
+        std::streambuf *Plaintext() { return &plaintext_buffer; }
+        std::streambuf *Ciphertext() { return &ciphertext_buffer; }
+        bool Verify();
+
+    protected:
+        void Decrypt();
+
+        Terra::Logger::LoggerPointer logger;
+        SecureU8String password;
+        DigestStreamBuf plaintext_buffer;
+        TeeQueueStreamBuf ciphertext_buffer;
+        SinkStreamBuf<HashSink> decrypted_buffer;
+        Terra::AESCrypt::Engine::Decryptor decryptor;
+        Terra::AESCrypt::Engine::DecryptResult decrypt_result;
+        std::thread decrypt_thread;
+};
@@ -0,0 +1,646 @@
+/*
+ *  fault_injection.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file implements the FaultInjectionBackend object, which injects
+ *      latency, limited bandwidth, short transfers, and running out of
+ *      space into the I/O of files opened through another backend.
+ *
+ *  Portability Issues:
+ *      None.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <thread>
+#include "fault_injection.h"
+#include "option_values.h"
+
+namespace
+{
+
+// Size of the buffer used if the caller does not give one
+constexpr std::size_t Fault_Buffer_Size = 65'536;
+
+// A file opened for reading with faults injected
+class FaultSource : public Source
+{
+    public:
+        FaultSource(const Terra::Logger::LoggerPointer &logger,
+                    std::unique_ptr<Source> source,
+                    const FaultSettings &settings,
+                    RateLimiter &rate_limiter) :
+            source{std::move(source)},
+            fault_buffer(logger,
+                         this->source->Buffer(),
+                         settings,
+                         rate_limiter,
+                         FaultStreamBuf::Direction::Read)
+        {
+        }
+        ~FaultSource() = default;
+
+        std::streambuf *Buffer() override { return &fault_buffer; }
+        bool Close() override { return source->Close(); }
+
+    protected:
+        std::unique_ptr<Source> source;
+        FaultStreamBuf fault_buffer;
+};
+
+// A file opened for writing with faults injected
+class FaultSink : public Sink
+{
+    public:
+        FaultSink(const Terra::Logger::LoggerPointer &logger,
+                  std::unique_ptr<Sink> sink,
+                  const FaultSettings &settings,
+                  RateLimiter &rate_limiter) :
+            sink{std::move(sink)},
+            fault_buffer(logger,
+                         this->sink->Buffer(),
+                         settings,
+                         rate_limiter,
+                         FaultStreamBuf::Direction::Write)
+        {
+        }
+        ~FaultSink() = default;
+
+        std::streambuf *Buffer() override { return &fault_buffer; }
+        bool Close() override
+        {
+            const bool flushed = (fault_buffer.pubsync() == 0);
+            const int saved_errno = errno;
+            const bool closed = sink->Close();
+            if (!flushed) errno = saved_errno;
+            return flushed && closed;
+        }
+
+    protected:
+        std::unique_ptr<Sink> sink;
+        FaultStreamBuf fault_buffer;
+};
+
+/*
+ *  ParseLatency()
+ *
+ *  Description:
+ *      Parse a latency given as an integer with an optional unit suffix of
+ *      "us", "ms", or "s", where the default unit is milliseconds.
+ *
+ *  Parameters:
+ *      value [in]
+ *          The string to parse.
+ *
+ *  Returns:
+ *      The latency, or no value if the string is not valid.
+ *
+ *  Comments:
+ *      None.
+ */
+std::optional<std::chrono::microseconds> ParseLatency(const std::string &value)
+{
+    std::uint32_t count{};
+
+    auto [end, error] =
+        std::from_chars(value.data(), value.data() + value.size(), count);
+    if ((error != std::errc()) || (end == value.data())) return {};
+
+    const std::string unit(end, value.data() + value.size());
+    if (unit == "us") return std::chrono::microseconds(count);
+    if (unit.empty() || (unit == "ms")) return std::chrono::milliseconds(count);
+    if (unit == "s") return std::chrono::seconds(count);
+
+    return {};
+}
+
+} // namespace
+
+/*
+ *  ParseFaultSettings()
+ *
+ *  Description:
+ *      Parse the faults to inject, given as a comma-separated list of
+ *      settings (e.g., "latency=2ms,short-io=4K").
+ *
+ *  Parameters:
+ *      value [in]
+ *          The string to parse.
+ *
+ *  Returns:
+ *      The faults to inject, or no value if the string is not valid.
+ *
+ *  Comments:
+ *      Sizes are parsed using ParseSize().
+ */
+std::optional<FaultSettings> ParseFaultSettings(const std::string &value)
+{
+    FaultSettings settings;
+    std::size_t position{};
+
+    while (position <= value.size())
+    {
+        // Extract the next setting
+        std::size_t end = value.find(',', position);
+        if (end == std::string::npos) end = value.size();
+        const std::string setting = value.substr(position, end - position);
+        position = end + 1;
+
+        const std::size_t equals = setting.find('=');
+        if (equals == std::string::npos) return {};
+        const std::string name = setting.substr(0, equals);
+        const std::string argument = setting.substr(equals + 1);
+
+        if (name == "latency")
+        {
+            const auto latency = ParseLatency(argument);
+            if (!latency) return {};
+            settings.latency = *latency;
+        }
+        else if (name == "bandwidth")
+        {
+            const auto bandwidth = ParseSize(argument);
+            if (!bandwidth) return {};
+            settings.bandwidth = *bandwidth;
+        }
+        else if (name == "short-io")
+        {
+            const auto short_io = ParseSize(argument);
+            if (!short_io) return {};
+            settings.short_io = static_cast<std::size_t>(*short_io);
+        }
+        else if (name == "enospc")
+        {
+            settings.space = ParseSize(argument);
+            if (!settings.space) return {};
+        }
+        else
+        {
+            return {};
+        }
+    }
+
+    return settings;
+}
+
+/*
+ *  FaultStreamBuf::FaultStreamBuf()
+ *
+ *  Description:
+ *      Constructor for the FaultStreamBuf object.
+ *
+ *  Parameters:
+ *      logger [in]
+ *          The logger to which logging output will be sent.
+ *
+ *      stream_buffer [in]
+ *          The stream buffer to read from or write to, which is made
+ *          unbuffered as this object provides buffering.
+ *
+ *      settings [in]
+ *          The faults to inject, which must remain valid for the lifetime
+ *          of this object.
+ *
+ *      rate_limiter [in]
+ *          The rate limiter shared by all files transferring data in the
+ *          same direction, used to limit bandwidth.
+ *
+ *      direction [in]
+ *          Whether this stream buffer is used for reading or writing.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      A buffer given via pubsetbuf() is used in place of this object's own.
+ */
+FaultStreamBuf::FaultStreamBuf(const Terra::Logger::LoggerPointer &logger,
+                               std::streambuf *stream_buffer,
+                               const FaultSettings &settings,
+                               RateLimiter &rate_limiter,
+                               Direction direction) :
+    logger{logger},
+    stream_buffer{stream_buffer},
+    settings{settings},
+    rate_limiter{rate_limiter},
+    direction{direction},
+    written{0}
+{
+    stream_buffer->pubsetbuf(nullptr, 0);
+    setbuf(nullptr, 0);
+}
+
+/*
+ *  FaultStreamBuf::~FaultStreamBuf()
+ *
+ *  Description:
+ *      Destructor for the FaultStreamBuf object, which writes any data
+ *      remaining in the buffer.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+FaultStreamBuf::~FaultStreamBuf()
+{
+    if (direction == Direction::Write) FlushBuffer();
+}
+
+/*
+ *  FaultStreamBuf::setbuf()
+ *
+ *  Description:
+ *      Use the given buffer, or this object's own buffer if none is given.
+ *
+ *  Parameters:
+ *      s [in]
+ *          The buffer to use, or nullptr.
+ *
+ *      n [in]
+ *          The size of the buffer.
+ *
+ *  Returns:
+ *      This stream buffer.
+ *
+ *  Comments:
+ *      This must be called before any data is transferred.
+ */
+std::streambuf *FaultStreamBuf::setbuf(char_type *s, std::streamsize n)
+{
+    if ((s != nullptr) && (n > 0))
+    {
+        buffer = std::span<char>(s, static_cast<std::size_t>(n));
+    }
+    else
+    {
+        own_buffer.resize(Fault_Buffer_Size);
+        buffer = own_buffer;
+    }
+
+    if (direction == Direction::Read)
+    {
+        setg(buffer.data(), buffer.data(), buffer.data());
+    }
+    else
+    {
+        setp(buffer.data(), buffer.data() + buffer.size());
+    }
+
+    return this;
+}
+
+/*
+ *  FaultStreamBuf::underflow()
+ *
+ *  Description:
+ *      Refill the buffer from the wrapped stream buffer after injecting
+ *      latency and limiting bandwidth.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      The next character, or EOF if no more data is available.
+ *
+ *  Comments:
+ *      At most the short transfer size is read at once.
+ */
+FaultStreamBuf::int_type FaultStreamBuf::underflow()
+{
+    if (direction != Direction::Read) return traits_type::eof();
+
+    if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+
+    std::size_t request = buffer.size();
+    if (settings.short_io > 0) request = std::min(request, settings.short_io);
+
+    Delay(request);
+
+    const std::streamsize octets =
+        stream_buffer->sgetn(buffer.data(),
+                             static_cast<std::streamsize>(request));
+    if (octets <= 0) return traits_type::eof();
+
+    setg(buffer.data(), buffer.data(), buffer.data() + octets);
+
+    return traits_type::to_int_type(*gptr());
+}
+
+/*
+ *  FaultStreamBuf::overflow()
+ *
+ *  Description:
+ *      Write the buffer to the wrapped stream buffer when it is full.
+ *
+ *  Parameters:
+ *      c [in]
+ *          The character that did not fit in the buffer, or EOF.
+ *
+ *  Returns:
+ *      A value other than EOF on success, EOF on failure.
+ *
+ *  Comments:
+ *      None.
+ */
+FaultStreamBuf::int_type FaultStreamBuf::overflow(int_type c)
+{
+    if (direction != Direction::Write) return traits_type::eof();
+
+    if (!FlushBuffer()) return traits_type::eof();
+
+    if (!traits_type::eq_int_type(c, traits_type::eof()))
+    {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+
+    return traits_type::not_eof(c);
+}
+
+/*
+ *  FaultStreamBuf::sync()
+ *
+ *  Description:
+ *      Write any buffered data and synchronize the wrapped stream buffer.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Zero on success, -1 on failure.
+ *
+ *  Comments:
+ *      None.
+ */
+int FaultStreamBuf::sync()
+{
+    if (direction != Direction::Write) return 0;
+
+    if (!FlushBuffer()) return -1;
+
+    return stream_buffer->pubsync();
+}
+
+/*
+ *  FaultStreamBuf::FlushBuffer()
+ *
+ *  Description:
+ *      Write the buffered data to the wrapped stream buffer in transfers no
+ *      larger than the short transfer size, each after injecting latency
+ *      and limiting bandwidth.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      True if all of the data was written, false if not.
+ *
+ *  Comments:
+ *      Once the space available to the file is exhausted, the data that
+ *      fits is written and errno is set to ENOSPC.
+ */
+bool FaultStreamBuf::FlushBuffer()
+{
+    const char *data = pbase();
+    std::size_t remaining = static_cast<std::size_t>(pptr() - pbase());
+    bool result = true;
+
+    while (remaining > 0)
+    {
+        std::size_t octets = remaining;
+        if (settings.short_io > 0)
+        {
+            octets = std::min(octets, settings.short_io);
+        }
+
+        // Write only what fits in the space remaining
+        bool no_space{};
+        if (settings.space && (written + octets > *settings.space))
+        {
+            octets = static_cast<std::size_t>(*settings.space - written);
+            no_space = true;
+        }
+
+        Delay(octets);
+
+        const std::streamsize count =
+            stream_buffer->sputn(data, static_cast<std::streamsize>(octets));
+        if (count > 0) written += static_cast<std::uint64_t>(count);
+        if (count != static_cast<std::streamsize>(octets))
+        {
+            result = false;
+            break;
+        }
+
+        if (no_space)
+        {
+            logger->warning << "Injected ENOSPC after writing " << written
+                            << " octets" << std::flush;
+            errno = ENOSPC;
+            result = false;
+            break;
+        }
+
+        data += octets;
+        remaining -= octets;
+    }
+
+    setp(buffer.data(), buffer.data() + buffer.size());
+
+    return result;
+}
+
+/*
+ *  FaultStreamBuf::Delay()
+ *
+ *  Description:
+ *      Wait for the injected latency and for the given number of octets to
+ *      conform to the bandwidth limit.
+ *
+ *  Parameters:
+ *      octets [in]
+ *          The number of octets about to be transferred.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+void FaultStreamBuf::Delay(std::size_t octets)
+{
+    if (settings.latency.count() > 0)
+    {
+        std::this_thread::sleep_for(settings.latency);
+    }
+
+    if (settings.bandwidth > 0)
+    {
+        const RateLimiter::Clock::duration delay =
+            rate_limiter.Reserve(octets);
+        if (delay > RateLimiter::Clock::duration::zero())
+        {
+            std::this_thread::sleep_for(delay);
+        }
+    }
+}
+
+/*
+ *  FaultInjectionBackend::FaultInjectionBackend()
+ *
+ *  Description:
+ *      Constructor for the FaultInjectionBackend object.
+ *
+ *  Parameters:
+ *      parent_logger [in]
+ *          A parent logger to which the child logger would direct logging
+ *          messages.
+ *
+ *      backend [in]
+ *          The backend through which files are opened, which must remain
+ *          valid for the lifetime of this object.
+ *
+ *      settings [in]
+ *          The faults to inject.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+FaultInjectionBackend::FaultInjectionBackend(
+    const Terra::Logger::LoggerPointer &parent_logger,
+    IOBackend &backend,
+    const FaultSettings &settings) :
+    logger{std::make_shared<Terra::Logger::Logger>(parent_logger, "FALT")},
+    backend{backend},
+    settings{settings},
+    read_limiter{settings.bandwidth},
+    write_limiter{settings.bandwidth}
+{
+    logger->warning << "Injecting faults into file I/O (latency "
+                    << settings.latency.count() << " us, bandwidth "
+                    << settings.bandwidth << " octets/s, short I/O "
+                    << settings.short_io << " octets, space "
+                    << (settings.space ? std::to_string(*settings.space)
+                                       : std::string("unlimited"))
+                    << ")" << std::flush;
+}
+
+/*
+ *  FaultInjectionBackend::OpenSource()
+ *
+ *  Description:
+ *      Open the given file for reading with faults injected.
+ *
+ *  Parameters:
+ *      logger [in]
+ *          The logger to which logging output will be sent.
+ *
+ *      filename [in]
+ *          The name of the file to open in UTF-8 format.
+ *
+ *  Returns:
+ *      The opened file, or nullptr if it could not be opened, in which case
+ *      errno indicates the reason.
+ *
+ *  Comments:
+ *      None.
+ */
+std::unique_ptr<Source> FaultInjectionBackend::OpenSource(
+    const Terra::Logger::LoggerPointer &logger,
+    const SecureString &filename)
+{
+    auto source = backend.OpenSource(logger, filename);
+    if (!source) return nullptr;
+
+    return std::make_unique<FaultSource>(logger,
+                                         std::move(source),
+                                         settings,
+                                         read_limiter);
+}
+
+/*
+ *  FaultInjectionBackend::AdoptSource()
+ *
+ *  Description:
+ *      Form a source reading from the given open file descriptor with faults
+ *      injected.
+ *
+ *  Parameters:
+ *      logger [in]
+ *          The logger to which logging output will be sent.
+ *
+ *      filename [in]
+ *          The name of the file in UTF-8 format.
+ *
+ *      descriptor [in]
+ *          The file descriptor open for reading, which the source owns.
+ *
+ *  Returns:
+ *      The source, or nullptr if it could not be formed, in which case
+ *      errno indicates the reason.
+ *
+ *  Comments:
+ *      None.
+ */
+std::unique_ptr<Source> FaultInjectionBackend::AdoptSource(
+    const Terra::Logger::LoggerPointer &logger,
+    const SecureString &filename,
+    int descriptor)
+{
+    auto source = backend.AdoptSource(logger, filename, descriptor);
+    if (!source) return nullptr;
+
+    return std::make_unique<FaultSource>(logger,
+                                         std::move(source),
+                                         settings,
+                                         read_limiter);
+}
+
+/*
+ *  FaultInjectionBackend::OpenSink()
+ *
+ *  Description:
+ *      Open the given file for writing with faults injected.
+ *
+ *  Parameters:
+ *      logger [in]
+ *          The logger to which logging output will be sent.
+ *
+ *      filename [in]
+ *          The name of the file to open in UTF-8 format.
+ *
+ *  Returns:
+ *      The opened file, or nullptr if it could not be opened, in which case
+ *      errno indicates the reason.
+ *
+ *  Comments:
+ *      None.
+ */
+std::unique_ptr<Sink> FaultInjectionBackend::OpenSink(
+    const Terra::Logger::LoggerPointer &logger,
+    const SecureString &filename)
+{
+    auto sink = backend.OpenSink(logger, filename);
+    if (!sink) return nullptr;
+
+    return std::make_unique<FaultSink>(logger,
+                                       std::move(sink),
+                                       settings,
+                                       write_limiter);
+}
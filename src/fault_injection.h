@@ -0,0 +1,145 @@
+/*
+ *  fault_injection.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file defines the FaultInjectionBackend object, an IOBackend that
+ *      wraps another backend to inject the conditions seen with network
+ *      file systems: latency on each transfer, limited bandwidth, reads and
+ *      writes that transfer fewer octets than requested, and running out of
+ *      space.  It allows such conditions to be benchmarked locally and the
+ *      handling of failures to be tested.
+ *
+ *      Faults are configured with the AESCRYPT_FAULTS environment variable,
+ *      which holds a comma-separated list of settings:
+ *
+ *          latency=N[us|ms|s]  Delay before each transfer (default ms)
+ *          bandwidth=SIZE      Octets per second read and written by all
+ *                              files, applied separately to each direction
+ *          short-io=SIZE       Most octets transferred at once
+ *          enospc=SIZE         Octets that may be written to each file
+ *                              before writes fail with ENOSPC
+ *
+ *      For example, "latency=2ms,bandwidth=10M,short-io=4K".
+ *
+ *      This is built only if the aescrypt_cli_FAULT_INJECTION CMake option
+ *      is enabled, so other builds ignore AESCRYPT_FAULTS.
+ *
+ *  Portability Issues:
+ *      None.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include <terra/logger/logger.h>
+#include "io_backend.h"
+#include "rate_limiter.h"
+
+// Environment variable holding the faults to inject
+constexpr char Fault_Injection_Variable[] = "AESCRYPT_FAULTS";
+
+// Faults injected into file I/O
+struct FaultSettings
+{
+    std::chrono::microseconds latency{};        // Delay before each transfer
+    std::uint64_t bandwidth{};                  // Octets per second (0 = none)
+    std::size_t short_io{};                     // Largest transfer (0 = none)
+    std::optional<std::uint64_t> space;         // Octets each file may hold
+};
+
+/*
+ *  ParseFaultSettings()
+ *
+ *  Description:
+ *      Parse the faults to inject, given as a comma-separated list of
+ *      settings (e.g., "latency=2ms,short-io=4K").
+ *
+ *  Parameters:
+ *      value [in]
+ *          The string to parse.
+ *
+ *  Returns:
+ *      The faults to inject, or no value if the string is not valid.
+ *
+ *  Comments:
+ *      Sizes are parsed using ParseSize().
+ */
+std::optional<FaultSettings> ParseFaultSettings(const std::string &value);
+
+// Stream buffer that injects faults when reading from or writing to another
+class FaultStreamBuf : public std::streambuf
+{
+    public:
+        enum class Direction
+        {
+            Read,
+            Write
+        };
+
+        FaultStreamBuf(const Terra::Logger::LoggerPointer &logger,
+                       std::streambuf *stream_buffer,
+                       const FaultSettings &settings,
+                       RateLimiter &rate_limiter,
+                       Direction direction);
+        ~FaultStreamBuf();
+
+    protected:
+        std::streambuf *setbuf(char_type *s, std::streamsize n) override;
+        int_type underflow() override;
+        int_type overflow(int_type c) override;
+        int sync() override;
+        bool FlushBuffer();
+        void Delay(std::size_t octets);
+
+        Terra::Logger::LoggerPointer logger;
+        std::streambuf *stream_buffer;
+        const FaultSettings &settings;
+        RateLimiter &rate_limiter;
+        Direction direction;
+        std::vector<char> own_buffer;           // Used if none is given
+        std::span<char> buffer;
+        std::uint64_t written;                  // Octets written so far
+};
+
+// Opens files through another backend, injecting faults into their I/O
+class FaultInjectionBackend : public IOBackend
+{
+    public:
+        FaultInjectionBackend(const Terra::Logger::LoggerPointer &parent_logger,
+                              IOBackend &backend,
+                              const FaultSettings &settings);
+        ~FaultInjectionBackend() = default;
+
+        std::unique_ptr<Source> OpenSource(
+            const Terra::Logger::LoggerPointer &logger,
+            const SecureString &filename) override;
+        std::unique_ptr<Source> AdoptSource(
+            const Terra::Logger::LoggerPointer &logger,
+            const SecureString &filename,
+            int descriptor) override;
+        std::unique_ptr<Sink> OpenSink(
+            const Terra::Logger::LoggerPointer &logger,
+            const SecureString &filename) override;
+
+    protected:
+        Terra::Logger::LoggerPointer logger;
+        IOBackend &backend;
+        FaultSettings settings;
+        RateLimiter read_limiter;
+        RateLimiter write_limiter;
+};
@@ -0,0 +1,448 @@
+/*
+ *  file_batch.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file implements a function to process a set of files, either
+ *      serially or concurrently, using a given per-file task.
+ *
+ *  Portability Issues:
+ *      None.
+ */
+
+#include <iostream>
+#include <atomic>
+#include <exception>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <vector>
+#include <filesystem>
+#include <limits>
+#include <memory>
+#include "file_batch.h"
+#include "file_prefetcher.h"
+
+namespace
+{
+
+// Queue of file indices taken in order by jobs
+struct FileQueue
+{
+    std::vector<std::size_t> files;
+    std::atomic<std::size_t> next{0};
+};
+
+/*
+ *  TakeFile()
+ *
+ *  Description:
+ *      Take the next file from the given queue.
+ *
+ *  Parameters:
+ *      queue [in/out]
+ *          The queue from which to take a file.
+ *
+ *      prefetcher [in]
+ *          The prefetcher to notify that the file is started so it may
+ *          prefetch the files that follow it in the queue, or nullptr if
+ *          files are not prefetched.
+ *
+ *      index [out]
+ *          The index of the file taken.
+ *
+ *      source [out]
+ *          The source from which to read the file taken if the prefetcher
+ *          opened it, else this is unchanged.
+ *
+ *  Returns:
+ *      True if a file was taken, false if the queue is empty.
+ *
+ *  Comments:
+ *      This may be called concurrently by multiple jobs.
+ */
+bool TakeFile(FileQueue &queue,
+              FilePrefetcher *prefetcher,
+              std::size_t &index,
+              std::unique_ptr<Source> &source)
+{
+    const std::size_t position = queue.next++;
+
+    if (position >= queue.files.size()) return false;
+
+    index = queue.files[position];
+
+    if (prefetcher != nullptr)
+    {
+        source = prefetcher->FileStarted(queue.files, position);
+    }
+
+    return true;
+}
+
+/*
+ *  GetFileSize()
+ *
+ *  Description:
+ *      Determine the size of the given file.
+ *
+ *  Parameters:
+ *      logger [in]
+ *          The logger to which logging output will be sent.
+ *
+ *      filename [in]
+ *          The name of the file ("-" is stdin).
+ *
+ *  Returns:
+ *      The size of the file in octets, or the largest possible size if the
+ *      size cannot be determined (e.g., stdin or an object).
+ *
+ *  Comments:
+ *      None.
+ */
+std::uint64_t GetFileSize(const Terra::Logger::LoggerPointer &logger,
+                          const SecureString &filename)
+{
+    if ((filename == "-") || IsS3URL(static_cast<std::string>(filename)))
+    {
+        return std::numeric_limits<std::uint64_t>::max();
+    }
+
+    try
+    {
+        // Filenames should be in UTF-8 format, so form a UTF-8 string type
+        SecureU8String u8name(filename.cbegin(), filename.cend());
+
+        return std::filesystem::file_size(std::filesystem::path(u8name));
+    }
+    catch (const std::exception &e)
+    {
+        logger->warning << "Unable to determine size of " << filename
+                        << " (err=" << e.what() << ")" << std::flush;
+    }
+    catch (...)
+    {
+        logger->warning << "Unable to determine size of " << filename
+                        << std::flush;
+    }
+
+    return std::numeric_limits<std::uint64_t>::max();
+}
+
+} // namespace
+
+/*
+ *  ProcessFileBatch()
+ *
+ *  Description:
+ *      This function will call the given task once for each file index in
+ *      the range [0, filenames.size()).  When more than one job is
+ *      requested, files are processed concurrently by that many worker
+ *      threads, each having its own I/O buffers.
+ *
+ *  Parameters:
+ *      parent_logger [in]
+ *          A parent logger to which the child logger would direct logging
+ *          messages.
+ *
+ *      process_control [in]
+ *          A structure used to control execution.  Once termination is
+ *          requested, no further files are started.
+ *
+ *      batch_options [in]
+ *          Options controlling the number of concurrent jobs, the size of
+ *          I/O buffers, and the processors on which each job runs.
+ *
+ *      filenames [in]
+ *          The names of the files to process ("-" is stdin).
+ *
+ *      task [in]
+ *          The function to call to process each file.  It must return true
+ *          on success and false on failure.
+ *
+ *  Returns:
+ *      True if every file was processed successfully, false if not.
+ *
+ *  Comments:
+ *      Once any file fails, no further files are started, though files
+ *      already being processed by other jobs are allowed to complete.  When
+ *      scrubbing, every file is processed regardless of failures.
+ *      Files are processed in order when there is a single job.  If a
+ *      small file size is given in the batch options, files smaller than
+ *      that are placed in a separate queue, which the jobs reserved for
+ *      small files drain before taking large files; the other jobs take
+ *      large files first.  If a prefetch depth is given, the files that
+ *      follow each file started in its queue are opened and read ahead,
+ *      and each file so opened is given to the task as its source.
+ *      If a deadline is given, files that would finish after it are not
+ *      started but deferred, which is not a failure.
+ *      If a cooperative batch is given, each file is claimed before it is
+ *      processed, files claimed by other processes are skipped, and once
+ *      no files remain this waits for files held by other processes,
+ *      reclaiming any that are abandoned.
+ */
+bool ProcessFileBatch(const Terra::Logger::LoggerPointer &parent_logger,
+                      ProcessControl &process_control,
+                      const BatchOptions &batch_options,
+                      const std::vector<SecureString> &filenames,
+                      const FileTask &task)
+{
+    FileQueue small_files;
+    FileQueue large_files;
+    std::size_t small_file_jobs{};
+    std::atomic<bool> failed{false};
+
+    // Create a child logger
+    Terra::Logger::LoggerPointer logger =
+        std::make_shared<Terra::Logger::Logger>(parent_logger, "BTCH");
+
+    // Place small files in a separate queue if requested and there is at
+    // least one job remaining to take large files; otherwise, all files are
+    // placed in the large file queue in order
+    if ((batch_options.small_file_size > 0) &&
+        (batch_options.small_file_jobs < batch_options.jobs))
+    {
+        small_file_jobs = batch_options.small_file_jobs;
+    }
+    for (std::size_t i = 0; i < filenames.size(); i++)
+    {
+        if ((small_file_jobs > 0) && (GetFileSize(logger, filenames[i]) <
+                                      batch_options.small_file_size))
+        {
+            small_files.files.push_back(i);
+        }
+        else
+        {
+            large_files.files.push_back(i);
+        }
+    }
+    if (small_file_jobs > 0)
+    {
+        logger->info << "Queued " << small_files.files.size()
+                     << " small files (under "
+                     << batch_options.small_file_size << " octets) for "
+                     << small_file_jobs << " reserved jobs and "
+                     << large_files.files.size() << " large files"
+                     << std::flush;
+    }
+
+    // Function to determine if termination has been requested
+    auto terminating = [&]() -> bool { return process_control.Terminating(); };
+
+    // Open and prefetch upcoming files, if requested
+    std::unique_ptr<FilePrefetcher> prefetcher;
+    if (batch_options.prefetch_depth > 0)
+    {
+        prefetcher = std::make_unique<FilePrefetcher>(
+            logger,
+            *batch_options.io_backend,
+            filenames,
+            batch_options.prefetch_depth);
+    }
+
+    // Controller adjusting the number of active jobs (if adaptive)
+    ConcurrencyController *controller = batch_options.concurrency_controller;
+
+    // Work directory shared with other processes (if cooperating)
+    CooperativeBatch *cooperative_batch = batch_options.cooperative_batch;
+
+    // Deadline by which the batch must finish (if any)
+    BatchDeadline *deadline = batch_options.deadline;
+
+    // Function executed by each job to process files until none remain
+    auto worker = [&](std::size_t job)
+    {
+        // Pin the job to its processors before allocating buffers so that
+        // memory is allocated on the job's NUMA node
+        const auto &worker_cpus = batch_options.worker_cpus;
+        if (!worker_cpus.empty())
+        {
+            PinThread(logger, worker_cpus[job % worker_cpus.size()]);
+        }
+
+        IOBuffers buffers{
+            SecureVector<char>(batch_options.io_buffer_size, 0),
+            SecureVector<char>(batch_options.io_buffer_size, 0)};
+
+        while ((!failed || batch_options.scrub) && !terminating())
+        {
+            // With adaptive concurrency, wait until this job may run
+            if ((controller != nullptr) && !controller->AwaitTurn(job)) break;
+
+            // Jobs reserved for small files drain that queue first, while
+            // other jobs take small files only once large files are done
+            std::size_t index{};
+            std::unique_ptr<Source> source;
+            auto take = [&](FileQueue &queue) -> bool
+            {
+                return TakeFile(queue, prefetcher.get(), index, source);
+            };
+            bool taken{};
+            if (job < small_file_jobs)
+            {
+                taken = take(small_files) || take(large_files);
+            }
+            else
+            {
+                taken = take(large_files) || take(small_files);
+            }
+
+            // Once a file would finish after the deadline, it and the files
+            // remaining are deferred, and unfinished files held by other
+            // processes are not reclaimed
+            if ((deadline != nullptr) && taken &&
+                !deadline->Admit(GetFileSize(logger, filenames[index])))
+            {
+                deadline->Defer(index);
+                continue;
+            }
+            if ((deadline != nullptr) && !taken && deadline->Reached()) break;
+
+            // When cooperating with other processes, each file must also be
+            // claimed; once none remain to take, claim any file unfinished
+            // by other processes, waiting while they hold them
+            CooperativeBatch::ClaimResult claim{};
+            if (cooperative_batch != nullptr)
+            {
+                claim = taken ? cooperative_batch->Claim(index)
+                              : cooperative_batch->ClaimUnfinished(index);
+                if (claim == CooperativeBatch::ClaimResult::Error)
+                {
+                    failed = true;
+                    break;
+                }
+                if (claim == CooperativeBatch::ClaimResult::Unavailable)
+                {
+                    if (taken) continue;
+                    break;
+                }
+            }
+            else if (!taken)
+            {
+                break;
+            }
+
+            // Output left by an abandoned attempt is replaced
+            const auto start = std::chrono::steady_clock::now();
+            const bool success = task(
+                index,
+                buffers,
+                claim == CooperativeBatch::ClaimResult::Reclaimed,
+                std::move(source));
+            if (!success) failed = true;
+
+            // Refine the projections used to meet the deadline
+            if ((deadline != nullptr) && success)
+            {
+                deadline->Completed(GetFileSize(logger, filenames[index]),
+                                    std::chrono::steady_clock::now() - start);
+            }
+
+            // Record the outcome, unless interrupted by termination
+            if (cooperative_batch != nullptr)
+            {
+                if (!success && terminating())
+                {
+                    cooperative_batch->Release(index);
+                }
+                else
+                {
+                    cooperative_batch->Complete(index, success);
+                }
+            }
+        }
+
+        // Release jobs waiting to run, since processing is finished
+        if (controller != nullptr) controller->Stop();
+    };
+
+    // With a single job, process files on the calling thread, unless the
+    // job is pinned to processors, in which case it runs on its own thread
+    // so that the calling thread (and any thread it later creates) is not
+    // restricted once the batch finishes
+    if (batch_options.jobs <= 1)
+    {
+        if (batch_options.worker_cpus.empty())
+        {
+            worker(0);
+            return !failed && !terminating();
+        }
+
+        std::exception_ptr exception;
+        std::thread pinned_worker(
+            [&]()
+            {
+                try
+                {
+                    worker(0);
+                }
+                catch (...)
+                {
+                    exception = std::current_exception();
+                }
+            });
+        pinned_worker.join();
+
+        // Report any exception as if the job ran on the calling thread
+        if (exception) std::rethrow_exception(exception);
+
+        return !failed && !terminating();
+    }
+
+    logger->info << "Starting " << batch_options.jobs << " concurrent jobs"
+                 << std::flush;
+
+    // Start the worker threads, ensuring an exception in one only results
+    // in the failure of the batch
+    std::vector<std::thread> workers;
+    for (std::size_t i = 0; i < batch_options.jobs; i++)
+    {
+        workers.emplace_back(
+            [&, i]()
+            {
+                try
+                {
+                    worker(i);
+                }
+                catch (const std::exception &e)
+                {
+                    logger->critical << "Exception processing files: "
+                                     << e.what() << std::flush;
+                    std::cerr << "Exception processing files: " << e.what()
+                              << std::endl;
+                    failed = true;
+                    if (controller != nullptr) controller->Stop();
+                }
+                catch (...)
+                {
+                    logger->critical << "Unknown exception processing files"
+                                     << std::flush;
+                    std::cerr << "Unknown exception processing files"
+                              << std::endl;
+                    failed = true;
+                    if (controller != nullptr) controller->Stop();
+                }
+            });
+    }
+
+    // With adaptive concurrency, adjust the number of active jobs until
+    // processing is finished
+    if (controller != nullptr)
+    {
+        while (controller->Regulate())
+        {
+            if (terminating()) controller->Stop();
+        }
+    }
+
+    // Wait for all of the worker threads to complete
+    for (auto &thread : workers) thread.join();
+
+    return !failed && !terminating();
+}
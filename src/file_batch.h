@@ -0,0 +1,97 @@
+/*
+ *  file_batch.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file defines a function to process a set of files, either
+ *      serially or concurrently, using a given per-file task.
+ *
+ *  Portability Issues:
+ *      None.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <terra/logger/logger.h>
+#include "secure_containers.h"
+#include "process_control.h"
+#include "batch_options.h"
+#include "io_backend.h"
+
+// I/O buffers owned by a job and used for each file it processes
+struct IOBuffers
+{
+    SecureVector<char> read_buffer;
+    SecureVector<char> write_buffer;
+};
+
+// Function called to process the file at the given index, replacing any
+// existing output if requested and reading from the given source if the file
+// was opened by the prefetcher (otherwise, the source is nullptr)
+using FileTask = std::function<bool(std::size_t index,
+                                    IOBuffers &buffers,
+                                    bool replace_output,
+                                    std::unique_ptr<Source> source)>;
+
+/*
+ *  ProcessFileBatch()
+ *
+ *  Description:
+ *      This function will call the given task once for each file index in
+ *      the range [0, filenames.size()).  When more than one job is
+ *      requested, files are processed concurrently by that many worker
+ *      threads, each having its own I/O buffers.
+ *
+ *  Parameters:
+ *      parent_logger [in]
+ *          A parent logger to which the child logger would direct logging
+ *          messages.
+ *
+ *      process_control [in]
+ *          A structure used to control execution.  Once termination is
+ *          requested, no further files are started.
+ *
+ *      batch_options [in]
+ *          Options controlling the number of concurrent jobs, the size of
+ *          I/O buffers, and the processors on which each job runs.
+ *
+ *      filenames [in]
+ *          The names of the files to process ("-" is stdin).
+ *
+ *      task [in]
+ *          The function to call to process each file.  It must return true
+ *          on success and false on failure.
+ *
+ *  Returns:
+ *      True if every file was processed successfully, false if not.
+ *
+ *  Comments:
+ *      Once any file fails, no further files are started, though files
+ *      already being processed by other jobs are allowed to complete.
+ *      Files are processed in order when there is a single job.  If a
+ *      small file size is given in the batch options, files smaller than
+ *      that are placed in a separate queue, which the jobs reserved for
+ *      small files drain before taking large files; the other jobs take
+ *      large files first.  If a prefetch depth is given, the files that
+ *      follow each file started in its queue are opened and read ahead,
+ *      and each file so opened is given to the task as its source.
+ *      If a cooperative batch is given, each file is claimed before it is
+ *      processed, files claimed by other processes are skipped, and once
+ *      no files remain this waits for files held by other processes,
+ *      reclaiming any that are abandoned.
+ */
+bool ProcessFileBatch(const Terra::Logger::LoggerPointer &parent_logger,
+                      ProcessControl &process_control,
+                      const BatchOptions &batch_options,
+                      const std::vector<SecureString> &filenames,
+                      const FileTask &task);
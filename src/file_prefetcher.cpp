@@ -0,0 +1,355 @@
+/*
+ *  file_prefetcher.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file implements the FilePrefetcher object, which opens files that
+ *      will be processed soon and asks the operating system to read the
+ *      start of each into the page cache.  The open file is handed to the
+ *      job that processes it.
+ *
+ *  Portability Issues:
+ *      Prefetching is not supported on Windows, where this object does
+ *      nothing.  On macOS, F_RDADVISE is used in place of posix_fadvise().
+ */
+
+#include <algorithm>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include "file_prefetcher.h"
+#include "aescrypt.h"
+#include "error_string.h"
+#include "s3_url.h"
+
+/*
+ *  FilePrefetcher::FilePrefetcher()
+ *
+ *  Description:
+ *      Constructor for the FilePrefetcher object, which starts the thread
+ *      that opens and prefetches files.
+ *
+ *  Parameters:
+ *      parent_logger [in]
+ *          A parent logger to which the child logger would direct logging
+ *          messages.
+ *
+ *      io_backend [in]
+ *          The backend used to form a source from each file opened.  This
+ *          must remain valid for the lifetime of this object.
+ *
+ *      filenames [in]
+ *          The names of the files that will be processed ("-" is stdin,
+ *          which is never prefetched, nor are objects).  This must remain
+ *          valid for the lifetime of this object.
+ *
+ *      depth [in]
+ *          The number of files to open ahead of the file being started,
+ *          which is also the most files this object holds open at once.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+FilePrefetcher::FilePrefetcher(
+    const Terra::Logger::LoggerPointer &parent_logger,
+    IOBackend &io_backend,
+    const std::vector<SecureString> &filenames,
+    std::size_t depth) :
+    logger{std::make_shared<Terra::Logger::Logger>(parent_logger, "PREF")},
+    io_backend{io_backend},
+    filenames{filenames},
+    depth{std::max<std::size_t>(depth, 1)},
+    stop{false},
+    states(filenames.size(), State::Idle),
+    descriptors(filenames.size(), -1),
+    open_count{0}
+{
+#ifdef _WIN32
+    logger->warning << "File prefetching is not supported on this platform"
+                    << std::flush;
+#else
+    logger->info << "Prefetching up to " << this->depth << " files ahead"
+                 << std::flush;
+
+    thread = std::thread(&FilePrefetcher::Run, this);
+#endif
+}
+
+/*
+ *  FilePrefetcher::~FilePrefetcher()
+ *
+ *  Description:
+ *      Destructor for the FilePrefetcher object, which stops the thread and
+ *      closes any files still open.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+FilePrefetcher::~FilePrefetcher()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+        cv.notify_all();
+    }
+
+    if (thread.joinable()) thread.join();
+}
+
+/*
+ *  FilePrefetcher::FileStarted()
+ *
+ *  Description:
+ *      Called when a job starts processing a file, this releases that file
+ *      and requests that the files following it be prefetched.
+ *
+ *  Parameters:
+ *      order [in]
+ *          The indices of files in the order in which they are processed.
+ *
+ *      position [in]
+ *          The position in the order of the file being started.
+ *
+ *  Returns:
+ *      The source from which the job should read the file if this opened
+ *      it, else nullptr, in which case the job opens the file itself.
+ *
+ *  Comments:
+ *      None.
+ */
+std::unique_ptr<Source> FilePrefetcher::FileStarted(
+    const std::vector<std::size_t> &order,
+    std::size_t position)
+{
+    if (!thread.joinable() || (position >= order.size())) return {};
+
+    std::unique_ptr<Source> source = Release(order[position]);
+
+    const std::size_t last = std::min(order.size(), position + 1 + depth);
+    for (std::size_t i = position + 1; i < last; i++) Prefetch(order[i]);
+
+    return source;
+}
+
+/*
+ *  FilePrefetcher::Prefetch()
+ *
+ *  Description:
+ *      Request that the given file be opened and prefetched.
+ *
+ *  Parameters:
+ *      index [in]
+ *          The index of the file to prefetch.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      Requests for files already requested are ignored.
+ */
+void FilePrefetcher::Prefetch(std::size_t index)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if ((states[index] != State::Idle) || (filenames[index] == "-") ||
+        IsS3URL(static_cast<std::string>(filenames[index])))
+    {
+        return;
+    }
+
+    states[index] = State::Queued;
+    pending.push_back(index);
+    cv.notify_all();
+}
+
+/*
+ *  FilePrefetcher::Release()
+ *
+ *  Description:
+ *      Release the given file, handing it to the caller if this object
+ *      opened it, making room for another file to be opened.
+ *
+ *  Parameters:
+ *      index [in]
+ *          The index of the file to release.
+ *
+ *  Returns:
+ *      The source from which to read the file if this object opened it,
+ *      else nullptr.
+ *
+ *  Comments:
+ *      If the file is being opened, the prefetching thread closes it once
+ *      the open completes.
+ */
+std::unique_ptr<Source> FilePrefetcher::Release(std::size_t index)
+{
+    int descriptor{-1};
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (states[index] == State::Open)
+        {
+            descriptor = descriptors[index];
+            descriptors[index] = -1;
+            open_count--;
+            cv.notify_all();
+        }
+        states[index] = State::Released;
+    }
+
+    if (descriptor < 0) return {};
+
+    // Nothing was read from the descriptor, so reading starts at the
+    // beginning of the file
+    std::unique_ptr<Source> source =
+        io_backend.AdoptSource(logger, filenames[index], descriptor);
+    if (!source)
+    {
+        LogSystemError(logger,
+                       std::string("Unable to read prefetched file: ") +
+                           filenames[index].c_str());
+    }
+
+    return source;
+}
+
+/*
+ *  FilePrefetcher::Run()
+ *
+ *  Description:
+ *      Open and prefetch requested files in the order requested, holding at
+ *      most depth files open, until this object is destroyed.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      Files are opened with the mutex unlocked, since opening may take
+ *      some time.
+ */
+void FilePrefetcher::Run()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true)
+    {
+        cv.wait(lock,
+                [&]() -> bool
+                {
+                    return stop || (!pending.empty() && (open_count < depth));
+                });
+        if (stop) break;
+
+        const std::size_t index = pending.front();
+        pending.pop_front();
+
+        // Skip files that were started before they could be prefetched
+        if (states[index] != State::Queued) continue;
+
+        states[index] = State::Opening;
+        open_count++;
+
+        lock.unlock();
+        const int descriptor = OpenFile(index);
+        lock.lock();
+
+        // Keep the file open unless it was released or could not be opened
+        if ((states[index] == State::Opening) && (descriptor >= 0))
+        {
+            states[index] = State::Open;
+            descriptors[index] = descriptor;
+            continue;
+        }
+
+        states[index] = State::Released;
+        open_count--;
+#ifndef _WIN32
+        if (descriptor >= 0) close(descriptor);
+#endif
+    }
+
+    // Close any files that remain open
+#ifndef _WIN32
+    for (int &descriptor : descriptors)
+    {
+        if (descriptor >= 0) close(descriptor);
+        descriptor = -1;
+    }
+#endif
+}
+
+/*
+ *  FilePrefetcher::OpenFile()
+ *
+ *  Description:
+ *      Open the given file and advise the operating system that the start of
+ *      the file will be read soon, so that it is read into the page cache.
+ *
+ *  Parameters:
+ *      index [in]
+ *          The index of the file to open.
+ *
+ *  Returns:
+ *      The open file descriptor, or -1 if the file could not be opened.
+ *
+ *  Comments:
+ *      Failure is only logged, since the job processing the file will
+ *      report any error opening it.
+ */
+int FilePrefetcher::OpenFile([[maybe_unused]] std::size_t index)
+{
+#ifndef _WIN32
+    const int descriptor =
+        open(filenames[index].c_str(), O_RDONLY | O_CLOEXEC);
+    if (descriptor < 0)
+    {
+        LogSystemError(logger,
+                       std::string("Unable to open file to prefetch: ") +
+                           filenames[index].c_str());
+        return -1;
+    }
+
+#ifdef __APPLE__
+    radvisory advisory{};
+    advisory.ra_offset = 0;
+    advisory.ra_count = static_cast<int>(Prefetch_Read_Size);
+    if (fcntl(descriptor, F_RDADVISE, &advisory) == -1)
+#else
+    if (posix_fadvise(descriptor,
+                      0,
+                      static_cast<off_t>(Prefetch_Read_Size),
+                      POSIX_FADV_WILLNEED) != 0)
+#endif
+    {
+        logger->info << "Unable to advise reading file "
+                     << filenames[index].c_str() << std::flush;
+    }
+
+    logger->info << "Prefetched file " << filenames[index].c_str()
+                 << std::flush;
+
+    return descriptor;
+#else
+    return -1;
+#endif
+}
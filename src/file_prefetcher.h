@@ -0,0 +1,79 @@
+/*
+ *  file_prefetcher.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file defines the FilePrefetcher object, which opens files that
+ *      will be processed soon and asks the operating system to read the
+ *      start of each into the page cache.  This overlaps the latency of
+ *      opening and first reading a file (e.g., network round trips on NFS)
+ *      with the processing of the current file.  When a job starts a file
+ *      this opened, the open file is handed to the job as its source, so the
+ *      file is not opened again by name.
+ *
+ *  Portability Issues:
+ *      Prefetching is not supported on Windows, where this object does
+ *      nothing.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <terra/logger/logger.h>
+#include "secure_containers.h"
+#include "io_backend.h"
+
+// Opens upcoming files ahead of time and prefetches their data
+class FilePrefetcher
+{
+    public:
+        FilePrefetcher(const Terra::Logger::LoggerPointer &parent_logger,
+                       IOBackend &io_backend,
+                       const std::vector<SecureString> &filenames,
+                       std::size_t depth);
+        ~FilePrefetcher();
+
+        std::unique_ptr<Source> FileStarted(
+            const std::vector<std::size_t> &order,
+            std::size_t position);
+
+    protected:
+        enum class State
+        {
+            Idle,                               // Not requested
+            Queued,                             // Waiting to be opened
+            Opening,                            // Being opened
+            Open,                               // Open and prefetched
+            Released                            // No longer needed
+        };
+
+        void Prefetch(std::size_t index);
+        std::unique_ptr<Source> Release(std::size_t index);
+        void Run();
+        int OpenFile(std::size_t index);
+
+        Terra::Logger::LoggerPointer logger;
+        IOBackend &io_backend;
+        const std::vector<SecureString> &filenames;
+        std::size_t depth;                      // Most files open at once
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool stop;
+        std::vector<State> states;              // State of each file
+        std::vector<int> descriptors;           // Open file descriptors
+        std::size_t open_count;                 // Files open or opening
+        std::deque<std::size_t> pending;        // Files to open in order
+        std::thread thread;
+};
@@ -0,0 +1,335 @@
+/*
+ *  flushing_stream.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file implements the FlushingStreamBuf object, which flushes
+ *      another stream buffer once enough data has been written to it or
+ *      once written data has waited long enough.
+ *
+ *  Portability Issues:
+ *      None.
+ */
+
+#include <algorithm>
+#include "flushing_stream.h"
+
+/*
+ *  FlushingStreamBuf::FlushingStreamBuf()
+ *
+ *  Description:
+ *      Constructor for the FlushingStreamBuf object.
+ *
+ *  Parameters:
+ *      stream_buffer [in]
+ *          The stream buffer to which data is written.
+ *
+ *      flush_interval [in]
+ *          The longest time written data may wait before the stream buffer
+ *          is flushed, or zero if there is no limit.
+ *
+ *      flush_bytes [in]
+ *          The number of octets written after which the stream buffer is
+ *          flushed, or zero if there is no limit.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      A thread that flushes the stream buffer is started only if there
+ *      is a flush interval.
+ */
+FlushingStreamBuf::FlushingStreamBuf(std::streambuf *stream_buffer,
+                                     std::chrono::milliseconds flush_interval,
+                                     std::size_t flush_bytes) :
+    stream_buffer{stream_buffer},
+    flush_interval{flush_interval},
+    flush_bytes{flush_bytes},
+    stop{false},
+    pending{0},
+    flushes{0},
+    maximum_latency{0}
+{
+    if (flush_interval.count() > 0)
+    {
+        flush_thread =
+            std::thread(&FlushingStreamBuf::FlushPeriodically, this);
+    }
+}
+
+/*
+ *  FlushingStreamBuf::~FlushingStreamBuf()
+ *
+ *  Description:
+ *      Destructor for the FlushingStreamBuf object, which stops the thread
+ *      that flushes the stream buffer.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      Data is not flushed; the owner should flush this stream before
+ *      destroying it.
+ */
+FlushingStreamBuf::~FlushingStreamBuf()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+        cv.notify_all();
+    }
+
+    if (flush_thread.joinable()) flush_thread.join();
+}
+
+/*
+ *  FlushingStreamBuf::Flushes()
+ *
+ *  Description:
+ *      Return the number of times written data was flushed.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      The number of flushes.
+ *
+ *  Comments:
+ *      Flushes requested when no data was waiting are not counted.
+ */
+std::size_t FlushingStreamBuf::Flushes()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    return flushes;
+}
+
+/*
+ *  FlushingStreamBuf::MaximumLatency()
+ *
+ *  Description:
+ *      Return the longest time written data waited before being flushed.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      The maximum latency observed.
+ *
+ *  Comments:
+ *      The time is measured from the first write following a flush, so it
+ *      is the longest that any octet may have been held by the wrapped stream
+ *      buffer before being pushed to the operating system.
+ */
+std::chrono::microseconds FlushingStreamBuf::MaximumLatency()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    return maximum_latency;
+}
+
+/*
+ *  FlushingStreamBuf::overflow()
+ *
+ *  Description:
+ *      Write a single character to the wrapped stream buffer.
+ *
+ *  Parameters:
+ *      c [in]
+ *          The character to write.
+ *
+ *  Returns:
+ *      The character written, or EOF on failure.
+ *
+ *  Comments:
+ *      This object has no put area, so this is called for every character
+ *      not written via xsputn().
+ */
+FlushingStreamBuf::int_type FlushingStreamBuf::overflow(int_type c)
+{
+    if (traits_type::eq_int_type(c, traits_type::eof()))
+    {
+        return traits_type::not_eof(c);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (traits_type::eq_int_type(
+            stream_buffer->sputc(traits_type::to_char_type(c)),
+            traits_type::eof()))
+    {
+        return traits_type::eof();
+    }
+
+    Written(1);
+
+    return c;
+}
+
+/*
+ *  FlushingStreamBuf::xsputn()
+ *
+ *  Description:
+ *      Write a sequence of characters to the wrapped stream buffer.
+ *
+ *  Parameters:
+ *      s [in]
+ *          The characters to write.
+ *
+ *      count [in]
+ *          The number of characters to write.
+ *
+ *  Returns:
+ *      The number of characters written.
+ *
+ *  Comments:
+ *      None.
+ */
+std::streamsize FlushingStreamBuf::xsputn(const char_type *s,
+                                          std::streamsize count)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    std::streamsize written = stream_buffer->sputn(s, count);
+
+    if (written > 0) Written(static_cast<std::size_t>(written));
+
+    return written;
+}
+
+/*
+ *  FlushingStreamBuf::sync()
+ *
+ *  Description:
+ *      Flush the wrapped stream buffer.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Zero on success, -1 on failure.
+ *
+ *  Comments:
+ *      None.
+ */
+int FlushingStreamBuf::sync()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    return Flush();
+}
+
+/*
+ *  FlushingStreamBuf::Written()
+ *
+ *  Description:
+ *      Account for data written to the wrapped stream buffer, flushing it
+ *      if the number of octets waiting reaches the limit.
+ *
+ *  Parameters:
+ *      length [in]
+ *          The number of octets written.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      The mutex must be locked when calling this function.
+ */
+void FlushingStreamBuf::Written(std::size_t length)
+{
+    // Note when data starts waiting and wake the flushing thread
+    if (pending == 0)
+    {
+        pending_since = std::chrono::steady_clock::now();
+        if (flush_thread.joinable()) cv.notify_all();
+    }
+
+    pending += length;
+
+    if ((flush_bytes > 0) && (pending >= flush_bytes)) Flush();
+}
+
+/*
+ *  FlushingStreamBuf::Flush()
+ *
+ *  Description:
+ *      Flush the wrapped stream buffer and record how long data waited.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Zero on success, -1 on failure.
+ *
+ *  Comments:
+ *      The mutex must be locked when calling this function.
+ */
+int FlushingStreamBuf::Flush()
+{
+    int result = stream_buffer->pubsync();
+
+    if (pending > 0)
+    {
+        maximum_latency = std::max(
+            maximum_latency,
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - pending_since));
+        flushes++;
+        pending = 0;
+    }
+
+    return result;
+}
+
+/*
+ *  FlushingStreamBuf::FlushPeriodically()
+ *
+ *  Description:
+ *      Flush the wrapped stream buffer whenever written data has waited for
+ *      the flush interval.  This is run by the flushing thread.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      Failures are reported to the writer by the next flush it requests.
+ */
+void FlushingStreamBuf::FlushPeriodically()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true)
+    {
+        // Wait for data to be written
+        cv.wait(lock, [&]() -> bool { return stop || (pending > 0); });
+        if (stop) break;
+
+        // Wait until the oldest waiting data is due to be flushed
+        if (cv.wait_until(lock,
+                          pending_since + flush_interval,
+                          [&]() -> bool { return stop; }))
+        {
+            break;
+        }
+
+        // Flush if the data was not already flushed as it was written
+        if ((pending > 0) && (std::chrono::steady_clock::now() >=
+                              pending_since + flush_interval))
+        {
+            Flush();
+        }
+    }
+}
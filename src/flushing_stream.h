@@ -0,0 +1,91 @@
+/*
+ *  flushing_stream.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file defines stream objects that wrap an existing output stream
+ *      buffer and flush it once a given number of octets has been written
+ *      or once written data has waited a given time, whichever is first.
+ *      This bounds the time data is held in buffers when output is consumed
+ *      as it is produced (e.g., through a pipe).  The time from each write
+ *      until the data is flushed is measured.
+ *
+ *      The wrapper holds no data itself; writes pass directly to the
+ *      wrapped stream buffer.
+ *
+ *  Portability Issues:
+ *      None.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <chrono>
+#include <streambuf>
+#include <ostream>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+// Stream buffer that flushes another stream buffer periodically
+class FlushingStreamBuf : public std::streambuf
+{
+    public:
+        FlushingStreamBuf(std::streambuf *stream_buffer,
+                          std::chrono::milliseconds flush_interval,
+                          std::size_t flush_bytes);
+        ~FlushingStreamBuf();
+
+        std::size_t Flushes();
+        std::chrono::microseconds MaximumLatency();
+
+    protected:
+        int_type overflow(int_type c) override;
+        std::streamsize xsputn(const char_type *s,
+                               std::streamsize count) override;
+        int sync() override;
+        void Written(std::size_t length);
+        int Flush();
+        void FlushPeriodically();
+
+        std::streambuf *stream_buffer;
+        std::chrono::milliseconds flush_interval;
+        std::size_t flush_bytes;
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool stop;
+        std::size_t pending;                    // Octets written, not flushed
+        std::chrono::steady_clock::time_point pending_since;
+        std::size_t flushes;                    // Flushes performed
+        std::chrono::microseconds maximum_latency;// Longest wait to flush
+        std::thread flush_thread;
+};
+
+// Output stream that flushes a stream buffer periodically
+class FlushingOStream : public std::ostream
+{
+    public:
+        FlushingOStream(std::streambuf *stream_buffer,
+                        std::chrono::milliseconds flush_interval,
+                        std::size_t flush_bytes) :
+            std::ostream(nullptr),
+            flushing_buffer(stream_buffer, flush_interval, flush_bytes)
+        {
+            rdbuf(&flushing_buffer);
+        }
+
+        std::size_t Flushes() { return flushing_buffer.Flushes(); }
+        std::chrono::microseconds MaximumLatency()
+        {
+            return flushing_buffer.MaximumLatency();
+        }
+
+    protected:
+        FlushingStreamBuf flushing_buffer;
+};
@@ -0,0 +1,675 @@
+/*
+ *  http_client.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file implements a minimal HTTP/1.1 client used to communicate
+ *      with object storage services.
+ *
+ *  Portability Issues:
+ *      Windows uses Winsock, which is initialized on first use.
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <mutex>
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netdb.h>
+#include <unistd.h>
+#endif
+#include "http_client.h"
+
+namespace
+{
+
+#ifdef _WIN32
+using SocketHandle = SOCKET;
+constexpr SocketHandle Invalid_Socket = INVALID_SOCKET;
+constexpr int Send_Flags = 0;
+#else
+using SocketHandle = int;
+constexpr SocketHandle Invalid_Socket = -1;
+#ifdef MSG_NOSIGNAL
+constexpr int Send_Flags = MSG_NOSIGNAL;
+#else
+constexpr int Send_Flags = 0;
+#endif
+#endif
+
+// Seconds a connection may be idle before sending or receiving fails
+constexpr int HTTP_Timeout = 60;
+
+// Largest response header accepted
+constexpr std::size_t Max_Header_Size = 65'536;
+
+// Size of each read from the connection
+constexpr std::size_t Receive_Size = 65'536;
+
+// Most octets reserved for a response body before it is received, since the
+// Content-Length given by the server is not trusted to size an allocation
+constexpr std::size_t Max_Body_Reserve = 67'108'864;
+
+// Object that owns a connected socket, closing it when destroyed
+class Connection
+{
+    public:
+        Connection() : handle{Invalid_Socket} {}
+        ~Connection()
+        {
+#ifdef _WIN32
+            if (handle != Invalid_Socket) closesocket(handle);
+#else
+            if (handle != Invalid_Socket) close(handle);
+#endif
+        }
+
+        bool Connect(const std::string &host,
+                     std::uint16_t port,
+                     std::string &error);
+        bool Send(const char *data, std::size_t length, std::string &error);
+        long Receive(char *data, std::size_t length, std::string &error);
+
+    protected:
+        SocketHandle handle;
+};
+
+/*
+ *  LastSocketError()
+ *
+ *  Description:
+ *      Return a description of the last socket error.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      The error description.
+ *
+ *  Comments:
+ *      None.
+ */
+std::string LastSocketError()
+{
+#ifdef _WIN32
+    return "socket error " + std::to_string(WSAGetLastError());
+#else
+    return std::strerror(errno);
+#endif
+}
+
+/*
+ *  InitializeSockets()
+ *
+ *  Description:
+ *      Initialize the sockets library, if required on this platform.
+ *
+ *  Parameters:
+ *      error [out]
+ *          A description of the failure if initialization failed.
+ *
+ *  Returns:
+ *      True if sockets may be used, false if not.
+ *
+ *  Comments:
+ *      Initialization is performed only once per process.
+ */
+bool InitializeSockets([[maybe_unused]] std::string &error)
+{
+#ifdef _WIN32
+    static std::once_flag once;
+    static bool initialized{};
+
+    std::call_once(once,
+                   []()
+                   {
+                       WSADATA wsa_data;
+                       initialized =
+                           (WSAStartup(MAKEWORD(2, 2), &wsa_data) == 0);
+                   });
+
+    if (!initialized) error = "unable to initialize Winsock";
+
+    return initialized;
+#else
+    return true;
+#endif
+}
+
+/*
+ *  Connection::Connect()
+ *
+ *  Description:
+ *      Connect to the given server.
+ *
+ *  Parameters:
+ *      host [in]
+ *          The server host name or address.
+ *
+ *      port [in]
+ *          The server port.
+ *
+ *      error [out]
+ *          A description of the failure if the connection failed.
+ *
+ *  Returns:
+ *      True if connected, false if not.
+ *
+ *  Comments:
+ *      Each address for the host is tried in turn.
+ */
+bool Connection::Connect(const std::string &host,
+                         std::uint16_t port,
+                         std::string &error)
+{
+    addrinfo hints{};
+    addrinfo *addresses{};
+
+    if (!InitializeSockets(error)) return false;
+
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    int result = getaddrinfo(host.c_str(),
+                             std::to_string(port).c_str(),
+                             &hints,
+                             &addresses);
+    if (result != 0)
+    {
+        error = "unable to resolve " + host + ": " + gai_strerror(result);
+        return false;
+    }
+
+    error = "unable to connect to " + host;
+
+    for (addrinfo *address = addresses; address != nullptr;
+         address = address->ai_next)
+    {
+        handle = socket(address->ai_family,
+                        address->ai_socktype,
+                        address->ai_protocol);
+        if (handle == Invalid_Socket) continue;
+
+        // Set the send and receive timeouts
+#ifdef _WIN32
+        DWORD timeout = HTTP_Timeout * 1000;
+#else
+        timeval timeout{};
+        timeout.tv_sec = HTTP_Timeout;
+#endif
+        setsockopt(handle,
+                   SOL_SOCKET,
+                   SO_RCVTIMEO,
+                   reinterpret_cast<const char *>(&timeout),
+                   sizeof(timeout));
+        setsockopt(handle,
+                   SOL_SOCKET,
+                   SO_SNDTIMEO,
+                   reinterpret_cast<const char *>(&timeout),
+                   sizeof(timeout));
+#ifdef SO_NOSIGPIPE
+        int enable = 1;
+        setsockopt(handle, SOL_SOCKET, SO_NOSIGPIPE, &enable, sizeof(enable));
+#endif
+
+        if (connect(handle,
+                    address->ai_addr,
+                    static_cast<int>(address->ai_addrlen)) == 0)
+        {
+            freeaddrinfo(addresses);
+            error.clear();
+            return true;
+        }
+
+        error = "unable to connect to " + host + ": " + LastSocketError();
+
+#ifdef _WIN32
+        closesocket(handle);
+#else
+        close(handle);
+#endif
+        handle = Invalid_Socket;
+    }
+
+    freeaddrinfo(addresses);
+
+    return false;
+}
+
+/*
+ *  Connection::Send()
+ *
+ *  Description:
+ *      Send the given data.
+ *
+ *  Parameters:
+ *      data [in]
+ *          The data to send.
+ *
+ *      length [in]
+ *          The number of octets to send.
+ *
+ *      error [out]
+ *          A description of the failure if the data could not be sent.
+ *
+ *  Returns:
+ *      True if all of the data was sent, false if not.
+ *
+ *  Comments:
+ *      Sending is retried if interrupted by a signal.
+ */
+bool Connection::Send(const char *data, std::size_t length, std::string &error)
+{
+    while (length > 0)
+    {
+        const int chunk =
+            static_cast<int>(std::min<std::size_t>(length, 1'048'576));
+        const auto sent = send(handle, data, chunk, Send_Flags);
+#ifndef _WIN32
+        // Retry if interrupted by a signal (e.g., SIGUSR2 to reload limits)
+        if ((sent < 0) && (errno == EINTR)) continue;
+#endif
+        if (sent <= 0)
+        {
+            error = "unable to send request: " + LastSocketError();
+            return false;
+        }
+        data += sent;
+        length -= static_cast<std::size_t>(sent);
+    }
+
+    return true;
+}
+
+/*
+ *  Connection::Receive()
+ *
+ *  Description:
+ *      Receive data.
+ *
+ *  Parameters:
+ *      data [out]
+ *          The buffer into which to receive data.
+ *
+ *      length [in]
+ *          The size of the buffer.
+ *
+ *      error [out]
+ *          A description of the failure if data could not be received.
+ *
+ *  Returns:
+ *      The number of octets received, zero if the server closed the
+ *      connection, or -1 on error.
+ *
+ *  Comments:
+ *      Receiving is retried if interrupted by a signal.
+ */
+long Connection::Receive(char *data, std::size_t length, std::string &error)
+{
+    auto received = recv(handle, data, static_cast<int>(length), 0);
+#ifndef _WIN32
+    // Retry if interrupted by a signal (e.g., SIGUSR2 to reload limits)
+    while ((received < 0) && (errno == EINTR))
+    {
+        received = recv(handle, data, static_cast<int>(length), 0);
+    }
+#endif
+    if (received < 0)
+    {
+        error = "unable to receive response: " + LastSocketError();
+        return -1;
+    }
+
+    return static_cast<long>(received);
+}
+
+/*
+ *  ToLower()
+ *
+ *  Description:
+ *      Convert the given ASCII string to lowercase.
+ *
+ *  Parameters:
+ *      text [in]
+ *          The string to convert.
+ *
+ *  Returns:
+ *      The lowercase string.
+ *
+ *  Comments:
+ *      None.
+ */
+std::string ToLower(std::string text)
+{
+    std::transform(text.begin(),
+                   text.end(),
+                   text.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+
+    return text;
+}
+
+/*
+ *  Trim()
+ *
+ *  Description:
+ *      Remove leading and trailing whitespace from the given string.
+ *
+ *  Parameters:
+ *      text [in]
+ *          The string to trim.
+ *
+ *  Returns:
+ *      The trimmed string.
+ *
+ *  Comments:
+ *      None.
+ */
+std::string Trim(const std::string &text)
+{
+    const std::size_t first = text.find_first_not_of(" \t");
+    if (first == std::string::npos) return {};
+
+    return text.substr(first, text.find_last_not_of(" \t\r") - first + 1);
+}
+
+/*
+ *  ParseHeader()
+ *
+ *  Description:
+ *      Parse the status line and header fields of a response.
+ *
+ *  Parameters:
+ *      header [in]
+ *          The response header, without the terminating empty line.
+ *
+ *      response [out]
+ *          The response into which the status and header fields are stored.
+ *
+ *  Returns:
+ *      True if the header is valid, false if not.
+ *
+ *  Comments:
+ *      None.
+ */
+bool ParseHeader(const std::string &header, HTTPResponse &response)
+{
+    std::size_t line_start{};
+    std::size_t line_end = header.find("\r\n");
+    const std::string status_line = header.substr(0, line_end);
+
+    // Parse the status line (e.g., "HTTP/1.1 200 OK")
+    if (status_line.rfind("HTTP/", 0) != 0) return false;
+    const std::size_t space = status_line.find(' ');
+    if (space == std::string::npos) return false;
+    const char *end = status_line.data() + status_line.size();
+    auto [next, error] =
+        std::from_chars(status_line.data() + space + 1, end, response.status);
+    if (error != std::errc()) return false;
+
+    // Parse each header field
+    while (line_end != std::string::npos)
+    {
+        line_start = line_end + 2;
+        line_end = header.find("\r\n", line_start);
+        const std::string line = header.substr(
+            line_start,
+            (line_end == std::string::npos) ? std::string::npos
+                                            : line_end - line_start);
+
+        const std::size_t colon = line.find(':');
+        if (colon == std::string::npos) continue;
+
+        response.headers[ToLower(line.substr(0, colon))] =
+            Trim(line.substr(colon + 1));
+    }
+
+    return true;
+}
+
+/*
+ *  DecodeChunked()
+ *
+ *  Description:
+ *      Decode a body sent with chunked transfer encoding.
+ *
+ *  Parameters:
+ *      encoded [in]
+ *          The encoded body.
+ *
+ *      max_size [in]
+ *          The largest decoded body accepted.
+ *
+ *      body [out]
+ *          The decoded body.
+ *
+ *  Returns:
+ *      True if the body was decoded, false if it is incomplete, invalid, or
+ *      larger than max_size.
+ *
+ *  Comments:
+ *      Chunk extensions and trailer fields are ignored.  Chunk sizes are
+ *      not trusted, so they are compared without risk of overflow.
+ */
+bool DecodeChunked(const std::string &encoded,
+                   std::size_t max_size,
+                   std::string &body)
+{
+    std::size_t position{};
+
+    body.clear();
+
+    while (true)
+    {
+        const std::size_t line_end = encoded.find("\r\n", position);
+        if (line_end == std::string::npos) return false;
+
+        std::size_t chunk_size{};
+        auto [next, error] = std::from_chars(encoded.data() + position,
+                                             encoded.data() + line_end,
+                                             chunk_size,
+                                             16);
+        if (error != std::errc()) return false;
+
+        position = line_end + 2;
+        if (chunk_size == 0) return true;
+
+        // The chunk and the line ending that follows it must be present
+        const std::size_t remaining = encoded.size() - position;
+        if ((chunk_size > remaining) || (remaining - chunk_size < 2))
+        {
+            return false;
+        }
+        if (chunk_size > max_size - body.size()) return false;
+        body.append(encoded, position, chunk_size);
+        position += chunk_size + 2;
+    }
+}
+
+} // namespace
+
+/*
+ *  SendHTTPRequest()
+ *
+ *  Description:
+ *      Send an HTTP request and receive the response.
+ *
+ *  Parameters:
+ *      request [in]
+ *          The request to send.  The Host, Content-Length, and Connection
+ *          headers are added to those given.
+ *
+ *      response [out]
+ *          The response received.
+ *
+ *      error [out]
+ *          A description of the failure if the request could not be sent
+ *          or the response could not be received.
+ *
+ *  Returns:
+ *      True if a response was received, false if not.  A response
+ *      indicating an error (e.g., status 500) is still a response.
+ *
+ *  Comments:
+ *      Sending and receiving fail if the connection is idle for longer
+ *      than the HTTP timeout.
+ */
+bool SendHTTPRequest(const HTTPRequest &request,
+                     HTTPResponse &response,
+                     std::string &error)
+{
+    Connection connection;
+    std::string header;
+    std::string received;
+    std::vector<char> buffer(Receive_Size);
+
+    response = {};
+
+    if (!connection.Connect(request.host, request.port, error)) return false;
+
+    // Form and send the request header, then the body
+    header = request.method + " " + request.target + " HTTP/1.1\r\n";
+    header += "Host: " + request.host;
+    if (request.port != 80) header += ":" + std::to_string(request.port);
+    header += "\r\n";
+    for (const auto &[name, value] : request.headers)
+    {
+        header += name + ": " + value + "\r\n";
+    }
+    if (!request.body.empty() || (request.method == "PUT") ||
+        (request.method == "POST"))
+    {
+        header += "Content-Length: " + std::to_string(request.body.size()) +
+                  "\r\n";
+    }
+    header += "Connection: close\r\n\r\n";
+
+    if (!connection.Send(header.data(), header.size(), error)) return false;
+    if (!connection.Send(request.body.data(), request.body.size(), error))
+    {
+        return false;
+    }
+
+    // Receive the response header
+    std::size_t header_end{};
+    while ((header_end = received.find("\r\n\r\n")) == std::string::npos)
+    {
+        if (received.size() > Max_Header_Size)
+        {
+            error = "response header is too large";
+            return false;
+        }
+
+        const long octets =
+            connection.Receive(buffer.data(), buffer.size(), error);
+        if (octets < 0) return false;
+        if (octets == 0)
+        {
+            error = "connection closed before the response was received";
+            return false;
+        }
+        received.append(buffer.data(), static_cast<std::size_t>(octets));
+    }
+
+    if (!ParseHeader(received.substr(0, header_end), response))
+    {
+        error = "invalid response header";
+        return false;
+    }
+    received.erase(0, header_end + 4);
+
+    // Responses to HEAD and some status codes have no body
+    if ((request.method == "HEAD") || (response.status == 204) ||
+        (response.status == 304) || (response.status < 200))
+    {
+        return true;
+    }
+
+    // Determine how much of the body to receive
+    const bool chunked =
+        response.headers.contains("transfer-encoding") &&
+        (ToLower(response.headers["transfer-encoding"]) != "identity");
+    std::size_t content_length{};
+    bool length_known{};
+    if (!chunked && response.headers.contains("content-length"))
+    {
+        const std::string &value = response.headers["content-length"];
+        auto [next, parse_error] = std::from_chars(value.data(),
+                                                   value.data() + value.size(),
+                                                   content_length);
+        if (parse_error != std::errc())
+        {
+            error = "invalid Content-Length in response";
+            return false;
+        }
+        if (content_length > request.max_response_body)
+        {
+            error = "response body is too large";
+            return false;
+        }
+        length_known = true;
+        received.reserve(std::min(content_length, Max_Body_Reserve));
+    }
+
+    // A body of unknown length is limited as it is received; a chunked body
+    // may be up to twice as large (plus trailers) to allow for chunk framing
+    const std::size_t receive_limit =
+        chunked ? (2 * request.max_response_body) + Max_Header_Size
+                : request.max_response_body;
+
+    // Receive the body; the server closes the connection after sending it
+    while (!length_known || (received.size() < content_length))
+    {
+        const long octets =
+            connection.Receive(buffer.data(), buffer.size(), error);
+        if (octets < 0) return false;
+        if (octets == 0) break;
+        received.append(buffer.data(), static_cast<std::size_t>(octets));
+        if (!length_known && (received.size() > receive_limit))
+        {
+            error = "response body is too large";
+            return false;
+        }
+    }
+
+    if (length_known)
+    {
+        if (received.size() < content_length)
+        {
+            error = "connection closed before the response was received";
+            return false;
+        }
+        received.resize(content_length);
+        response.body = std::move(received);
+    }
+    else if (chunked)
+    {
+        if (!DecodeChunked(received,
+                           request.max_response_body,
+                           response.body))
+        {
+            error = "invalid chunked response body";
+            return false;
+        }
+    }
+    else
+    {
+        response.body = std::move(received);
+    }
+
+    return true;
+}
@@ -0,0 +1,82 @@
+/*
+ *  http_client.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file defines a minimal HTTP/1.1 client used to communicate with
+ *      object storage services.  Each request is sent on a new connection
+ *      that is closed once the response is received.
+ *
+ *  Portability Issues:
+ *      Only plain HTTP is supported; there is no TLS support.  This is
+ *      built only if the aescrypt_cli_S3 CMake option is enabled.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <span>
+#include <string>
+#include <vector>
+
+// Largest response body accepted unless a request allows a larger one
+constexpr std::size_t Default_Max_Response_Body = 1'048'576;
+
+// An HTTP request
+struct HTTPRequest
+{
+    std::string method;                         // E.g., "PUT"
+    std::string host;                           // Server host name
+    std::uint16_t port{80};                     // Server port
+    std::string target;                         // Path and query string
+    std::vector<std::pair<std::string, std::string>> headers;
+    std::span<const char> body;                 // Request body
+    std::size_t max_response_body{Default_Max_Response_Body};
+};
+
+// An HTTP response
+struct HTTPResponse
+{
+    unsigned status{};                          // Status code
+    std::map<std::string, std::string> headers; // Names are lowercase
+    std::string body;                           // Response body
+};
+
+/*
+ *  SendHTTPRequest()
+ *
+ *  Description:
+ *      Send an HTTP request and receive the response.
+ *
+ *  Parameters:
+ *      request [in]
+ *          The request to send.  The Host, Content-Length, and Connection
+ *          headers are added to those given.
+ *
+ *      response [out]
+ *          The response received.
+ *
+ *      error [out]
+ *          A description of the failure if the request could not be sent
+ *          or the response could not be received.
+ *
+ *  Returns:
+ *      True if a response was received, false if not.  A response
+ *      indicating an error (e.g., status 500) is still a response.
+ *
+ *  Comments:
+ *      Sending and receiving fail if the connection is idle for longer
+ *      than the HTTP timeout.  Receiving fails if the response body is
+ *      larger than the request's max_response_body.
+ */
+bool SendHTTPRequest(const HTTPRequest &request,
+                     HTTPResponse &response,
+                     std::string &error);
@@ -0,0 +1,497 @@
+/*
+ *  io_backend.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file implements the FileBackend object, which opens files for
+ *      reading and writing using the standard file streams or, if requested,
+ *      for writing by mapping them into memory.  A file already open for
+ *      reading is read via its file descriptor.
+ *
+ *  Portability Issues:
+ *      Reading via a file descriptor is not supported on Windows, where the
+ *      file is opened again by name.
+ */
+
+#include <cerrno>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+#include "io_backend.h"
+#include "mapped_sink.h"
+
+namespace
+{
+
+// A file opened for reading using std::ifstream
+class FileSource : public Source
+{
+    public:
+        FileSource() = default;
+        ~FileSource() = default;
+
+        std::ifstream &Stream() { return ifs; }
+        std::streambuf *Buffer() override { return ifs.rdbuf(); }
+        bool Close() override
+        {
+            if (ifs.is_open()) ifs.close();
+            return true;
+        }
+
+    protected:
+        std::ifstream ifs;
+};
+
+#ifndef _WIN32
+// Stream buffer reading from a file descriptor, which it owns
+class DescriptorStreamBuf : public std::streambuf
+{
+    public:
+        explicit DescriptorStreamBuf(int descriptor) :
+            descriptor{descriptor},
+            own_buffer(1),
+            buffer{own_buffer.data()},
+            buffer_size{own_buffer.size()}
+        {
+            setg(buffer, buffer, buffer);
+        }
+        ~DescriptorStreamBuf() { Close(); }
+
+        bool Close()
+        {
+            if (descriptor < 0) return true;
+            const int result = close(descriptor);
+            descriptor = -1;
+            return result == 0;
+        }
+
+    protected:
+        std::streambuf *setbuf(char_type *s, std::streamsize n) override
+        {
+            // Use the given buffer, or read a character at a time
+            if ((s != nullptr) && (n > 0))
+            {
+                buffer = s;
+                buffer_size = static_cast<std::size_t>(n);
+            }
+            else
+            {
+                buffer = own_buffer.data();
+                buffer_size = own_buffer.size();
+            }
+            setg(buffer, buffer, buffer);
+
+            return this;
+        }
+
+        int_type underflow() override
+        {
+            if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+
+            const std::size_t octets = Read(buffer, buffer_size);
+            setg(buffer, buffer, buffer + octets);
+            if (octets == 0) return traits_type::eof();
+
+            return traits_type::to_int_type(*gptr());
+        }
+
+        std::streamsize xsgetn(char_type *s, std::streamsize n) override
+        {
+            // Take what is buffered, then read larger requests directly
+            std::streamsize total = std::min<std::streamsize>(n,
+                                                              egptr() - gptr());
+            traits_type::copy(s, gptr(), static_cast<std::size_t>(total));
+            gbump(static_cast<int>(total));
+
+            while (total < n)
+            {
+                const auto remaining = static_cast<std::size_t>(n - total);
+                if (remaining < buffer_size)
+                {
+                    if (traits_type::eq_int_type(underflow(),
+                                                 traits_type::eof()))
+                    {
+                        break;
+                    }
+                    const std::streamsize octets =
+                        std::min<std::streamsize>(n - total,
+                                                  egptr() - gptr());
+                    traits_type::copy(s + total,
+                                      gptr(),
+                                      static_cast<std::size_t>(octets));
+                    gbump(static_cast<int>(octets));
+                    total += octets;
+                    continue;
+                }
+
+                const std::size_t octets = Read(s + total, remaining);
+                if (octets == 0) break;
+                total += static_cast<std::streamsize>(octets);
+            }
+
+            return total;
+        }
+
+        pos_type seekoff(off_type off,
+                         std::ios_base::seekdir dir,
+                         std::ios_base::openmode which) override
+        {
+            if (!(which & std::ios_base::in)) return pos_type(off_type(-1));
+
+            // Data buffered has been read from the file but not consumed
+            const off_type buffered = egptr() - gptr();
+
+            // Report the position without discarding buffered data
+            if ((dir == std::ios_base::cur) && (off == 0))
+            {
+                const off_t position = lseek(descriptor, 0, SEEK_CUR);
+                if (position < 0) return pos_type(off_type(-1));
+                return pos_type(off_type(position) - buffered);
+            }
+
+            const int whence = (dir == std::ios_base::beg)   ? SEEK_SET
+                               : (dir == std::ios_base::cur) ? SEEK_CUR
+                                                             : SEEK_END;
+            if (dir == std::ios_base::cur) off -= buffered;
+            const off_t position =
+                lseek(descriptor, static_cast<off_t>(off), whence);
+            if (position < 0) return pos_type(off_type(-1));
+            setg(buffer, buffer, buffer);
+
+            return pos_type(off_type(position));
+        }
+
+        pos_type seekpos(pos_type pos, std::ios_base::openmode which) override
+        {
+            return seekoff(off_type(pos), std::ios_base::beg, which);
+        }
+
+        std::size_t Read(char *data, std::size_t length)
+        {
+            ssize_t result{};
+
+            do
+            {
+                result = read(descriptor, data, length);
+            } while ((result < 0) && (errno == EINTR));
+
+            return (result > 0) ? static_cast<std::size_t>(result) : 0;
+        }
+
+        int descriptor;
+        std::vector<char> own_buffer;           // Used if none is given
+        char *buffer;
+        std::size_t buffer_size;
+};
+
+// A file read via a file descriptor opened elsewhere
+class DescriptorSource : public Source
+{
+    public:
+        explicit DescriptorSource(int descriptor) : stream_buffer{descriptor}
+        {
+        }
+        ~DescriptorSource() = default;
+
+        std::streambuf *Buffer() override { return &stream_buffer; }
+        bool Close() override { return stream_buffer.Close(); }
+
+    protected:
+        DescriptorStreamBuf stream_buffer;
+};
+#endif
+
+// A file opened for writing using std::ofstream
+class FileSink : public Sink
+{
+    public:
+        FileSink() = default;
+        ~FileSink() = default;
+
+        std::ofstream &Stream() { return ofs; }
+        std::streambuf *Buffer() override { return ofs.rdbuf(); }
+        bool Close() override
+        {
+            if (!ofs.is_open()) return true;
+            ofs.flush();
+            ofs.close();
+            return !ofs.fail();
+        }
+
+    protected:
+        std::ofstream ofs;
+};
+
+} // namespace
+
+/*
+ *  IOBackend::OpenMappedSink()
+ *
+ *  Description:
+ *      Open the given file for writing by mapping it into memory, which by
+ *      default is not supported, so the file is opened via OpenSink().
+ *
+ *  Parameters:
+ *      logger [in]
+ *          The logger to which logging output will be sent.
+ *
+ *      filename [in]
+ *          The name of the file to open in UTF-8 format.
+ *
+ *      capacity [in]
+ *          The most octets that will be written to the file.
+ *
+ *  Returns:
+ *      The opened file, or nullptr if it could not be opened, in which case
+ *      errno indicates the reason.
+ *
+ *  Comments:
+ *      None.
+ */
+std::unique_ptr<Sink> IOBackend::OpenMappedSink(
+    const Terra::Logger::LoggerPointer &logger,
+    const SecureString &filename,
+    [[maybe_unused]] std::uint64_t capacity)
+{
+    return OpenSink(logger, filename);
+}
+
+/*
+ *  IOBackend::AdoptSource()
+ *
+ *  Description:
+ *      Form a source reading from the given open file descriptor, which by
+ *      default is not supported, so the descriptor is closed and the file is
+ *      opened via OpenSource().
+ *
+ *  Parameters:
+ *      logger [in]
+ *          The logger to which logging output will be sent.
+ *
+ *      filename [in]
+ *          The name of the file in UTF-8 format.
+ *
+ *      descriptor [in]
+ *          The file descriptor open for reading, which this takes ownership
+ *          of.
+ *
+ *  Returns:
+ *      The source, or nullptr if it could not be formed, in which case
+ *      errno indicates the reason.
+ *
+ *  Comments:
+ *      None.
+ */
+std::unique_ptr<Source> IOBackend::AdoptSource(
+    const Terra::Logger::LoggerPointer &logger,
+    const SecureString &filename,
+    [[maybe_unused]] int descriptor)
+{
+#ifndef _WIN32
+    close(descriptor);
+#endif
+
+    return OpenSource(logger, filename);
+}
+
+/*
+ *  FileBackend::OpenSource()
+ *
+ *  Description:
+ *      Open the given file for reading.
+ *
+ *  Parameters:
+ *      logger [in]
+ *          The logger to which logging output will be sent.
+ *
+ *      filename [in]
+ *          The name of the file to open in UTF-8 format.
+ *
+ *  Returns:
+ *      The opened file, or nullptr if it could not be opened, in which case
+ *      errno indicates the reason.
+ *
+ *  Comments:
+ *      None.
+ */
+std::unique_ptr<Source> FileBackend::OpenSource(
+    const Terra::Logger::LoggerPointer &logger,
+    const SecureString &filename)
+{
+    auto source = std::make_unique<FileSource>();
+
+    // Filenames should be in UTF-8 format, so form a UTF-8 string type
+    // for use with open()
+    SecureU8String u8name(filename.cbegin(), filename.cend());
+
+    try
+    {
+        // Open the input file for reading
+        source->Stream().open(std::filesystem::path(u8name),
+                              std::ios::in | std::ios::binary);
+    }
+    catch (const std::filesystem::filesystem_error &e)
+    {
+        logger->error << "Exception opening input file "
+                         "(file system err="
+                      << e.what() << ")" << std::flush;
+    }
+    catch (const std::exception &e)
+    {
+        logger->error << "Exception opening input file (err=" << e.what()
+                      << ")" << std::flush;
+    }
+    catch (...)
+    {
+        logger->error << "Exception opening input file" << std::flush;
+    }
+    if (!source->Stream().good() || !source->Stream().is_open()) return nullptr;
+
+    return source;
+}
+
+/*
+ *  FileBackend::AdoptSource()
+ *
+ *  Description:
+ *      Form a source reading from the given open file descriptor, so that
+ *      the file is not opened again by name.
+ *
+ *  Parameters:
+ *      logger [in]
+ *          The logger to which logging output will be sent.
+ *
+ *      filename [in]
+ *          The name of the file in UTF-8 format.
+ *
+ *      descriptor [in]
+ *          The file descriptor open for reading, which the source owns.
+ *
+ *  Returns:
+ *      The source, or nullptr if it could not be formed, in which case
+ *      errno indicates the reason.
+ *
+ *  Comments:
+ *      Reading starts at the descriptor's current offset.  On Windows, the
+ *      file is opened again by name.
+ */
+std::unique_ptr<Source> FileBackend::AdoptSource(
+    [[maybe_unused]] const Terra::Logger::LoggerPointer &logger,
+    [[maybe_unused]] const SecureString &filename,
+    int descriptor)
+{
+#ifndef _WIN32
+    return std::make_unique<DescriptorSource>(descriptor);
+#else
+    return IOBackend::AdoptSource(logger, filename, descriptor);
+#endif
+}
+
+/*
+ *  FileBackend::OpenSink()
+ *
+ *  Description:
+ *      Open the given file for writing, replacing any existing content.
+ *
+ *  Parameters:
+ *      logger [in]
+ *          The logger to which logging output will be sent.
+ *
+ *      filename [in]
+ *          The name of the file to open in UTF-8 format.
+ *
+ *  Returns:
+ *      The opened file, or nullptr if it could not be opened, in which case
+ *      errno indicates the reason.
+ *
+ *  Comments:
+ *      None.
+ */
+std::unique_ptr<Sink> FileBackend::OpenSink(
+    const Terra::Logger::LoggerPointer &logger,
+    const SecureString &filename)
+{
+    auto sink = std::make_unique<FileSink>();
+
+    // Filenames should be in UTF-8 format, so form a UTF-8 string type
+    // for use with open()
+    SecureU8String u8name(filename.cbegin(), filename.cend());
+
+    try
+    {
+        // Open the output file for writing
+        sink->Stream().open(std::filesystem::path(u8name),
+                            std::ios::out | std::ios::binary |
+                                std::ios::trunc);
+    }
+    catch (const std::filesystem::filesystem_error &e)
+    {
+        logger->error << "Exception opening output file: " << filename
+                      << " (file system err=" << e.what() << ")"
+                      << std::flush;
+    }
+    catch (const std::exception &e)
+    {
+        logger->error << "Exception opening output file: " << filename
+                      << " (err=" << e.what() << ")" << std::flush;
+    }
+    catch (...)
+    {
+        logger->error << "Exception opening output file: " << filename
+                      << std::flush;
+    }
+    if (!sink->Stream().good() || !sink->Stream().is_open()) return nullptr;
+
+    return sink;
+}
+
+/*
+ *  FileBackend::OpenMappedSink()
+ *
+ *  Description:
+ *      Open the given file for writing by mapping it into memory, so that
+ *      data written is placed directly into the file's pages.  If the file
+ *      cannot be mapped, it is opened via OpenSink().
+ *
+ *  Parameters:
+ *      logger [in]
+ *          The logger to which logging output will be sent.
+ *
+ *      filename [in]
+ *          The name of the file to open in UTF-8 format.
+ *
+ *      capacity [in]
+ *          The most octets that will be written to the file, which are
+ *          allocated before writing; the file is truncated to the octets
+ *          actually written when closed.
+ *
+ *  Returns:
+ *      The opened file, or nullptr if it could not be opened, in which case
+ *      errno indicates the reason.
+ *
+ *  Comments:
+ *      The file should be a new regular file, as it is replaced.
+ */
+std::unique_ptr<Sink> FileBackend::OpenMappedSink(
+    const Terra::Logger::LoggerPointer &logger,
+    const SecureString &filename,
+    std::uint64_t capacity)
+{
+    auto sink = std::make_unique<MappedSink>(logger);
+
+    if (sink->Open(filename, capacity)) return sink;
+
+    logger->info << "Writing output file without mapping it: " << filename
+                 << std::flush;
+
+    return OpenSink(logger, filename);
+}
@@ -0,0 +1,102 @@
+/*
+ *  io_backend.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file defines the interface through which files are opened for
+ *      reading (a Source) and writing (a Sink), allowing alternative ways
+ *      of performing file I/O to be used in place of the standard file
+ *      streams.  The FileBackend object implements the interface using
+ *      std::ifstream and std::ofstream.
+ *
+ *      A Source may also be formed from a file descriptor already opened
+ *      for reading (e.g., by the FilePrefetcher), so the file need not be
+ *      opened again by name.
+ *
+ *      Each Source and Sink provides a stream buffer, which the caller may
+ *      give a buffer via pubsetbuf() before any I/O is performed.  A sink
+ *      opened via OpenMappedSink() may write directly into a mapping of the
+ *      file, in which case it ignores any buffer given.
+ *
+ *  Portability Issues:
+ *      None.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <streambuf>
+#include <terra/logger/logger.h>
+#include "secure_containers.h"
+
+// A file opened for reading
+class Source
+{
+    public:
+        virtual ~Source() = default;
+
+        virtual std::streambuf *Buffer() = 0;
+        virtual bool Close() = 0;
+};
+
+// A file opened for writing
+class Sink
+{
+    public:
+        virtual ~Sink() = default;
+
+        virtual std::streambuf *Buffer() = 0;
+        virtual bool Close() = 0;
+};
+
+// Opens files for reading and writing
+class IOBackend
+{
+    public:
+        virtual ~IOBackend() = default;
+
+        virtual std::unique_ptr<Source> OpenSource(
+            const Terra::Logger::LoggerPointer &logger,
+            const SecureString &filename) = 0;
+        virtual std::unique_ptr<Source> AdoptSource(
+            const Terra::Logger::LoggerPointer &logger,
+            const SecureString &filename,
+            int descriptor);
+        virtual std::unique_ptr<Sink> OpenSink(
+            const Terra::Logger::LoggerPointer &logger,
+            const SecureString &filename) = 0;
+        virtual std::unique_ptr<Sink> OpenMappedSink(
+            const Terra::Logger::LoggerPointer &logger,
+            const SecureString &filename,
+            std::uint64_t capacity);
+};
+
+// Opens files using the standard file streams
+class FileBackend : public IOBackend
+{
+    public:
+        FileBackend() = default;
+        ~FileBackend() = default;
+
+        std::unique_ptr<Source> OpenSource(
+            const Terra::Logger::LoggerPointer &logger,
+            const SecureString &filename) override;
+        std::unique_ptr<Source> AdoptSource(
+            const Terra::Logger::LoggerPointer &logger,
+            const SecureString &filename,
+            int descriptor) override;
+        std::unique_ptr<Sink> OpenSink(
+            const Terra::Logger::LoggerPointer &logger,
+            const SecureString &filename) override;
+        std::unique_ptr<Sink> OpenMappedSink(
+            const Terra::Logger::LoggerPointer &logger,
+            const SecureString &filename,
+            std::uint64_t capacity) override;
+};
@@ -25,11 +25,32 @@
 #include <algorithm>
 #include <span>
 #include <string>
+#include <sstream>
+#include <iomanip>
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#include <share.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <cerrno>
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define AESCRYPT_KEY_MAP_SSE2
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define AESCRYPT_KEY_MAP_NEON
+#endif
 #include <terra/random/random_generator.h>
-#include <terra/charutil/character_utilities.h>
 #include "key_file.h"
+#include "aescrypt.h"
 #include "error_string.h"
 #include "password_convert.h"
+#include "unicode_fast_path.h"
 
 // It is assumed a character is 8 bits
 static_assert(CHAR_BIT == 8);
@@ -50,6 +71,186 @@ static const char Key_Characters[64] =
     '4', '5', '6', '7', '8', '9', '_', '+'
 };
 
+// Number of octets of random data to produce per batch when generating
+// multiple key files
+constexpr std::size_t Key_Generation_Batch_Size = 1'048'576;
+
+// Initial buffer size when reading a key of unknown length
+constexpr std::size_t Key_Read_Chunk_Size = 4096;
+
+/*
+ *  MapKeyCharacters()
+ *
+ *  Description:
+ *      Map each octet of random data onto the Key_Characters set, retaining
+ *      the low-order 6 bits of entropy from each octet.  Where the processor
+ *      supports it, 16 octets are mapped at a time by computing the offset
+ *      from each 6-bit value to its character, which is equivalent to
+ *      indexing into the Key_Characters table.
+ *
+ *  Parameters:
+ *      key [in/out]
+ *          The random octets to map onto printable key characters.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      The offsets are 'A' for values 0..25, 'a' - 26 for 26..51, '0' - 52
+ *      for 52..61, '_' - 62 for 62 and '+' - 63 for 63.  Each comparison
+ *      below adjusts the running offset by the difference between adjacent
+ *      ranges.
+ */
+void MapKeyCharacters(std::span<std::uint8_t> key)
+{
+    std::size_t i = 0;
+
+#if defined(AESCRYPT_KEY_MAP_SSE2)
+    const __m128i six_bits = _mm_set1_epi8(0x3f);
+
+    for (; i + 16 <= key.size(); i += 16)
+    {
+        __m128i value = _mm_and_si128(
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(key.data() + i)),
+            six_bits);
+        __m128i offset = _mm_set1_epi8('A');
+        offset = _mm_add_epi8(
+            offset,
+            _mm_and_si128(_mm_cmpgt_epi8(value, _mm_set1_epi8(25)),
+                          _mm_set1_epi8(6)));
+        offset = _mm_add_epi8(
+            offset,
+            _mm_and_si128(_mm_cmpgt_epi8(value, _mm_set1_epi8(51)),
+                          _mm_set1_epi8(-75)));
+        offset = _mm_add_epi8(
+            offset,
+            _mm_and_si128(_mm_cmpgt_epi8(value, _mm_set1_epi8(61)),
+                          _mm_set1_epi8(37)));
+        offset = _mm_add_epi8(
+            offset,
+            _mm_and_si128(_mm_cmpgt_epi8(value, _mm_set1_epi8(62)),
+                          _mm_set1_epi8(-53)));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(key.data() + i),
+                         _mm_add_epi8(value, offset));
+    }
+#elif defined(AESCRYPT_KEY_MAP_NEON)
+    const uint8x16_t six_bits = vdupq_n_u8(0x3f);
+
+    for (; i + 16 <= key.size(); i += 16)
+    {
+        uint8x16_t value = vandq_u8(vld1q_u8(key.data() + i), six_bits);
+        uint8x16_t offset = vdupq_n_u8('A');
+        offset = vaddq_u8(offset,
+                          vandq_u8(vcgtq_u8(value, vdupq_n_u8(25)),
+                                   vdupq_n_u8(6)));
+        offset = vaddq_u8(offset,
+                          vandq_u8(vcgtq_u8(value, vdupq_n_u8(51)),
+                                   vdupq_n_u8(static_cast<std::uint8_t>(-75))));
+        offset = vaddq_u8(offset,
+                          vandq_u8(vcgtq_u8(value, vdupq_n_u8(61)),
+                                   vdupq_n_u8(37)));
+        offset = vaddq_u8(offset,
+                          vandq_u8(vcgtq_u8(value, vdupq_n_u8(62)),
+                                   vdupq_n_u8(static_cast<std::uint8_t>(-53))));
+        vst1q_u8(key.data() + i, vaddq_u8(value, offset));
+    }
+#endif
+
+    // Map any remaining octets using the character table
+    for (; i < key.size(); i++) key[i] = Key_Characters[(key[i] & 0x3f)];
+}
+
+/*
+ *  WriteNewKeyFile()
+ *
+ *  Description:
+ *      Create a new key file and write the given key to it.  The file is
+ *      created exclusively (i.e., it must not already exist) and, on
+ *      systems that support it, readable and writable only by the owner.
+ *
+ *  Parameters:
+ *      logger [in]
+ *          The logger to which logging output will be sent.
+ *
+ *      path [in]
+ *          The path of the key file to create.
+ *
+ *      key [in]
+ *          The key data to write to the file.
+ *
+ *  Returns:
+ *      True if successful, false if unsuccessful.  On failure, any partially
+ *      written file is removed.
+ *
+ *  Comments:
+ *      None.
+ */
+bool WriteNewKeyFile(const Terra::Logger::LoggerPointer &logger,
+                     const std::filesystem::path &path,
+                     std::span<const std::uint8_t> key)
+{
+    std::size_t written = 0;
+
+#ifdef _WIN32
+    int fd = -1;
+
+    if (_wsopen_s(&fd,
+                  path.c_str(),
+                  _O_WRONLY | _O_CREAT | _O_EXCL | _O_BINARY,
+                  _SH_DENYRW,
+                  _S_IREAD | _S_IWRITE) != 0)
+    {
+        LogSystemError(logger,
+                       "Failed to create key file: " + path.string());
+        return false;
+    }
+
+    while (written < key.size())
+    {
+        int result = _write(fd,
+                            key.data() + written,
+                            static_cast<unsigned>(key.size() - written));
+        if (result <= 0) break;
+        written += static_cast<std::size_t>(result);
+    }
+
+    if ((_close(fd) != 0) || (written != key.size()))
+#else
+    int fd = open(path.c_str(),
+                  O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC,
+                  S_IRUSR | S_IWUSR);
+    if (fd < 0)
+    {
+        LogSystemError(logger,
+                       "Failed to create key file: " + path.string());
+        return false;
+    }
+
+    while (written < key.size())
+    {
+        ssize_t result = write(fd, key.data() + written, key.size() - written);
+        if (result < 0)
+        {
+            if (errno == EINTR) continue;
+            break;
+        }
+        written += static_cast<std::size_t>(result);
+    }
+
+    if ((close(fd) != 0) || (written != key.size()))
+#endif
+    {
+        LogSystemError(logger, "Failed writing key file: " + path.string());
+
+        std::error_code ec;
+        std::filesystem::remove(path, ec);
+
+        return false;
+    }
+
+    return true;
+}
+
 /*
  *  TruncateKeyOnLineEnding()
  *
@@ -84,6 +285,207 @@ void TruncateKeyOnLineEnding(SecureU8String &key)
     }
 }
 
+/*
+ *  ReadKeyDescriptor()
+ *
+ *  Description:
+ *      Read all of the data from the given file descriptor.  If the size of
+ *      the data can be determined in advance (e.g., the descriptor refers to
+ *      a regular file), the key is read into a string of that size;
+ *      otherwise, the string grows geometrically as data arrives.
+ *
+ *  Parameters:
+ *      logger [in]
+ *          The logger to which logging output will be sent.
+ *
+ *      source [in]
+ *          A description of the source, used only for logging.
+ *
+ *      fd [in]
+ *          The file descriptor from which to read.
+ *
+ *  Returns:
+ *      The key data read or an empty string if there was an error.
+ *
+ *  Comments:
+ *      None.
+ */
+SecureU8String ReadKeyDescriptor(const Terra::Logger::LoggerPointer &logger,
+                                 const SecureString &source,
+                                 int fd)
+{
+    SecureU8String key;
+    std::size_t length = 0;
+    std::size_t capacity = Key_Read_Chunk_Size;
+
+#ifdef _WIN32
+    struct _stat64 file_status{};
+    if ((_fstat64(fd, &file_status) == 0) &&
+        ((file_status.st_mode & _S_IFREG) != 0))
+#else
+    struct stat file_status{};
+    if ((fstat(fd, &file_status) == 0) && S_ISREG(file_status.st_mode))
+#endif
+    {
+        // Size the key to match a regular file (plus one octet to observe
+        // end of file with the same read)
+        capacity = static_cast<std::size_t>(file_status.st_size) + 1;
+    }
+
+    key.resize(std::min(capacity, Max_Key_Read_Size + 1));
+
+    while (true)
+    {
+        // Grow the key buffer if it is full
+        if (length == key.size())
+        {
+            if (key.size() > Max_Key_Read_Size) break;
+            key.resize(std::min(key.size() * 2, Max_Key_Read_Size + 1));
+        }
+
+#ifdef _WIN32
+        int result = _read(fd,
+                           key.data() + length,
+                           static_cast<unsigned>(key.size() - length));
+#else
+        ssize_t result = read(fd, key.data() + length, key.size() - length);
+        if ((result < 0) && (errno == EINTR)) continue;
+#endif
+        if (result < 0)
+        {
+            LogSystemError(logger,
+                           std::string("Failed reading key from ") +
+                               static_cast<std::string>(source));
+            return {};
+        }
+
+        // Zero indicates end of file
+        if (result == 0) break;
+
+        length += static_cast<std::size_t>(result);
+    }
+
+    // Ensure the key is not unreasonably large
+    if (length > Max_Key_Read_Size)
+    {
+        logger->error << "Key data exceeds the maximum key size of "
+                      << Max_Key_Read_Size << " octets" << std::flush;
+        return {};
+    }
+
+    key.resize(length);
+
+    // If there is no key, report the error
+    if (key.empty())
+    {
+        logger->error << "No data read from " << source << std::flush;
+    }
+
+    return key;
+}
+
+/*
+ *  ParseKey()
+ *
+ *  Description:
+ *      Given the raw contents of a key file, determine the encoding of the
+ *      key (UTF-8 or UTF-16), convert it to UTF-8 if necessary and remove
+ *      any trailing line ending.
+ *
+ *  Parameters:
+ *      logger [in]
+ *          The logger to which logging output will be sent.
+ *
+ *      key [in]
+ *          The raw contents of the key file.
+ *
+ *  Returns:
+ *      A string containing the key or an empty string if there was an error.
+ *      The returned string will be encoded as UTF-8.
+ *
+ *  Comments:
+ *      None.
+ */
+SecureU8String ParseKey(const Terra::Logger::LoggerPointer &logger,
+                        SecureU8String &key)
+{
+    bool little_endian = true;
+
+    // If there is no key, return early
+    if (key.empty())
+    {
+        logger->error << "No valid data read from the key file" << std::flush;
+        return {};
+    }
+
+    // If the key does not start with byte-order-mark (BOM) value 0xFF or 0xFE,
+    // it is assumed to be UTF-8
+    if ((static_cast<std::uint8_t>(key[0]) != 0xFE) &&
+        (static_cast<std::uint8_t>(key[0]) != 0xFF))
+    {
+        // Truncate the key on line end
+        TruncateKeyOnLineEnding(key);
+
+        // Verify that the key if proper UTF-8
+        if (!IsUTF8ValidFast(
+                {reinterpret_cast<const std::uint8_t *>(key.data()),
+                 key.size()}))
+        {
+            logger->error << "Key data does not appear to be valid UTF-8"
+                          << std::flush;
+            return {};
+        }
+
+        // Ensure the key is not empty
+        if (key.empty())
+        {
+            logger->error << "The key contents appear to be empty"
+                          << std::flush;
+            return {};
+        }
+
+        return std::move(key);
+    }
+
+    // UTF-16 data should have an even number of octets
+    if ((key.length() & 0x01) != 0)
+    {
+        logger->error << "Key has an odd number of octets; UTF-16 data has "
+                         "an even number of octets"
+                      << std::flush;
+        return {};
+    }
+
+    // The key length must be >= 4 since the BOM occupies the first 2 octets
+    if (key.length() < 4)
+    {
+        logger->error << "Key file data appears to be too short" << std::flush;
+        return {};
+    }
+
+    // Inspect the first octet to determine endianness
+    little_endian = (static_cast<std::uint8_t>(key[0]) == 0xFF);
+
+    // Convert the UTF-16 key (password) to UTF-8, skipping over the BOM
+    SecureU8String u8key =
+        PasswordConvertUTF8(std::span<const char8_t>(key).subspan(2),
+                            little_endian);
+
+    // Truncate the key on line end
+    TruncateKeyOnLineEnding(u8key);
+
+    // Ensure the key is not empty
+    if (u8key.empty())
+    {
+        logger->error << "The key contents appear to be empty" << std::flush;
+        return {};
+    }
+
+    logger->info << "Finished reading the key file" << std::flush;
+
+    return u8key;
+}
+
 } // namespace
 
 /*
@@ -218,7 +620,7 @@ bool GenerateKeyFile(const Terra::Logger::LoggerPointer &parent_logger,
     rng.GetRandomOctets(key);
 
     // Convert each to printable character (retains 6 bits of entropy)
-    for (auto &value : key) value = Key_Characters[(value & 0x3f)];
+    MapKeyCharacters(key);
 
     // Output a stream of octets
     stream.write(reinterpret_cast<char *>(key.data()),
@@ -275,6 +677,145 @@ bool GenerateKeyFile(const Terra::Logger::LoggerPointer &parent_logger,
     return true;
 }
 
+/*
+ *  GenerateKeyFiles()
+ *
+ *  Description:
+ *      This function will generate a number of key files in the given
+ *      directory.
+ *
+ *  Parameters:
+ *      parent_logger [in]
+ *          Parent logging object.
+ *
+ *      key_directory [in]
+ *          The directory into which key files are written.  If it does not
+ *          exist, it will be created.
+ *
+ *      key_size [in]
+ *          The size (in octets) of the random key data to emit per file.
+ *
+ *      key_count [in]
+ *          The number of key files to generate.
+ *
+ *  Returns:
+ *      True if successful, false if unsuccessful.  Errors will be emitted
+ *      to stderr.
+ *
+ *  Comments:
+ *      Random data for many keys is produced with a single request to the
+ *      random number generator, bounded by Key_Generation_Batch_Size, and
+ *      each key file is written with a single write call.  Key files are
+ *      named "key-NNNNNN.key" and are never overwritten.  Should a failure
+ *      occur, key files already written remain in place.
+ */
+bool GenerateKeyFiles(const Terra::Logger::LoggerPointer &parent_logger,
+                      const SecureString &key_directory,
+                      std::size_t key_size,
+                      std::size_t key_count)
+{
+    Terra::Random::RandomGenerator rng;
+
+    // Create a child logger
+    Terra::Logger::LoggerPointer logger =
+        std::make_shared<Terra::Logger::Logger>(parent_logger, "KGEN");
+
+    logger->info << "Preparing to generate " << key_count << " key files"
+                 << std::flush;
+
+    // Ensure the key length and count are not 0
+    if ((key_size == 0) || (key_count == 0))
+    {
+        logger->error << "Key length or count is zero, which is not allowed"
+                      << std::flush;
+        return false;
+    }
+
+    // Filenames should be in UTF-8 format, so form a UTF-8 string type
+    // for use with the filesystem functions
+    std::filesystem::path directory(
+        SecureU8String(key_directory.cbegin(), key_directory.cend()));
+
+    try
+    {
+        // Create the directory if it does not exist, restricting access
+        if (std::filesystem::create_directories(directory))
+        {
+            std::filesystem::permissions(directory,
+                                         std::filesystem::perms::owner_all);
+        }
+        else if (!std::filesystem::is_directory(directory))
+        {
+            logger->error << "Key directory is not a directory: "
+                          << key_directory << std::flush;
+            return false;
+        }
+    }
+    catch (const std::filesystem::filesystem_error &e)
+    {
+        logger->error << "Exception creating key directory: " << key_directory
+                      << " (file system err=" << e.what() << ")"
+                      << std::flush;
+        return false;
+    }
+    catch (const std::exception &e)
+    {
+        logger->error << "Exception creating key directory: " << key_directory
+                      << " (err=" << e.what() << ")" << std::flush;
+        return false;
+    }
+    catch (...)
+    {
+        logger->error << "Exception creating key directory: " << key_directory
+                      << std::flush;
+        return false;
+    }
+
+    // Determine how many keys to produce per batch of random data
+    const std::size_t batch_keys =
+        std::clamp<std::size_t>(Key_Generation_Batch_Size / key_size,
+                                1,
+                                key_count);
+
+    // Width of the numeric portion of each key file name
+    const std::size_t name_width =
+        std::max<std::size_t>(6, std::to_string(key_count).length());
+
+    // Buffer to hold random data for a batch of keys
+    SecureVector<std::uint8_t> keys(batch_keys * key_size);
+
+    for (std::size_t generated = 0; generated < key_count;)
+    {
+        // Produce random data and printable characters for the batch
+        const std::size_t count =
+            std::min(batch_keys, key_count - generated);
+        std::span<std::uint8_t> batch(keys.data(), count * key_size);
+        rng.GetRandomOctets(batch);
+        MapKeyCharacters(batch);
+
+        // Write each key to its own file
+        for (std::size_t i = 0; i < count; i++, generated++)
+        {
+            std::ostringstream name;
+            name << "key-" << std::setw(static_cast<int>(name_width))
+                 << std::setfill('0') << (generated + 1) << ".key";
+
+            if (!WriteNewKeyFile(logger,
+                                 directory / name.str(),
+                                 batch.subspan(i * key_size, key_size)))
+            {
+                std::cerr << "Unable to create key file: "
+                          << (directory / name.str()).string() << std::endl;
+                return false;
+            }
+        }
+    }
+
+    logger->info << "Generated " << key_count << " key files" << std::flush;
+
+    return true;
+}
+
 /*
  *  ReadKeyFile()
  *
@@ -294,15 +835,14 @@ bool GenerateKeyFile(const Terra::Logger::LoggerPointer &parent_logger,
  *      The returned string will be encoded as UTF-8.
  *
  *  Comments:
- *      None.
+ *      When reading a regular file, the key is read with a single read into
+ *      a string sized to match the file.  Other files that can be read
+ *      (e.g., pipes and FIFOs) are read until end of file.
  */
 SecureU8String ReadKeyFile(const Terra::Logger::LoggerPointer &parent_logger,
                            const SecureString &key_file)
 {
     SecureU8String key;
-    std::ifstream file_stream;
-    bool using_stdin = true;
-    bool little_endian = true;
 
     // Create a child logger
     Terra::Logger::LoggerPointer logger =
@@ -311,147 +851,125 @@ SecureU8String ReadKeyFile(const Terra::Logger::LoggerPointer &parent_logger,
     logger->info << "Preparing to read key file" << std::flush;
 
     // Is the key file coming from stdin?
-    if (key_file != "-")
+    if (key_file == "-")
     {
-        // Filenames should be in UTF-8 format, so form a UTF-8 string type
-        // for use with open()
-        SecureU8String u8name(key_file.cbegin(), key_file.cend());
-
-        try
-        {
-            // Open the file for writing
-            file_stream.open(std::filesystem::path(u8name),
-                             std::ios::in | std::ios::binary);
-        }
-        catch (const std::filesystem::filesystem_error &e)
-        {
-            logger->error << "Exception opening key file: "
-                          << key_file << "(file system err=" << e.what()
-                          << ")" << std::flush;
-        }
-        catch (const std::exception &e)
-        {
-            logger->error << "Exception opening key file: " << key_file
-                          << "(err=" << e.what() << ")" << std::flush;
-        }
-        catch (...)
-        {
-            logger->error << "Exception opening key file: " << key_file
-                          << std::flush;
-        }
-
-        // Ensure the file opened properly
-        if (!file_stream.good() || !file_stream.is_open())
-        {
-            LogSystemError(logger,
-                           std::string("Failed to open input file \"") +
-                               static_cast<std::string>(key_file) + "\"");
-            return {};
-        }
+        // Read the key from the stdin file descriptor
+        key = ReadKeyDescriptor(logger, key_file, 0);
+        if (key.empty()) return {};
 
-        // Not reading from stdin
-        using_stdin = false;
+        return ParseKey(logger, key);
     }
 
-    // Assign the effective input stream to the "stream" variable
-    std::istream &stream = (using_stdin ? std::cin : file_stream);
+    // Filenames should be in UTF-8 format, so form a UTF-8 string type
+    // for use with open()
+    SecureU8String u8name(key_file.cbegin(), key_file.cend());
+    std::filesystem::path path;
 
-    // Read the entire file
-    while (!stream.eof())
+    try
     {
-        char octet{};
-
-        // Read a single character
-        stream.get(octet);
-
-        // Check for errors
-        if (!stream.good() && !stream.eof())
-        {
-            LogSystemError(logger,
-                           std::string("Failed reading input file \"") +
-                               static_cast<std::string>(key_file) + "\"");
-            return {};
-        }
-
-        // Store octet is not EOF
-        if (!stream.eof()) key.push_back(octet);
+        path = std::filesystem::path(u8name);
     }
-
-    // Close the key file if still open
-    if (file_stream.is_open()) file_stream.close();
-
-    // If there is no key, return early
-    if (key.empty())
+    catch (const std::filesystem::filesystem_error &e)
     {
-        logger->error << "No valid data read from the key file" << std::flush;
+        logger->error << "Exception opening key file: "
+                      << key_file << "(file system err=" << e.what()
+                      << ")" << std::flush;
         return {};
     }
-
-    // If the key does not start with byte-order-mark (BOM) value 0xFF or 0xFE,
-    // it is assumed to be UTF-8
-    if ((static_cast<std::uint8_t>(key[0]) != 0xFE) &&
-        (static_cast<std::uint8_t>(key[0]) != 0xFF))
+    catch (const std::exception &e)
     {
-        // Truncate the key on line end
-        TruncateKeyOnLineEnding(key);
-
-        // Verify that the key if proper UTF-8
-        if (!Terra::CharUtil::IsUTF8Valid(
-                {reinterpret_cast<const std::uint8_t *>(key.data()),
-                 key.size()}))
-        {
-            logger->error << "Key data does not appear to be valid UTF-8"
-                          << std::flush;
-            return {};
-        }
-
-        // Ensure the key is not empty
-        if (key.empty())
-        {
-            logger->error << "The key contents appear to be empty"
-                          << std::flush;
-            return {};
-        }
-
-        return key;
+        logger->error << "Exception opening key file: " << key_file
+                      << "(err=" << e.what() << ")" << std::flush;
+        return {};
     }
-
-    // UTF-16 data should have an even number of octets
-    if ((key.length() & 0x01) != 0)
+    catch (...)
     {
-        logger->error << "Key has an odd number of octets; UTF-16 data has "
-                         "an even number of octets"
+        logger->error << "Exception opening key file: " << key_file
                       << std::flush;
         return {};
     }
 
-    // The key length must be >= 4 since the BOM occupies the first 2 octets
-    if (key.length() < 4)
+    // Open the key file, which may be a regular file or something else
+    // that can be read, such as a pipe (e.g., -k <(command) or a FIFO)
+#ifdef _WIN32
+    int fd = -1;
+    if (_wsopen_s(&fd,
+                  path.c_str(),
+                  _O_RDONLY | _O_BINARY,
+                  _SH_DENYWR,
+                  0) != 0)
     {
-        logger->error << "Key file data appears to be too short" << std::flush;
+        fd = -1;
+    }
+#else
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+#endif
+    if (fd < 0)
+    {
+        LogSystemError(logger,
+                       std::string("Failed to open input file \"") +
+                           static_cast<std::string>(key_file) + "\"");
         return {};
     }
 
-    // Inspect the first octet to determine endianness
-    little_endian = (static_cast<std::uint8_t>(key[0]) == 0xFF);
+    // Read the key, which for a regular file is a single read into a
+    // string sized to match the file
+    key = ReadKeyDescriptor(logger, key_file, fd);
 
-    // Strip off the BOM
-    key.erase(0, 2);
+    // Close the key file
+#ifdef _WIN32
+    _close(fd);
+#else
+    close(fd);
+#endif
 
-    // Convert the UTF-16 key (password) to UTF-8
-    key = PasswordConvertUTF8(key, little_endian);
+    if (key.empty()) return {};
 
-    // Truncate the key on line end
-    TruncateKeyOnLineEnding(key);
+    return ParseKey(logger, key);
+}
 
-    // Ensure the key is not empty
-    if (key.empty())
-    {
-        logger->error << "The key contents appear to be empty" << std::flush;
-        return {};
-    }
+/*
+ *  ReadKeyFileDescriptor()
+ *
+ *  Description:
+ *      This function will read a key from an open file descriptor (e.g., a
+ *      pipe or memory file provided by a parent process) and return the key
+ *      value.  As with key files, the data may be in either UTF-8 or UTF-16LE
+ *      format.
+ *
+ *  Parameters:
+ *      parent_logger [in]
+ *          Parent logging object.
+ *
+ *      fd [in]
+ *          The file descriptor from which to read the key.  The descriptor
+ *          is read until end of file, but it is not closed.
+ *
+ *  Returns:
+ *      A string containing the key or an empty string if there was an error.
+ *      The returned string will be encoded as UTF-8.
+ *
+ *  Comments:
+ *      The key never touches the file system when the descriptor refers to a
+ *      pipe or anonymous memory file.
+ */
+SecureU8String ReadKeyFileDescriptor(
+    const Terra::Logger::LoggerPointer &parent_logger,
+    int fd)
+{
+    // Create a child logger
+    Terra::Logger::LoggerPointer logger =
+        std::make_shared<Terra::Logger::Logger>(parent_logger, "KFLE");
 
-    logger->info << "Finished reading the key file" << std::flush;
+    logger->info << "Preparing to read key from descriptor " << fd
+                 << std::flush;
 
-    return key;
+    // Read the key from the file descriptor
+    SecureU8String key = ReadKeyDescriptor(
+        logger,
+        SecureString("descriptor ") + std::to_string(fd).c_str(),
+        fd);
+    if (key.empty()) return {};
+
+    return ParseKey(logger, key);
 }
@@ -51,6 +51,40 @@ bool GenerateKeyFile(const Terra::Logger::LoggerPointer &parent_logger,
                      const SecureString &key_file,
                      std::size_t key_size);
 
+/*
+ *  GenerateKeyFiles()
+ *
+ *  Description:
+ *      This function will generate a number of key files in the given
+ *      directory.
+ *
+ *  Parameters:
+ *      parent_logger [in]
+ *          Parent logging object.
+ *
+ *      key_directory [in]
+ *          The directory into which key files are written.  If it does not
+ *          exist, it will be created.
+ *
+ *      key_size [in]
+ *          The size (in octets) of the random key data to emit per file.
+ *
+ *      key_count [in]
+ *          The number of key files to generate.
+ *
+ *  Returns:
+ *      True if successful, false if unsuccessful.  Errors will be emitted
+ *      to stderr.
+ *
+ *  Comments:
+ *      Each key file is created exclusively with permissions that allow only
+ *      the owner to read or write it.
+ */
+bool GenerateKeyFiles(const Terra::Logger::LoggerPointer &parent_logger,
+                      const SecureString &key_directory,
+                      std::size_t key_size,
+                      std::size_t key_count);
+
 /*
  *  ReadKeyFile()
  *
@@ -74,3 +108,29 @@ bool GenerateKeyFile(const Terra::Logger::LoggerPointer &parent_logger,
  */
 SecureU8String ReadKeyFile(const Terra::Logger::LoggerPointer &parent_logger,
                            const SecureString &key_file);
+
+/*
+ *  ReadKeyFileDescriptor()
+ *
+ *  Description:
+ *      This function will read a key from an open file descriptor and ensure
+ *      the returned data is in UTF-8 format.  As with key files, the data may
+ *      be in either UTF-8 or UTF-16LE format.
+ *
+ *  Parameters:
+ *      parent_logger [in]
+ *          Parent logging object.
+ *
+ *      fd [in]
+ *          The file descriptor from which to read the key (e.g., a pipe or
+ *          memory file provided by a parent process).
+ *
+ *  Returns:
+ *      A string containing the key or an empty string if there was an error.
+ *
+ *  Comments:
+ *      None.
+ */
+SecureU8String ReadKeyFileDescriptor(
+    const Terra::Logger::LoggerPointer &parent_logger,
+    int fd);
@@ -0,0 +1,384 @@
+/*
+ *  mapped_sink.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file implements the MappedStreamBuf object, which writes a file
+ *      by mapping successive windows of it into memory.
+ *
+ *  Portability Issues:
+ *      Files are mapped only on Linux.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "mapped_sink.h"
+#include "error_string.h"
+
+namespace
+{
+
+// Octets mapped at once, which is a multiple of any page size
+constexpr std::size_t Mapped_Window_Size = 8'388'608;
+
+} // namespace
+
+/*
+ *  MappedStreamBuf::MappedStreamBuf()
+ *
+ *  Description:
+ *      Constructor for the MappedStreamBuf object.
+ *
+ *  Parameters:
+ *      logger [in]
+ *          The logger to which logging output will be sent.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      Open() must be called before data is written.
+ */
+MappedStreamBuf::MappedStreamBuf(const Terra::Logger::LoggerPointer &logger) :
+    logger{logger},
+    fd{-1},
+    capacity{0},
+    window_offset{0},
+    window{nullptr},
+    window_size{0},
+    failed{false}
+{
+}
+
+/*
+ *  MappedStreamBuf::~MappedStreamBuf()
+ *
+ *  Description:
+ *      Destructor for the MappedStreamBuf object, which closes the file if
+ *      it is open.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+MappedStreamBuf::~MappedStreamBuf()
+{
+    Close();
+}
+
+/*
+ *  MappedStreamBuf::Open()
+ *
+ *  Description:
+ *      Create the given file, allocate space for the given number of octets,
+ *      and map the first window of it.
+ *
+ *  Parameters:
+ *      filename [in]
+ *          The name of the file to open in UTF-8 format.
+ *
+ *      capacity [in]
+ *          The most octets that will be written to the file.
+ *
+ *  Returns:
+ *      True if the file is ready to be written, false if not, in which case
+ *      nothing has been written to the file.
+ *
+ *  Comments:
+ *      The file must be a regular file on a file system that supports
+ *      allocating space, as writing to a mapped page for which space cannot
+ *      be found would terminate the process with SIGBUS.
+ */
+bool MappedStreamBuf::Open(const SecureString &filename,
+                           std::uint64_t capacity)
+{
+#ifdef __linux__
+    if (capacity == 0) return false;
+
+    fd = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (fd < 0)
+    {
+        LogSystemError(logger, "Unable to open output file for mapping");
+        return false;
+    }
+
+    // Map only regular files
+    struct stat file_status{};
+    if ((fstat(fd, &file_status) != 0) || !S_ISREG(file_status.st_mode))
+    {
+        logger->info << "Output file is not a regular file" << std::flush;
+        close(fd);
+        fd = -1;
+        return false;
+    }
+
+    // Allocate space for all of the output before writing any of it
+    if (fallocate(fd, 0, 0, static_cast<off_t>(capacity)) != 0)
+    {
+        LogSystemError(logger, "Unable to allocate space for output file");
+        close(fd);
+        fd = -1;
+        return false;
+    }
+
+    this->capacity = capacity;
+
+    if (!MapWindow(0))
+    {
+        Close();
+        return false;
+    }
+
+    return true;
+#else
+    (void) filename;
+    (void) capacity;
+    errno = ENOTSUP;
+
+    return false;
+#endif
+}
+
+/*
+ *  MappedStreamBuf::Close()
+ *
+ *  Description:
+ *      Unmap the file, truncate it to the octets written, and close it.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      True if successful, false if writing or closing the file failed.
+ *
+ *  Comments:
+ *      None.
+ */
+bool MappedStreamBuf::Close()
+{
+#ifdef __linux__
+    if (fd < 0) return !failed;
+
+    // Determine the octets written before unmapping the window
+    const std::uint64_t written =
+        window_offset + static_cast<std::uint64_t>(pptr() - pbase());
+
+    bool result = UnmapWindow() && !failed;
+
+    if (ftruncate(fd, static_cast<off_t>(written)) != 0)
+    {
+        LogSystemError(logger, "Unable to set output file size");
+        result = false;
+    }
+
+    if (close(fd) != 0)
+    {
+        LogSystemError(logger, "Unable to close output file");
+        result = false;
+    }
+    fd = -1;
+
+    return result;
+#else
+    return !failed;
+#endif
+}
+
+/*
+ *  MappedStreamBuf::setbuf()
+ *
+ *  Description:
+ *      Ignore any buffer given, as data is written directly into the mapped
+ *      file.
+ *
+ *  Parameters:
+ *      s [in]
+ *          The buffer given (not used).
+ *
+ *      n [in]
+ *          The size of the buffer (not used).
+ *
+ *  Returns:
+ *      This stream buffer.
+ *
+ *  Comments:
+ *      None.
+ */
+std::streambuf *MappedStreamBuf::setbuf([[maybe_unused]] char_type *s,
+                                        [[maybe_unused]] std::streamsize n)
+{
+    return this;
+}
+
+/*
+ *  MappedStreamBuf::overflow()
+ *
+ *  Description:
+ *      Map the next window of the file when the current one is full.
+ *
+ *  Parameters:
+ *      c [in]
+ *          The character that did not fit in the window, or EOF.
+ *
+ *  Returns:
+ *      A value other than EOF on success, EOF on failure.
+ *
+ *  Comments:
+ *      Writing more octets than the capacity given to Open() fails.
+ */
+MappedStreamBuf::int_type MappedStreamBuf::overflow(int_type c)
+{
+    if (failed || (window == nullptr)) return traits_type::eof();
+
+    const std::uint64_t next_offset = window_offset + window_size;
+
+    if (!UnmapWindow() || !MapWindow(next_offset))
+    {
+        failed = true;
+        return traits_type::eof();
+    }
+
+    if (!traits_type::eq_int_type(c, traits_type::eof()))
+    {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+
+    return traits_type::not_eof(c);
+}
+
+/*
+ *  MappedStreamBuf::MapWindow()
+ *
+ *  Description:
+ *      Map the window of the file starting at the given offset and make it
+ *      the put area.
+ *
+ *  Parameters:
+ *      offset [in]
+ *          The offset of the window, which is a multiple of the window size.
+ *
+ *  Returns:
+ *      True if successful, false if not or if the offset is at the end of
+ *      the space allocated.
+ *
+ *  Comments:
+ *      None.
+ */
+bool MappedStreamBuf::MapWindow(std::uint64_t offset)
+{
+#ifdef __linux__
+    if (offset >= capacity)
+    {
+        logger->error << "Output exceeds the space allocated (" << capacity
+                      << " octets)" << std::flush;
+        return false;
+    }
+
+    const std::size_t size = static_cast<std::size_t>(
+        std::min<std::uint64_t>(capacity - offset, Mapped_Window_Size));
+
+    void *address = mmap(nullptr,
+                         size,
+                         PROT_READ | PROT_WRITE,
+                         MAP_SHARED,
+                         fd,
+                         static_cast<off_t>(offset));
+    if (address == MAP_FAILED)
+    {
+        LogSystemError(logger, "Unable to map output file");
+        return false;
+    }
+
+    window = static_cast<char *>(address);
+    window_offset = offset;
+    window_size = size;
+    setp(window, window + window_size);
+
+    return true;
+#else
+    (void) offset;
+
+    return false;
+#endif
+}
+
+/*
+ *  MappedStreamBuf::UnmapWindow()
+ *
+ *  Description:
+ *      Unmap the current window after starting writeback of the data written
+ *      to it, and release the cached pages of the window before it.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      True if successful, false if not.
+ *
+ *  Comments:
+ *      On Linux, msync(MS_ASYNC) does not start writeback, so
+ *      sync_file_range() is used instead.  Waiting for the previous
+ *      window's writeback limits dirty pages to about two windows, and since
+ *      unmapping (or MADV_DONTNEED) leaves the pages of a shared mapping in
+ *      the page cache, posix_fadvise() is used to release them.
+ */
+bool MappedStreamBuf::UnmapWindow()
+{
+#ifdef __linux__
+    if (window == nullptr) return true;
+
+    const std::size_t written = static_cast<std::size_t>(pptr() - pbase());
+    bool result = true;
+
+    if (munmap(window, window_size) != 0)
+    {
+        LogSystemError(logger, "Unable to unmap output file");
+        result = false;
+    }
+    window = nullptr;
+    setp(nullptr, nullptr);
+
+    // Start writing this window and wait for the previous one to be written
+    sync_file_range(fd,
+                    static_cast<off_t>(window_offset),
+                    static_cast<off_t>(written),
+                    SYNC_FILE_RANGE_WRITE);
+    if (window_offset >= Mapped_Window_Size)
+    {
+        const off_t previous =
+            static_cast<off_t>(window_offset - Mapped_Window_Size);
+        sync_file_range(fd,
+                        previous,
+                        Mapped_Window_Size,
+                        SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE |
+                            SYNC_FILE_RANGE_WAIT_AFTER);
+        posix_fadvise(fd, previous, Mapped_Window_Size, POSIX_FADV_DONTNEED);
+    }
+
+    // Account for the octets written in the window
+    window_offset += written;
+    window_size = 0;
+
+    return result;
+#else
+    return true;
+#endif
+}
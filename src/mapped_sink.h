@@ -0,0 +1,82 @@
+/*
+ *  mapped_sink.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file defines the MappedSink object, a Sink that writes a file by
+ *      mapping successive windows of it into memory.  The stream buffer's
+ *      put area is the mapped window itself, so data written (e.g., by the
+ *      AES Crypt Engine) is copied once, directly into the file's pages,
+ *      rather than into a buffer and then into the page cache.
+ *
+ *      The caller gives the most octets that will be written, which are
+ *      allocated when the file is opened so that running out of space is
+ *      detected then rather than when a page is written.  The file is
+ *      truncated to the octets actually written when closed.
+ *
+ *  Portability Issues:
+ *      Files are mapped only on Linux, where fallocate() and
+ *      sync_file_range() are available.  Elsewhere, Open() fails and the
+ *      caller should write the file using streams.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <streambuf>
+#include <terra/logger/logger.h>
+#include "io_backend.h"
+#include "secure_containers.h"
+
+// Stream buffer that writes directly into windows of a mapped file
+class MappedStreamBuf : public std::streambuf
+{
+    public:
+        MappedStreamBuf(const Terra::Logger::LoggerPointer &logger);
+        ~MappedStreamBuf();
+
+        bool Open(const SecureString &filename, std::uint64_t capacity);
+        bool Close();
+
+    protected:
+        std::streambuf *setbuf(char_type *s, std::streamsize n) override;
+        int_type overflow(int_type c) override;
+        bool MapWindow(std::uint64_t offset);
+        bool UnmapWindow();
+
+        Terra::Logger::LoggerPointer logger;
+        int fd;
+        std::uint64_t capacity;                 // Octets allocated
+        std::uint64_t window_offset;            // File offset of the window
+        char *window;                           // Mapped window
+        std::size_t window_size;                // Octets in the window
+        bool failed;                            // True if a write failed
+};
+
+// A file opened for writing by mapping it into memory
+class MappedSink : public Sink
+{
+    public:
+        MappedSink(const Terra::Logger::LoggerPointer &logger) :
+            mapped_buffer(logger)
+        {
+        }
+        ~MappedSink() = default;
+
+        bool Open(const SecureString &filename, std::uint64_t capacity)
+        {
+            return mapped_buffer.Open(filename, capacity);
+        }
+        std::streambuf *Buffer() override { return &mapped_buffer; }
+        bool Close() override { return mapped_buffer.Close(); }
+
+    protected:
+        MappedStreamBuf mapped_buffer;
+};
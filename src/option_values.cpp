@@ -0,0 +1,331 @@
+/*
+ *  option_values.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file implements functions to parse program option values that
+ *      are not simple integers, such as sizes having a unit suffix.
+ *
+ *  Portability Issues:
+ *      The local time is determined using localtime_s() on Windows and
+ *      localtime_r() elsewhere.
+ */
+
+#include <charconv>
+#include <cctype>
+#include <ctime>
+#include <limits>
+#include "option_values.h"
+
+namespace
+{
+
+/*
+ *  LowerCase()
+ *
+ *  Description:
+ *      Return the given ASCII string converted to lower case.
+ *
+ *  Parameters:
+ *      value [in]
+ *          The string to convert.
+ *
+ *  Returns:
+ *      The lower case string.
+ *
+ *  Comments:
+ *      None.
+ */
+std::string LowerCase(std::string value)
+{
+    for (auto &c : value)
+    {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+
+    return value;
+}
+
+} // namespace
+
+/*
+ *  ParseSize()
+ *
+ *  Description:
+ *      Parse a size given as an integer with an optional binary unit suffix
+ *      (K, M, G, or T, optionally followed by "iB" or "B"), such as "512M"
+ *      or "2GiB".  The suffix is not case sensitive.
+ *
+ *  Parameters:
+ *      value [in]
+ *          The string to parse.
+ *
+ *  Returns:
+ *      The size in octets, or no value if the string is not a valid size.
+ *
+ *  Comments:
+ *      Units are powers of 1024.
+ */
+std::optional<std::uint64_t> ParseSize(const std::string &value)
+{
+    std::uint64_t size{};
+    std::uint64_t multiplier = 1;
+
+    // Parse the numeric portion of the string
+    auto [end, error] =
+        std::from_chars(value.data(), value.data() + value.size(), size);
+    if ((error != std::errc()) || (end == value.data())) return {};
+
+    // Determine the multiplier from the unit suffix
+    const std::string suffix =
+        LowerCase(std::string(end, value.data() + value.size()));
+    if (!suffix.empty())
+    {
+        switch (suffix[0])
+        {
+            case 'k':
+                multiplier = 1ULL << 10;
+                break;
+
+            case 'm':
+                multiplier = 1ULL << 20;
+                break;
+
+            case 'g':
+                multiplier = 1ULL << 30;
+                break;
+
+            case 't':
+                multiplier = 1ULL << 40;
+                break;
+
+            case 'b':
+                break;
+
+            default:
+                return {};
+        }
+
+        // Only "B", "<unit>", "<unit>B", and "<unit>iB" are accepted
+        const std::string unit = suffix.substr(1);
+        if ((suffix[0] == 'b') ? !unit.empty()
+                               : (!unit.empty() && (unit != "b") &&
+                                  (unit != "ib")))
+        {
+            return {};
+        }
+    }
+
+    // Guard against overflow
+    if (size > std::numeric_limits<std::uint64_t>::max() / multiplier)
+    {
+        return {};
+    }
+
+    return size * multiplier;
+}
+
+/*
+ *  ParseBandwidthLimit()
+ *
+ *  Description:
+ *      Parse a bandwidth limit given as "READ[:WRITE]", where each rate is a
+ *      size (see ParseSize()) in octets per second.  If the write rate is
+ *      not given, it is the same as the read rate.
+ *
+ *  Parameters:
+ *      value [in]
+ *          The string to parse.
+ *
+ *  Returns:
+ *      The read and write rates in octets per second, or no value if the
+ *      string is not valid.  A rate of zero means the rate is unlimited.
+ *
+ *  Comments:
+ *      Leading and trailing whitespace is ignored so that limits may be read
+ *      from a file.
+ */
+std::optional<std::pair<std::uint64_t, std::uint64_t>> ParseBandwidthLimit(
+    const std::string &value)
+{
+    // Remove leading and trailing whitespace
+    const auto first = value.find_first_not_of(" \t\r\n");
+    if (first == std::string::npos) return {};
+    const auto last = value.find_last_not_of(" \t\r\n");
+    const std::string limit = value.substr(first, last - first + 1);
+
+    // Split the read and write rates
+    const auto separator = limit.find(':');
+    auto read_rate = ParseSize(limit.substr(0, separator));
+    if (!read_rate) return {};
+    if (separator == std::string::npos) return {{*read_rate, *read_rate}};
+
+    auto write_rate = ParseSize(limit.substr(separator + 1));
+    if (!write_rate) return {};
+
+    return {{*read_rate, *write_rate}};
+}
+
+/*
+ *  ParseSmallFiles()
+ *
+ *  Description:
+ *      Parse a small file specification given as "SIZE[:JOBS]", where SIZE
+ *      is a size (see ParseSize()) below which a file is considered small
+ *      and JOBS is the number of jobs reserved for small files.
+ *
+ *  Parameters:
+ *      value [in]
+ *          The string to parse.
+ *
+ *  Returns:
+ *      The small file size and number of reserved jobs, or no value if the
+ *      string is not valid.  If the number of jobs is not given, it is zero.
+ *
+ *  Comments:
+ *      None.
+ */
+std::optional<std::pair<std::uint64_t, std::size_t>> ParseSmallFiles(
+    const std::string &value)
+{
+    std::size_t jobs{};
+
+    // Split the size and the number of jobs
+    const auto separator = value.find(':');
+    auto size = ParseSize(value.substr(0, separator));
+    if (!size || (*size == 0)) return {};
+    if (separator == std::string::npos) return {{*size, jobs}};
+
+    const std::string jobs_value = value.substr(separator + 1);
+    const char *jobs_end = jobs_value.data() + jobs_value.size();
+    auto [end, error] = std::from_chars(jobs_value.data(), jobs_end, jobs);
+    if ((error != std::errc()) || (end != jobs_end) || (jobs == 0)) return {};
+
+    return {{*size, jobs}};
+}
+
+/*
+ *  ParseDeadline()
+ *
+ *  Description:
+ *      Parse a deadline given either as a local time of day "HH:MM[:SS]"
+ *      or as a duration from now, being a number of seconds or one or more
+ *      numbers each followed by "h", "m", or "s" (e.g., "90m" or "1h30m").
+ *
+ *  Parameters:
+ *      value [in]
+ *          The string to parse.
+ *
+ *  Returns:
+ *      The time remaining until the deadline, or no value if the string is
+ *      not valid.
+ *
+ *  Comments:
+ *      A time of day that has already passed today refers to tomorrow.
+ */
+std::optional<std::chrono::seconds> ParseDeadline(const std::string &value)
+{
+    const char *position = value.data();
+    const char *const end = value.data() + value.size();
+
+    if (value.empty()) return {};
+
+    // A time of day contains a colon
+    if (value.find(':') != std::string::npos)
+    {
+        int fields[3]{};
+        std::size_t count{};
+
+        while ((position < end) && (count < 3))
+        {
+            auto [next, error] = std::from_chars(position, end, fields[count]);
+            if ((error != std::errc()) || (next == position)) return {};
+            count++;
+            position = next;
+            if (position == end) break;
+            if (*position++ != ':') return {};
+        }
+        if ((position != end) || (count < 2) || (fields[0] < 0) ||
+            (fields[0] > 23) || (fields[1] < 0) || (fields[1] > 59) ||
+            (fields[2] < 0) || (fields[2] > 59))
+        {
+            return {};
+        }
+
+        // Form the given time of day today in local time
+        const std::time_t now = std::time(nullptr);
+        std::tm target{};
+#ifdef _WIN32
+        if (localtime_s(&target, &now) != 0) return {};
+#else
+        if (localtime_r(&now, &target) == nullptr) return {};
+#endif
+        target.tm_hour = fields[0];
+        target.tm_min = fields[1];
+        target.tm_sec = fields[2];
+        target.tm_isdst = -1;
+        std::time_t deadline = std::mktime(&target);
+        if (deadline == static_cast<std::time_t>(-1)) return {};
+
+        // If the time has passed, the deadline is tomorrow
+        if (deadline <= now)
+        {
+            target.tm_mday++;
+            target.tm_isdst = -1;
+            deadline = std::mktime(&target);
+            if (deadline == static_cast<std::time_t>(-1)) return {};
+        }
+
+        return std::chrono::seconds(
+            static_cast<std::int64_t>(std::difftime(deadline, now)));
+    }
+
+    // Otherwise, the value is a duration
+    std::uint64_t total{};
+    while (position < end)
+    {
+        std::uint64_t number{};
+        auto [next, error] = std::from_chars(position, end, number);
+        if ((error != std::errc()) || (next == position)) return {};
+        position = next;
+
+        // A number without a unit is seconds and must end the value
+        std::uint64_t multiplier = 1;
+        if (position < end)
+        {
+            switch (std::tolower(static_cast<unsigned char>(*position++)))
+            {
+                case 'h':
+                    multiplier = 3600;
+                    break;
+
+                case 'm':
+                    multiplier = 60;
+                    break;
+
+                case 's':
+                    break;
+
+                default:
+                    return {};
+            }
+        }
+
+        // Guard against overflow
+        constexpr auto maximum = static_cast<std::uint64_t>(
+            std::numeric_limits<std::int64_t>::max());
+        if (number > (maximum - total) / multiplier)
+        {
+            return {};
+        }
+        total += number * multiplier;
+    }
+
+    return std::chrono::seconds(static_cast<std::int64_t>(total));
+}
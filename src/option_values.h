@@ -0,0 +1,112 @@
+/*
+ *  option_values.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file defines functions to parse program option values that are
+ *      not simple integers, such as sizes having a unit suffix.
+ *
+ *  Portability Issues:
+ *      None.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <chrono>
+#include <optional>
+#include <string>
+#include <utility>
+
+/*
+ *  ParseSize()
+ *
+ *  Description:
+ *      Parse a size given as an integer with an optional binary unit suffix
+ *      (K, M, G, or T, optionally followed by "iB" or "B"), such as "512M"
+ *      or "2GiB".  The suffix is not case sensitive.
+ *
+ *  Parameters:
+ *      value [in]
+ *          The string to parse.
+ *
+ *  Returns:
+ *      The size in octets, or no value if the string is not a valid size.
+ *
+ *  Comments:
+ *      Units are powers of 1024.
+ */
+std::optional<std::uint64_t> ParseSize(const std::string &value);
+
+/*
+ *  ParseBandwidthLimit()
+ *
+ *  Description:
+ *      Parse a bandwidth limit given as "READ[:WRITE]", where each rate is a
+ *      size (see ParseSize()) in octets per second.  If the write rate is
+ *      not given, it is the same as the read rate.
+ *
+ *  Parameters:
+ *      value [in]
+ *          The string to parse.
+ *
+ *  Returns:
+ *      The read and write rates in octets per second, or no value if the
+ *      string is not valid.  A rate of zero means the rate is unlimited.
+ *
+ *  Comments:
+ *      Leading and trailing whitespace is ignored so that limits may be read
+ *      from a file.
+ */
+std::optional<std::pair<std::uint64_t, std::uint64_t>> ParseBandwidthLimit(
+    const std::string &value);
+
+/*
+ *  ParseSmallFiles()
+ *
+ *  Description:
+ *      Parse a small file specification given as "SIZE[:JOBS]", where SIZE
+ *      is a size (see ParseSize()) below which a file is considered small
+ *      and JOBS is the number of jobs reserved for small files.
+ *
+ *  Parameters:
+ *      value [in]
+ *          The string to parse.
+ *
+ *  Returns:
+ *      The small file size and number of reserved jobs, or no value if the
+ *      string is not valid.  If the number of jobs is not given, it is zero.
+ *
+ *  Comments:
+ *      None.
+ */
+std::optional<std::pair<std::uint64_t, std::size_t>> ParseSmallFiles(
+    const std::string &value);
+
+/*
+ *  ParseDeadline()
+ *
+ *  Description:
+ *      Parse a deadline given either as a local time of day "HH:MM[:SS]"
+ *      or as a duration from now, being a number of seconds or one or more
+ *      numbers each followed by "h", "m", or "s" (e.g., "90m" or "1h30m").
+ *
+ *  Parameters:
+ *      value [in]
+ *          The string to parse.
+ *
+ *  Returns:
+ *      The time remaining until the deadline, or no value if the string is
+ *      not valid.
+ *
+ *  Comments:
+ *      A time of day that has already passed today refers to tomorrow.
+ */
+std::optional<std::chrono::seconds> ParseDeadline(const std::string &value);
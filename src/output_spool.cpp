@@ -0,0 +1,580 @@
+/*
+ *  output_spool.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file implements the OutputSpool object, which holds decrypted
+ *      output until it is released to stdout.
+ *
+ *  Portability Issues:
+ *      On Linux, output is held in a memfd and released using splice() or
+ *      sendfile().  Elsewhere, output is held in a temporary file created
+ *      with std::tmpfile() and copied to stdout.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#ifdef __linux__
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <unistd.h>
+#endif
+#include "output_spool.h"
+#include "error_string.h"
+
+namespace
+{
+
+// Size of the buffer used if the caller does not give one
+constexpr std::size_t Spool_Buffer_Size = 131'072;
+
+// Most octets released to stdout at once, so termination is observed
+constexpr std::size_t Release_Size = 1'048'576;
+
+#ifdef __linux__
+
+/*
+ *  OpenTemporaryFile()
+ *
+ *  Description:
+ *      Create an unlinked temporary file in the system's temporary directory
+ *      (e.g., as given by TMPDIR).
+ *
+ *  Parameters:
+ *      logger [in]
+ *          The logger to which logging output will be sent.
+ *
+ *  Returns:
+ *      The file descriptor of the file, or -1 if it could not be created,
+ *      in which case errno indicates the reason.
+ *
+ *  Comments:
+ *      O_TMPFILE creates a file without a name; if the file system does not
+ *      support it, a named file is created and immediately removed.
+ */
+int OpenTemporaryFile(const Terra::Logger::LoggerPointer &logger)
+{
+    std::string directory = "/tmp";
+
+    try
+    {
+        directory = std::filesystem::temp_directory_path().string();
+    }
+    catch (const std::filesystem::filesystem_error &e)
+    {
+        logger->warning << "Unable to determine the temporary directory "
+                           "(file system err="
+                        << e.what() << ")" << std::flush;
+    }
+    catch (const std::exception &e)
+    {
+        logger->warning << "Unable to determine the temporary directory "
+                           "(err="
+                        << e.what() << ")" << std::flush;
+    }
+    catch (...)
+    {
+        logger->warning << "Unable to determine the temporary directory"
+                        << std::flush;
+    }
+
+    int fd = open(directory.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+    if (fd >= 0) return fd;
+
+    std::string name = directory + "/aescrypt-spool-XXXXXX";
+    fd = mkostemp(name.data(), O_CLOEXEC);
+    if (fd < 0) return -1;
+    unlink(name.c_str());
+
+    return fd;
+}
+
+/*
+ *  WaitForStdout()
+ *
+ *  Description:
+ *      Wait briefly for stdout to accept more data, which is necessary if
+ *      stdout is non-blocking.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      The wait is bounded so that termination requests are observed.
+ */
+void WaitForStdout()
+{
+    pollfd descriptor{STDOUT_FILENO, POLLOUT, 0};
+
+    poll(&descriptor, 1, 100);
+}
+
+#endif
+
+} // namespace
+
+/*
+ *  OutputSpool::OutputSpool()
+ *
+ *  Description:
+ *      Constructor for the OutputSpool object.
+ *
+ *  Parameters:
+ *      parent_logger [in]
+ *          The parent logger to which logging output will be sent.
+ *
+ *      memory_limit [in]
+ *          The number of octets that may be held in memory before output is
+ *          moved to a temporary file.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      Open() must be called before output is written.  A buffer given via
+ *      pubsetbuf() is used in place of this object's own.
+ */
+OutputSpool::OutputSpool(const Terra::Logger::LoggerPointer &parent_logger,
+                         std::uint64_t memory_limit) :
+    logger{std::make_shared<Terra::Logger::Logger>(parent_logger, "SPOL")},
+    memory_limit{memory_limit},
+    size{0},
+#ifdef __linux__
+    fd{-1},
+    in_memory{false}
+#else
+    file{nullptr}
+#endif
+{
+    setbuf(nullptr, 0);
+}
+
+/*
+ *  OutputSpool::~OutputSpool()
+ *
+ *  Description:
+ *      Destructor for the OutputSpool object, which discards any output that
+ *      was not released.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+OutputSpool::~OutputSpool()
+{
+#ifdef __linux__
+    if (fd >= 0) close(fd);
+#else
+    if (file != nullptr) std::fclose(file);
+#endif
+}
+
+/*
+ *  OutputSpool::Open()
+ *
+ *  Description:
+ *      Create the memory or file in which output is held.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      True if successful, false if not, in which case errno indicates the
+ *      reason.
+ *
+ *  Comments:
+ *      If a memfd cannot be created, output is held in a temporary file.
+ */
+bool OutputSpool::Open()
+{
+#ifdef __linux__
+    if (memory_limit > 0)
+    {
+        fd = memfd_create("aescrypt-spool", MFD_CLOEXEC);
+        if (fd >= 0)
+        {
+            in_memory = true;
+            return true;
+        }
+
+        LogSystemError(logger, "Unable to create memfd for output");
+    }
+
+    fd = OpenTemporaryFile(logger);
+
+    return fd >= 0;
+#else
+    file = std::tmpfile();
+
+    return file != nullptr;
+#endif
+}
+
+/*
+ *  OutputSpool::Release()
+ *
+ *  Description:
+ *      Write all of the output held to stdout.
+ *
+ *  Parameters:
+ *      process_control [in]
+ *          Used to stop releasing output if termination is requested.
+ *
+ *  Returns:
+ *      True if all of the output was written to stdout, false if not.
+ *
+ *  Comments:
+ *      This must be called only once decryption succeeds.
+ */
+bool OutputSpool::Release(ProcessControl &process_control)
+{
+    if (!FlushBuffer()) return false;
+
+    // Ensure anything already written to std::cout precedes the output
+    std::cout.flush();
+
+    logger->info << "Releasing " << size << " octets to stdout" << std::flush;
+
+#ifdef __linux__
+    bool use_splice = true;
+    bool use_sendfile = true;
+    std::uint64_t position{};
+
+    while (position < size)
+    {
+        if (process_control.Terminating()) return false;
+
+        const std::size_t length = static_cast<std::size_t>(
+            std::min<std::uint64_t>(size - position, Release_Size));
+        ssize_t octets{};
+
+        if (use_splice)
+        {
+            // Moves pages from the spool into a pipe without copying them
+            loff_t offset = static_cast<loff_t>(position);
+            octets = splice(fd,
+                            &offset,
+                            STDOUT_FILENO,
+                            nullptr,
+                            length,
+                            SPLICE_F_MORE);
+            if ((octets < 0) && (errno == EINVAL))
+            {
+                use_splice = false;
+                continue;
+            }
+        }
+        else if (use_sendfile)
+        {
+            off_t offset = static_cast<off_t>(position);
+            octets = sendfile(STDOUT_FILENO, fd, &offset, length);
+            if ((octets < 0) && ((errno == EINVAL) || (errno == ENOSYS)))
+            {
+                use_sendfile = false;
+                continue;
+            }
+        }
+        else
+        {
+            octets = pread(fd,
+                           buffer.data(),
+                           std::min(length, buffer.size()),
+                           static_cast<off_t>(position));
+            if (octets > 0)
+            {
+                std::cout.write(buffer.data(),
+                                static_cast<std::streamsize>(octets));
+                std::cout.flush();
+                if (!std::cout.good()) return false;
+            }
+        }
+
+        if (octets < 0)
+        {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN)
+            {
+                WaitForStdout();
+                continue;
+            }
+
+            LogSystemError(logger, "Unable to release output to stdout");
+            return false;
+        }
+
+        // The spool should never end early
+        if (octets == 0) return false;
+
+        position += static_cast<std::uint64_t>(octets);
+    }
+#else
+    std::rewind(file);
+
+    std::uint64_t position{};
+    while (position < size)
+    {
+        if (process_control.Terminating()) return false;
+
+        const std::size_t length = std::min(
+            static_cast<std::size_t>(std::min<std::uint64_t>(size - position,
+                                                             Release_Size)),
+            buffer.size());
+        const std::size_t octets =
+            std::fread(buffer.data(), 1, length, file);
+        if (octets == 0) return false;
+
+        std::cout.write(buffer.data(), static_cast<std::streamsize>(octets));
+        if (!std::cout.good()) return false;
+
+        position += octets;
+    }
+
+    std::cout.flush();
+    if (!std::cout.good()) return false;
+#endif
+
+    return true;
+}
+
+/*
+ *  OutputSpool::setbuf()
+ *
+ *  Description:
+ *      Use the given buffer, or this object's own buffer if none is given.
+ *
+ *  Parameters:
+ *      s [in]
+ *          The buffer to use, or nullptr.
+ *
+ *      n [in]
+ *          The size of the buffer.
+ *
+ *  Returns:
+ *      This stream buffer.
+ *
+ *  Comments:
+ *      This must be called before any data is written.
+ */
+std::streambuf *OutputSpool::setbuf(char_type *s, std::streamsize n)
+{
+    if ((s != nullptr) && (n > 0))
+    {
+        buffer = std::span<char>(s, static_cast<std::size_t>(n));
+    }
+    else
+    {
+        own_buffer.resize(Spool_Buffer_Size);
+        buffer = own_buffer;
+    }
+
+    setp(buffer.data(), buffer.data() + buffer.size());
+
+    return this;
+}
+
+/*
+ *  OutputSpool::overflow()
+ *
+ *  Description:
+ *      Move the buffered data into the spool when the buffer is full.
+ *
+ *  Parameters:
+ *      c [in]
+ *          The character that did not fit in the buffer, or EOF.
+ *
+ *  Returns:
+ *      A value other than EOF on success, EOF on failure.
+ *
+ *  Comments:
+ *      None.
+ */
+OutputSpool::int_type OutputSpool::overflow(int_type c)
+{
+    if (!FlushBuffer()) return traits_type::eof();
+
+    if (!traits_type::eq_int_type(c, traits_type::eof()))
+    {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+
+    return traits_type::not_eof(c);
+}
+
+/*
+ *  OutputSpool::sync()
+ *
+ *  Description:
+ *      Move any buffered data into the spool.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Zero on success, -1 on failure.
+ *
+ *  Comments:
+ *      Nothing is written to stdout until Release() is called.
+ */
+int OutputSpool::sync()
+{
+    return FlushBuffer() ? 0 : -1;
+}
+
+/*
+ *  OutputSpool::FlushBuffer()
+ *
+ *  Description:
+ *      Move the buffered data into the spool.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      True if successful, false if not.
+ *
+ *  Comments:
+ *      None.
+ */
+bool OutputSpool::FlushBuffer()
+{
+    const bool result =
+        Append(pbase(), static_cast<std::size_t>(pptr() - pbase()));
+
+    setp(buffer.data(), buffer.data() + buffer.size());
+
+    return result;
+}
+
+/*
+ *  OutputSpool::Append()
+ *
+ *  Description:
+ *      Append the given data to the spool, first moving the spool to a
+ *      temporary file if it would exceed the memory limit.
+ *
+ *  Parameters:
+ *      data [in]
+ *          The data to append.
+ *
+ *      length [in]
+ *          The number of octets to append.
+ *
+ *  Returns:
+ *      True if successful, false if not.
+ *
+ *  Comments:
+ *      None.
+ */
+bool OutputSpool::Append(const char *data, std::size_t length)
+{
+    if (length == 0) return true;
+
+#ifdef __linux__
+    if (fd < 0) return false;
+
+    if (in_memory && (size + length > memory_limit) && !Spill()) return false;
+
+    while (length > 0)
+    {
+        const ssize_t octets = write(fd, data, length);
+        if (octets < 0)
+        {
+            if (errno == EINTR) continue;
+
+            LogSystemError(logger, "Unable to write to output spool");
+            return false;
+        }
+
+        data += octets;
+        length -= static_cast<std::size_t>(octets);
+        size += static_cast<std::uint64_t>(octets);
+    }
+#else
+    if (file == nullptr) return false;
+
+    if (std::fwrite(data, 1, length, file) != length)
+    {
+        LogSystemError(logger, "Unable to write to output spool");
+        return false;
+    }
+    size += length;
+#endif
+
+    return true;
+}
+
+/*
+ *  OutputSpool::Spill()
+ *
+ *  Description:
+ *      Move the output held in memory to a temporary file, to which further
+ *      output is then written.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      True if successful, false if not.
+ *
+ *  Comments:
+ *      On platforms other than Linux, output is always held in a file.
+ */
+bool OutputSpool::Spill()
+{
+#ifdef __linux__
+    logger->info << "Moving " << size << " octets of output to a temporary "
+                 << "file" << std::flush;
+
+    const int file_fd = OpenTemporaryFile(logger);
+    if (file_fd < 0)
+    {
+        LogSystemError(logger, "Unable to create temporary file for output");
+        return false;
+    }
+
+    // Copy the memfd's pages to the file within the kernel
+    off_t offset{};
+    while (static_cast<std::uint64_t>(offset) < size)
+    {
+        const ssize_t octets = sendfile(
+            file_fd,
+            fd,
+            &offset,
+            static_cast<std::size_t>(
+                size - static_cast<std::uint64_t>(offset)));
+        if ((octets < 0) && (errno == EINTR)) continue;
+        if (octets <= 0)
+        {
+            LogSystemError(logger, "Unable to move output to temporary file");
+            close(file_fd);
+            return false;
+        }
+    }
+
+    close(fd);
+    fd = file_fd;
+    in_memory = false;
+#endif
+
+    return true;
+}
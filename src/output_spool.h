@@ -0,0 +1,70 @@
+/*
+ *  output_spool.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file defines the OutputSpool object, a stream buffer that holds
+ *      decrypted output until the stream's HMAC is verified, after which the
+ *      output is released to stdout.  This ensures a downstream consumer
+ *      reading from stdout never receives plaintext from a stream that was
+ *      altered.  Output is held in memory up to a limit, beyond which it is
+ *      moved to an unlinked temporary file.
+ *
+ *  Portability Issues:
+ *      On Linux, output is held in a memfd and released using splice()
+ *      (or sendfile() if stdout is not a pipe), so releasing output does not
+ *      copy it again.  Elsewhere, output is held in a temporary file created
+ *      with std::tmpfile() and copied to stdout.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <span>
+#include <streambuf>
+#include <vector>
+#include <terra/logger/logger.h>
+#include "process_control.h"
+
+// Default octets held in memory before output is moved to a temporary file
+constexpr std::uint64_t Default_Spool_Memory = 268'435'456;
+
+// Stream buffer that holds output until it is released to stdout
+class OutputSpool : public std::streambuf
+{
+    public:
+        OutputSpool(const Terra::Logger::LoggerPointer &parent_logger,
+                    std::uint64_t memory_limit);
+        ~OutputSpool();
+
+        bool Open();
+        bool Release(ProcessControl &process_control);
+
+    protected:
+        std::streambuf *setbuf(char_type *s, std::streamsize n) override;
+        int_type overflow(int_type c) override;
+        int sync() override;
+        bool FlushBuffer();
+        bool Append(const char *data, std::size_t length);
+        bool Spill();
+
+        Terra::Logger::LoggerPointer logger;
+        std::uint64_t memory_limit;
+        std::vector<char> own_buffer;           // Used if none is given
+        std::span<char> buffer;
+        std::uint64_t size;                     // Octets held
+#ifdef __linux__
+        int fd;                                 // Descriptor holding output
+        bool in_memory;                         // True if fd is a memfd
+#else
+        std::FILE *file;                        // Temporary file
+#endif
+};
@@ -17,8 +17,8 @@
  */
 
 #include <cstdint>
-#include <terra/charutil/character_utilities.h>
 #include "password_convert.h"
+#include "unicode_fast_path.h"
 
 /*
  *  PasswordConvertUTF8()
@@ -54,7 +54,7 @@ SecureU8String PasswordConvertUTF8(std::span<const char8_t> password,
     SecureU8String u8password(password.size() + (password.size() >> 1), '\0');
 
     // Convert the character string to UTF-8
-    auto [conversion_result, length] = Terra::CharUtil::ConvertUTF16ToUTF8(
+    auto [conversion_result, length] = ConvertUTF16ToUTF8Fast(
         std::span<const std::uint8_t>(
             reinterpret_cast<const std::uint8_t *>(password.data()),
             password.size()),
@@ -0,0 +1,323 @@
+/*
+ *  process_control.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file implements the ProcessControl object, which is used to
+ *      gracefully control the termination of the process when the user
+ *      requests it (e.g., CTRL-C).
+ *
+ *  Portability Issues:
+ *      On Windows, an event object is used in place of the self-pipe.
+ */
+
+#include <cerrno>
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include "process_control.h"
+
+// Requesting termination from a signal handler requires lock-free atomics
+static_assert(std::atomic<bool>::is_always_lock_free);
+
+namespace
+{
+
+// Interval at which termination is polled if the wake-up cannot be created
+constexpr std::chrono::milliseconds Poll_Interval{50};
+
+} // namespace
+
+/*
+ *  ProcessControl::ProcessControl()
+ *
+ *  Description:
+ *      Constructor for the ProcessControl object, which creates the
+ *      self-pipe and starts the thread that watches it.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      If the self-pipe cannot be created, the watcher thread polls for
+ *      termination instead.
+ */
+ProcessControl::ProcessControl() :
+    terminate{false},
+    shutdown{false},
+    next_handle{0},
+#ifdef _WIN32
+    wake_event{nullptr}
+#else
+    wake_pipe{-1, -1}
+#endif
+{
+#ifdef _WIN32
+    wake_event = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+#else
+    if (pipe(wake_pipe) == 0)
+    {
+        // Writing must never block the signal handler
+        fcntl(wake_pipe[1],
+              F_SETFL,
+              fcntl(wake_pipe[1], F_GETFL) | O_NONBLOCK);
+        fcntl(wake_pipe[0], F_SETFD, FD_CLOEXEC);
+        fcntl(wake_pipe[1], F_SETFD, FD_CLOEXEC);
+    }
+    else
+    {
+        wake_pipe[0] = wake_pipe[1] = -1;
+    }
+#endif
+
+    watcher = std::thread(&ProcessControl::Watch, this);
+}
+
+/*
+ *  ProcessControl::~ProcessControl()
+ *
+ *  Description:
+ *      Destructor for the ProcessControl object, which stops the watcher
+ *      thread and closes the self-pipe.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+ProcessControl::~ProcessControl()
+{
+    shutdown = true;
+
+#ifdef _WIN32
+    if (wake_event != nullptr) SetEvent(wake_event);
+#else
+    if (wake_pipe[1] >= 0)
+    {
+        [[maybe_unused]] auto written = write(wake_pipe[1], "", 1);
+    }
+#endif
+
+    if (watcher.joinable()) watcher.join();
+
+#ifdef _WIN32
+    if (wake_event != nullptr) CloseHandle(wake_event);
+#else
+    if (wake_pipe[0] >= 0) close(wake_pipe[0]);
+    if (wake_pipe[1] >= 0) close(wake_pipe[1]);
+#endif
+}
+
+/*
+ *  ProcessControl::RequestTermination()
+ *
+ *  Description:
+ *      Request that the process terminate, which cancels any operation in
+ *      progress and ends any wait.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      This function is async-signal-safe: it only stores to a lock-free
+ *      atomic and writes to the self-pipe, leaving the watcher thread to
+ *      call the cancel handlers and wake waiting threads.
+ */
+void ProcessControl::RequestTermination() noexcept
+{
+    terminate.store(true, std::memory_order_release);
+
+#ifdef _WIN32
+    if (wake_event != nullptr) SetEvent(wake_event);
+#else
+    if (wake_pipe[1] >= 0)
+    {
+        const int saved_errno = errno;
+        [[maybe_unused]] auto written = write(wake_pipe[1], "", 1);
+        errno = saved_errno;
+    }
+#endif
+}
+
+/*
+ *  ProcessControl::AddCancelHandler()
+ *
+ *  Description:
+ *      Register a function to be called if termination is requested, such
+ *      as one that cancels encryption in progress.
+ *
+ *  Parameters:
+ *      handler [in]
+ *          The function to call, which must return promptly.
+ *
+ *  Returns:
+ *      A handle used to remove the handler.
+ *
+ *  Comments:
+ *      If termination has already been requested, the handler is called
+ *      before this function returns.
+ */
+std::size_t ProcessControl::AddCancelHandler(const CancelHandler &handler)
+{
+    std::lock_guard<std::mutex> lock(handler_mutex);
+
+    const std::size_t handle = next_handle++;
+    handlers.emplace(handle, handler);
+
+    if (Terminating()) handler();
+
+    return handle;
+}
+
+/*
+ *  ProcessControl::RemoveCancelHandler()
+ *
+ *  Description:
+ *      Remove a function registered to be called if termination is
+ *      requested.
+ *
+ *  Parameters:
+ *      handle [in]
+ *          The handle returned when the handler was added.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      Once this returns, the handler is not running and will not be
+ *      called, so the object it refers to may be destroyed.
+ */
+void ProcessControl::RemoveCancelHandler(std::size_t handle)
+{
+    std::lock_guard<std::mutex> lock(handler_mutex);
+
+    handlers.erase(handle);
+}
+
+/*
+ *  ProcessControl::WaitFor()
+ *
+ *  Description:
+ *      Wait for the given period of time to pass or for termination to be
+ *      requested.
+ *
+ *  Parameters:
+ *      duration [in]
+ *          The period of time to wait.
+ *
+ *  Returns:
+ *      True if termination was requested, false if the time passed.
+ *
+ *  Comments:
+ *      None.
+ */
+bool ProcessControl::WaitFor(std::chrono::steady_clock::duration duration)
+{
+    return WaitUntil(std::chrono::steady_clock::now() + duration);
+}
+
+/*
+ *  ProcessControl::WaitUntil()
+ *
+ *  Description:
+ *      Wait until the given time or for termination to be requested.
+ *
+ *  Parameters:
+ *      time [in]
+ *          The time until which to wait.
+ *
+ *  Returns:
+ *      True if termination was requested, false if the time passed.
+ *
+ *  Comments:
+ *      None.
+ */
+bool ProcessControl::WaitUntil(std::chrono::steady_clock::time_point time)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    return cv.wait_until(lock, time, [&]() -> bool { return Terminating(); });
+}
+
+/*
+ *  ProcessControl::Watch()
+ *
+ *  Description:
+ *      Wait for termination to be requested, then call the cancel handlers
+ *      and wake any waiting threads.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      This runs on the watcher thread until termination is requested or
+ *      this object is destroyed.
+ */
+void ProcessControl::Watch()
+{
+    bool polling{};
+
+    while (!Terminating() && !shutdown)
+    {
+#ifdef _WIN32
+        if ((wake_event != nullptr) && !polling)
+        {
+            if (WaitForSingleObject(wake_event, INFINITE) == WAIT_FAILED)
+            {
+                // Fall back to polling if the event cannot be waited on
+                polling = true;
+            }
+            continue;
+        }
+#else
+        if ((wake_pipe[0] >= 0) && !polling)
+        {
+            char octet{};
+            if ((read(wake_pipe[0], &octet, 1) < 0) && (errno != EINTR))
+            {
+                // Fall back to polling if the pipe cannot be read
+                polling = true;
+            }
+            continue;
+        }
+#endif
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait_for(lock, Poll_Interval);
+    }
+
+    if (!Terminating()) return;
+
+    // Wake threads waiting for time to pass; the mutex is taken so that a
+    // thread about to wait does not miss the notification
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        cv.notify_all();
+    }
+
+    // Cancel operations in progress
+    std::lock_guard<std::mutex> lock(handler_mutex);
+    for (const auto &[handle, handler] : handlers) handler();
+}
@@ -9,9 +9,16 @@
  *      Paul E. Jones <paulej@packetizer.com>
  *
  *  Description:
- *      This header defines a simple ProcessControl structure used to gracefully
- *      control the termination of the process when the user requests it
- *      (e.g., CTRL-C).
+ *      This file defines the ProcessControl object, which is used to
+ *      gracefully control the termination of the process when the user
+ *      requests it (e.g., CTRL-C).
+ *
+ *      Termination is requested by setting an atomic flag and writing to a
+ *      self-pipe (an event on Windows), both of which are safe to do from a
+ *      signal handler.  A watcher thread waits on the pipe and, once woken,
+ *      calls each registered cancel handler (e.g., to cancel an Encryptor or
+ *      Decryptor in flight) and wakes any thread waiting for a period of
+ *      time to pass.  Checking for termination is lock-free.
  *
  *  Portability Issues:
  *      None.
@@ -19,13 +26,72 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <map>
 #include <mutex>
+#include <thread>
+
+// Controls the graceful termination of the process
+class ProcessControl
+{
+    public:
+        using CancelHandler = std::function<void()>;
+
+        ProcessControl();
+        ~ProcessControl();
+
+        void RequestTermination() noexcept;
+        bool Terminating() const noexcept
+        {
+            return terminate.load(std::memory_order_acquire);
+        }
+        std::size_t AddCancelHandler(const CancelHandler &handler);
+        void RemoveCancelHandler(std::size_t handle);
+        bool WaitFor(std::chrono::steady_clock::duration duration);
+        bool WaitUntil(std::chrono::steady_clock::time_point time);
 
-// Simple structure to facilitate process control
-struct ProcessControl
+        std::atomic<bool> reload_bandwidth = false; // Set via SIGUSR2
+
+    protected:
+        void Watch();
+
+        std::atomic<bool> terminate;
+        std::atomic<bool> shutdown;
+        std::mutex mutex;                       // Guards waits on cv
+        std::condition_variable cv;
+        std::mutex handler_mutex;               // Guards cancel handlers
+        std::map<std::size_t, CancelHandler> handlers;
+        std::size_t next_handle;
+#ifdef _WIN32
+        void *wake_event;
+#else
+        int wake_pipe[2];
+#endif
+        std::thread watcher;
+};
+
+// Cancels an operation in progress if termination is requested
+class ScopedCancelHandler
 {
-    bool terminate = false;
-    std::condition_variable cv;
-    std::mutex mutex;
+    public:
+        ScopedCancelHandler(ProcessControl &process_control,
+                            const ProcessControl::CancelHandler &handler) :
+            process_control{process_control},
+            handle{process_control.AddCancelHandler(handler)}
+        {
+        }
+        ~ScopedCancelHandler()
+        {
+            process_control.RemoveCancelHandler(handle);
+        }
+        ScopedCancelHandler(const ScopedCancelHandler &) = delete;
+        ScopedCancelHandler &operator=(const ScopedCancelHandler &) = delete;
+
+    protected:
+        ProcessControl &process_control;
+        std::size_t handle;
 };
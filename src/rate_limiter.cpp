@@ -0,0 +1,375 @@
+/*
+ *  rate_limiter.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file implements the RateLimiter object, which implements a token
+ *      bucket, and the BandwidthLimiter object, which uses a pair of
+ *      RateLimiter objects to limit the rate at which all files are read
+ *      and written.
+ *
+ *  Portability Issues:
+ *      None.
+ */
+
+#include <algorithm>
+#include <fstream>
+#include <filesystem>
+#include "rate_limiter.h"
+#include "option_values.h"
+
+namespace
+{
+
+// The token bucket holds at most this fraction of a second's worth of octets,
+// which bounds the burst permitted after a period of inactivity
+constexpr double Burst_Interval = 0.1;
+
+} // namespace
+
+/*
+ *  RateLimiter::RateLimiter()
+ *
+ *  Description:
+ *      Constructor for the RateLimiter object.
+ *
+ *  Parameters:
+ *      rate [in]
+ *          The rate in octets per second, or zero if unlimited.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+RateLimiter::RateLimiter(std::uint64_t rate) :
+    rate{},
+    tokens{},
+    capacity{},
+    last_update{Clock::now()}
+{
+    SetRate(rate);
+}
+
+/*
+ *  RateLimiter::SetRate()
+ *
+ *  Description:
+ *      Change the rate at which octets may be transferred.
+ *
+ *  Parameters:
+ *      new_rate [in]
+ *          The rate in octets per second, or zero if unlimited.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      Any debt accumulated by prior reservations is retained, though
+ *      callers already waiting are not affected by the change.
+ */
+void RateLimiter::SetRate(std::uint64_t new_rate)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    rate = new_rate;
+    capacity = std::max(1.0, static_cast<double>(rate) * Burst_Interval);
+    tokens = std::min(tokens, capacity);
+    last_update = Clock::now();
+}
+
+/*
+ *  RateLimiter::GetRate()
+ *
+ *  Description:
+ *      Return the rate at which octets may be transferred.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      The rate in octets per second, or zero if unlimited.
+ *
+ *  Comments:
+ *      None.
+ */
+std::uint64_t RateLimiter::GetRate() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    return rate;
+}
+
+/*
+ *  RateLimiter::Reserve()
+ *
+ *  Description:
+ *      Reserve the given number of octets for transfer, returning how long
+ *      the caller must wait before the transfer conforms to the rate.
+ *
+ *  Parameters:
+ *      octets [in]
+ *          The number of octets to be transferred.
+ *
+ *  Returns:
+ *      The time the caller must wait, which is zero if the transfer may
+ *      proceed immediately.
+ *
+ *  Comments:
+ *      The bucket may go into debt, which allows transfers larger than the
+ *      bucket's capacity and ensures that concurrent callers are queued in
+ *      the order in which they made reservations.
+ */
+RateLimiter::Clock::duration RateLimiter::Reserve(std::size_t octets)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // If the rate is unlimited, there is never a need to wait
+    if (rate == 0) return Clock::duration::zero();
+
+    // Add tokens for the time elapsed since the last update
+    const Clock::time_point now = Clock::now();
+    const std::chrono::duration<double> elapsed = now - last_update;
+    last_update = now;
+    tokens = std::min(capacity,
+                      tokens + elapsed.count() * static_cast<double>(rate));
+
+    // Take the tokens needed for this transfer
+    tokens -= static_cast<double>(octets);
+    if (tokens >= 0.0) return Clock::duration::zero();
+
+    // Wait until the debt is repaid
+    return std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(-tokens / static_cast<double>(rate)));
+}
+
+/*
+ *  BandwidthLimiter::BandwidthLimiter()
+ *
+ *  Description:
+ *      Constructor for the BandwidthLimiter object.
+ *
+ *  Parameters:
+ *      parent_logger [in]
+ *          A parent logger to which the child logger would direct logging
+ *          messages.
+ *
+ *      process_control [in]
+ *          A structure used to control execution.  Waiting is cut short if
+ *          termination is requested, and the limits are reloaded from the
+ *          limits file when "reload_bandwidth" is set.
+ *
+ *      read_rate [in]
+ *          The rate in octets per second at which files may be read, or
+ *          zero if unlimited.
+ *
+ *      write_rate [in]
+ *          The rate in octets per second at which files may be written, or
+ *          zero if unlimited.
+ *
+ *      limits_file [in]
+ *          The name of a file containing "READ[:WRITE]" limits that are read
+ *          when a reload is requested, or empty if there is no such file.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+BandwidthLimiter::BandwidthLimiter(
+    const Terra::Logger::LoggerPointer &parent_logger,
+    ProcessControl &process_control,
+    std::uint64_t read_rate,
+    std::uint64_t write_rate,
+    const std::string &limits_file) :
+    logger{std::make_shared<Terra::Logger::Logger>(parent_logger, "BWLM")},
+    process_control{process_control},
+    limits_file{limits_file},
+    read_limiter{read_rate},
+    write_limiter{write_rate},
+    throttled_time{0}
+{
+    logger->info << "Bandwidth limits: read=" << read_rate
+                 << " octets/s, write=" << write_rate << " octets/s"
+                 << std::flush;
+}
+
+/*
+ *  BandwidthLimiter::Read()
+ *
+ *  Description:
+ *      Account for octets read, waiting as necessary to observe the read
+ *      rate limit.
+ *
+ *  Parameters:
+ *      octets [in]
+ *          The number of octets read.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+void BandwidthLimiter::Read(std::size_t octets)
+{
+    Throttle(read_limiter, octets);
+}
+
+/*
+ *  BandwidthLimiter::Write()
+ *
+ *  Description:
+ *      Account for octets to be written, waiting as necessary to observe the
+ *      write rate limit.
+ *
+ *  Parameters:
+ *      octets [in]
+ *          The number of octets to be written.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+void BandwidthLimiter::Write(std::size_t octets)
+{
+    Throttle(write_limiter, octets);
+}
+
+/*
+ *  BandwidthLimiter::Reload()
+ *
+ *  Description:
+ *      Read the bandwidth limits from the limits file and apply them.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      True if the limits were reloaded, false if there is no limits file or
+ *      the file could not be read or is invalid.  If false, the current
+ *      limits remain in effect.
+ *
+ *  Comments:
+ *      None.
+ */
+bool BandwidthLimiter::Reload()
+{
+    std::lock_guard<std::mutex> lock(reload_mutex);
+    std::string line;
+
+    if (limits_file.empty()) return false;
+
+    try
+    {
+        std::ifstream stream(std::filesystem::path(
+            std::u8string(limits_file.cbegin(), limits_file.cend())));
+        if (!stream.is_open() || !std::getline(stream, line))
+        {
+            logger->error << "Unable to read bandwidth limits file: "
+                          << limits_file << std::flush;
+            return false;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        logger->error << "Exception reading bandwidth limits file: "
+                      << limits_file << " (err=" << e.what() << ")"
+                      << std::flush;
+        return false;
+    }
+    catch (...)
+    {
+        logger->error << "Exception reading bandwidth limits file: "
+                      << limits_file << std::flush;
+        return false;
+    }
+
+    auto limits = ParseBandwidthLimit(line);
+    if (!limits)
+    {
+        logger->error << "Invalid bandwidth limits in file: " << limits_file
+                      << std::flush;
+        return false;
+    }
+
+    read_limiter.SetRate(limits->first);
+    write_limiter.SetRate(limits->second);
+
+    logger->info << "Bandwidth limits reloaded: read=" << limits->first
+                 << " octets/s, write=" << limits->second << " octets/s"
+                 << std::flush;
+
+    return true;
+}
+
+/*
+ *  BandwidthLimiter::ThrottledTime()
+ *
+ *  Description:
+ *      Return the total time that readers and writers spent waiting in
+ *      order to observe the bandwidth limits.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      The total throttled time.  With concurrent jobs, this is the sum of
+ *      the time each job waited.
+ *
+ *  Comments:
+ *      None.
+ */
+std::chrono::nanoseconds BandwidthLimiter::ThrottledTime() const
+{
+    return std::chrono::nanoseconds(throttled_time.load());
+}
+
+/*
+ *  BandwidthLimiter::Throttle()
+ *
+ *  Description:
+ *      Reserve octets from the given rate limiter and wait until the
+ *      transfer conforms to the rate.
+ *
+ *  Parameters:
+ *      rate_limiter [in]
+ *          The rate limiter from which to reserve octets.
+ *
+ *      octets [in]
+ *          The number of octets to be transferred.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      Waiting ends early if termination is requested so that encryption
+ *      or decryption may be cancelled promptly.
+ */
+void BandwidthLimiter::Throttle(RateLimiter &rate_limiter, std::size_t octets)
+{
+    // Reload the limits if requested (e.g., via SIGUSR2)
+    if (process_control.reload_bandwidth.exchange(false)) Reload();
+
+    const RateLimiter::Clock::duration delay = rate_limiter.Reserve(octets);
+    if (delay == RateLimiter::Clock::duration::zero()) return;
+
+    const RateLimiter::Clock::time_point start = RateLimiter::Clock::now();
+
+    // Wait for the delay to pass or termination to be requested
+    process_control.WaitUntil(start + delay);
+
+    throttled_time += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          RateLimiter::Clock::now() - start)
+                          .count();
+}
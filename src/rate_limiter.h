@@ -0,0 +1,80 @@
+/*
+ *  rate_limiter.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file defines the RateLimiter object, which implements a token
+ *      bucket, and the BandwidthLimiter object, which uses a pair of
+ *      RateLimiter objects to limit the rate at which all files are read
+ *      and written.  A single BandwidthLimiter is shared by all concurrent
+ *      jobs so that the limits apply to the process as a whole.
+ *
+ *  Portability Issues:
+ *      None.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <chrono>
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <terra/logger/logger.h>
+#include "process_control.h"
+
+// Token bucket that limits the rate at which octets may be transferred
+class RateLimiter
+{
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        RateLimiter(std::uint64_t rate = 0);
+        ~RateLimiter() = default;
+
+        void SetRate(std::uint64_t rate);
+        std::uint64_t GetRate() const;
+        Clock::duration Reserve(std::size_t octets);
+
+    protected:
+        mutable std::mutex mutex;
+        std::uint64_t rate;                     // Octets per second (0 = none)
+        double tokens;                          // Octets that may be sent
+        double capacity;                        // Maximum burst in octets
+        Clock::time_point last_update;          // Time tokens last added
+};
+
+// Limits the rate at which files are read and written
+class BandwidthLimiter
+{
+    public:
+        BandwidthLimiter(const Terra::Logger::LoggerPointer &parent_logger,
+                         ProcessControl &process_control,
+                         std::uint64_t read_rate,
+                         std::uint64_t write_rate,
+                         const std::string &limits_file);
+        ~BandwidthLimiter() = default;
+
+        void Read(std::size_t octets);
+        void Write(std::size_t octets);
+        bool Reload();
+        std::chrono::nanoseconds ThrottledTime() const;
+
+    protected:
+        void Throttle(RateLimiter &rate_limiter, std::size_t octets);
+
+        Terra::Logger::LoggerPointer logger;
+        ProcessControl &process_control;
+        std::string limits_file;
+        std::mutex reload_mutex;
+        RateLimiter read_limiter;
+        RateLimiter write_limiter;
+        std::atomic<std::int64_t> throttled_time;
+};
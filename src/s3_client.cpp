@@ -0,0 +1,913 @@
+/*
+ *  s3_client.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file implements the S3Client object, which performs requests
+ *      to S3-compatible object storage services.
+ *
+ *  Portability Issues:
+ *      None.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <charconv>
+#include <cstdlib>
+#include <ctime>
+#include "s3_client.h"
+#include "digest.h"
+
+namespace
+{
+
+// Region used if none is configured
+constexpr char Default_Region[] = "us-east-1";
+
+// Most attempts made to complete a request
+constexpr unsigned Max_Request_Attempts = 5;
+
+// Delay before the first retry, which doubles with each retry
+constexpr std::chrono::milliseconds Initial_Retry_Delay{250};
+
+// Longest delay between retries
+constexpr std::chrono::milliseconds Max_Retry_Delay{8000};
+
+// Payload hash of a request with an empty body
+constexpr char Empty_Payload_Hash[] =
+    "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855";
+
+/*
+ *  GetEnvironment()
+ *
+ *  Description:
+ *      Return the value of the given environment variable.
+ *
+ *  Parameters:
+ *      name [in]
+ *          The name of the environment variable.
+ *
+ *  Returns:
+ *      The value, which is empty if the variable is not set.
+ *
+ *  Comments:
+ *      None.
+ */
+std::string GetEnvironment(const char *name)
+{
+    const char *value = std::getenv(name);
+
+    return (value == nullptr) ? std::string() : std::string(value);
+}
+
+/*
+ *  URIEncode()
+ *
+ *  Description:
+ *      Percent-encode the given string as required for signing requests,
+ *      leaving only unreserved characters unencoded.
+ *
+ *  Parameters:
+ *      text [in]
+ *          The string to encode.
+ *
+ *      keep_slash [in]
+ *          If true, "/" is not encoded (for encoding paths).
+ *
+ *  Returns:
+ *      The encoded string.
+ *
+ *  Comments:
+ *      None.
+ */
+std::string URIEncode(const std::string &text, bool keep_slash)
+{
+    constexpr char Digits[] = "0123456789ABCDEF";
+    std::string encoded;
+
+    for (unsigned char c : text)
+    {
+        if (((c >= 'A') && (c <= 'Z')) || ((c >= 'a') && (c <= 'z')) ||
+            ((c >= '0') && (c <= '9')) || (c == '-') || (c == '.') ||
+            (c == '_') || (c == '~') || (keep_slash && (c == '/')))
+        {
+            encoded.push_back(static_cast<char>(c));
+        }
+        else
+        {
+            encoded.push_back('%');
+            encoded.push_back(Digits[c >> 4]);
+            encoded.push_back(Digits[c & 0x0f]);
+        }
+    }
+
+    return encoded;
+}
+
+/*
+ *  XMLEscape()
+ *
+ *  Description:
+ *      Escape the characters in the given string that are special in XML.
+ *
+ *  Parameters:
+ *      text [in]
+ *          The string to escape.
+ *
+ *  Returns:
+ *      The escaped string.
+ *
+ *  Comments:
+ *      None.
+ */
+std::string XMLEscape(const std::string &text)
+{
+    std::string escaped;
+
+    for (char c : text)
+    {
+        switch (c)
+        {
+            case '&':
+                escaped += "&amp;";
+                break;
+            case '<':
+                escaped += "&lt;";
+                break;
+            case '>':
+                escaped += "&gt;";
+                break;
+            case '"':
+                escaped += "&quot;";
+                break;
+            default:
+                escaped.push_back(c);
+                break;
+        }
+    }
+
+    return escaped;
+}
+
+/*
+ *  XMLElement()
+ *
+ *  Description:
+ *      Return the text of the first element having the given name in an XML
+ *      document.
+ *
+ *  Parameters:
+ *      xml [in]
+ *          The XML document.
+ *
+ *      name [in]
+ *          The element name.
+ *
+ *  Returns:
+ *      The element text, which is empty if there is no such element.
+ *
+ *  Comments:
+ *      This is sufficient for the simple documents returned by object
+ *      storage services.  Entities in the text are not decoded.
+ */
+std::string XMLElement(const std::string &xml, const std::string &name)
+{
+    const std::string start_tag = "<" + name + ">";
+    const std::string end_tag = "</" + name + ">";
+
+    const std::size_t start = xml.find(start_tag);
+    if (start == std::string::npos) return {};
+
+    const std::size_t text_start = start + start_tag.size();
+    const std::size_t end = xml.find(end_tag, text_start);
+    if (end == std::string::npos) return {};
+
+    return xml.substr(text_start, end - text_start);
+}
+
+/*
+ *  FormatTime()
+ *
+ *  Description:
+ *      Format the given time in UTC using the given strftime() format.
+ *
+ *  Parameters:
+ *      time [in]
+ *          The time to format.
+ *
+ *      format [in]
+ *          The strftime() format string.
+ *
+ *  Returns:
+ *      The formatted time.
+ *
+ *  Comments:
+ *      None.
+ */
+std::string FormatTime(std::time_t time, const char *format)
+{
+    std::tm utc{};
+    char text[32]{};
+
+#ifdef _WIN32
+    gmtime_s(&utc, &time);
+#else
+    gmtime_r(&time, &utc);
+#endif
+    std::strftime(text, sizeof(text), format, &utc);
+
+    return text;
+}
+
+} // namespace
+
+/*
+ *  GetS3Config()
+ *
+ *  Description:
+ *      Read the object storage service configuration from the environment.
+ *
+ *  Parameters:
+ *      error [out]
+ *          A description of the problem if the configuration is not valid.
+ *
+ *  Returns:
+ *      The configuration, or no value if it is not valid.
+ *
+ *  Comments:
+ *      AWS_ENDPOINT_URL must give an http:// endpoint.  Since requests
+ *      (including signatures, session tokens, and file contents) are sent
+ *      without TLS, the AWS endpoint for the region is never used by
+ *      default; the feature is intended for local or test object storage.
+ */
+std::optional<S3Config> GetS3Config(std::string &error)
+{
+    S3Config config;
+
+    config.region = GetEnvironment("AWS_REGION");
+    if (config.region.empty())
+    {
+        config.region = GetEnvironment("AWS_DEFAULT_REGION");
+    }
+    if (config.region.empty()) config.region = Default_Region;
+
+    config.access_key = GetEnvironment("AWS_ACCESS_KEY_ID");
+    const std::string secret_key = GetEnvironment("AWS_SECRET_ACCESS_KEY");
+    config.secret_key = SecureString(secret_key.begin(), secret_key.end());
+    config.session_token = GetEnvironment("AWS_SESSION_TOKEN");
+    if (config.access_key.empty() || config.secret_key.empty())
+    {
+        error = "AWS_ACCESS_KEY_ID and AWS_SECRET_ACCESS_KEY must be set";
+        return {};
+    }
+
+    // Requests are sent without TLS, so an endpoint must be given
+    // explicitly rather than defaulting to the AWS endpoint for the region
+    std::string endpoint = GetEnvironment("AWS_ENDPOINT_URL");
+    if (endpoint.empty())
+    {
+        error = "AWS_ENDPOINT_URL must be set to an http:// endpoint (only "
+                "local or test object storage is supported, as requests "
+                "are not encrypted)";
+        return {};
+    }
+
+    if (endpoint.rfind("https://", 0) == 0)
+    {
+        error = "HTTPS endpoints are not supported";
+        return {};
+    }
+    if (endpoint.rfind("http://", 0) != 0)
+    {
+        error = "Invalid AWS_ENDPOINT_URL (e.g., http://localhost:9000)";
+        return {};
+    }
+
+    // Extract the host and optional port
+    endpoint.erase(0, 7);
+    endpoint = endpoint.substr(0, endpoint.find('/'));
+    const std::size_t colon = endpoint.rfind(':');
+    config.host = endpoint.substr(0, colon);
+    if (colon != std::string::npos)
+    {
+        const char *end = endpoint.data() + endpoint.size();
+        auto [next, parse_error] =
+            std::from_chars(endpoint.data() + colon + 1, end, config.port);
+        if ((parse_error != std::errc()) || (next != end) ||
+            (config.port == 0))
+        {
+            error = "Invalid port in AWS_ENDPOINT_URL";
+            return {};
+        }
+    }
+    if (config.host.empty())
+    {
+        error = "Invalid AWS_ENDPOINT_URL (e.g., http://localhost:9000)";
+        return {};
+    }
+
+    return config;
+}
+
+/*
+ *  S3Client::S3Client()
+ *
+ *  Description:
+ *      Constructor for the S3Client object.
+ *
+ *  Parameters:
+ *      parent_logger [in]
+ *          A parent logger to which the child logger would direct logging
+ *          messages.
+ *
+ *      process_control [in]
+ *          A structure used to control execution.  Retries are abandoned if
+ *          the process is asked to terminate.
+ *
+ *      config [in]
+ *          The configuration of the object storage service.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+S3Client::S3Client(const Terra::Logger::LoggerPointer &parent_logger,
+                   ProcessControl &process_control,
+                   const S3Config &config) :
+    logger{std::make_shared<Terra::Logger::Logger>(parent_logger, "S3CL")},
+    process_control{process_control},
+    config{config}
+{
+    logger->info << "Object storage endpoint: " << config.host << ":"
+                 << config.port << " (region " << config.region << ")"
+                 << std::flush;
+}
+
+/*
+ *  S3Client::CreateMultipartUpload()
+ *
+ *  Description:
+ *      Start a multipart upload of the given object.
+ *
+ *  Parameters:
+ *      location [in]
+ *          The object to upload.
+ *
+ *      upload_id [out]
+ *          The identifier of the upload.
+ *
+ *  Returns:
+ *      True if the upload was started, false if not.
+ *
+ *  Comments:
+ *      The upload requests SHA-256 checksums for each part.
+ */
+bool S3Client::CreateMultipartUpload(const S3Location &location,
+                                     std::string &upload_id) const
+{
+    HTTPResponse response;
+
+    if (!SendRequest("POST",
+                     location,
+                     {{"uploads", ""}},
+                     {{"x-amz-checksum-algorithm", "SHA256"}},
+                     {},
+                     Empty_Payload_Hash,
+                     response))
+    {
+        return false;
+    }
+
+    upload_id = XMLElement(response.body, "UploadId");
+    if (upload_id.empty())
+    {
+        logger->error << "No upload identifier returned for "
+                      << location.key << std::flush;
+        return false;
+    }
+
+    logger->info << "Started upload of s3://" << location.bucket << "/"
+                 << location.key << " (upload " << upload_id << ")"
+                 << std::flush;
+
+    return true;
+}
+
+/*
+ *  S3Client::UploadPart()
+ *
+ *  Description:
+ *      Upload a part of a multipart upload.
+ *
+ *  Parameters:
+ *      location [in]
+ *          The object being uploaded.
+ *
+ *      upload_id [in]
+ *          The identifier of the upload.
+ *
+ *      data [in]
+ *          The content of the part.
+ *
+ *      part [in/out]
+ *          The part, whose number must be given.  The ETag and checksum are
+ *          stored on success.
+ *
+ *  Returns:
+ *      True if the part was uploaded, false if not.
+ *
+ *  Comments:
+ *      The part's SHA-256 checksum is sent so the service verifies the
+ *      part was received intact.  This may be called from several threads
+ *      at once.
+ */
+bool S3Client::UploadPart(const S3Location &location,
+                          const std::string &upload_id,
+                          std::span<const char> data,
+                          S3Part &part) const
+{
+    HTTPResponse response;
+
+    // The same digest serves as the payload hash and the part checksum
+    const SHA256Digest digest = ComputeSHA256(std::span<const std::uint8_t>(
+        reinterpret_cast<const std::uint8_t *>(data.data()),
+        data.size()));
+    part.checksum = Base64Encode(digest);
+
+    if (!SendRequest("PUT",
+                     location,
+                     {{"partNumber", std::to_string(part.number)},
+                      {"uploadId", upload_id}},
+                     {{"x-amz-checksum-sha256", part.checksum}},
+                     data,
+                     HexEncode(digest),
+                     response))
+    {
+        return false;
+    }
+
+    part.etag = response.headers["etag"];
+    if (part.etag.empty())
+    {
+        logger->error << "No ETag returned for part " << part.number
+                      << " of " << location.key << std::flush;
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ *  S3Client::CompleteMultipartUpload()
+ *
+ *  Description:
+ *      Complete a multipart upload, creating the object from its parts.
+ *
+ *  Parameters:
+ *      location [in]
+ *          The object being uploaded.
+ *
+ *      upload_id [in]
+ *          The identifier of the upload.
+ *
+ *      parts [in]
+ *          The parts uploaded, in order of part number.
+ *
+ *  Returns:
+ *      True if the object was created, false if not.
+ *
+ *  Comments:
+ *      None.
+ */
+bool S3Client::CompleteMultipartUpload(const S3Location &location,
+                                       const std::string &upload_id,
+                                       const std::vector<S3Part> &parts) const
+{
+    HTTPResponse response;
+    std::string body = "<CompleteMultipartUpload>";
+
+    for (const S3Part &part : parts)
+    {
+        body += "<Part><PartNumber>" + std::to_string(part.number) +
+                "</PartNumber><ETag>" + XMLEscape(part.etag) +
+                "</ETag><ChecksumSHA256>" + part.checksum +
+                "</ChecksumSHA256></Part>";
+    }
+    body += "</CompleteMultipartUpload>";
+
+    if (!SendRequest("POST",
+                     location,
+                     {{"uploadId", upload_id}},
+                     {{"content-type", "application/xml"}},
+                     body,
+                     HexEncode(ComputeSHA256(body)),
+                     response))
+    {
+        return false;
+    }
+
+    // An error may be reported after the response status was sent
+    if (response.body.find("<Error>") != std::string::npos)
+    {
+        logger->error << "Unable to complete upload of " << location.key
+                      << " (" << XMLElement(response.body, "Code") << ": "
+                      << XMLElement(response.body, "Message") << ")"
+                      << std::flush;
+        return false;
+    }
+
+    logger->info << "Completed upload of s3://" << location.bucket << "/"
+                 << location.key << " in " << parts.size() << " parts"
+                 << std::flush;
+
+    return true;
+}
+
+/*
+ *  S3Client::AbortMultipartUpload()
+ *
+ *  Description:
+ *      Abort a multipart upload, discarding any parts uploaded.
+ *
+ *  Parameters:
+ *      location [in]
+ *          The object being uploaded.
+ *
+ *      upload_id [in]
+ *          The identifier of the upload.
+ *
+ *  Returns:
+ *      True if the upload was aborted, false if not.
+ *
+ *  Comments:
+ *      None.
+ */
+bool S3Client::AbortMultipartUpload(const S3Location &location,
+                                    const std::string &upload_id) const
+{
+    HTTPResponse response;
+
+    logger->info << "Aborting upload of s3://" << location.bucket << "/"
+                 << location.key << std::flush;
+
+    return SendRequest("DELETE",
+                       location,
+                       {{"uploadId", upload_id}},
+                       {},
+                       {},
+                       Empty_Payload_Hash,
+                       response);
+}
+
+/*
+ *  S3Client::HeadObject()
+ *
+ *  Description:
+ *      Retrieve the size and ETag of the given object.
+ *
+ *  Parameters:
+ *      location [in]
+ *          The object.
+ *
+ *      size [out]
+ *          The size of the object in octets.
+ *
+ *      etag [out]
+ *          The ETag of the object, which identifies its content.
+ *
+ *  Returns:
+ *      True if the object exists and its size is known, false if not.
+ *
+ *  Comments:
+ *      None.
+ */
+bool S3Client::HeadObject(const S3Location &location,
+                          std::uint64_t &size,
+                          std::string &etag) const
+{
+    HTTPResponse response;
+
+    if (!SendRequest("HEAD",
+                     location,
+                     {},
+                     {},
+                     {},
+                     Empty_Payload_Hash,
+                     response))
+    {
+        return false;
+    }
+
+    const std::string &length = response.headers["content-length"];
+    auto [next, error] =
+        std::from_chars(length.data(), length.data() + length.size(), size);
+    if ((error != std::errc()) || (next != length.data() + length.size()))
+    {
+        logger->error << "No object size returned for " << location.key
+                      << std::flush;
+        return false;
+    }
+
+    etag = response.headers["etag"];
+
+    return true;
+}
+
+/*
+ *  S3Client::GetObjectRange()
+ *
+ *  Description:
+ *      Retrieve a range of octets from the given object.
+ *
+ *  Parameters:
+ *      location [in]
+ *          The object.
+ *
+ *      etag [in]
+ *          The ETag the object is expected to have, or empty if any version
+ *          of the object may be read.
+ *
+ *      offset [in]
+ *          The offset of the first octet to retrieve.
+ *
+ *      length [in]
+ *          The number of octets to retrieve, which must be within the
+ *          object.
+ *
+ *      data [out]
+ *          The octets retrieved.
+ *
+ *  Returns:
+ *      True if the range was retrieved, false if not (including if the
+ *      object was replaced and no longer has the expected ETag).
+ *
+ *  Comments:
+ *      This may be called from several threads at once.
+ */
+bool S3Client::GetObjectRange(const S3Location &location,
+                              const std::string &etag,
+                              std::uint64_t offset,
+                              std::size_t length,
+                              std::string &data) const
+{
+    HTTPResponse response;
+    std::vector<std::pair<std::string, std::string>> headers;
+
+    if (length == 0)
+    {
+        data.clear();
+        return true;
+    }
+
+    headers.emplace_back("range",
+                         "bytes=" + std::to_string(offset) + "-" +
+                             std::to_string(offset + length - 1));
+    if (!etag.empty()) headers.emplace_back("if-match", etag);
+
+    if (!SendRequest("GET",
+                     location,
+                     {},
+                     std::move(headers),
+                     {},
+                     Empty_Payload_Hash,
+                     response,
+                     std::max(length, Default_Max_Response_Body)))
+    {
+        return false;
+    }
+
+    if ((response.status != 206) || (response.body.size() != length))
+    {
+        logger->error << "Unexpected response to range request for "
+                      << location.key << " (status " << response.status
+                      << ", " << response.body.size() << " of " << length
+                      << " octets)" << std::flush;
+        return false;
+    }
+
+    data = std::move(response.body);
+
+    return true;
+}
+
+/*
+ *  S3Client::SendRequest()
+ *
+ *  Description:
+ *      Sign and send a request concerning the given object, retrying if
+ *      the request fails in a way that may be temporary.
+ *
+ *  Parameters:
+ *      method [in]
+ *          The request method.
+ *
+ *      location [in]
+ *          The object to which the request applies.
+ *
+ *      query [in]
+ *          The query parameters (not encoded).
+ *
+ *      headers [in]
+ *          Additional request headers, with lowercase names.
+ *
+ *      body [in]
+ *          The request body.
+ *
+ *      payload_hash [in]
+ *          The hexadecimal SHA-256 digest of the body.
+ *
+ *      response [out]
+ *          The successful response.
+ *
+ *      max_response_body [in]
+ *          The largest response body accepted.
+ *
+ *  Returns:
+ *      True if a successful response was received, false if not.
+ *
+ *  Comments:
+ *      Connection failures, server errors (5xx), and throttling (429) are
+ *      retried with exponential backoff.  Other errors are not retried.
+ */
+bool S3Client::SendRequest(
+    const std::string &method,
+    const S3Location &location,
+    const std::vector<std::pair<std::string, std::string>> &query,
+    std::vector<std::pair<std::string, std::string>> headers,
+    std::span<const char> body,
+    const std::string &payload_hash,
+    HTTPResponse &response,
+    std::size_t max_response_body) const
+{
+    std::chrono::milliseconds retry_delay = Initial_Retry_Delay;
+
+    // Form the canonical (encoded) path and query string
+    const std::string canonical_uri =
+        "/" + URIEncode(location.bucket, false) + "/" +
+        URIEncode(location.key, true);
+    std::vector<std::string> parameters;
+    for (const auto &[name, value] : query)
+    {
+        parameters.push_back(URIEncode(name, false) + "=" +
+                             URIEncode(value, false));
+    }
+    std::sort(parameters.begin(), parameters.end());
+    std::string canonical_query;
+    for (const std::string &parameter : parameters)
+    {
+        if (!canonical_query.empty()) canonical_query += "&";
+        canonical_query += parameter;
+    }
+
+    headers.emplace_back("x-amz-content-sha256", payload_hash);
+    if (!config.session_token.empty())
+    {
+        headers.emplace_back("x-amz-security-token", config.session_token);
+    }
+
+    for (unsigned attempt = 1; attempt <= Max_Request_Attempts; attempt++)
+    {
+        HTTPRequest request;
+        std::string error;
+
+        request.method = method;
+        request.host = config.host;
+        request.port = config.port;
+        request.target = canonical_uri;
+        if (!canonical_query.empty()) request.target += "?" + canonical_query;
+        request.headers = headers;
+        request.body = body;
+        request.max_response_body = max_response_body;
+
+        // Requests are signed for each attempt, as the time is signed
+        SignRequest(request, canonical_uri, canonical_query, payload_hash);
+
+        if (SendHTTPRequest(request, response, error))
+        {
+            if ((response.status >= 200) && (response.status < 300))
+            {
+                return true;
+            }
+
+            error = "status " + std::to_string(response.status);
+            const std::string code = XMLElement(response.body, "Code");
+            if (!code.empty())
+            {
+                error += ", " + code + ": " +
+                         XMLElement(response.body, "Message");
+            }
+
+            // Other client errors will not succeed if retried
+            if ((response.status < 500) && (response.status != 429))
+            {
+                logger->error << "Request failed: " << method << " "
+                              << location.key << " (" << error << ")"
+                              << std::flush;
+                return false;
+            }
+        }
+
+        logger->warning << "Request failed (attempt " << attempt << " of "
+                        << Max_Request_Attempts << "): " << method << " "
+                        << location.key << " (" << error << ")"
+                        << std::flush;
+
+        if (attempt == Max_Request_Attempts) break;
+
+        // Wait before retrying, unless asked to terminate
+        if (process_control.WaitFor(retry_delay)) return false;
+        retry_delay = std::min(retry_delay * 2, Max_Retry_Delay);
+    }
+
+    return false;
+}
+
+/*
+ *  S3Client::SignRequest()
+ *
+ *  Description:
+ *      Sign the given request using AWS Signature Version 4, adding the
+ *      x-amz-date and Authorization headers.
+ *
+ *  Parameters:
+ *      request [in/out]
+ *          The request to sign.
+ *
+ *      canonical_uri [in]
+ *          The encoded request path.
+ *
+ *      canonical_query [in]
+ *          The encoded query string, with parameters sorted.
+ *
+ *      payload_hash [in]
+ *          The hexadecimal SHA-256 digest of the body.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      All headers given in the request are signed, along with Host.
+ */
+void S3Client::SignRequest(HTTPRequest &request,
+                           const std::string &canonical_uri,
+                           const std::string &canonical_query,
+                           const std::string &payload_hash) const
+{
+    const std::time_t now = std::time(nullptr);
+    const std::string amz_date = FormatTime(now, "%Y%m%dT%H%M%SZ");
+    const std::string date = FormatTime(now, "%Y%m%d");
+    const std::string scope = date + "/" + config.region + "/s3/aws4_request";
+
+    request.headers.emplace_back("x-amz-date", amz_date);
+
+    // Form the canonical headers, sorted by name
+    std::vector<std::pair<std::string, std::string>> signed_headers =
+        request.headers;
+    std::string host = request.host;
+    if (request.port != 80) host += ":" + std::to_string(request.port);
+    signed_headers.emplace_back("host", host);
+    std::sort(signed_headers.begin(), signed_headers.end());
+
+    std::string canonical_headers;
+    std::string signed_names;
+    for (const auto &[name, value] : signed_headers)
+    {
+        canonical_headers += name + ":" + value + "\n";
+        if (!signed_names.empty()) signed_names += ";";
+        signed_names += name;
+    }
+
+    const std::string canonical_request =
+        request.method + "\n" + canonical_uri + "\n" + canonical_query +
+        "\n" + canonical_headers + "\n" + signed_names + "\n" + payload_hash;
+
+    const std::string string_to_sign =
+        "AWS4-HMAC-SHA256\n" + amz_date + "\n" + scope + "\n" +
+        HexEncode(ComputeSHA256(canonical_request));
+
+    // Derive the signing key and compute the signature
+    SecureString secret = "AWS4" + config.secret_key;
+    auto key = ComputeHMACSHA256(
+        std::span<const std::uint8_t>(
+            reinterpret_cast<const std::uint8_t *>(secret.data()),
+            secret.size()),
+        date);
+    key = ComputeHMACSHA256(key, config.region);
+    key = ComputeHMACSHA256(key, "s3");
+    key = ComputeHMACSHA256(key, "aws4_request");
+    const std::string signature =
+        HexEncode(ComputeHMACSHA256(key, string_to_sign));
+
+    request.headers.emplace_back(
+        "Authorization",
+        "AWS4-HMAC-SHA256 Credential=" + config.access_key + "/" + scope +
+            ", SignedHeaders=" + signed_names + ", Signature=" + signature);
+}
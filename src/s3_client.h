@@ -0,0 +1,137 @@
+/*
+ *  s3_client.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file defines the S3Client object, which performs the requests
+ *      needed to upload objects to S3-compatible object storage services
+ *      (e.g., MinIO) using multipart uploads and to download objects using
+ *      ranged requests.  Requests are signed with AWS Signature Version 4
+ *      and failed requests are retried.
+ *
+ *      The service is configured from these environment variables:
+ *
+ *          AWS_ENDPOINT_URL        Service URL (e.g., http://localhost:9000)
+ *          AWS_REGION              Region (default is us-east-1)
+ *          AWS_ACCESS_KEY_ID       Access key
+ *          AWS_SECRET_ACCESS_KEY   Secret key
+ *          AWS_SESSION_TOKEN       Session token, if using temporary keys
+ *
+ *      Objects are named with URLs of the form s3://bucket/key and are
+ *      addressed using path-style requests.
+ *
+ *  Portability Issues:
+ *      Only http:// endpoints are supported, as there is no TLS support.
+ *      The data transferred is AES Crypt output, so it is protected, but
+ *      the bucket and key names are not.  This is built only if the
+ *      aescrypt_cli_S3 CMake option is enabled.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+#include <terra/logger/logger.h>
+#include "secure_containers.h"
+#include "process_control.h"
+#include "http_client.h"
+#include "s3_url.h"
+
+// Configuration of the object storage service
+struct S3Config
+{
+    std::string host;
+    std::uint16_t port{80};
+    std::string region;
+    std::string access_key;
+    SecureString secret_key;
+    std::string session_token;
+};
+
+// A part of a multipart upload
+struct S3Part
+{
+    std::size_t number{};                       // Part number (from 1)
+    std::string etag;                           // ETag returned by server
+    std::string checksum;                       // Base64 SHA-256 of the part
+};
+
+/*
+ *  GetS3Config()
+ *
+ *  Description:
+ *      Read the object storage service configuration from the environment.
+ *
+ *  Parameters:
+ *      error [out]
+ *          A description of the problem if the configuration is not valid.
+ *
+ *  Returns:
+ *      The configuration, or no value if it is not valid.
+ *
+ *  Comments:
+ *      AWS_ENDPOINT_URL must give an http:// endpoint.  Since requests are
+ *      sent without TLS, the AWS endpoint for the region is never used by
+ *      default; the feature is intended for local or test object storage.
+ */
+std::optional<S3Config> GetS3Config(std::string &error);
+
+// Performs requests to an S3-compatible object storage service
+class S3Client
+{
+    public:
+        S3Client(const Terra::Logger::LoggerPointer &parent_logger,
+                 ProcessControl &process_control,
+                 const S3Config &config);
+        ~S3Client() = default;
+
+        bool CreateMultipartUpload(const S3Location &location,
+                                   std::string &upload_id) const;
+        bool UploadPart(const S3Location &location,
+                        const std::string &upload_id,
+                        std::span<const char> data,
+                        S3Part &part) const;
+        bool CompleteMultipartUpload(const S3Location &location,
+                                     const std::string &upload_id,
+                                     const std::vector<S3Part> &parts) const;
+        bool AbortMultipartUpload(const S3Location &location,
+                                  const std::string &upload_id) const;
+        bool HeadObject(const S3Location &location,
+                        std::uint64_t &size,
+                        std::string &etag) const;
+        bool GetObjectRange(const S3Location &location,
+                            const std::string &etag,
+                            std::uint64_t offset,
+                            std::size_t length,
+                            std::string &data) const;
+
+    protected:
+        bool SendRequest(
+            const std::string &method,
+            const S3Location &location,
+            const std::vector<std::pair<std::string, std::string>> &query,
+            std::vector<std::pair<std::string, std::string>> headers,
+            std::span<const char> body,
+            const std::string &payload_hash,
+            HTTPResponse &response,
+            std::size_t max_response_body = Default_Max_Response_Body) const;
+        void SignRequest(
+            HTTPRequest &request,
+            const std::string &canonical_uri,
+            const std::string &canonical_query,
+            const std::string &payload_hash) const;
+
+        Terra::Logger::LoggerPointer logger;
+        ProcessControl &process_control;
+        S3Config config;
+};
@@ -0,0 +1,682 @@
+/*
+ *  s3_stream.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file implements the S3UploadStreamBuf object, which uploads
+ *      data written to it as an object in S3-compatible object storage, and
+ *      the S3DownloadStreamBuf object, which downloads an object as it is
+ *      read.
+ *
+ *  Portability Issues:
+ *      None.
+ */
+
+#include <algorithm>
+#include "s3_stream.h"
+
+namespace
+{
+
+// Most parts a multipart upload may have
+constexpr std::size_t Max_Upload_Parts = 10'000;
+
+} // namespace
+
+/*
+ *  S3UploadStreamBuf::S3UploadStreamBuf()
+ *
+ *  Description:
+ *      Constructor for the S3UploadStreamBuf object.
+ *
+ *  Parameters:
+ *      parent_logger [in]
+ *          A parent logger to which the child logger would direct logging
+ *          messages.
+ *
+ *      client [in]
+ *          The client used to perform requests.  This must remain valid for
+ *          the lifetime of this object.
+ *
+ *      location [in]
+ *          The object to upload.
+ *
+ *      part_size [in]
+ *          The size of each part, except the last.
+ *
+ *      connections [in]
+ *          The number of parts to upload concurrently.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      The upload does not start until Open() is called.
+ */
+S3UploadStreamBuf::S3UploadStreamBuf(
+    const Terra::Logger::LoggerPointer &parent_logger,
+    const S3Client &client,
+    const S3Location &location,
+    std::size_t part_size,
+    std::size_t connections) :
+    logger{std::make_shared<Terra::Logger::Logger>(parent_logger, "S3UP")},
+    client{client},
+    location{location},
+    part_size{part_size},
+    connections{std::max<std::size_t>(connections, 1)},
+    stop{false},
+    failed{false},
+    buffer_count{0}
+{
+}
+
+/*
+ *  S3UploadStreamBuf::~S3UploadStreamBuf()
+ *
+ *  Description:
+ *      Destructor for the S3UploadStreamBuf object, which aborts the upload
+ *      if it was not closed.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+S3UploadStreamBuf::~S3UploadStreamBuf()
+{
+    Abort();
+}
+
+/*
+ *  S3UploadStreamBuf::Open()
+ *
+ *  Description:
+ *      Start the upload and the threads that upload parts.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      True if the upload was started, false if not.
+ *
+ *  Comments:
+ *      None.
+ */
+bool S3UploadStreamBuf::Open()
+{
+    if (!client.CreateMultipartUpload(location, upload_id)) return false;
+
+    current.resize(part_size);
+    buffer_count = 1;
+    setp(current.data(), current.data() + current.size());
+
+    for (std::size_t i = 0; i < connections; i++)
+    {
+        threads.emplace_back(&S3UploadStreamBuf::Upload, this);
+    }
+
+    return true;
+}
+
+/*
+ *  S3UploadStreamBuf::Close()
+ *
+ *  Description:
+ *      Upload the final part and complete the upload, creating the object.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      True if the object was created, false if not.  On failure, the upload
+ *      is aborted.
+ *
+ *  Comments:
+ *      None.
+ */
+bool S3UploadStreamBuf::Close()
+{
+    if (upload_id.empty()) return false;
+
+    // Submit the final part; an empty object has a single empty part
+    if ((pptr() > pbase()) || parts.empty())
+    {
+        SubmitPart();
+    }
+
+    StopUploading();
+
+    if (failed)
+    {
+        Abort();
+        return false;
+    }
+
+    if (!client.CompleteMultipartUpload(location, upload_id, parts))
+    {
+        Abort();
+        return false;
+    }
+
+    upload_id.clear();
+
+    return true;
+}
+
+/*
+ *  S3UploadStreamBuf::Abort()
+ *
+ *  Description:
+ *      Abort the upload, discarding any parts uploaded.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      Parts not yet being uploaded are discarded; parts being uploaded
+ *      are allowed to finish before the upload is aborted.
+ */
+void S3UploadStreamBuf::Abort()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        failed = true;
+        pending.clear();
+    }
+
+    setp(nullptr, nullptr);
+
+    StopUploading();
+
+    if (upload_id.empty()) return;
+
+    client.AbortMultipartUpload(location, upload_id);
+    upload_id.clear();
+}
+
+/*
+ *  S3UploadStreamBuf::overflow()
+ *
+ *  Description:
+ *      Submit the full part for upload and start filling another part with
+ *      the given character.
+ *
+ *  Parameters:
+ *      c [in]
+ *          The character that did not fit in the part, or EOF.
+ *
+ *  Returns:
+ *      A value other than EOF on success, or EOF if the upload failed.
+ *
+ *  Comments:
+ *      This waits for a part buffer to become available, so data is
+ *      produced no faster than it is uploaded.
+ */
+S3UploadStreamBuf::int_type S3UploadStreamBuf::overflow(int_type c)
+{
+    if (upload_id.empty() || (pbase() == nullptr)) return traits_type::eof();
+
+    if ((pptr() > pbase()) && !SubmitPart()) return traits_type::eof();
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        // Wait for a part buffer, allocating one if within the limit
+        cv.wait(lock,
+                [&]() -> bool
+                {
+                    return failed || !free_buffers.empty() ||
+                           (buffer_count < connections + 1);
+                });
+        if (failed) return traits_type::eof();
+
+        if (!free_buffers.empty())
+        {
+            current = std::move(free_buffers.back());
+            free_buffers.pop_back();
+        }
+        else
+        {
+            buffer_count++;
+        }
+    }
+
+    current.resize(part_size);
+    setp(current.data(), current.data() + current.size());
+
+    if (traits_type::eq_int_type(c, traits_type::eof()))
+    {
+        return traits_type::not_eof(c);
+    }
+
+    return sputc(traits_type::to_char_type(c));
+}
+
+/*
+ *  S3UploadStreamBuf::sync()
+ *
+ *  Description:
+ *      Report whether the upload has failed.  Data is not uploaded until a
+ *      part is full (or the stream is closed), since every part but the
+ *      last must be at least the minimum part size.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      0 if the upload has not failed, -1 if it has.
+ *
+ *  Comments:
+ *      None.
+ */
+int S3UploadStreamBuf::sync()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    return failed ? -1 : 0;
+}
+
+/*
+ *  S3UploadStreamBuf::SubmitPart()
+ *
+ *  Description:
+ *      Queue the part being filled to be uploaded.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      True if the part was queued, false if the upload has failed or has
+ *      too many parts.
+ *
+ *  Comments:
+ *      The part buffer is given to the uploading threads, so current is
+ *      left empty and there is no put area until another buffer is
+ *      obtained.
+ */
+bool S3UploadStreamBuf::SubmitPart()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (failed) return false;
+
+    if (parts.size() >= Max_Upload_Parts)
+    {
+        logger->error << "Object has more than " << Max_Upload_Parts
+                      << " parts; a larger part size is required"
+                      << std::flush;
+        failed = true;
+        cv.notify_all();
+        return false;
+    }
+
+    current.resize(static_cast<std::size_t>(pptr() - pbase()));
+    parts.emplace_back();
+    parts.back().number = parts.size();
+    pending.emplace_back(parts.size(), std::move(current));
+    current = {};
+    setp(nullptr, nullptr);
+    cv.notify_all();
+
+    return true;
+}
+
+/*
+ *  S3UploadStreamBuf::StopUploading()
+ *
+ *  Description:
+ *      Wait for the uploading threads to upload the parts queued, then stop
+ *      them.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+void S3UploadStreamBuf::StopUploading()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+        cv.notify_all();
+    }
+
+    for (std::thread &thread : threads)
+    {
+        if (thread.joinable()) thread.join();
+    }
+    threads.clear();
+}
+
+/*
+ *  S3UploadStreamBuf::Upload()
+ *
+ *  Description:
+ *      Upload queued parts until stopped and no parts remain.  This is run
+ *      by each uploading thread.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      Once any part fails, queued parts are discarded.
+ */
+void S3UploadStreamBuf::Upload()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true)
+    {
+        cv.wait(lock, [&]() -> bool { return stop || !pending.empty(); });
+        if (pending.empty()) break;
+
+        auto [number, data] = std::move(pending.front());
+        pending.pop_front();
+
+        S3Part part{number, {}, {}};
+        bool uploaded{};
+
+        if (!failed)
+        {
+            lock.unlock();
+            uploaded = client.UploadPart(location, upload_id, data, part);
+            lock.lock();
+        }
+
+        if (uploaded)
+        {
+            logger->info << "Uploaded part " << number << " ("
+                         << data.size() << " octets) of " << location.key
+                         << std::flush;
+            parts[number - 1] = std::move(part);
+        }
+        else
+        {
+            failed = true;
+        }
+
+        // Return the part buffer for reuse
+        free_buffers.push_back(std::move(data));
+        cv.notify_all();
+    }
+}
+
+/*
+ *  S3DownloadStreamBuf::S3DownloadStreamBuf()
+ *
+ *  Description:
+ *      Constructor for the S3DownloadStreamBuf object.
+ *
+ *  Parameters:
+ *      parent_logger [in]
+ *          A parent logger to which the child logger would direct logging
+ *          messages.
+ *
+ *      client [in]
+ *          The client used to perform requests.  This must remain valid for
+ *          the lifetime of this object.
+ *
+ *      location [in]
+ *          The object to download.
+ *
+ *      range_size [in]
+ *          The size of each range requested, except the last.
+ *
+ *      connections [in]
+ *          The number of ranges to download concurrently.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      The download does not start until Open() is called.
+ */
+S3DownloadStreamBuf::S3DownloadStreamBuf(
+    const Terra::Logger::LoggerPointer &parent_logger,
+    const S3Client &client,
+    const S3Location &location,
+    std::size_t range_size,
+    std::size_t connections) :
+    logger{std::make_shared<Terra::Logger::Logger>(parent_logger, "S3DL")},
+    client{client},
+    location{location},
+    range_size{std::max<std::size_t>(range_size, 1)},
+    connections{std::max<std::size_t>(connections, 1)},
+    size{0},
+    stop{false},
+    failed{false},
+    range_count{0},
+    next_request{0},
+    next_read{0}
+{
+}
+
+/*
+ *  S3DownloadStreamBuf::~S3DownloadStreamBuf()
+ *
+ *  Description:
+ *      Destructor for the S3DownloadStreamBuf object, which stops the
+ *      downloading threads.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+S3DownloadStreamBuf::~S3DownloadStreamBuf()
+{
+    StopDownloading();
+}
+
+/*
+ *  S3DownloadStreamBuf::Open()
+ *
+ *  Description:
+ *      Determine the size of the object and start the threads that
+ *      download it.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      True if the object exists, false if not.
+ *
+ *  Comments:
+ *      Ranges are requested with the object's ETag, so a download fails
+ *      rather than mixing versions if the object is replaced.
+ */
+bool S3DownloadStreamBuf::Open()
+{
+    if (!client.HeadObject(location, size, etag)) return false;
+
+    range_count = static_cast<std::size_t>((size + range_size - 1) /
+                                           range_size);
+
+    logger->info << "Downloading s3://" << location.bucket << "/"
+                 << location.key << " (" << size << " octets in "
+                 << range_count << " ranges)" << std::flush;
+
+    const std::size_t thread_count = std::min(connections, range_count);
+    for (std::size_t i = 0; i < thread_count; i++)
+    {
+        threads.emplace_back(&S3DownloadStreamBuf::Download, this);
+    }
+
+    return true;
+}
+
+/*
+ *  S3DownloadStreamBuf::Failed()
+ *
+ *  Description:
+ *      Report whether downloading any range failed.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      True if the download failed, false if not.
+ *
+ *  Comments:
+ *      A failed download appears to the reader as the end of the object.
+ */
+bool S3DownloadStreamBuf::Failed()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    return failed;
+}
+
+/*
+ *  S3DownloadStreamBuf::underflow()
+ *
+ *  Description:
+ *      Make the next range available for reading, waiting for it to be
+ *      downloaded if necessary.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      The next character, or EOF at the end of the object or if the
+ *      download failed.
+ *
+ *  Comments:
+ *      The range previously read is released, allowing another range to
+ *      be requested.
+ */
+S3DownloadStreamBuf::int_type S3DownloadStreamBuf::underflow()
+{
+    if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+
+    std::unique_lock<std::mutex> lock(mutex);
+
+    if (next_read >= range_count) return traits_type::eof();
+
+    cv.wait(lock,
+            [&]() -> bool { return failed || ranges.contains(next_read); });
+    if (failed) return traits_type::eof();
+
+    auto range = ranges.find(next_read);
+    current = std::move(range->second);
+    ranges.erase(range);
+    next_read++;
+    cv.notify_all();
+
+    lock.unlock();
+
+    setg(current.data(), current.data(), current.data() + current.size());
+
+    return traits_type::to_int_type(*gptr());
+}
+
+/*
+ *  S3DownloadStreamBuf::StopDownloading()
+ *
+ *  Description:
+ *      Stop the downloading threads.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      Ranges being downloaded are allowed to finish.
+ */
+void S3DownloadStreamBuf::StopDownloading()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+        cv.notify_all();
+    }
+
+    for (std::thread &thread : threads)
+    {
+        if (thread.joinable()) thread.join();
+    }
+    threads.clear();
+}
+
+/*
+ *  S3DownloadStreamBuf::Download()
+ *
+ *  Description:
+ *      Download ranges in order until all are requested, the download
+ *      fails, or this object is stopped.  This is run by each downloading
+ *      thread.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      A range is requested only if it is fewer than connections ranges
+ *      ahead of the range being read.
+ */
+void S3DownloadStreamBuf::Download()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true)
+    {
+        cv.wait(lock,
+                [&]() -> bool
+                {
+                    return stop || failed || (next_request >= range_count) ||
+                           (next_request < next_read + connections);
+                });
+        if (stop || failed || (next_request >= range_count)) break;
+
+        const std::size_t index = next_request++;
+        const std::uint64_t offset =
+            static_cast<std::uint64_t>(index) * range_size;
+        const std::size_t length =
+            static_cast<std::size_t>(std::min<std::uint64_t>(range_size,
+                                                             size - offset));
+        std::string data;
+
+        lock.unlock();
+        const bool downloaded =
+            client.GetObjectRange(location, etag, offset, length, data);
+        lock.lock();
+
+        if (!downloaded)
+        {
+            failed = true;
+            cv.notify_all();
+            break;
+        }
+
+        ranges.emplace(index, std::move(data));
+        cv.notify_all();
+    }
+}
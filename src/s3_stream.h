@@ -0,0 +1,178 @@
+/*
+ *  s3_stream.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file defines stream objects that write an object to
+ *      S3-compatible object storage as it is produced, or read an object as
+ *      it is downloaded.
+ *
+ *      Data written is collected into parts of a multipart upload, which
+ *      are uploaded by a pool of threads while later parts are being
+ *      produced.  At most one part more than the number of uploading threads
+ *      is held in memory.
+ *
+ *      Data read is downloaded in fixed-size ranges by a pool of threads.
+ *      Ranges may arrive in any order and are held until read in order.
+ *      Ranges are requested no further ahead of the range being read than
+ *      the number of downloading threads, which bounds the memory used.
+ *
+ *  Portability Issues:
+ *      This is built only if the aescrypt_cli_S3 CMake option is enabled.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <streambuf>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <terra/logger/logger.h>
+#include "s3_client.h"
+
+// Stream buffer that uploads data written to it as an object
+class S3UploadStreamBuf : public std::streambuf
+{
+    public:
+        S3UploadStreamBuf(const Terra::Logger::LoggerPointer &parent_logger,
+                          const S3Client &client,
+                          const S3Location &location,
+                          std::size_t part_size,
+                          std::size_t connections);
+        ~S3UploadStreamBuf();
+
+        bool Open();
+        bool Close();
+        void Abort();
+
+    protected:
+        int_type overflow(int_type c) override;
+        int sync() override;
+        bool SubmitPart();
+        void StopUploading();
+        void Upload();
+
+        Terra::Logger::LoggerPointer logger;
+        const S3Client &client;
+        S3Location location;
+        std::size_t part_size;
+        std::size_t connections;
+        std::string upload_id;
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool stop;
+        bool failed;
+        std::vector<char> current;              // Part being filled
+        std::deque<std::pair<std::size_t, std::vector<char>>> pending;
+        std::vector<std::vector<char>> free_buffers;
+        std::size_t buffer_count;               // Part buffers allocated
+        std::vector<S3Part> parts;              // Parts uploaded
+        std::vector<std::thread> threads;
+};
+
+// Output stream that uploads data written to it as an object
+class S3UploadStream : public std::ostream
+{
+    public:
+        S3UploadStream(const Terra::Logger::LoggerPointer &parent_logger,
+                       const S3Client &client,
+                       const S3Location &location,
+                       std::size_t part_size,
+                       std::size_t connections) :
+            std::ostream(nullptr),
+            upload_buffer(parent_logger,
+                          client,
+                          location,
+                          part_size,
+                          connections)
+        {
+            rdbuf(&upload_buffer);
+        }
+
+        bool Open() { return upload_buffer.Open(); }
+        bool Close() { return upload_buffer.Close(); }
+        void Abort() { upload_buffer.Abort(); }
+
+    protected:
+        S3UploadStreamBuf upload_buffer;
+};
+
+// Stream buffer that downloads an object as it is read
+class S3DownloadStreamBuf : public std::streambuf
+{
+    public:
+        S3DownloadStreamBuf(const Terra::Logger::LoggerPointer &parent_logger,
+                            const S3Client &client,
+                            const S3Location &location,
+                            std::size_t range_size,
+                            std::size_t connections);
+        ~S3DownloadStreamBuf();
+
+        bool Open();
+        std::uint64_t Size() const { return size; }
+        bool Failed();
+
+    protected:
+        int_type underflow() override;
+        void StopDownloading();
+        void Download();
+
+        Terra::Logger::LoggerPointer logger;
+        const S3Client &client;
+        S3Location location;
+        std::size_t range_size;
+        std::size_t connections;
+        std::uint64_t size;                     // Object size
+        std::string etag;                       // Object version
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool stop;
+        bool failed;
+        std::size_t range_count;                // Ranges in the object
+        std::size_t next_request;               // Next range to request
+        std::size_t next_read;                  // Next range to read
+        std::map<std::size_t, std::string> ranges; // Ranges awaiting reading
+        std::string current;                    // Range being read
+        std::vector<std::thread> threads;
+};
+
+// Input stream that downloads an object as it is read
+class S3DownloadStream : public std::istream
+{
+    public:
+        S3DownloadStream(const Terra::Logger::LoggerPointer &parent_logger,
+                         const S3Client &client,
+                         const S3Location &location,
+                         std::size_t range_size,
+                         std::size_t connections) :
+            std::istream(nullptr),
+            download_buffer(parent_logger,
+                            client,
+                            location,
+                            range_size,
+                            connections)
+        {
+            rdbuf(&download_buffer);
+        }
+
+        bool Open() { return download_buffer.Open(); }
+        std::uint64_t Size() const { return download_buffer.Size(); }
+        bool Failed() { return download_buffer.Failed(); }
+
+    protected:
+        S3DownloadStreamBuf download_buffer;
+};
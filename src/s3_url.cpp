@@ -0,0 +1,79 @@
+/*
+ *  s3_url.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file implements functions to recognize and parse the URLs naming
+ *      objects in object storage.
+ *
+ *  Portability Issues:
+ *      None.
+ */
+
+#include "s3_url.h"
+
+namespace
+{
+
+// Object URL scheme
+constexpr char S3_Scheme[] = "s3://";
+
+} // namespace
+
+/*
+ *  IsS3URL()
+ *
+ *  Description:
+ *      Determine whether the given name is an object URL (s3://...).
+ *
+ *  Parameters:
+ *      name [in]
+ *          The file name or URL.
+ *
+ *  Returns:
+ *      True if the name is an object URL, false if not.
+ *
+ *  Comments:
+ *      None.
+ */
+bool IsS3URL(const std::string &name)
+{
+    return name.rfind(S3_Scheme, 0) == 0;
+}
+
+/*
+ *  ParseS3URL()
+ *
+ *  Description:
+ *      Parse an object URL of the form s3://bucket/key.
+ *
+ *  Parameters:
+ *      url [in]
+ *          The URL to parse.
+ *
+ *  Returns:
+ *      The object location, or no value if the URL is not valid.
+ *
+ *  Comments:
+ *      None.
+ */
+std::optional<S3Location> ParseS3URL(const std::string &url)
+{
+    if (!IsS3URL(url)) return {};
+
+    const std::string path = url.substr(sizeof(S3_Scheme) - 1);
+    const std::size_t slash = path.find('/');
+    if ((slash == 0) || (slash == std::string::npos) ||
+        (slash + 1 == path.size()))
+    {
+        return {};
+    }
+
+    return S3Location{path.substr(0, slash), path.substr(slash + 1)};
+}
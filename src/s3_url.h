@@ -0,0 +1,67 @@
+/*
+ *  s3_url.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file defines functions to recognize and parse the URLs naming
+ *      objects in object storage (s3://bucket/key).  These are built even
+ *      if object storage support is not, so that such names are not
+ *      mistaken for file names.
+ *
+ *  Portability Issues:
+ *      None.
+ */
+
+#pragma once
+
+#include <optional>
+#include <string>
+
+// Location of an object
+struct S3Location
+{
+    std::string bucket;
+    std::string key;
+};
+
+/*
+ *  IsS3URL()
+ *
+ *  Description:
+ *      Determine whether the given name is an object URL (s3://...).
+ *
+ *  Parameters:
+ *      name [in]
+ *          The file name or URL.
+ *
+ *  Returns:
+ *      True if the name is an object URL, false if not.
+ *
+ *  Comments:
+ *      None.
+ */
+bool IsS3URL(const std::string &name);
+
+/*
+ *  ParseS3URL()
+ *
+ *  Description:
+ *      Parse an object URL of the form s3://bucket/key.
+ *
+ *  Parameters:
+ *      url [in]
+ *          The URL to parse.
+ *
+ *  Returns:
+ *      The object location, or no value if the URL is not valid.
+ *
+ *  Comments:
+ *      None.
+ */
+std::optional<S3Location> ParseS3URL(const std::string &url);
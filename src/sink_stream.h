@@ -0,0 +1,135 @@
+/*
+ *  sink_stream.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file defines the SinkStreamBuf and SinkOStream templates, which
+ *      present a sink type as a std::streambuf or std::ostream, and the
+ *      sinks used where only a property of the output is of interest:
+ *      NullSink, which discards data (e.g., when scrubbing files), and
+ *      HashSink, which computes the SHA-256 digest of data (e.g., when
+ *      verifying encryption).
+ *
+ *      A sink is specialized at compile time, so data written to the
+ *      stream buffer reaches the sink through a single virtual call that
+ *      is made once for each chunk written, with the sink's Write() called
+ *      directly.  A sink that discards data is identified via the constant
+ *      Discards, which removes even that call.
+ *
+ *      A sink provides:
+ *
+ *          static constexpr bool Discards;
+ *          bool Write(const char *data, std::size_t length);
+ *
+ *  Portability Issues:
+ *      None.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+#include <streambuf>
+#include <string_view>
+#include <utility>
+#include "digest.h"
+
+// Sink that discards data written to it
+class NullSink
+{
+    public:
+        static constexpr bool Discards = true;
+
+        bool Write(const char *, std::size_t) { return true; }
+};
+
+// Sink that computes the SHA-256 digest of data written to it
+class HashSink
+{
+    public:
+        static constexpr bool Discards = false;
+
+        bool Write(const char *data, std::size_t length)
+        {
+            sha256.Input(std::string_view(data, length));
+            return true;
+        }
+        SHA256Digest Digest() { return FinalizeSHA256(sha256); }
+
+    protected:
+        Terra::Crypto::Hashing::SHA256 sha256;
+};
+
+// Stream buffer that passes data written to it to a sink
+template<typename Sink>
+class SinkStreamBuf : public std::streambuf
+{
+    public:
+        template<typename... Args>
+        explicit SinkStreamBuf(Args &&...args) :
+            sink(std::forward<Args>(args)...)
+        {
+        }
+        ~SinkStreamBuf() = default;
+
+        Sink &GetSink() { return sink; }
+
+    protected:
+        int_type overflow(int_type c) override
+        {
+            if constexpr (!Sink::Discards)
+            {
+                if (!traits_type::eq_int_type(c, traits_type::eof()))
+                {
+                    const char character = traits_type::to_char_type(c);
+                    if (!sink.Write(&character, 1)) return traits_type::eof();
+                }
+            }
+
+            return traits_type::not_eof(c);
+        }
+        std::streamsize xsputn(const char_type *s,
+                               std::streamsize count) override
+        {
+            if constexpr (!Sink::Discards)
+            {
+                if ((count > 0) &&
+                    !sink.Write(s, static_cast<std::size_t>(count)))
+                {
+                    return 0;
+                }
+            }
+
+            return count;
+        }
+
+        Sink sink;
+};
+
+// Output stream that passes data written to it to a sink
+template<typename Sink>
+class SinkOStream : public std::ostream
+{
+    public:
+        template<typename... Args>
+        explicit SinkOStream(Args &&...args) :
+            std::ostream(nullptr),
+            sink_buffer(std::forward<Args>(args)...)
+        {
+            rdbuf(&sink_buffer);
+        }
+
+        Sink &GetSink() { return sink_buffer.GetSink(); }
+
+    protected:
+        SinkStreamBuf<Sink> sink_buffer;
+};
+
+// Output stream that discards data written to it
+using NullOStream = SinkOStream<NullSink>;
@@ -0,0 +1,493 @@
+/*
+ *  stream_scrubber.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file implements functions to check the integrity of an AES Crypt
+ *      stream without decrypting it.
+ *
+ *  Portability Issues:
+ *      None.
+ */
+
+#include <array>
+#include <cstring>
+#include <terra/crypto/cipher/aes.h>
+#include <terra/crypto/hashing/hmac.h>
+#include <terra/crypto/kdf/pbkdf2.h>
+#include <terra/secutil/secure_erase.h>
+#include "stream_scrubber.h"
+#include "aescrypt.h"
+
+namespace
+{
+
+// Octets in an AES block
+constexpr std::size_t AES_Block_Size = 16;
+
+// Octets in the key derived from the password and in the session key
+constexpr std::size_t Key_Size = 32;
+
+// Octets in the encrypted session IV and key
+constexpr std::size_t Session_Size = AES_Block_Size + Key_Size;
+
+// Octets in each HMAC
+constexpr std::size_t HMAC_Size = 32;
+
+/*
+ *  ReadOctets()
+ *
+ *  Description:
+ *      Read exactly the given number of octets from the input stream.
+ *
+ *  Parameters:
+ *      istream [in]
+ *          The input stream from which to read.
+ *
+ *      data [out]
+ *          The buffer to fill.
+ *
+ *  Returns:
+ *      True if the buffer was filled, false if not.
+ *
+ *  Comments:
+ *      None.
+ */
+bool ReadOctets(std::istream &istream, std::span<std::uint8_t> data)
+{
+    istream.read(reinterpret_cast<char *>(data.data()),
+                 static_cast<std::streamsize>(data.size()));
+
+    return istream.gcount() == static_cast<std::streamsize>(data.size());
+}
+
+/*
+ *  EqualOctets()
+ *
+ *  Description:
+ *      Compare two strings of octets in time that does not depend on where
+ *      they differ.
+ *
+ *  Parameters:
+ *      a [in]
+ *          The first string of octets.
+ *
+ *      b [in]
+ *          The second string of octets.
+ *
+ *  Returns:
+ *      True if the strings are equal, false if not.
+ *
+ *  Comments:
+ *      None.
+ */
+bool EqualOctets(std::span<const std::uint8_t> a,
+                 std::span<const std::uint8_t> b)
+{
+    std::uint8_t difference{};
+
+    if (a.size() != b.size()) return false;
+
+    for (std::size_t i = 0; i < a.size(); i++) difference |= a[i] ^ b[i];
+
+    return difference == 0;
+}
+
+/*
+ *  DecryptBlock()
+ *
+ *  Description:
+ *      Decrypt one block of AES-CBC ciphertext.
+ *
+ *  Parameters:
+ *      aes [in]
+ *          The AES object holding the key.
+ *
+ *      previous [in]
+ *          The previous block of ciphertext (or the IV for the first block).
+ *
+ *      ciphertext [in]
+ *          The block to decrypt.
+ *
+ *      plaintext [out]
+ *          The decrypted block.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+void DecryptBlock(Terra::Crypto::Cipher::AES &aes,
+                  const std::uint8_t *previous,
+                  const std::uint8_t *ciphertext,
+                  std::uint8_t *plaintext)
+{
+    aes.Decrypt(std::span<const std::uint8_t, AES_Block_Size>(ciphertext,
+                                                              AES_Block_Size),
+                std::span<std::uint8_t, AES_Block_Size>(plaintext,
+                                                        AES_Block_Size));
+
+    for (std::size_t i = 0; i < AES_Block_Size; i++)
+    {
+        plaintext[i] ^= previous[i];
+    }
+}
+
+} // namespace
+
+/*
+ *  PeekStreamVersion()
+ *
+ *  Description:
+ *      Read the AES Crypt stream version from the start of the given input
+ *      stream, then return to the start of the stream.
+ *
+ *  Parameters:
+ *      istream [in]
+ *          The input stream, which must support seeking.
+ *
+ *  Returns:
+ *      The stream version, or no value if the input does not start with an
+ *      AES Crypt signature or does not support seeking.
+ *
+ *  Comments:
+ *      If the input does not support seeking, nothing is read from it.
+ */
+std::optional<std::uint8_t> PeekStreamVersion(std::istream &istream)
+{
+    std::array<std::uint8_t, 4> header{};
+
+    // Only an input that supports seeking may be read and then rewound
+    const std::istream::pos_type start = istream.tellg();
+    if (start == std::istream::pos_type(-1))
+    {
+        istream.clear();
+        return {};
+    }
+
+    const bool complete = ReadOctets(istream, header);
+
+    istream.clear();
+    istream.seekg(start);
+
+    if (!complete || (std::memcmp(header.data(), "AES", 3) != 0)) return {};
+
+    return header[3];
+}
+
+/*
+ *  ScrubStream()
+ *
+ *  Description:
+ *      Check the integrity of a version 3 AES Crypt stream by computing its
+ *      HMAC over the ciphertext and checking the padding of the final block,
+ *      without decrypting the rest of the stream.
+ *
+ *  Parameters:
+ *      logger [in]
+ *          The logger to which logging output will be sent.
+ *
+ *      process_control [in]
+ *          Used to stop checking if termination is requested.
+ *
+ *      password [in]
+ *          The password (in UTF-8 encoding) used to encrypt the stream.
+ *
+ *      istream [in]
+ *          The input stream holding the AES Crypt stream.
+ *
+ *      buffer [in]
+ *          The buffer into which the ciphertext is read.
+ *
+ *  Returns:
+ *      The result of checking the stream.
+ *
+ *  Comments:
+ *      A version 3 stream holds the signature, version, and reserved octet,
+ *      extensions, the KDF iterations, the IV (which is also the KDF salt),
+ *      the session IV and key encrypted using the derived key, an HMAC over
+ *      those and the version, the ciphertext (padded per PKCS #7), and an
+ *      HMAC over the ciphertext using the session key.
+ */
+ScrubResult ScrubStream(const Terra::Logger::LoggerPointer &logger,
+                        const ProcessControl &process_control,
+                        const SecureU8String &password,
+                        std::istream &istream,
+                        std::span<char> buffer)
+{
+    using namespace Terra::Crypto;
+
+    std::array<std::uint8_t, 5> header{};
+    std::array<std::uint8_t, 4> iterations_octets{};
+    std::array<std::uint8_t, AES_Block_Size> iv{};
+    std::array<std::uint8_t, Session_Size> encrypted_session{};
+    std::array<std::uint8_t, HMAC_Size> expected_hmac{};
+    std::array<std::uint8_t, HMAC_Size> computed_hmac{};
+    std::array<std::uint8_t, Key_Size> key{};
+    std::array<std::uint8_t, Session_Size> session{};
+    std::array<std::uint8_t, 2 * AES_Block_Size> last_blocks{};
+    std::array<std::uint8_t, AES_Block_Size> last_plaintext{};
+
+    // The buffer holds the final HMAC while looking for the end of input
+    if (buffer.size() <= HMAC_Size) return ScrubResult::ReadError;
+
+    // Read the signature, version, and reserved octet
+    if (!ReadOctets(istream, header) ||
+        (std::memcmp(header.data(), "AES", 3) != 0))
+    {
+        return ScrubResult::InvalidHeader;
+    }
+    if (header[3] != Scrub_Stream_Version)
+    {
+        return ScrubResult::UnsupportedVersion;
+    }
+
+    // Skip over the extensions, which end with one of zero length
+    while (true)
+    {
+        std::array<std::uint8_t, 2> length_octets{};
+        if (!ReadOctets(istream, length_octets))
+        {
+            return ScrubResult::InvalidHeader;
+        }
+        const std::streamsize length =
+            (static_cast<std::streamsize>(length_octets[0]) << 8) |
+            length_octets[1];
+        if (length == 0) break;
+        istream.ignore(length);
+        if (istream.gcount() != length) return ScrubResult::InvalidHeader;
+    }
+
+    // Read the KDF iterations, IV, encrypted session IV and key, and HMAC
+    if (!ReadOctets(istream, iterations_octets) || !ReadOctets(istream, iv) ||
+        !ReadOctets(istream, encrypted_session) ||
+        !ReadOctets(istream, expected_hmac))
+    {
+        return ScrubResult::InvalidHeader;
+    }
+    const std::uint32_t iterations =
+        (static_cast<std::uint32_t>(iterations_octets[0]) << 24) |
+        (static_cast<std::uint32_t>(iterations_octets[1]) << 16) |
+        (static_cast<std::uint32_t>(iterations_octets[2]) << 8) |
+        static_cast<std::uint32_t>(iterations_octets[3]);
+    if ((iterations < KDF_Min_Iterations) || (iterations > KDF_Max_Iterations))
+    {
+        return ScrubResult::InvalidIterations;
+    }
+
+    // Derive the key from the password
+    KDF::PBKDF2(Hashing::HashAlgorithm::SHA512,
+                std::span<const std::uint8_t>(
+                    reinterpret_cast<const std::uint8_t *>(password.data()),
+                    password.size()),
+                iv,
+                iterations,
+                std::span<std::uint8_t>(key));
+
+    // Check the HMAC over the encrypted session IV and key and the version,
+    // which fails if the password is incorrect
+    {
+        Hashing::HMAC hmac(Hashing::HashAlgorithm::SHA256, key);
+        hmac.Input(encrypted_session);
+        hmac.Input(std::span<const std::uint8_t>(&header[3], 1));
+        hmac.Finalize();
+        hmac.Result(computed_hmac);
+    }
+    if (!EqualOctets(computed_hmac, expected_hmac))
+    {
+        Terra::SecUtil::SecureErase(key);
+        return ScrubResult::InvalidKey;
+    }
+
+    // Decrypt the session IV and key
+    {
+        Cipher::AES aes(key);
+        for (std::size_t i = 0; i < Session_Size; i += AES_Block_Size)
+        {
+            DecryptBlock(aes,
+                         (i == 0) ? iv.data()
+                                  : encrypted_session.data() + i -
+                                        AES_Block_Size,
+                         encrypted_session.data() + i,
+                         session.data() + i);
+        }
+    }
+    Terra::SecUtil::SecureErase(key);
+    const std::span<const std::uint8_t> session_iv(session.data(),
+                                                   AES_Block_Size);
+    const std::span<const std::uint8_t> session_key(
+        session.data() + AES_Block_Size,
+        Key_Size);
+
+    logger->debug << "Checking ciphertext using " << iterations
+                  << " KDF iterations" << std::flush;
+
+    // Compute the HMAC over the ciphertext, holding back the octets last
+    // read, since the final HMAC_Size octets of the input are the HMAC
+    Hashing::HMAC hmac(Hashing::HashAlgorithm::SHA256, session_key);
+    std::uint64_t ciphertext_length{};
+    std::size_t held{};
+    while (true)
+    {
+        if (process_control.Terminating())
+        {
+            Terra::SecUtil::SecureErase(session);
+            return ScrubResult::Cancelled;
+        }
+
+        istream.read(buffer.data() + held,
+                     static_cast<std::streamsize>(buffer.size() - held));
+        const std::size_t octets = static_cast<std::size_t>(istream.gcount());
+        if (octets == 0) break;
+
+        const std::size_t available = held + octets;
+        if (available <= HMAC_Size)
+        {
+            held = available;
+            continue;
+        }
+
+        // Add all but the last HMAC_Size octets to the HMAC
+        const std::size_t length = available - HMAC_Size;
+        const auto *ciphertext =
+            reinterpret_cast<const std::uint8_t *>(buffer.data());
+        hmac.Input(std::span<const std::uint8_t>(ciphertext, length));
+        ciphertext_length += length;
+
+        // Retain the last two blocks of ciphertext to check the padding
+        if (length >= last_blocks.size())
+        {
+            std::memcpy(last_blocks.data(),
+                        ciphertext + length - last_blocks.size(),
+                        last_blocks.size());
+        }
+        else
+        {
+            std::memmove(last_blocks.data(),
+                         last_blocks.data() + length,
+                         last_blocks.size() - length);
+            std::memcpy(last_blocks.data() + last_blocks.size() - length,
+                        ciphertext,
+                        length);
+        }
+
+        std::memmove(buffer.data(), buffer.data() + length, HMAC_Size);
+        held = HMAC_Size;
+    }
+    if (istream.bad())
+    {
+        Terra::SecUtil::SecureErase(session);
+        return ScrubResult::ReadError;
+    }
+
+    // The ciphertext must be whole blocks followed by the HMAC
+    hmac.Finalize();
+    hmac.Result(computed_hmac);
+    if ((held < HMAC_Size) || (ciphertext_length < AES_Block_Size) ||
+        ((ciphertext_length % AES_Block_Size) != 0) ||
+        !EqualOctets(computed_hmac,
+                     std::span<const std::uint8_t>(
+                         reinterpret_cast<const std::uint8_t *>(buffer.data()),
+                         HMAC_Size)))
+    {
+        Terra::SecUtil::SecureErase(session);
+        return ScrubResult::AlteredStream;
+    }
+
+    // Decrypt only the final block to check its padding
+    {
+        Cipher::AES aes(session_key);
+        DecryptBlock(aes,
+                     (ciphertext_length > AES_Block_Size) ? last_blocks.data()
+                                                          : session_iv.data(),
+                     last_blocks.data() + AES_Block_Size,
+                     last_plaintext.data());
+    }
+    Terra::SecUtil::SecureErase(session);
+
+    const std::uint8_t padding = last_plaintext[AES_Block_Size - 1];
+    bool valid_padding = (padding > 0) && (padding <= AES_Block_Size);
+    for (std::size_t i = AES_Block_Size - (valid_padding ? padding : 0);
+         i < AES_Block_Size;
+         i++)
+    {
+        valid_padding = valid_padding && (last_plaintext[i] == padding);
+    }
+    Terra::SecUtil::SecureErase(last_plaintext);
+
+    return valid_padding ? ScrubResult::Success : ScrubResult::InvalidPadding;
+}
+
+/*
+ *  operator<<()
+ *
+ *  Description:
+ *      Write a description of the given scrub result to the output stream.
+ *
+ *  Parameters:
+ *      o [in]
+ *          The output stream to which the description is written.
+ *
+ *      result [in]
+ *          The result to describe.
+ *
+ *  Returns:
+ *      The output stream.
+ *
+ *  Comments:
+ *      None.
+ */
+std::ostream &operator<<(std::ostream &o, const ScrubResult result)
+{
+    switch (result)
+    {
+        case ScrubResult::Success:
+            o << "Success";
+            break;
+
+        case ScrubResult::InvalidHeader:
+            o << "Invalid or truncated AES Crypt stream header";
+            break;
+
+        case ScrubResult::UnsupportedVersion:
+            o << "Unsupported AES Crypt stream version";
+            break;
+
+        case ScrubResult::InvalidIterations:
+            o << "Invalid number of KDF iterations";
+            break;
+
+        case ScrubResult::InvalidKey:
+            o << "Invalid password or corrupted stream header";
+            break;
+
+        case ScrubResult::AlteredStream:
+            o << "Message altered, truncated, or corrupted";
+            break;
+
+        case ScrubResult::InvalidPadding:
+            o << "Invalid padding in final block";
+            break;
+
+        case ScrubResult::ReadError:
+            o << "Error reading the stream";
+            break;
+
+        case ScrubResult::Cancelled:
+            o << "Check cancelled";
+            break;
+
+        default:
+            o << "Unknown result";
+            break;
+    }
+
+    return o;
+}
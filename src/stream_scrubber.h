@@ -0,0 +1,130 @@
+/*
+ *  stream_scrubber.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file defines functions to check the integrity of an AES Crypt
+ *      stream without decrypting it.  In a version 3 stream, the HMAC that
+ *      ends the stream covers the ciphertext, so after deriving the key and
+ *      unwrapping the session key, the integrity of the stream is checked by
+ *      computing the HMAC over the ciphertext and decrypting only the final
+ *      block to check its padding.  This avoids decrypting every block, as
+ *      full decryption would.
+ *
+ *      Earlier stream versions are checked by decrypting them.
+ *
+ *  Portability Issues:
+ *      None.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <terra/logger/logger.h>
+#include "secure_containers.h"
+#include "process_control.h"
+
+// Stream version whose integrity may be checked without decrypting it
+constexpr std::uint8_t Scrub_Stream_Version = 3;
+
+// Result of checking the integrity of a stream
+enum class ScrubResult
+{
+    Success,
+    InvalidHeader,
+    UnsupportedVersion,
+    InvalidIterations,
+    InvalidKey,
+    AlteredStream,
+    InvalidPadding,
+    ReadError,
+    Cancelled
+};
+
+/*
+ *  PeekStreamVersion()
+ *
+ *  Description:
+ *      Read the AES Crypt stream version from the start of the given input
+ *      stream, then return to the start of the stream.
+ *
+ *  Parameters:
+ *      istream [in]
+ *          The input stream, which must support seeking.
+ *
+ *  Returns:
+ *      The stream version, or no value if the input does not start with an
+ *      AES Crypt signature or does not support seeking.
+ *
+ *  Comments:
+ *      If the input does not support seeking, nothing is read from it.
+ */
+std::optional<std::uint8_t> PeekStreamVersion(std::istream &istream);
+
+/*
+ *  ScrubStream()
+ *
+ *  Description:
+ *      Check the integrity of a version 3 AES Crypt stream by computing its
+ *      HMAC over the ciphertext and checking the padding of the final block,
+ *      without decrypting the rest of the stream.
+ *
+ *  Parameters:
+ *      logger [in]
+ *          The logger to which logging output will be sent.
+ *
+ *      process_control [in]
+ *          Used to stop checking if termination is requested.
+ *
+ *      password [in]
+ *          The password (in UTF-8 encoding) used to encrypt the stream.
+ *
+ *      istream [in]
+ *          The input stream holding the AES Crypt stream.
+ *
+ *      buffer [in]
+ *          The buffer into which the ciphertext is read.
+ *
+ *  Returns:
+ *      The result of checking the stream.
+ *
+ *  Comments:
+ *      Use PeekStreamVersion() to determine whether a stream may be checked
+ *      this way.
+ */
+ScrubResult ScrubStream(const Terra::Logger::LoggerPointer &logger,
+                        const ProcessControl &process_control,
+                        const SecureU8String &password,
+                        std::istream &istream,
+                        std::span<char> buffer);
+
+/*
+ *  operator<<()
+ *
+ *  Description:
+ *      Write a description of the given scrub result to the output stream.
+ *
+ *  Parameters:
+ *      o [in]
+ *          The output stream to which the description is written.
+ *
+ *      result [in]
+ *          The result to describe.
+ *
+ *  Returns:
+ *      The output stream.
+ *
+ *  Comments:
+ *      None.
+ */
+std::ostream &operator<<(std::ostream &o, const ScrubResult result);
@@ -0,0 +1,476 @@
+/*
+ *  stream_splitter.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file implements the StreamSplitter object, which splits input
+ *      containing AES Crypt streams written back-to-back into the individual
+ *      streams.
+ *
+ *  Portability Issues:
+ *      None.
+ */
+
+#include <cstdint>
+#include <algorithm>
+#include "stream_splitter.h"
+
+namespace
+{
+
+// Length of the signature and version that begin each stream ("AES", the
+// version, and the reserved octet or, for version 0, the length modulo 16)
+constexpr std::size_t Signature_Length = 5;
+
+// Size of an AES block, by which ciphertext is aligned
+constexpr std::size_t AES_Block_Size = 16;
+
+// Length of the fields that follow the extensions in the header, being the
+// IV, the encrypted session IV and key, and the HMAC over them
+constexpr std::size_t Session_Key_Length = 16 + 48 + 32;
+
+// Length of the HMAC that ends each stream
+constexpr std::size_t HMAC_Length = 32;
+
+// Result of examining the header of a stream
+enum class HeaderResult
+{
+    Complete,
+    NeedMoreData,
+    Invalid
+};
+
+/*
+ *  ReadExtensionLength()
+ *
+ *  Description:
+ *      Read the big-endian length of the extension at the given offset.
+ *
+ *  Parameters:
+ *      stream [in]
+ *          The stream containing the extension.
+ *
+ *      offset [in]
+ *          The offset of the extension, which must be followed by at least
+ *          two octets.
+ *
+ *  Returns:
+ *      The length of the extension, not including the length itself.
+ *
+ *  Comments:
+ *      None.
+ */
+std::size_t ReadExtensionLength(std::span<const char> stream,
+                                std::size_t offset)
+{
+    return (static_cast<std::size_t>(
+                static_cast<std::uint8_t>(stream[offset])) << 8) |
+           static_cast<std::uint8_t>(stream[offset + 1]);
+}
+
+/*
+ *  FindFirstBoundary()
+ *
+ *  Description:
+ *      Examine the header of the stream at the start of the given data to
+ *      determine the first offset at which the next stream may start.
+ *
+ *  Parameters:
+ *      stream [in]
+ *          The data beginning with the stream's header.
+ *
+ *      boundary [out]
+ *          The offset following the header, the smallest ciphertext
+ *          permitted, and the trailer.
+ *
+ *  Returns:
+ *      Complete if the boundary was determined, NeedMoreData if the header
+ *      is not yet complete, or Invalid if the data is not an AES Crypt
+ *      stream.
+ *
+ *  Comments:
+ *      The ciphertext is a multiple of the AES block size, so subsequent
+ *      boundaries are found at multiples of the block size from this one.
+ */
+HeaderResult FindFirstBoundary(std::span<const char> stream,
+                               std::size_t &boundary)
+{
+    std::size_t header_length{};
+    std::size_t minimum_ciphertext{};
+    std::size_t trailer_length{};
+
+    if (stream.size() < Signature_Length) return HeaderResult::NeedMoreData;
+
+    if ((stream[0] != 'A') || (stream[1] != 'E') || (stream[2] != 'S'))
+    {
+        return HeaderResult::Invalid;
+    }
+
+    const auto version = static_cast<std::uint8_t>(stream[3]);
+
+    switch (version)
+    {
+        case 0:
+            // Signature, IV, ciphertext, and HMAC
+            header_length = Signature_Length + 16;
+            trailer_length = HMAC_Length;
+            break;
+
+        case 1:
+            // Signature, session key, ciphertext, length modulo 16, and HMAC
+            header_length = Signature_Length + Session_Key_Length;
+            trailer_length = 1 + HMAC_Length;
+            break;
+
+        case 2:
+        case 3:
+        {
+            // Extensions follow the signature, ending with an empty one
+            std::size_t offset = Signature_Length;
+            while (true)
+            {
+                if (offset + 2 > stream.size())
+                {
+                    return HeaderResult::NeedMoreData;
+                }
+                std::size_t length = ReadExtensionLength(stream, offset);
+                offset += 2 + length;
+                if (length == 0) break;
+            }
+
+            if (version == 2)
+            {
+                // Session key, ciphertext, length modulo 16, and HMAC
+                header_length = offset + Session_Key_Length;
+                trailer_length = 1 + HMAC_Length;
+            }
+            else
+            {
+                // KDF iterations, session key, padded ciphertext, and HMAC
+                header_length = offset + 4 + Session_Key_Length;
+                minimum_ciphertext = AES_Block_Size;
+                trailer_length = HMAC_Length;
+            }
+            break;
+        }
+
+        default:
+            return HeaderResult::Invalid;
+    }
+
+    boundary = header_length + minimum_ciphertext + trailer_length;
+
+    return HeaderResult::Complete;
+}
+
+} // namespace
+
+/*
+ *  StreamSplitter::StreamSplitter()
+ *
+ *  Description:
+ *      Constructor for the StreamSplitter object.
+ *
+ *  Parameters:
+ *      istream [in]
+ *          The input stream containing the AES Crypt streams.  This must
+ *          remain valid for the lifetime of this object.
+ *
+ *      read_size [in]
+ *          The number of octets to read from the input at once.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+StreamSplitter::StreamSplitter(std::istream &istream, std::size_t read_size) :
+    istream{istream},
+    read_size{std::max<std::size_t>(read_size, Signature_Length)},
+    end_of_input{false},
+    failed{false}
+{
+}
+
+/*
+ *  StreamSplitter::Next()
+ *
+ *  Description:
+ *      Return the next AES Crypt stream from the input.
+ *
+ *  Parameters:
+ *      stream [out]
+ *          The stream, including its header and trailer.
+ *
+ *  Returns:
+ *      True if a stream was returned, false if there is no more input.
+ *
+ *  Comments:
+ *      If the input does not begin with a recognizable header, the rest of
+ *      the input is returned as a single stream so that the caller reports
+ *      the failure to decrypt it.  The stream is not known to be complete
+ *      until the next one is found, so this may wait for more input.
+ */
+bool StreamSplitter::Next(std::vector<char> &stream)
+{
+    std::size_t boundary{};
+    HeaderResult header_result{};
+
+    stream.clear();
+
+    // Ensure there is input
+    while (data.empty())
+    {
+        if (!Fill()) return false;
+    }
+
+    // Determine where the stream may end
+    while (true)
+    {
+        header_result = FindFirstBoundary(data, boundary);
+        if ((header_result != HeaderResult::NeedMoreData) || !Fill()) break;
+    }
+
+    // If the header is not recognized, the stream continues to the end of
+    // the input
+    if (header_result != HeaderResult::Complete)
+    {
+        while (Fill()) {}
+        boundary = data.size();
+    }
+    else
+    {
+        boundary = FindSignature(boundary);
+    }
+
+    const auto end = data.begin() + static_cast<std::ptrdiff_t>(boundary);
+    stream.assign(data.begin(), end);
+    data.erase(data.begin(), end);
+
+    return true;
+}
+
+/*
+ *  StreamSplitter::PeekExtension()
+ *
+ *  Description:
+ *      Return the input from the boundary that ended the stream last
+ *      returned up to the next boundary at the same alignment, without
+ *      consuming it.  This is used when the stream last returned fails to
+ *      decrypt, as the boundary that ended it may have been false.
+ *
+ *  Parameters:
+ *      extension [out]
+ *          The input that would extend the stream to the next boundary.
+ *
+ *  Returns:
+ *      True if there is input to extend the stream, false if not.
+ *
+ *  Comments:
+ *      Call Discard() to consume the extension if it is used.
+ */
+bool StreamSplitter::PeekExtension(std::vector<char> &extension)
+{
+    extension.clear();
+
+    // Ensure there is input
+    while (data.empty())
+    {
+        if (!Fill()) return false;
+    }
+
+    const std::size_t length = FindSignature(AES_Block_Size);
+    extension.assign(data.begin(),
+                     data.begin() + static_cast<std::ptrdiff_t>(length));
+
+    return true;
+}
+
+/*
+ *  StreamSplitter::Discard()
+ *
+ *  Description:
+ *      Consume the given number of octets of buffered input.
+ *
+ *  Parameters:
+ *      length [in]
+ *          The number of octets to consume, which is typically the size of
+ *          an extension returned by PeekExtension().
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+void StreamSplitter::Discard(std::size_t length)
+{
+    const auto end = data.begin() +
+                     static_cast<std::ptrdiff_t>(std::min(length, data.size()));
+    data.erase(data.begin(), end);
+}
+
+/*
+ *  StreamSplitter::FindExtension()
+ *
+ *  Description:
+ *      Find the value of the extension having the given identifier in the
+ *      header of an AES Crypt stream.
+ *
+ *  Parameters:
+ *      stream [in]
+ *          The stream, beginning with its header.
+ *
+ *      identifier [in]
+ *          The identifier of the extension.
+ *
+ *  Returns:
+ *      The value of the extension, or no value if the stream does not have
+ *      the extension.
+ *
+ *  Comments:
+ *      Only streams of version 2 or later have extensions.  Extensions are
+ *      neither encrypted nor authenticated.
+ */
+std::optional<std::string> StreamSplitter::FindExtension(
+    std::span<const char> stream,
+    const std::string &identifier)
+{
+    if ((stream.size() < Signature_Length) || (stream[0] != 'A') ||
+        (stream[1] != 'E') || (stream[2] != 'S') ||
+        (static_cast<std::uint8_t>(stream[3]) < 2))
+    {
+        return {};
+    }
+
+    std::size_t offset = Signature_Length;
+    while (offset + 2 <= stream.size())
+    {
+        std::size_t length = ReadExtensionLength(stream, offset);
+        offset += 2;
+        if ((length == 0) || (offset + length > stream.size())) break;
+
+        // The extension is the identifier and value separated by a NUL
+        std::string_view extension(stream.data() + offset, length);
+        std::size_t separator = extension.find('\0');
+        if ((separator != std::string_view::npos) &&
+            (extension.substr(0, separator) == identifier))
+        {
+            return std::string(extension.substr(separator + 1));
+        }
+
+        offset += length;
+    }
+
+    return {};
+}
+
+/*
+ *  StreamSplitter::Fill()
+ *
+ *  Description:
+ *      Read more input.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      True if input was read, false at the end of the input.
+ *
+ *  Comments:
+ *      A read error is treated as the end of the input and noted so that
+ *      it may be reported.
+ */
+bool StreamSplitter::Fill()
+{
+    if (end_of_input) return false;
+
+    const std::size_t length = data.size();
+    data.resize(length + read_size);
+    istream.read(data.data() + length, static_cast<std::streamsize>(read_size));
+    const auto octets_read = static_cast<std::size_t>(istream.gcount());
+    data.resize(length + octets_read);
+
+    if (!istream.good())
+    {
+        end_of_input = true;
+        if (istream.bad()) failed = true;
+    }
+
+    return octets_read > 0;
+}
+
+/*
+ *  StreamSplitter::FindSignature()
+ *
+ *  Description:
+ *      Find the first signature in the input at or after the given offset
+ *      and at a multiple of the AES block size from it, reading more input
+ *      as necessary.
+ *
+ *  Parameters:
+ *      offset [in]
+ *          The first offset into the buffered input to examine.
+ *
+ *  Returns:
+ *      The offset of the signature, or the length of the input if there is
+ *      no signature.
+ *
+ *  Comments:
+ *      None.
+ */
+std::size_t StreamSplitter::FindSignature(std::size_t offset)
+{
+    while (true)
+    {
+        if (offset + Signature_Length > data.size())
+        {
+            if (Fill()) continue;
+            return data.size();
+        }
+
+        if (IsSignature(offset)) return offset;
+
+        offset += AES_Block_Size;
+    }
+}
+
+/*
+ *  StreamSplitter::IsSignature()
+ *
+ *  Description:
+ *      Determine whether a stream appears to begin at the given offset.
+ *
+ *  Parameters:
+ *      offset [in]
+ *          The offset into the buffered input, which must be followed by at
+ *          least Signature_Length octets.
+ *
+ *  Returns:
+ *      True if the octets at the offset are a valid signature and version.
+ *
+ *  Comments:
+ *      For version 0, the octet following the version is the length of the
+ *      plaintext modulo 16; for later versions it is reserved and zero.
+ */
+bool StreamSplitter::IsSignature(std::size_t offset) const
+{
+    if ((data[offset] != 'A') || (data[offset + 1] != 'E') ||
+        (data[offset + 2] != 'S'))
+    {
+        return false;
+    }
+
+    const auto version = static_cast<std::uint8_t>(data[offset + 3]);
+    const auto next = static_cast<std::uint8_t>(data[offset + 4]);
+
+    return ((version == 0) && (next < 16)) ||
+           ((version >= 1) && (version <= 3) && (next == 0));
+}
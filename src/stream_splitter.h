@@ -0,0 +1,68 @@
+/*
+ *  stream_splitter.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file defines the StreamSplitter object, which splits input
+ *      containing AES Crypt streams written back-to-back into the individual
+ *      streams.
+ *
+ *      An AES Crypt stream does not record its own length, so the end of a
+ *      stream is found by the start of the next one.  The header of each
+ *      stream is parsed to learn where its ciphertext begins and how long
+ *      its trailer is, and the next stream is expected only where the
+ *      ciphertext would end on an AES block boundary.  At each such offset
+ *      the input is checked for an AES Crypt signature and version.
+ *
+ *      Since ciphertext may contain what appears to be a signature, a
+ *      reported boundary may be false.  The caller can detect this, as the
+ *      stream will not decrypt, and extend the stream to the next boundary
+ *      found at the same alignment.
+ *
+ *  Portability Issues:
+ *      None.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <istream>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Splits input into back-to-back AES Crypt streams
+class StreamSplitter
+{
+    public:
+        StreamSplitter(std::istream &istream, std::size_t read_size);
+        ~StreamSplitter() = default;
+
+        bool Next(std::vector<char> &stream);
+        bool PeekExtension(std::vector<char> &extension);
+        void Discard(std::size_t length);
+        bool Failed() const { return failed; }
+
+        static std::optional<std::string> FindExtension(
+            std::span<const char> stream,
+            const std::string &identifier);
+
+    protected:
+        bool Fill();
+        std::size_t FindSignature(std::size_t offset);
+        bool IsSignature(std::size_t offset) const;
+
+        std::istream &istream;
+        std::size_t read_size;
+        std::vector<char> data;                 // Input not yet returned
+        bool end_of_input;
+        bool failed;
+};
@@ -0,0 +1,449 @@
+/*
+ *  system_resources.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file implements functions to determine the processor and memory
+ *      resources available to the process (observing container limits) and
+ *      to size concurrent file processing to fit within those resources.
+ *
+ *  Portability Issues:
+ *      Control group (cgroup v2) limits are observed only on Linux.
+ */
+
+#include <thread>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#ifdef __linux__
+#include <sched.h>
+#endif
+#include "system_resources.h"
+
+namespace
+{
+
+// Estimate of the memory used by the AES Crypt Engine for each concurrent
+// encryption or decryption operation (beyond the I/O buffers)
+constexpr std::uint64_t Engine_Memory_Estimate = 262'144;
+
+// Estimate of memory used by the process independent of concurrent jobs
+constexpr std::uint64_t Process_Memory_Estimate = 16'777'216;
+
+#ifdef __linux__
+// Root of the cgroup v2 unified hierarchy
+constexpr char CGroup_Root[] = "/sys/fs/cgroup";
+
+/*
+ *  ReadFirstLine()
+ *
+ *  Description:
+ *      Read the first line of the given file.
+ *
+ *  Parameters:
+ *      path [in]
+ *          The file to read.
+ *
+ *      line [out]
+ *          The line read from the file.
+ *
+ *  Returns:
+ *      True if a line was read, false if the file could not be read.
+ *
+ *  Comments:
+ *      None.
+ */
+bool ReadFirstLine(const std::filesystem::path &path, std::string &line)
+{
+    std::ifstream stream(path);
+
+    return stream.is_open() && static_cast<bool>(std::getline(stream, line));
+}
+
+/*
+ *  GetCGroupPaths()
+ *
+ *  Description:
+ *      Return the directories of the process's cgroup v2 control group and
+ *      each of its ancestors, since limits on any ancestor also apply.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      The control group directories, starting with the process's own
+ *      group.  This is empty if the unified hierarchy is not in use.
+ *
+ *  Comments:
+ *      Within a container having its own cgroup namespace, the process's
+ *      group is reported as "/", which is the container's group.
+ */
+std::vector<std::filesystem::path> GetCGroupPaths()
+{
+    std::vector<std::filesystem::path> paths;
+    std::ifstream stream("/proc/self/cgroup");
+    std::string line;
+
+    // The unified hierarchy is identified by the line "0::<path>"
+    while (std::getline(stream, line))
+    {
+        if (line.rfind("0::", 0) != 0) continue;
+
+        std::filesystem::path group = line.substr(3);
+
+        while (true)
+        {
+            paths.push_back(std::filesystem::path(CGroup_Root) /
+                            group.relative_path());
+            if (!group.has_relative_path()) break;
+            group = group.parent_path();
+        }
+
+        break;
+    }
+
+    return paths;
+}
+
+/*
+ *  GetCGroupCPULimit()
+ *
+ *  Description:
+ *      Determine the number of processors permitted by the cgroup v2
+ *      "cpu.max" quota.
+ *
+ *  Parameters:
+ *      paths [in]
+ *          The control group directories to inspect.
+ *
+ *  Returns:
+ *      The number of processors (rounded up) permitted by the most
+ *      restrictive quota, or zero if there is no quota.
+ *
+ *  Comments:
+ *      The cpu.max file contains "<quota> <period>" or "max <period>".
+ */
+std::size_t GetCGroupCPULimit(const std::vector<std::filesystem::path> &paths)
+{
+    std::size_t limit = 0;
+
+    for (const auto &path : paths)
+    {
+        std::string line;
+        std::string quota;
+        std::uint64_t period{};
+
+        if (!ReadFirstLine(path / "cpu.max", line)) continue;
+
+        std::istringstream values(line);
+        values >> quota >> period;
+        if (!values || (quota == "max") || (period == 0)) continue;
+
+        std::uint64_t quota_value{};
+        try
+        {
+            quota_value = std::stoull(quota);
+        }
+        catch (...)
+        {
+            continue;
+        }
+
+        // Round partial processors up (e.g., 1.5 processors -> 2)
+        const auto cpus = static_cast<std::size_t>(
+            std::max<std::uint64_t>(1, (quota_value + period - 1) / period));
+
+        limit = (limit == 0) ? cpus : std::min(limit, cpus);
+    }
+
+    return limit;
+}
+
+/*
+ *  GetCGroupMemoryLimit()
+ *
+ *  Description:
+ *      Determine the memory limit imposed by the cgroup v2 "memory.max"
+ *      setting.
+ *
+ *  Parameters:
+ *      paths [in]
+ *          The control group directories to inspect.
+ *
+ *  Returns:
+ *      The most restrictive memory limit in octets, or zero if there is
+ *      no limit.
+ *
+ *  Comments:
+ *      None.
+ */
+std::uint64_t GetCGroupMemoryLimit(
+    const std::vector<std::filesystem::path> &paths)
+{
+    std::uint64_t limit = 0;
+
+    for (const auto &path : paths)
+    {
+        std::string line;
+
+        if (!ReadFirstLine(path / "memory.max", line) || (line == "max"))
+        {
+            continue;
+        }
+
+        try
+        {
+            const std::uint64_t value = std::stoull(line);
+            limit = (limit == 0) ? value : std::min(limit, value);
+        }
+        catch (...)
+        {
+            continue;
+        }
+    }
+
+    return limit;
+}
+#endif
+
+} // namespace
+
+/*
+ *  GetSystemResources()
+ *
+ *  Description:
+ *      Determine the number of processors and amount of memory available to
+ *      this process.  On Linux, this observes the process's CPU affinity
+ *      mask and the cgroup v2 "cpu.max" and "memory.max" limits of the
+ *      process's control group and each of its ancestors.
+ *
+ *  Parameters:
+ *      logger [in]
+ *          The logger to which logging output will be sent.
+ *
+ *  Returns:
+ *      The resources available to the process.  The CPU count is always at
+ *      least 1.
+ *
+ *  Comments:
+ *      None.
+ */
+SystemResources GetSystemResources(const Terra::Logger::LoggerPointer &logger)
+{
+    SystemResources resources{std::thread::hardware_concurrency(), 0};
+
+#ifdef __linux__
+    // Observe the CPU affinity mask (e.g., taskset or cpuset restrictions)
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set) == 0)
+    {
+        const auto affinity_cpus =
+            static_cast<std::size_t>(CPU_COUNT(&cpu_set));
+        if (affinity_cpus > 0)
+        {
+            resources.cpu_count = (resources.cpu_count == 0)
+                                      ? affinity_cpus
+                                      : std::min(resources.cpu_count,
+                                                 affinity_cpus);
+        }
+    }
+
+    // Observe control group limits
+    const auto cgroup_paths = GetCGroupPaths();
+    const std::size_t cpu_limit = GetCGroupCPULimit(cgroup_paths);
+    if (cpu_limit > 0)
+    {
+        logger->info << "Control group CPU quota permits " << cpu_limit
+                     << " processors" << std::flush;
+        resources.cpu_count = (resources.cpu_count == 0)
+                                  ? cpu_limit
+                                  : std::min(resources.cpu_count, cpu_limit);
+    }
+
+    resources.memory_limit = GetCGroupMemoryLimit(cgroup_paths);
+    if (resources.memory_limit > 0)
+    {
+        logger->info << "Control group memory limit is "
+                     << resources.memory_limit << " octets" << std::flush;
+    }
+#endif
+
+    // There is always at least one processor
+    if (resources.cpu_count == 0) resources.cpu_count = 1;
+
+    logger->info << "Available processors: " << resources.cpu_count
+                 << std::flush;
+
+    return resources;
+}
+
+/*
+ *  SizeBatchResources()
+ *
+ *  Description:
+ *      Determine the number of concurrent jobs and the I/O buffer size to
+ *      use so that processing fits within the available processors and
+ *      memory budget.
+ *
+ *  Parameters:
+ *      logger [in]
+ *          The logger to which logging output will be sent.
+ *
+ *      resources [in]
+ *          The resources available to the process.
+ *
+ *      requested_jobs [in]
+ *          The number of concurrent jobs requested, or zero to use one job
+ *          per available processor.
+ *
+ *      max_memory [in]
+ *          The user-specified memory budget in octets, or zero if none.
+ *
+ *      file_count [in]
+ *          The number of files to be processed.
+ *
+ *      batch_options [in/out]
+ *          The batch options whose "jobs" and "io_buffer_size" members (and
+ *          "spool_memory" member, when holding verified output) are
+ *          assigned.  When files are objects, "s3_connections" may be
+ *          reduced.
+ *
+ *  Returns:
+ *      True if processing fits within the memory budget, false if the
+ *      budget is too small to process even a single file.
+ *
+ *  Comments:
+ *      The memory budget is the lesser of max_memory and the control group
+ *      memory limit.  I/O buffers are reduced in size before the number of
+ *      concurrent jobs is reduced.  A job transferring an object holds a
+ *      part or range for each connection plus one more; when any file is an
+ *      object, this is counted for every job.  Output held until it is
+ *      verified is given the memory the jobs leave; without max_memory, no
+ *      more than Default_Spool_Memory.
+ */
+bool SizeBatchResources(const Terra::Logger::LoggerPointer &logger,
+                        const SystemResources &resources,
+                        std::size_t requested_jobs,
+                        std::uint64_t max_memory,
+                        std::size_t file_count,
+                        BatchOptions &batch_options)
+{
+    // Determine the number of jobs, which never exceeds the number of files
+    std::size_t jobs =
+        (requested_jobs == 0) ? resources.cpu_count : requested_jobs;
+    jobs = std::clamp<std::size_t>(jobs,
+                                   1,
+                                   std::max<std::size_t>(file_count, 1));
+
+    // Scrubbing only reads input, so it uses larger buffers
+    std::size_t buffer_size =
+        batch_options.scrub ? Scrub_IO_Size : Buffered_IO_Size;
+
+    // Determine the memory budget
+    std::uint64_t budget = max_memory;
+    if (resources.memory_limit > 0)
+    {
+        budget = (budget == 0) ? resources.memory_limit
+                               : std::min(budget, resources.memory_limit);
+    }
+
+    if (budget > 0)
+    {
+        // Each job uses a read buffer, a write buffer, and engine memory,
+        // plus the parts or ranges held for each object storage connection
+        // and the one being written or read
+        auto job_memory = [&](std::size_t size) -> std::uint64_t
+        {
+            std::uint64_t memory = 2 * static_cast<std::uint64_t>(size) +
+                                   Engine_Memory_Estimate;
+            if (batch_options.object_storage)
+            {
+                memory += static_cast<std::uint64_t>(
+                              batch_options.s3_connections + 1) *
+                          batch_options.s3_part_size;
+            }
+            return memory;
+        };
+
+        // Memory available for concurrent jobs
+        const std::uint64_t job_budget =
+            (budget > Process_Memory_Estimate)
+                ? budget - Process_Memory_Estimate
+                : 0;
+
+        // Reduce the buffer size until the jobs fit (or the minimum is hit)
+        while ((buffer_size > Min_Buffered_IO_Size) &&
+               (jobs * job_memory(buffer_size) > job_budget))
+        {
+            buffer_size /= 2;
+        }
+        buffer_size = std::max(buffer_size, Min_Buffered_IO_Size);
+
+        // Reduce object storage connections if even one job does not fit
+        while (batch_options.object_storage &&
+               (batch_options.s3_connections > Min_S3_Connections) &&
+               (job_memory(buffer_size) > job_budget))
+        {
+            batch_options.s3_connections =
+                std::max(batch_options.s3_connections / 2,
+                         Min_S3_Connections);
+            logger->warning << "Reducing object storage connections to "
+                            << batch_options.s3_connections
+                            << " to fit the memory budget" << std::flush;
+        }
+
+        // Reduce the number of jobs to fit the budget
+        const std::uint64_t fitting_jobs = job_budget / job_memory(buffer_size);
+        if (fitting_jobs == 0)
+        {
+            logger->error << "Memory budget of " << budget
+                          << " octets is too small to process files"
+                          << std::flush;
+            return false;
+        }
+        if (fitting_jobs < jobs)
+        {
+            jobs = static_cast<std::size_t>(fitting_jobs);
+        }
+
+        logger->info << "Memory budget is " << budget << " octets"
+                     << std::flush;
+
+        // Output held until it is verified is charged to the control group
+        // while in memory, so each job holds in memory only its share of
+        // what the jobs leave of the budget (the rest goes to a file)
+        if (batch_options.verified_output)
+        {
+            std::uint64_t spool_memory =
+                (job_budget - jobs * job_memory(buffer_size)) / jobs;
+            if (max_memory == 0)
+            {
+                spool_memory = std::min(spool_memory, Default_Spool_Memory);
+            }
+            batch_options.spool_memory = spool_memory;
+
+            logger->info << "Holding up to " << spool_memory
+                         << " octets of output in memory per job"
+                         << std::flush;
+        }
+    }
+
+    batch_options.jobs = jobs;
+    batch_options.io_buffer_size = buffer_size;
+
+    logger->info << "Processing with " << jobs
+                 << " concurrent jobs using I/O buffers of " << buffer_size
+                 << " octets" << std::flush;
+
+    return true;
+}
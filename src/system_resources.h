@@ -0,0 +1,106 @@
+/*
+ *  system_resources.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file defines functions to determine the processor and memory
+ *      resources available to the process (observing container limits) and
+ *      to size concurrent file processing to fit within those resources.
+ *
+ *  Portability Issues:
+ *      Control group (cgroup v2) limits are observed only on Linux.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <terra/logger/logger.h>
+#include "batch_options.h"
+
+// Resources available to the process
+struct SystemResources
+{
+    std::size_t cpu_count;                      // Usable processors
+    std::uint64_t memory_limit;                 // Memory limit (0 = none)
+};
+
+/*
+ *  GetSystemResources()
+ *
+ *  Description:
+ *      Determine the number of processors and amount of memory available to
+ *      this process.  On Linux, this observes the process's CPU affinity
+ *      mask and the cgroup v2 "cpu.max" and "memory.max" limits of the
+ *      process's control group and each of its ancestors.
+ *
+ *  Parameters:
+ *      logger [in]
+ *          The logger to which logging output will be sent.
+ *
+ *  Returns:
+ *      The resources available to the process.  The CPU count is always at
+ *      least 1.
+ *
+ *  Comments:
+ *      std::thread::hardware_concurrency() reports the host's processors,
+ *      which within a container is often far more than the CPU quota.
+ */
+SystemResources GetSystemResources(const Terra::Logger::LoggerPointer &logger);
+
+/*
+ *  SizeBatchResources()
+ *
+ *  Description:
+ *      Determine the number of concurrent jobs and the I/O buffer size to
+ *      use so that processing fits within the available processors and
+ *      memory budget.
+ *
+ *  Parameters:
+ *      logger [in]
+ *          The logger to which logging output will be sent.
+ *
+ *      resources [in]
+ *          The resources available to the process.
+ *
+ *      requested_jobs [in]
+ *          The number of concurrent jobs requested, or zero to use one job
+ *          per available processor.
+ *
+ *      max_memory [in]
+ *          The user-specified memory budget in octets, or zero if none.
+ *
+ *      file_count [in]
+ *          The number of files to be processed.
+ *
+ *      batch_options [in/out]
+ *          The batch options whose "jobs" and "io_buffer_size" members (and
+ *          "spool_memory" member, when holding verified output) are
+ *          assigned.  When files are objects, "s3_connections" may be
+ *          reduced.
+ *
+ *  Returns:
+ *      True if processing fits within the memory budget, false if the
+ *      budget is too small to process even a single file.
+ *
+ *  Comments:
+ *      The memory budget is the lesser of max_memory and the control group
+ *      memory limit.  I/O buffers are reduced in size before the number of
+ *      concurrent jobs is reduced.  A job transferring an object holds a
+ *      part or range for each connection plus one more; when any file is an
+ *      object, this is counted for every job.  Output held until it is
+ *      verified is given the memory the jobs leave; without max_memory, no
+ *      more than Default_Spool_Memory.
+ */
+bool SizeBatchResources(const Terra::Logger::LoggerPointer &logger,
+                        const SystemResources &resources,
+                        std::size_t requested_jobs,
+                        std::uint64_t max_memory,
+                        std::size_t file_count,
+                        BatchOptions &batch_options);
@@ -0,0 +1,220 @@
+/*
+ *  thread_priority.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file implements functions to lower the I/O and CPU scheduling
+ *      priority of the threads that perform encryption and decryption.
+ *
+ *  Portability Issues:
+ *      I/O scheduling classes and SCHED_BATCH/SCHED_IDLE are supported only
+ *      on Linux.  On Windows, background processing mode and thread
+ *      priorities are used as the nearest equivalent.  Elsewhere, the
+ *      settings are ignored.
+ */
+
+#include <charconv>
+#ifdef _WIN32
+#include <Windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+#include "thread_priority.h"
+#include "error_string.h"
+
+namespace
+{
+
+#ifdef __linux__
+// I/O priority values (see ioprio_set(2)); glibc provides no definitions
+constexpr int IOPrio_Who_Process = 1;
+constexpr int IOPrio_Class_Shift = 13;
+constexpr int IOPrio_Class_BE = 2;
+constexpr int IOPrio_Class_Idle = 3;
+#endif
+
+} // namespace
+
+/*
+ *  ParseIOClass()
+ *
+ *  Description:
+ *      Parse an I/O class given as "idle" or "best-effort[:N]", where N is
+ *      a priority level from 0 (highest) to 7 (lowest).
+ *
+ *  Parameters:
+ *      value [in]
+ *          The string to parse.
+ *
+ *      thread_priority [out]
+ *          The thread priority whose "io_class" and "io_level" members are
+ *          assigned.
+ *
+ *  Returns:
+ *      True if the string is valid, false if not.
+ *
+ *  Comments:
+ *      None.
+ */
+bool ParseIOClass(const std::string &value, ThreadPriority &thread_priority)
+{
+    if (value == "idle")
+    {
+        thread_priority.io_class = IOClass::Idle;
+        return true;
+    }
+
+    const std::string best_effort = "best-effort";
+
+    if (value.rfind(best_effort, 0) != 0) return false;
+
+    // The level is optional
+    if (value.size() == best_effort.size())
+    {
+        thread_priority.io_class = IOClass::BestEffort;
+        return true;
+    }
+
+    if (value[best_effort.size()] != ':') return false;
+
+    int level{};
+    const char *first = value.data() + best_effort.size() + 1;
+    const char *last = value.data() + value.size();
+    auto [end, error] = std::from_chars(first, last, level);
+    if ((error != std::errc()) || (end != last) || (first == last) ||
+        (level < 0) || (level > 7))
+    {
+        return false;
+    }
+
+    thread_priority.io_class = IOClass::BestEffort;
+    thread_priority.io_level = level;
+
+    return true;
+}
+
+/*
+ *  ParseCPUPriority()
+ *
+ *  Description:
+ *      Parse a CPU priority given as "normal", "batch", or "idle".
+ *
+ *  Parameters:
+ *      value [in]
+ *          The string to parse.
+ *
+ *  Returns:
+ *      The CPU priority, or no value if the string is not valid.
+ *
+ *  Comments:
+ *      None.
+ */
+std::optional<CPUPriority> ParseCPUPriority(const std::string &value)
+{
+    if (value == "normal") return CPUPriority::Normal;
+    if (value == "batch") return CPUPriority::Batch;
+    if (value == "idle") return CPUPriority::Idle;
+
+    return {};
+}
+
+/*
+ *  ApplyThreadPriority()
+ *
+ *  Description:
+ *      Apply the given I/O class and CPU priority to the calling thread.
+ *
+ *  Parameters:
+ *      logger [in]
+ *          The logger to which logging output will be sent.
+ *
+ *      thread_priority [in]
+ *          The priority to apply.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      Failure to apply a setting is logged, but is not an error, since the
+ *      work can proceed at normal priority.
+ */
+void ApplyThreadPriority(const Terra::Logger::LoggerPointer &logger,
+                         const ThreadPriority &thread_priority)
+{
+#ifdef __linux__
+    // Set the I/O scheduling class of this thread (identified by thread ID)
+    if (thread_priority.io_class != IOClass::Default)
+    {
+        const int io_priority =
+            (thread_priority.io_class == IOClass::Idle)
+                ? (IOPrio_Class_Idle << IOPrio_Class_Shift)
+                : ((IOPrio_Class_BE << IOPrio_Class_Shift) |
+                   thread_priority.io_level);
+
+        if (syscall(SYS_ioprio_set,
+                    IOPrio_Who_Process,
+                    static_cast<int>(syscall(SYS_gettid)),
+                    io_priority) == -1)
+        {
+            LogSystemError(logger, "Unable to set the I/O priority");
+        }
+    }
+
+    // Set the CPU scheduling policy of this thread
+    if (thread_priority.cpu_priority != CPUPriority::Normal)
+    {
+        sched_param parameters{};
+        const int policy =
+            (thread_priority.cpu_priority == CPUPriority::Idle) ? SCHED_IDLE
+                                                                : SCHED_BATCH;
+
+        const int result =
+            pthread_setschedparam(pthread_self(), policy, &parameters);
+        if (result != 0)
+        {
+            logger->warning << "Unable to set the CPU scheduling policy (err="
+                            << result << ")" << std::flush;
+        }
+    }
+#elif defined(_WIN32)
+    // Background mode lowers both I/O and CPU priority of this thread
+    if (thread_priority.io_class == IOClass::Idle)
+    {
+        if (!SetThreadPriority(GetCurrentThread(),
+                               THREAD_MODE_BACKGROUND_BEGIN))
+        {
+            LogSystemError(logger, "Unable to enter background mode");
+        }
+    }
+
+    if (thread_priority.cpu_priority != CPUPriority::Normal)
+    {
+        const int priority =
+            (thread_priority.cpu_priority == CPUPriority::Idle)
+                ? THREAD_PRIORITY_IDLE
+                : THREAD_PRIORITY_BELOW_NORMAL;
+
+        if (!SetThreadPriority(GetCurrentThread(), priority))
+        {
+            LogSystemError(logger, "Unable to set the thread priority");
+        }
+    }
+#else
+    if ((thread_priority.io_class != IOClass::Default) ||
+        (thread_priority.cpu_priority != CPUPriority::Normal))
+    {
+        logger->warning << "Thread priorities are not supported on this "
+                           "platform"
+                        << std::flush;
+    }
+#endif
+}
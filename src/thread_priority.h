@@ -0,0 +1,117 @@
+/*
+ *  thread_priority.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file defines functions to lower the I/O and CPU scheduling
+ *      priority of the threads that perform encryption and decryption so
+ *      that background jobs do not compete with interactive work.  Only the
+ *      calling thread is affected, leaving the rest of the process
+ *      (e.g., the thread servicing the user interface) unchanged.
+ *
+ *  Portability Issues:
+ *      I/O scheduling classes and SCHED_BATCH/SCHED_IDLE are supported only
+ *      on Linux.  On Windows, background processing mode and thread
+ *      priorities are used as the nearest equivalent.  Elsewhere, the
+ *      settings are ignored.
+ */
+
+#pragma once
+
+#include <optional>
+#include <string>
+#include <terra/logger/logger.h>
+
+// I/O scheduling class
+enum class IOClass
+{
+    Default,
+    BestEffort,
+    Idle
+};
+
+// CPU scheduling priority
+enum class CPUPriority
+{
+    Normal,
+    Batch,
+    Idle
+};
+
+// Scheduling priority applied to threads performing encryption/decryption
+struct ThreadPriority
+{
+    IOClass io_class{IOClass::Default};         // I/O scheduling class
+    int io_level{4};                            // Best-effort level (0-7)
+    CPUPriority cpu_priority{CPUPriority::Normal};// CPU scheduling priority
+};
+
+/*
+ *  ParseIOClass()
+ *
+ *  Description:
+ *      Parse an I/O class given as "idle" or "best-effort[:N]", where N is
+ *      a priority level from 0 (highest) to 7 (lowest).
+ *
+ *  Parameters:
+ *      value [in]
+ *          The string to parse.
+ *
+ *      thread_priority [out]
+ *          The thread priority whose "io_class" and "io_level" members are
+ *          assigned.
+ *
+ *  Returns:
+ *      True if the string is valid, false if not.
+ *
+ *  Comments:
+ *      None.
+ */
+bool ParseIOClass(const std::string &value, ThreadPriority &thread_priority);
+
+/*
+ *  ParseCPUPriority()
+ *
+ *  Description:
+ *      Parse a CPU priority given as "normal", "batch", or "idle".
+ *
+ *  Parameters:
+ *      value [in]
+ *          The string to parse.
+ *
+ *  Returns:
+ *      The CPU priority, or no value if the string is not valid.
+ *
+ *  Comments:
+ *      None.
+ */
+std::optional<CPUPriority> ParseCPUPriority(const std::string &value);
+
+/*
+ *  ApplyThreadPriority()
+ *
+ *  Description:
+ *      Apply the given I/O class and CPU priority to the calling thread.
+ *
+ *  Parameters:
+ *      logger [in]
+ *          The logger to which logging output will be sent.
+ *
+ *      thread_priority [in]
+ *          The priority to apply.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      Failure to apply a setting is logged, but is not an error, since the
+ *      work can proceed at normal priority.
+ */
+void ApplyThreadPriority(const Terra::Logger::LoggerPointer &logger,
+                         const ThreadPriority &thread_priority);
@@ -0,0 +1,233 @@
+/*
+ *  throttled_stream.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file implements the ThrottledStreamBuf object, which passes data
+ *      read from or written to another stream buffer through a
+ *      BandwidthLimiter and reports writes to a ConcurrencyController.
+ *
+ *  Portability Issues:
+ *      None.
+ */
+
+#include "throttled_stream.h"
+
+/*
+ *  ThrottledStreamBuf::ThrottledStreamBuf()
+ *
+ *  Description:
+ *      Constructor for the ThrottledStreamBuf object.
+ *
+ *  Parameters:
+ *      stream_buffer [in]
+ *          The stream buffer from which data is read or to which data is
+ *          written.
+ *
+ *      bandwidth_limiter [in]
+ *          The bandwidth limiter through which all data passes, or nullptr
+ *          if bandwidth is not limited.
+ *
+ *      concurrency_controller [in]
+ *          The controller to which the size and latency of each write is
+ *          reported, or nullptr if there is none.
+ *
+ *      buffer [in]
+ *          The buffer to use to hold data being read or written.  The
+ *          amount of data transferred at once is the size of this buffer.
+ *
+ *      direction [in]
+ *          Indicates whether this object is used for reading or writing.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+ThrottledStreamBuf::ThrottledStreamBuf(
+    std::streambuf *stream_buffer,
+    BandwidthLimiter *bandwidth_limiter,
+    ConcurrencyController *concurrency_controller,
+    std::span<char> buffer,
+    Direction direction) :
+    stream_buffer{stream_buffer},
+    bandwidth_limiter{bandwidth_limiter},
+    concurrency_controller{concurrency_controller},
+    buffer{buffer},
+    direction{direction}
+{
+    if (direction == Direction::Read)
+    {
+        setg(buffer.data(), buffer.data(), buffer.data());
+    }
+    else
+    {
+        setp(buffer.data(), buffer.data() + buffer.size());
+    }
+}
+
+/*
+ *  ThrottledStreamBuf::~ThrottledStreamBuf()
+ *
+ *  Description:
+ *      Destructor for the ThrottledStreamBuf object, which writes any
+ *      buffered output.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+ThrottledStreamBuf::~ThrottledStreamBuf()
+{
+    if (direction == Direction::Write) FlushBuffer();
+}
+
+/*
+ *  ThrottledStreamBuf::underflow()
+ *
+ *  Description:
+ *      Refill the input buffer from the wrapped stream buffer.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      The next character, or EOF if no more data can be read.
+ *
+ *  Comments:
+ *      The read is accounted for after it completes, since the number of
+ *      octets that will be returned is not known in advance.
+ */
+ThrottledStreamBuf::int_type ThrottledStreamBuf::underflow()
+{
+    if (direction != Direction::Read) return traits_type::eof();
+
+    if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+
+    const std::streamsize octets =
+        stream_buffer->sgetn(buffer.data(),
+                             static_cast<std::streamsize>(buffer.size()));
+    if (octets <= 0) return traits_type::eof();
+
+    if (bandwidth_limiter != nullptr)
+    {
+        bandwidth_limiter->Read(static_cast<std::size_t>(octets));
+    }
+
+    setg(buffer.data(), buffer.data(), buffer.data() + octets);
+
+    return traits_type::to_int_type(*gptr());
+}
+
+/*
+ *  ThrottledStreamBuf::overflow()
+ *
+ *  Description:
+ *      Write the output buffer to the wrapped stream buffer to make room for
+ *      the given character.
+ *
+ *  Parameters:
+ *      c [in]
+ *          The character to be written, or EOF if there is none.
+ *
+ *  Returns:
+ *      A value other than EOF on success, EOF on failure.
+ *
+ *  Comments:
+ *      None.
+ */
+ThrottledStreamBuf::int_type ThrottledStreamBuf::overflow(int_type c)
+{
+    if (direction != Direction::Write) return traits_type::eof();
+
+    if (!FlushBuffer()) return traits_type::eof();
+
+    if (!traits_type::eq_int_type(c, traits_type::eof()))
+    {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+
+    return traits_type::not_eof(c);
+}
+
+/*
+ *  ThrottledStreamBuf::sync()
+ *
+ *  Description:
+ *      Write any buffered output to the wrapped stream buffer and
+ *      synchronize it.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Zero on success, -1 on failure.
+ *
+ *  Comments:
+ *      None.
+ */
+int ThrottledStreamBuf::sync()
+{
+    if (direction != Direction::Write) return 0;
+
+    if (!FlushBuffer()) return -1;
+
+    return stream_buffer->pubsync();
+}
+
+/*
+ *  ThrottledStreamBuf::FlushBuffer()
+ *
+ *  Description:
+ *      Write the buffered output to the wrapped stream buffer, waiting as
+ *      necessary to observe the write rate limit and reporting the time
+ *      taken to write.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      True if all buffered output was written, false if not.
+ *
+ *  Comments:
+ *      None.
+ */
+bool ThrottledStreamBuf::FlushBuffer()
+{
+    const std::streamsize octets = pptr() - pbase();
+
+    if (octets == 0) return true;
+
+    if (bandwidth_limiter != nullptr)
+    {
+        bandwidth_limiter->Write(static_cast<std::size_t>(octets));
+    }
+
+    const auto start = ConcurrencyController::Clock::now();
+
+    const std::streamsize written = stream_buffer->sputn(pbase(), octets);
+
+    if (concurrency_controller != nullptr)
+    {
+        concurrency_controller->RecordWrite(
+            static_cast<std::size_t>(written),
+            ConcurrencyController::Clock::now() - start);
+    }
+
+    setp(buffer.data(), buffer.data() + buffer.size());
+
+    return written == octets;
+}
@@ -0,0 +1,103 @@
+/*
+ *  throttled_stream.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file defines stream objects that wrap an existing stream buffer,
+ *      passing data read or written through a BandwidthLimiter and reporting
+ *      writes to a ConcurrencyController.  The wrapper provides buffering,
+ *      so the wrapped stream buffer should be unbuffered to avoid copying
+ *      data twice.
+ *
+ *  Portability Issues:
+ *      None.
+ */
+
+#pragma once
+
+#include <streambuf>
+#include <istream>
+#include <ostream>
+#include <span>
+#include "rate_limiter.h"
+#include "concurrency_controller.h"
+
+// Stream buffer that throttles reading from or writing to another buffer
+class ThrottledStreamBuf : public std::streambuf
+{
+    public:
+        enum class Direction
+        {
+            Read,
+            Write
+        };
+
+        ThrottledStreamBuf(std::streambuf *stream_buffer,
+                           BandwidthLimiter *bandwidth_limiter,
+                           ConcurrencyController *concurrency_controller,
+                           std::span<char> buffer,
+                           Direction direction);
+        ~ThrottledStreamBuf();
+
+    protected:
+        int_type underflow() override;
+        int_type overflow(int_type c) override;
+        int sync() override;
+        bool FlushBuffer();
+
+        std::streambuf *stream_buffer;
+        BandwidthLimiter *bandwidth_limiter;
+        ConcurrencyController *concurrency_controller;
+        std::span<char> buffer;
+        Direction direction;
+};
+
+// Input stream that throttles reading from a stream buffer
+class ThrottledIStream : public std::istream
+{
+    public:
+        ThrottledIStream(std::streambuf *stream_buffer,
+                         BandwidthLimiter *bandwidth_limiter,
+                         ConcurrencyController *concurrency_controller,
+                         std::span<char> buffer) :
+            std::istream(nullptr),
+            throttled_buffer(stream_buffer,
+                             bandwidth_limiter,
+                             concurrency_controller,
+                             buffer,
+                             ThrottledStreamBuf::Direction::Read)
+        {
+            rdbuf(&throttled_buffer);
+        }
+
+    protected:
+        ThrottledStreamBuf throttled_buffer;
+};
+
+// Output stream that throttles writing to a stream buffer
+class ThrottledOStream : public std::ostream
+{
+    public:
+        ThrottledOStream(std::streambuf *stream_buffer,
+                         BandwidthLimiter *bandwidth_limiter,
+                         ConcurrencyController *concurrency_controller,
+                         std::span<char> buffer) :
+            std::ostream(nullptr),
+            throttled_buffer(stream_buffer,
+                             bandwidth_limiter,
+                             concurrency_controller,
+                             buffer,
+                             ThrottledStreamBuf::Direction::Write)
+        {
+            rdbuf(&throttled_buffer);
+        }
+
+    protected:
+        ThrottledStreamBuf throttled_buffer;
+};
@@ -0,0 +1,318 @@
+/*
+ *  unicode_fast_path.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file implements functions to validate UTF-8 strings and to
+ *      convert UTF-16 strings to UTF-8 that process runs of ASCII characters
+ *      using vector instructions (SSE2 or NEON), deferring to the Character
+ *      Utilities library for all non-ASCII characters.
+ *
+ *  Portability Issues:
+ *      Vector instructions are used only when the compiler targets a
+ *      processor supporting SSE2 or NEON; otherwise, ASCII runs are
+ *      processed 8 octets at a time using ordinary integer operations.
+ */
+
+#include <cstring>
+#include <bit>
+#include <algorithm>
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define AESCRYPT_UNICODE_SSE2
+#elif (defined(__ARM_NEON) && defined(__aarch64__) && \
+       !defined(__ARM_BIG_ENDIAN)) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define AESCRYPT_UNICODE_NEON
+#endif
+#include <terra/charutil/character_utilities.h>
+#include "unicode_fast_path.h"
+
+namespace
+{
+
+/*
+ *  ASCIIRunLength()
+ *
+ *  Description:
+ *      Determine the number of ASCII octets at the start of the given string.
+ *
+ *  Parameters:
+ *      octets [in]
+ *          The string to examine.
+ *
+ *  Returns:
+ *      The number of leading octets having a value less than 0x80.
+ *
+ *  Comments:
+ *      None.
+ */
+std::size_t ASCIIRunLength(std::span<const std::uint8_t> octets)
+{
+    std::size_t i = 0;
+
+#if defined(AESCRYPT_UNICODE_SSE2)
+    for (; i + 16 <= octets.size(); i += 16)
+    {
+        const int mask = _mm_movemask_epi8(_mm_loadu_si128(
+            reinterpret_cast<const __m128i *>(octets.data() + i)));
+        if (mask != 0)
+        {
+            return i + static_cast<std::size_t>(
+                           std::countr_zero(static_cast<unsigned>(mask)));
+        }
+    }
+#elif defined(AESCRYPT_UNICODE_NEON)
+    for (; i + 16 <= octets.size(); i += 16)
+    {
+        if (vmaxvq_u8(vld1q_u8(octets.data() + i)) >= 0x80) break;
+    }
+#else
+    for (; i + 8 <= octets.size(); i += 8)
+    {
+        std::uint64_t word;
+        std::memcpy(&word, octets.data() + i, sizeof(word));
+        if ((word & 0x8080'8080'8080'8080) != 0) break;
+    }
+#endif
+
+    // Examine any remaining octets individually
+    while ((i < octets.size()) && (octets[i] < 0x80)) i++;
+
+    return i;
+}
+
+/*
+ *  UTF16Unit()
+ *
+ *  Description:
+ *      Return the UTF-16 code unit at the given position in the string.
+ *
+ *  Parameters:
+ *      utf16 [in]
+ *          The UTF-16 string.
+ *
+ *      unit [in]
+ *          The index of the code unit (not the octet) to return.
+ *
+ *      little_endian [in]
+ *          True if the string's octets are in little endian order.
+ *
+ *  Returns:
+ *      The code unit value.
+ *
+ *  Comments:
+ *      None.
+ */
+constexpr std::uint16_t UTF16Unit(std::span<const std::uint8_t> utf16,
+                                  std::size_t unit,
+                                  bool little_endian)
+{
+    const std::uint8_t first = utf16[unit * 2];
+    const std::uint8_t second = utf16[unit * 2 + 1];
+
+    return static_cast<std::uint16_t>(little_endian ? (second << 8) | first
+                                                    : (first << 8) | second);
+}
+
+/*
+ *  NarrowASCIIUnits()
+ *
+ *  Description:
+ *      Convert leading UTF-16 code units that are ASCII characters into
+ *      UTF-8, stopping at the first non-ASCII character or when the output
+ *      buffer is full.
+ *
+ *  Parameters:
+ *      utf16 [in]
+ *          The UTF-16 string to convert.
+ *
+ *      utf8 [out]
+ *          The buffer into which ASCII characters are written.
+ *
+ *      little_endian [in]
+ *          True if the string's octets are in little endian order.
+ *
+ *  Returns:
+ *      The number of code units converted, which equals the number of
+ *      octets written to the output buffer.
+ *
+ *  Comments:
+ *      None.
+ */
+std::size_t NarrowASCIIUnits(std::span<const std::uint8_t> utf16,
+                             std::span<std::uint8_t> utf8,
+                             bool little_endian)
+{
+    const std::size_t units = std::min(utf16.size() / 2, utf8.size());
+    std::size_t i = 0;
+
+#if defined(AESCRYPT_UNICODE_SSE2)
+    const __m128i non_ascii = _mm_set1_epi16(static_cast<short>(0xff80));
+    const __m128i zero = _mm_setzero_si128();
+
+    for (; i + 8 <= units; i += 8)
+    {
+        __m128i value = _mm_loadu_si128(
+            reinterpret_cast<const __m128i *>(utf16.data() + i * 2));
+        if (!little_endian)
+        {
+            value = _mm_or_si128(_mm_slli_epi16(value, 8),
+                                 _mm_srli_epi16(value, 8));
+        }
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(
+                _mm_and_si128(value, non_ascii), zero)) != 0xffff)
+        {
+            break;
+        }
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(utf8.data() + i),
+                         _mm_packus_epi16(value, value));
+    }
+#elif defined(AESCRYPT_UNICODE_NEON)
+    for (; i + 8 <= units; i += 8)
+    {
+        uint8x16_t octets = vld1q_u8(utf16.data() + i * 2);
+        if (!little_endian) octets = vrev16q_u8(octets);
+        const uint16x8_t value = vreinterpretq_u16_u8(octets);
+        if (vmaxvq_u16(value) >= 0x80) break;
+        vst1_u8(utf8.data() + i, vmovn_u16(value));
+    }
+#endif
+
+    // Convert any remaining ASCII characters individually
+    for (; i < units; i++)
+    {
+        const std::uint16_t value = UTF16Unit(utf16, i, little_endian);
+        if (value >= 0x80) break;
+        utf8[i] = static_cast<std::uint8_t>(value);
+    }
+
+    return i;
+}
+
+} // namespace
+
+/*
+ *  IsUTF8ValidFast()
+ *
+ *  Description:
+ *      This function will determine whether the given string is valid UTF-8.
+ *      The result is identical to Terra::CharUtil::IsUTF8Valid().
+ *
+ *  Parameters:
+ *      octets [in]
+ *          The string to validate.
+ *
+ *  Returns:
+ *      True if the string is valid UTF-8, false if not.
+ *
+ *  Comments:
+ *      Since no multi-octet UTF-8 sequence contains an ASCII octet, each run
+ *      of non-ASCII octets is validated independently.
+ */
+bool IsUTF8ValidFast(std::span<const std::uint8_t> octets)
+{
+    std::size_t i = 0;
+
+    while (i < octets.size())
+    {
+        // Skip over any ASCII characters
+        i += ASCIIRunLength(octets.subspan(i));
+        if (i == octets.size()) break;
+
+        // Locate the end of the run of non-ASCII octets
+        std::size_t end = i;
+        while ((end < octets.size()) && (octets[end] >= 0x80)) end++;
+
+        // Validate the non-ASCII run
+        if (!Terra::CharUtil::IsUTF8Valid(octets.subspan(i, end - i)))
+        {
+            return false;
+        }
+
+        i = end;
+    }
+
+    return true;
+}
+
+/*
+ *  ConvertUTF16ToUTF8Fast()
+ *
+ *  Description:
+ *      This function will convert a UTF-16 string to UTF-8.  The result is
+ *      identical to Terra::CharUtil::ConvertUTF16ToUTF8().
+ *
+ *  Parameters:
+ *      utf16 [in]
+ *          The UTF-16 string to convert.  This must be an even number of
+ *          octets.
+ *
+ *      utf8 [out]
+ *          The buffer into which the UTF-8 string is written.
+ *
+ *      little_endian [in]
+ *          True if the UTF-16 string's octets are in little endian order.
+ *
+ *  Returns:
+ *      A pair containing a boolean indicating success and the number of
+ *      octets written into the output buffer.  On failure, the length
+ *      will be zero.
+ *
+ *  Comments:
+ *      Since the surrogate pairs are not ASCII, each run of non-ASCII
+ *      characters is converted independently.
+ */
+std::pair<bool, std::size_t> ConvertUTF16ToUTF8Fast(
+    std::span<const std::uint8_t> utf16,
+    std::span<std::uint8_t> utf8,
+    bool little_endian)
+{
+    std::size_t unit = 0;
+    std::size_t length = 0;
+
+    // UTF-16 strings must have an even number of octets
+    if ((utf16.size() & 0x01) != 0) return {false, 0};
+
+    const std::size_t units = utf16.size() / 2;
+
+    while (unit < units)
+    {
+        // Convert any ASCII characters
+        const std::size_t ascii = NarrowASCIIUnits(utf16.subspan(unit * 2),
+                                                   utf8.subspan(length),
+                                                   little_endian);
+        unit += ascii;
+        length += ascii;
+        if (unit == units) break;
+
+        // Locate the end of the run of non-ASCII characters
+        std::size_t end = unit;
+        while ((end < units) && (UTF16Unit(utf16, end, little_endian) >= 0x80))
+        {
+            end++;
+        }
+
+        // If stopped on an ASCII character, the output buffer is full
+        if (end == unit) return {false, 0};
+
+        // Convert the non-ASCII run
+        auto [result, octets] = Terra::CharUtil::ConvertUTF16ToUTF8(
+            utf16.subspan(unit * 2, (end - unit) * 2),
+            utf8.subspan(length),
+            little_endian);
+        if (!result) return {false, 0};
+
+        unit = end;
+        length += octets;
+    }
+
+    return {true, length};
+}
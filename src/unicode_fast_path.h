@@ -0,0 +1,80 @@
+/*
+ *  unicode_fast_path.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file defines functions to validate UTF-8 strings and to convert
+ *      UTF-16 strings to UTF-8 that process runs of ASCII characters using
+ *      vector instructions (SSE2 or NEON), deferring to the Character
+ *      Utilities library for all non-ASCII characters.
+ *
+ *  Portability Issues:
+ *      Vector instructions are used only when the compiler targets a
+ *      processor supporting SSE2 or NEON; otherwise, ASCII runs are
+ *      processed 8 octets at a time using ordinary integer operations.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <utility>
+
+/*
+ *  IsUTF8ValidFast()
+ *
+ *  Description:
+ *      This function will determine whether the given string is valid UTF-8.
+ *      The result is identical to Terra::CharUtil::IsUTF8Valid().
+ *
+ *  Parameters:
+ *      octets [in]
+ *          The string to validate.
+ *
+ *  Returns:
+ *      True if the string is valid UTF-8, false if not.
+ *
+ *  Comments:
+ *      Since no multi-octet UTF-8 sequence contains an ASCII octet, each run
+ *      of non-ASCII octets is validated independently.
+ */
+bool IsUTF8ValidFast(std::span<const std::uint8_t> octets);
+
+/*
+ *  ConvertUTF16ToUTF8Fast()
+ *
+ *  Description:
+ *      This function will convert a UTF-16 string to UTF-8.  The result is
+ *      identical to Terra::CharUtil::ConvertUTF16ToUTF8().
+ *
+ *  Parameters:
+ *      utf16 [in]
+ *          The UTF-16 string to convert.  This must be an even number of
+ *          octets.
+ *
+ *      utf8 [out]
+ *          The buffer into which the UTF-8 string is written.
+ *
+ *      little_endian [in]
+ *          True if the UTF-16 string's octets are in little endian order.
+ *
+ *  Returns:
+ *      A pair containing a boolean indicating success and the number of
+ *      octets written into the output buffer.  On failure, the length
+ *      will be zero.
+ *
+ *  Comments:
+ *      Since the surrogate pairs are not ASCII, each run of non-ASCII
+ *      characters is converted independently.
+ */
+std::pair<bool, std::size_t> ConvertUTF16ToUTF8Fast(
+    std::span<const std::uint8_t> utf16,
+    std::span<std::uint8_t> utf8,
+    bool little_endian);
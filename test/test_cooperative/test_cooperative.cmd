@@ -0,0 +1,118 @@
+@echo off
+
+@rem This program assumes the environment variable CMAKE_CONFIG_TYPE will be
+@rem set to Debug or Release (or other value if appropriate).  It uses that
+@rem value as a replacement for CONFIG_TYPE, which is a substring in the
+@rem passed-in argument.  This is a part of the pathname, so it looks for
+@rem the substring /CONFIG_TYPE/ as it makes the substitution.
+
+setlocal enabledelayedexpansion
+
+@rem Set the result code to 0 (success)
+set RESULT=0
+
+@rem Get the AES Crypt binary path
+set "AESCRYPT=%1"
+
+@rem Ensure AESCRYPT is not an empty string
+if "%AESCRYPT%" == "" (
+    echo First argument should be the AES Crypt binary
+    set RESULT=1
+    goto :EXIT_RESULT
+)
+
+@rem Ensure CMAKE_CONFIG_TYPE is not an empty string
+if "%CMAKE_CONFIG_TYPE%" == "" (
+    echo The CMAKE_CONFIG_TYPE variable must contain the build type
+    set RESULT=1
+    goto :EXIT_RESULT
+)
+
+@rem Use the CMAKE_CONFIG_TYPE env variable to determine the correct executable
+set "AESCRYPT=!AESCRYPT:/CONFIG_TYPE/=/%CMAKE_CONFIG_TYPE%/!"
+
+@rem Convert pathnames to use \ rather than / (CMake uses /) to pacify Windows
+set "AESCRYPT=%AESCRYPT:/=\%"
+
+@rem Ensure the executable binary exists
+if not exist "%AESCRYPT%" (
+    echo AES Crypt executable not found: %AESCRYPT%
+    set RESULT=1
+    goto :EXIT_RESULT
+)
+
+@rem Switch directories to where the test process resides
+cd /D "%~dp0"
+
+@rem Encrypt the files with several cooperating processes
+echo Files processed by cooperating processes
+set "WORKDIR=%TEMP%\aescrypt_coop"
+if exist "%WORKDIR%" rmdir /S /Q "%WORKDIR%"
+mkdir "%WORKDIR%\files"
+copy /Y ..\test_file_set\vectors\*.dat "%WORKDIR%\files" > nul
+cd /D "%WORKDIR%"
+set COUNT=0
+set "FILES="
+for %%s in (files\*.dat) do (
+    set /A COUNT+=1
+    set "FILES=!FILES! files\%%~nxs"
+)
+for /L %%n in (1,1,4) do (
+    start "aescrypt" /B "%AESCRYPT%" -q -e -i 8192 -p password --coop-dir work !FILES!
+)
+
+@rem Wait for all files to be marked done and all leases removed
+set WAITED=0
+:WAIT_DONE
+set DONE=0
+for %%s in (work\*.done) do set /A DONE+=1
+set LEASES=0
+for %%s in (work\*.lease.*) do set /A LEASES+=1
+if "%DONE%" == "%COUNT%" if "%LEASES%" == "0" goto :WAIT_COMPLETE
+if %WAITED% geq 120 (
+    echo Error: cooperating processes did not complete all files
+    cd /D "%~dp0"
+    rmdir /S /Q "%WORKDIR%"
+    set RESULT=1
+    goto :EXIT_RESULT
+)
+timeout /T 1 /NOBREAK > nul
+set /A WAITED+=1
+goto :WAIT_DONE
+:WAIT_COMPLETE
+
+@rem Allow the processes to exit before checking their output
+timeout /T 2 /NOBREAK > nul
+
+@rem Decrypt each file to ensure it was encrypted exactly once and correctly
+for %%s in (files\*.dat) do (
+    "%AESCRYPT%" -q -d -p password -o "%%s.out" "%%s.aes" > nul 2> nul
+    if errorlevel 1 (
+        echo Error decrypting cooperatively processed file: %%s
+        cd /D "%~dp0"
+        rmdir /S /Q "%WORKDIR%"
+        set RESULT=1
+        goto :EXIT_RESULT
+    )
+    fc "%%s" "%%s.out" > nul
+    if errorlevel 1 (
+        echo Error with cooperatively processed file: %%s
+        cd /D "%~dp0"
+        rmdir /S /Q "%WORKDIR%"
+        set RESULT=1
+        goto :EXIT_RESULT
+    )
+)
+
+@rem Files already done are not processed again
+"%AESCRYPT%" -q -e -p password --coop-dir work !FILES!
+if errorlevel 1 (
+    echo Error re-running with finished work directory
+    set RESULT=1
+)
+cd /D "%~dp0"
+rmdir /S /Q "%WORKDIR%"
+
+:EXIT_RESULT
+exit /B %RESULT%
+endlocal
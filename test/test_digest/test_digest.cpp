@@ -0,0 +1,165 @@
+/*
+ *  test_digest.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This program verifies the hexadecimal and base64 encoding functions
+ *      used to sign object storage requests against known answers (from
+ *      RFC 4648).  Hashing is performed by the Terra crypto library, which
+ *      has its own tests.
+ *
+ *  Portability Issues:
+ *      None.
+ */
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include "digest.h"
+
+namespace
+{
+
+// Hexadecimal known answer
+struct HexVector
+{
+    std::string_view data;
+    std::string_view encoded;
+};
+
+// Base64 known answer from RFC 4648
+struct Base64Vector
+{
+    std::string_view data;
+    std::string_view encoded;
+};
+
+/*
+ *  AsOctets()
+ *
+ *  Description:
+ *      View the given string as a span of octets.
+ *
+ *  Parameters:
+ *      text [in]
+ *          The string to view.
+ *
+ *  Returns:
+ *      The span of octets.
+ *
+ *  Comments:
+ *      None.
+ */
+std::span<const std::uint8_t> AsOctets(std::string_view text)
+{
+    return {reinterpret_cast<const std::uint8_t *>(text.data()), text.size()};
+}
+
+/*
+ *  TestHexEncode()
+ *
+ *  Description:
+ *      Encode each test vector (from RFC 4648) as hexadecimal text and
+ *      compare with the known answers.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      The number of mismatches found.
+ *
+ *  Comments:
+ *      None.
+ */
+std::size_t TestHexEncode()
+{
+    const HexVector vectors[] =
+    {
+        {"", ""},
+        {"f", "66"},
+        {"foobar", "666f6f626172"},
+        {std::string_view("\x00\x0f\xf0\xff", 4), "000ff0ff"}
+    };
+    std::size_t failures{};
+
+    for (const auto &vector : vectors)
+    {
+        if (HexEncode(AsOctets(vector.data)) != vector.encoded)
+        {
+            std::cerr << "Hexadecimal mismatch for \"" << vector.encoded
+                      << "\"" << std::endl;
+            failures++;
+        }
+    }
+
+    return failures;
+}
+
+/*
+ *  TestBase64Encode()
+ *
+ *  Description:
+ *      Encode each RFC 4648 test vector and compare with the known answers.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      The number of mismatches found.
+ *
+ *  Comments:
+ *      None.
+ */
+std::size_t TestBase64Encode()
+{
+    const Base64Vector vectors[] =
+    {
+        {"", ""},
+        {"f", "Zg=="},
+        {"fo", "Zm8="},
+        {"foo", "Zm9v"},
+        {"foob", "Zm9vYg=="},
+        {"fooba", "Zm9vYmE="},
+        {"foobar", "Zm9vYmFy"}
+    };
+    std::size_t failures{};
+
+    for (const auto &vector : vectors)
+    {
+        if (Base64Encode(AsOctets(vector.data)) != vector.encoded)
+        {
+            std::cerr << "Base64 mismatch for \"" << vector.data << "\""
+                      << std::endl;
+            failures++;
+        }
+    }
+
+    return failures;
+}
+
+} // namespace
+
+int main()
+{
+    std::size_t failures = TestHexEncode();
+    failures += TestBase64Encode();
+
+    if (failures > 0)
+    {
+        std::cerr << "Total failures: " << failures << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "Encoding functions match all known answers" << std::endl;
+
+    return EXIT_SUCCESS;
+}
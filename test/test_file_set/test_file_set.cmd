@@ -21,6 +21,10 @@ if "%AESCRYPT%" == "" (
     goto :EXIT_RESULT
 )
 
+@rem Determine whether the binary supports fault injection (ON or OFF)
+set "FAULT_INJECTION=%2"
+if "%FAULT_INJECTION%" == "" set "FAULT_INJECTION=OFF"
+
 @rem Ensure CMAKE_CONFIG_TYPE is not an empty string
 if "%CMAKE_CONFIG_TYPE%" == "" (
     echo The CMAKE_CONFIG_TYPE variable must contain the build type
@@ -64,6 +68,334 @@ for %%s in (vectors\*.dat) do (
     del "%TEMP%\aescrypt_test"
 )
 
+@rem Stream the test vectors through a pipe with output flushed promptly
+echo Test vectors streamed with a flush policy
+for %%s in (vectors\*.dat) do (
+    type "%%s" | "%AESCRYPT%" -q -e -i 8192 -p password --flush-interval 10 --flush-bytes 4K -o - - ^
+        | "%AESCRYPT%" -q -d -p password -o "%TEMP%\aescrypt_test" -
+    fc "%%s" "%TEMP%\aescrypt_test" > nul
+    if errorlevel 1 (
+        echo Error with flushed test vector: %%s
+        del "%TEMP%\aescrypt_test"
+        set RESULT=1
+        goto :EXIT_RESULT
+    )
+    del "%TEMP%\aescrypt_test"
+)
+
+@rem Encrypt the test vectors, verifying the output as it is written
+echo Test vectors encrypted with verification
+for %%s in (vectors\*.dat) do (
+    type "%%s" | "%AESCRYPT%" -q -e -i 8192 -p password --verify-after -o - - ^
+        | "%AESCRYPT%" -q -d -p password -o "%TEMP%\aescrypt_test" -
+    fc "%%s" "%TEMP%\aescrypt_test" > nul
+    if errorlevel 1 (
+        echo Error with verified test vector: %%s
+        del "%TEMP%\aescrypt_test"
+        set RESULT=1
+        goto :EXIT_RESULT
+    )
+    del "%TEMP%\aescrypt_test"
+)
+
+@rem Concatenate the encrypted test vectors and decrypt them as one input
+echo Test vectors decrypted from multiple streams
+set "WORKDIR=%TEMP%\aescrypt_streams"
+if exist "%WORKDIR%" rmdir /S /Q "%WORKDIR%"
+mkdir "%WORKDIR%"
+type nul > "%WORKDIR%\all.dat"
+for %%s in (vectors\*.dat) do (
+    "%AESCRYPT%" -q -e -i 8192 -p password -o - "%%s" >> "%WORKDIR%\all.aes"
+    copy /B "%WORKDIR%\all.dat" + "%%s" "%WORKDIR%\all.dat" > nul
+)
+"%AESCRYPT%" -q -d -p password --multi-stream -o "%WORKDIR%\joined.dat" "%WORKDIR%\all.aes"
+fc /B "%WORKDIR%\all.dat" "%WORKDIR%\joined.dat" > nul
+if errorlevel 1 (
+    echo Error decrypting concatenated streams
+    rmdir /S /Q "%WORKDIR%"
+    set RESULT=1
+    goto :EXIT_RESULT
+)
+rmdir /S /Q "%WORKDIR%"
+
+@rem Check the integrity of the encrypted test vectors without output
+echo Test vectors scrubbed
+set "WORKDIR=%TEMP%\aescrypt_scrub"
+if exist "%WORKDIR%" rmdir /S /Q "%WORKDIR%"
+mkdir "%WORKDIR%"
+set "FILES="
+for %%s in (vectors\*.dat) do (
+    "%AESCRYPT%" -q -e -i 8192 -p password -o "%WORKDIR%\%%~nxs.aes" "%%s"
+    set "FILES=!FILES! "%WORKDIR%\%%~nxs.aes""
+)
+"%AESCRYPT%" -q -d -p password --scrub !FILES!
+if errorlevel 1 (
+    echo Error scrubbing test vectors
+    rmdir /S /Q "%WORKDIR%"
+    set RESULT=1
+    goto :EXIT_RESULT
+)
+if exist "%WORKDIR%\*.dat" (
+    echo Error: scrubbing produced output
+    rmdir /S /Q "%WORKDIR%"
+    set RESULT=1
+    goto :EXIT_RESULT
+)
+echo Not an AES Crypt stream> "%WORKDIR%\invalid.aes"
+"%AESCRYPT%" -q -d -p password --scrub !FILES! "%WORKDIR%\invalid.aes" 2> nul
+if not errorlevel 1 (
+    echo Error: scrubbing did not detect an invalid file
+    rmdir /S /Q "%WORKDIR%"
+    set RESULT=1
+    goto :EXIT_RESULT
+)
+rmdir /S /Q "%WORKDIR%"
+
+@rem Plan encryption of the test vectors, which must write nothing
+echo Test vectors planned
+set "WORKDIR=%TEMP%\aescrypt_plan"
+if exist "%WORKDIR%" rmdir /S /Q "%WORKDIR%"
+mkdir "%WORKDIR%"
+copy /Y vectors\*.dat "%WORKDIR%" > nul
+set "FILES="
+for %%s in (vectors\*.dat) do set "FILES=!FILES! "%WORKDIR%\%%~nxs""
+"%AESCRYPT%" -e -i 8192 --plan !FILES! > nul
+if errorlevel 1 (
+    echo Error planning encryption of test vectors
+    rmdir /S /Q "%WORKDIR%"
+    set RESULT=1
+    goto :EXIT_RESULT
+)
+if exist "%WORKDIR%\*.aes" (
+    echo Error: planning produced output
+    rmdir /S /Q "%WORKDIR%"
+    set RESULT=1
+    goto :EXIT_RESULT
+)
+"%AESCRYPT%" -q -e -i 8192 -p password !FILES!
+"%AESCRYPT%" -e -i 8192 --plan !FILES! > nul 2> nul
+if not errorlevel 1 (
+    echo Error: planning did not detect existing output files
+    rmdir /S /Q "%WORKDIR%"
+    set RESULT=1
+    goto :EXIT_RESULT
+)
+rmdir /S /Q "%WORKDIR%"
+
+@rem Encrypt the test vectors with a deadline that has passed, which defers
+@rem every file, and then with one that defers none
+echo Test vectors processed with a deadline
+set "WORKDIR=%TEMP%\aescrypt_deadline"
+if exist "%WORKDIR%" rmdir /S /Q "%WORKDIR%"
+mkdir "%WORKDIR%"
+copy /Y vectors\*.dat "%WORKDIR%" > nul
+set "FILES="
+for %%s in (vectors\*.dat) do set "FILES=!FILES! "%WORKDIR%\%%~nxs""
+"%AESCRYPT%" -q -e -i 8192 -p password --deadline 0s --deferred-list "%WORKDIR%\deferred.lst" !FILES!
+if errorlevel 1 (
+    echo Error encrypting test vectors with a passed deadline
+    rmdir /S /Q "%WORKDIR%"
+    set RESULT=1
+    goto :EXIT_RESULT
+)
+if exist "%WORKDIR%\*.aes" (
+    echo Error: files were not deferred by a passed deadline
+    rmdir /S /Q "%WORKDIR%"
+    set RESULT=1
+    goto :EXIT_RESULT
+)
+"%AESCRYPT%" -q -e -i 8192 -p password --deadline 1h --deferred-list "%WORKDIR%\deferred.lst" !FILES!
+if errorlevel 1 (
+    echo Error encrypting test vectors with a deadline
+    rmdir /S /Q "%WORKDIR%"
+    set RESULT=1
+    goto :EXIT_RESULT
+)
+for %%f in ("%WORKDIR%\deferred.lst") do if %%~zf neq 0 (
+    echo Error: files were deferred before the deadline
+    rmdir /S /Q "%WORKDIR%"
+    set RESULT=1
+    goto :EXIT_RESULT
+)
+for %%s in (vectors\*.dat) do (
+    if not exist "%WORKDIR%\%%~nxs.aes" (
+        echo Error: file was not encrypted before the deadline: %%s
+        rmdir /S /Q "%WORKDIR%"
+        set RESULT=1
+        goto :EXIT_RESULT
+    )
+)
+rmdir /S /Q "%WORKDIR%"
+
+@rem Encrypt and decrypt the test vectors with faults injected into file I/O,
+@rem then ensure running out of space fails and leaves no partial output
+@rem (only if the binary was built with fault injection support)
+if /I not "%FAULT_INJECTION%" == "ON" goto :NO_FAULT_INJECTION
+echo Test vectors processed with injected faults
+set "WORKDIR=%TEMP%\aescrypt_faults"
+if exist "%WORKDIR%" rmdir /S /Q "%WORKDIR%"
+mkdir "%WORKDIR%"
+copy /Y vectors\*.dat "%WORKDIR%" > nul
+set "FILES="
+for %%s in (vectors\*.dat) do set "FILES=!FILES! "%WORKDIR%\%%~nxs""
+set "AESCRYPT_FAULTS=latency=1ms,short-io=7,bandwidth=64K"
+"%AESCRYPT%" -q -e -i 8192 -p password -j 4 !FILES!
+if errorlevel 1 (
+    echo Error encrypting test vectors with injected faults
+    set "AESCRYPT_FAULTS="
+    rmdir /S /Q "%WORKDIR%"
+    set RESULT=1
+    goto :EXIT_RESULT
+)
+set "AESCRYPT_FAULTS=latency=1ms,short-io=5"
+for %%s in (vectors\*.dat) do (
+    "%AESCRYPT%" -q -d -p password -o "%WORKDIR%\%%~nxs.out" "%WORKDIR%\%%~nxs.aes"
+    fc /B "%%s" "%WORKDIR%\%%~nxs.out" > nul
+    if errorlevel 1 (
+        echo Error with test vector processed with injected faults: %%s
+        set "AESCRYPT_FAULTS="
+        rmdir /S /Q "%WORKDIR%"
+        set RESULT=1
+        goto :EXIT_RESULT
+    )
+)
+set "AESCRYPT_FAULTS="
+type nul > "%WORKDIR%\all.dat"
+for %%s in (vectors\*.dat) do (
+    copy /B "%WORKDIR%\all.dat" + "%%s" "%WORKDIR%\all.dat" > nul
+)
+"%AESCRYPT%" -q -e -i 8192 -p password -o "%WORKDIR%\all.aes" "%WORKDIR%\all.dat"
+set "AESCRYPT_FAULTS=enospc=256"
+"%AESCRYPT%" -q -e -i 8192 -p password -o "%WORKDIR%\full.aes" "%WORKDIR%\all.dat" 2> nul
+if not errorlevel 1 (
+    echo Error: running out of space did not fail
+    set "AESCRYPT_FAULTS="
+    rmdir /S /Q "%WORKDIR%"
+    set RESULT=1
+    goto :EXIT_RESULT
+)
+"%AESCRYPT%" -q -d -p password -o "%WORKDIR%\full.dat" "%WORKDIR%\all.aes" 2> nul
+if not errorlevel 1 (
+    echo Error: running out of space did not fail
+    set "AESCRYPT_FAULTS="
+    rmdir /S /Q "%WORKDIR%"
+    set RESULT=1
+    goto :EXIT_RESULT
+)
+set "AESCRYPT_FAULTS="
+if exist "%WORKDIR%\full.*" (
+    echo Error: partial output remains after running out of space
+    rmdir /S /Q "%WORKDIR%"
+    set RESULT=1
+    goto :EXIT_RESULT
+)
+rmdir /S /Q "%WORKDIR%"
+goto :FAULT_INJECTION_DONE
+
+@rem Without fault injection support, fault settings must be ignored
+:NO_FAULT_INJECTION
+echo Fault injection settings ignored
+set "AESCRYPT_FAULTS=latency=fast"
+for %%s in (vectors\*.dat) do (
+    "%AESCRYPT%" -q -e -i 8192 -p password -o - "%%s" > nul
+    if errorlevel 1 (
+        echo Error: fault injection settings used without support: %%s
+        set "AESCRYPT_FAULTS="
+        set RESULT=1
+        goto :EXIT_RESULT
+    )
+)
+set "AESCRYPT_FAULTS="
+:FAULT_INJECTION_DONE
+
+@rem Decrypt the test vectors to stdout, holding output until it is
+@rem verified, which must produce no output for an invalid file
+echo Test vectors decrypted with verified output
+set "WORKDIR=%TEMP%\aescrypt_verified"
+if exist "%WORKDIR%" rmdir /S /Q "%WORKDIR%"
+mkdir "%WORKDIR%"
+for %%s in (vectors\*.dat) do (
+    "%AESCRYPT%" -q -e -i 8192 -p password -o "%WORKDIR%\%%~nxs.aes" "%%s"
+    "%AESCRYPT%" -q -d -p password --verified-output -o - "%WORKDIR%\%%~nxs.aes" > "%WORKDIR%\%%~nxs.out"
+    fc /B "%%s" "%WORKDIR%\%%~nxs.out" > nul
+    if errorlevel 1 (
+        echo Error with test vector decrypted with verified output: %%s
+        rmdir /S /Q "%WORKDIR%"
+        set RESULT=1
+        goto :EXIT_RESULT
+    )
+)
+echo Not an AES Crypt stream> "%WORKDIR%\invalid.aes"
+"%AESCRYPT%" -q -d -p password --verified-output -o - "%WORKDIR%\invalid.aes" > "%WORKDIR%\invalid.out" 2> nul
+if not errorlevel 1 (
+    echo Error: verified output did not detect an invalid file
+    rmdir /S /Q "%WORKDIR%"
+    set RESULT=1
+    goto :EXIT_RESULT
+)
+for %%f in ("%WORKDIR%\invalid.out") do if %%~zf GTR 0 (
+    echo Error: verified output released output of an invalid file
+    rmdir /S /Q "%WORKDIR%"
+    set RESULT=1
+    goto :EXIT_RESULT
+)
+rmdir /S /Q "%WORKDIR%"
+
+@rem Decrypt the test vectors to files that are mapped into memory (where
+@rem supported; otherwise, files are written using streams)
+echo Test vectors decrypted to mapped output
+set "WORKDIR=%TEMP%\aescrypt_mmap"
+if exist "%WORKDIR%" rmdir /S /Q "%WORKDIR%"
+mkdir "%WORKDIR%"
+for %%s in (vectors\*.dat) do (
+    "%AESCRYPT%" -q -e -i 8192 -p password -o "%WORKDIR%\%%~nxs.aes" "%%s"
+    "%AESCRYPT%" -q -d -p password --mmap-output -o "%WORKDIR%\%%~nxs.out" "%WORKDIR%\%%~nxs.aes"
+    fc /B "%%s" "%WORKDIR%\%%~nxs.out" > nul
+    if errorlevel 1 (
+        echo Error with test vector decrypted to mapped output: %%s
+        rmdir /S /Q "%WORKDIR%"
+        set RESULT=1
+        goto :EXIT_RESULT
+    )
+)
+rmdir /S /Q "%WORKDIR%"
+
+@rem Encrypt and decrypt the set of test vectors concurrently
+echo Test vectors processed concurrently
+set "WORKDIR=%TEMP%\aescrypt_jobs"
+if exist "%WORKDIR%" rmdir /S /Q "%WORKDIR%"
+mkdir "%WORKDIR%"
+copy /Y vectors\*.dat "%WORKDIR%" > nul
+set "FILES="
+for %%s in (vectors\*.dat) do set "FILES=!FILES! "%WORKDIR%\%%~nxs""
+"%AESCRYPT%" -q -e -i 8192 -p password -j adaptive --bwlimit 64M:32M --prefetch 4 !FILES!
+if errorlevel 1 (
+    echo Error encrypting test vectors concurrently
+    rmdir /S /Q "%WORKDIR%"
+    set RESULT=1
+    goto :EXIT_RESULT
+)
+del /Q "%WORKDIR%\*.dat"
+set "FILES="
+for %%s in (vectors\*.dat) do set "FILES=!FILES! "%WORKDIR%\%%~nxs.aes""
+"%AESCRYPT%" -q -d -p password -j auto --max-memory 64M --io-class idle --cpu-priority batch --affinity node --small-files 64 !FILES!
+if errorlevel 1 (
+    echo Error decrypting test vectors concurrently
+    rmdir /S /Q "%WORKDIR%"
+    set RESULT=1
+    goto :EXIT_RESULT
+)
+for %%s in (vectors\*.dat) do (
+    fc "%%s" "%WORKDIR%\%%~nxs" > nul
+    if errorlevel 1 (
+        echo Error with concurrently processed test vector: %%s
+        rmdir /S /Q "%WORKDIR%"
+        set RESULT=1
+        goto :EXIT_RESULT
+    )
+)
+rmdir /S /Q "%WORKDIR%"
+
 :EXIT_RESULT
 exit /B %RESULT%
 endlocal
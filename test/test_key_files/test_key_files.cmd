@@ -106,6 +106,32 @@ if %ERRORLEVEL% neq 0 (
     @rem goto :EXIT_RESULT
 )
 
+@rem Generate a set of key files into a directory
+set "KEYDIR=%TEMP%\aescrypt_keys"
+if exist "%KEYDIR%" rmdir /S /Q "%KEYDIR%"
+"%AESCRYPT%" -g --count 25 --keydir "%KEYDIR%" >NUL 2>NUL
+if %ERRORLEVEL% neq 0 (
+    echo Error generating multiple key files
+    set RESULT=1
+    goto :EXIT_RESULT
+)
+set KEYCOUNT=0
+for %%k in ("%KEYDIR%\*.key") do set /A KEYCOUNT+=1
+if not "%KEYCOUNT%" == "25" (
+    echo Error: expected 25 generated key files
+    rmdir /S /Q "%KEYDIR%"
+    set RESULT=1
+    goto :EXIT_RESULT
+)
+
+@rem Existing key files must never be overwritten
+"%AESCRYPT%" -g --count 1 --keydir "%KEYDIR%" >NUL 2>NUL
+if %ERRORLEVEL% equ 0 (
+    echo Error: existing key file was overwritten
+    set RESULT=1
+)
+rmdir /S /Q "%KEYDIR%"
+
 :EXIT_RESULT
 exit /B %RESULT%
 endlocal
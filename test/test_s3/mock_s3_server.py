@@ -0,0 +1,281 @@
+#!/usr/bin/env python3
+#
+#  mock_s3_server.py
+#
+#  Copyright (C) 2024
+#  Terrapane Corporation
+#  All Rights Reserved
+#
+#  Author:
+#      Paul E. Jones <paulej@packetizer.com>
+#
+#  Description:
+#      A minimal S3-compatible server for testing.  It verifies AWS
+#      Signature Version 4 signatures, payload hashes, and part checksums,
+#      and supports multipart uploads and ranged downloads.  Completed
+#      objects are written to the store directory as STORE/bucket/key, from
+#      which objects are also downloaded.  Parts of objects whose key
+#      contains "reject" are rejected, and a file named "aborted" is created
+#      in the store directory when an upload is aborted.
+#
+#      The port the server listens on is written to the port file once the
+#      server is ready.  The server exits when the port file is removed.
+#
+
+import argparse
+import base64
+import hashlib
+import hmac
+import os
+import re
+import sys
+import threading
+import time
+import urllib.parse
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+ACCESS_KEY = "AKIDTEST"
+SECRET_KEY = "test-secret-key"
+
+uploads = {}
+uploads_lock = threading.Lock()
+failed_parts = set()
+options = None
+
+
+def sign(key, message):
+    return hmac.new(key, message.encode(), hashlib.sha256).digest()
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def log_message(self, format, *args):
+        pass
+
+    def respond(self, status, body=b"", headers=None):
+        if isinstance(body, str):
+            body = body.encode()
+        self.send_response(status)
+        for name, value in (headers or {}).items():
+            self.send_header(name, value)
+        self.send_header("Content-Length", str(len(body)))
+        self.send_header("Connection", "close")
+        self.end_headers()
+        self.wfile.write(body)
+        self.close_connection = True
+
+    def error(self, status, code, message):
+        self.respond(status,
+                     "<Error><Code>%s</Code><Message>%s</Message></Error>" %
+                     (code, message))
+
+    def send_object(self, bucket, key):
+        target = os.path.join(options.store, bucket, key)
+        if not key or not os.path.isfile(target):
+            self.error(404, "NoSuchKey", "Unknown object")
+            return
+        with open(target, "rb") as stored:
+            data = stored.read()
+        etag = '"%s"' % hashlib.md5(data).hexdigest()
+
+        if self.command == "HEAD":
+            self.send_response(200)
+            self.send_header("ETag", etag)
+            self.send_header("Content-Length", str(len(data)))
+            self.send_header("Connection", "close")
+            self.end_headers()
+            self.close_connection = True
+            return
+
+        if self.headers.get("If-Match", etag) != etag:
+            self.error(412, "PreconditionFailed", "ETag mismatch")
+            return
+
+        match = re.match(r"bytes=(\d+)-(\d+)$", self.headers.get("Range", ""))
+        if not match:
+            self.respond(200, data, {"ETag": etag})
+            return
+        first, last = int(match.group(1)), int(match.group(2))
+        if first >= len(data) or last < first:
+            self.error(416, "InvalidRange", "Range not satisfiable")
+            return
+        last = min(last, len(data) - 1)
+
+        # Delay the first range so later ranges arrive first
+        if first == 0 and options.slow_first_range:
+            time.sleep(0.5)
+
+        self.respond(206, data[first:last + 1],
+                     {"ETag": etag,
+                      "Content-Range": "bytes %d-%d/%d" %
+                                       (first, last, len(data))})
+
+    def verify_signature(self, body):
+        authorization = self.headers.get("Authorization", "")
+        match = re.match(r"AWS4-HMAC-SHA256 Credential=([^/]+)/([^,]+), "
+                         r"SignedHeaders=([^,]+), Signature=([0-9a-f]+)$",
+                         authorization)
+        if not match or match.group(1) != ACCESS_KEY:
+            return False
+        scope, signed_headers, signature = match.group(2, 3, 4)
+        date, region, service, _ = scope.split("/")
+
+        payload_hash = self.headers.get("x-amz-content-sha256", "")
+        if payload_hash != hashlib.sha256(body).hexdigest():
+            return False
+
+        path, _, query = self.path.partition("?")
+        parameters = sorted(parameter if "=" in parameter else parameter + "="
+                            for parameter in query.split("&") if parameter)
+        canonical_headers = "".join(
+            "%s:%s\n" % (name, self.headers.get(name, "").strip())
+            for name in signed_headers.split(";"))
+        canonical_request = "\n".join([self.command, path,
+                                       "&".join(parameters),
+                                       canonical_headers, signed_headers,
+                                       payload_hash])
+        string_to_sign = "\n".join([
+            "AWS4-HMAC-SHA256", self.headers.get("x-amz-date", ""), scope,
+            hashlib.sha256(canonical_request.encode()).hexdigest()])
+
+        key = sign(("AWS4" + SECRET_KEY).encode(), date)
+        key = sign(key, region)
+        key = sign(key, service)
+        key = sign(key, "aws4_request")
+        expected = hmac.new(key, string_to_sign.encode(),
+                            hashlib.sha256).hexdigest()
+
+        return hmac.compare_digest(expected, signature)
+
+    def handle_request(self):
+        length = int(self.headers.get("Content-Length", "0"))
+        body = self.rfile.read(length) if length else b""
+
+        if not self.verify_signature(body):
+            self.error(403, "SignatureDoesNotMatch", "Invalid signature")
+            return
+
+        path, _, query = self.path.partition("?")
+        query = urllib.parse.parse_qs(query, keep_blank_values=True)
+        bucket, _, key = urllib.parse.unquote(path[1:]).partition("/")
+
+        if self.command in ("GET", "HEAD"):
+            self.send_object(bucket, key)
+            return
+
+        if self.command == "POST" and "uploads" in query:
+            upload_id = os.urandom(8).hex()
+            with uploads_lock:
+                uploads[upload_id] = {"bucket": bucket, "key": key,
+                                      "parts": {}}
+            self.respond(200,
+                         "<InitiateMultipartUploadResult><Bucket>%s</Bucket>"
+                         "<Key>%s</Key><UploadId>%s</UploadId>"
+                         "</InitiateMultipartUploadResult>" %
+                         (bucket, key, upload_id))
+            return
+
+        upload_id = query.get("uploadId", [""])[0]
+        with uploads_lock:
+            upload = uploads.get(upload_id)
+        if upload is None:
+            self.error(404, "NoSuchUpload", "Unknown upload")
+            return
+
+        if self.command == "PUT":
+            number = int(query["partNumber"][0])
+
+            # Fail the first attempt of a part to exercise retries
+            if options.fail_part == number and number not in failed_parts:
+                failed_parts.add(number)
+                self.error(503, "SlowDown", "Please retry")
+                return
+
+            # Reject parts of objects so named to exercise aborting uploads
+            if "reject" in upload["key"]:
+                self.error(400, "InvalidRequest", "Part rejected")
+                return
+
+            checksum = base64.b64encode(hashlib.sha256(body).digest())
+            if self.headers.get("x-amz-checksum-sha256", "") != \
+                    checksum.decode():
+                self.error(400, "BadDigest", "Checksum mismatch")
+                return
+            etag = '"%s"' % hashlib.md5(body).hexdigest()
+            with uploads_lock:
+                upload["parts"][number] = (etag, checksum.decode(), body)
+            self.respond(200, headers={"ETag": etag})
+            return
+
+        if self.command == "POST":
+            listed = re.findall(r"<PartNumber>(\d+)</PartNumber>"
+                                r"<ETag>([^<]*)</ETag>"
+                                r"<ChecksumSHA256>([^<]*)</ChecksumSHA256>",
+                                body.decode())
+            data = b""
+            for position, (number, etag, checksum) in enumerate(listed):
+                part = upload["parts"].get(int(number))
+                etag = etag.replace("&quot;", '"')
+                if (int(number) != position + 1 or part is None or
+                        part[0] != etag or part[1] != checksum):
+                    self.error(400, "InvalidPart", "Part %s" % number)
+                    return
+                data += part[2]
+            if not listed:
+                self.error(400, "MalformedXML", "No parts")
+                return
+            target = os.path.join(options.store, upload["bucket"],
+                                  upload["key"])
+            os.makedirs(os.path.dirname(target), exist_ok=True)
+            with open(target, "wb") as output:
+                output.write(data)
+            with uploads_lock:
+                del uploads[upload_id]
+            self.respond(200,
+                         "<CompleteMultipartUploadResult><Key>%s</Key>"
+                         "</CompleteMultipartUploadResult>" % upload["key"])
+            return
+
+        if self.command == "DELETE":
+            with uploads_lock:
+                del uploads[upload_id]
+            open(os.path.join(options.store, "aborted"), "a").close()
+            self.respond(204)
+            return
+
+        self.error(405, "MethodNotAllowed", self.command)
+
+    do_GET = handle_request
+    do_HEAD = handle_request
+    do_POST = handle_request
+    do_PUT = handle_request
+    do_DELETE = handle_request
+
+
+def main():
+    global options
+
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--port-file", required=True)
+    parser.add_argument("--store", required=True)
+    parser.add_argument("--fail-part", type=int, default=0,
+                        help="part number whose first upload attempt fails")
+    parser.add_argument("--slow-first-range", action="store_true",
+                        help="delay downloads of the first range of objects")
+    options = parser.parse_args()
+
+    os.makedirs(options.store, exist_ok=True)
+    server = ThreadingHTTPServer(("127.0.0.1", 0), Handler)
+    with open(options.port_file + ".tmp", "w") as port_file:
+        port_file.write(str(server.server_address[1]))
+    os.replace(options.port_file + ".tmp", options.port_file)
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+
+    while os.path.exists(options.port_file):
+        time.sleep(0.2)
+    server.shutdown()
+
+
+if __name__ == "__main__":
+    sys.exit(main())
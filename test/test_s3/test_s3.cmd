@@ -0,0 +1,168 @@
+@echo off
+
+@rem This program assumes the environment variable CMAKE_CONFIG_TYPE will be
+@rem set to Debug or Release (or other value if appropriate).  It uses that
+@rem value as a replacement for CONFIG_TYPE, which is a substring in the
+@rem passed-in argument.  This is a part of the pathname, so it looks for
+@rem the substring /CONFIG_TYPE/ as it makes the substitution.
+
+setlocal enabledelayedexpansion
+
+@rem Set the result code to 0 (success)
+set RESULT=0
+
+@rem Get the AES Crypt binary path and the Python interpreter
+set "AESCRYPT=%1"
+set "PYTHON=%~2"
+if "%PYTHON%" == "" set "PYTHON=python"
+
+@rem Ensure AESCRYPT is not an empty string
+if "%AESCRYPT%" == "" (
+    echo First argument should be the AES Crypt binary
+    set RESULT=1
+    goto :EXIT_RESULT
+)
+
+@rem Ensure CMAKE_CONFIG_TYPE is not an empty string
+if "%CMAKE_CONFIG_TYPE%" == "" (
+    echo The CMAKE_CONFIG_TYPE variable must contain the build type
+    set RESULT=1
+    goto :EXIT_RESULT
+)
+
+@rem Use the CMAKE_CONFIG_TYPE env variable to determine the correct executable
+set "AESCRYPT=!AESCRYPT:/CONFIG_TYPE/=/%CMAKE_CONFIG_TYPE%/!"
+
+@rem Convert pathnames to use \ rather than / (CMake uses /) to pacify Windows
+set "AESCRYPT=%AESCRYPT:/=\%"
+
+@rem Ensure the executable binary exists
+if not exist "%AESCRYPT%" (
+    echo AES Crypt executable not found: %AESCRYPT%
+    set RESULT=1
+    goto :EXIT_RESULT
+)
+
+@rem Switch directories to where the test process resides
+cd /D "%~dp0"
+
+@rem Start the mock object storage server, which fails the first attempt to
+@rem upload part 2 so that retries are exercised and delays the first range of
+@rem downloads so that ranges arrive out of order (it exits when the port file
+@rem is removed)
+set "WORKDIR=%TEMP%\aescrypt_s3"
+if exist "%WORKDIR%" rmdir /S /Q "%WORKDIR%"
+mkdir "%WORKDIR%"
+start "mock_s3_server" /B "%PYTHON%" mock_s3_server.py --port-file "%WORKDIR%\port" --store "%WORKDIR%\store" --fail-part 2 --slow-first-range
+set WAITED=0
+:WAIT_SERVER
+if exist "%WORKDIR%\port" goto :SERVER_READY
+if %WAITED% geq 10 (
+    echo Error starting the mock object storage server
+    rmdir /S /Q "%WORKDIR%"
+    set RESULT=1
+    goto :EXIT_RESULT
+)
+timeout /T 1 /NOBREAK > nul
+set /A WAITED+=1
+goto :WAIT_SERVER
+:SERVER_READY
+set /P PORT=<"%WORKDIR%\port"
+
+set "AWS_ENDPOINT_URL=http://127.0.0.1:%PORT%"
+set "AWS_REGION=us-east-1"
+set "AWS_ACCESS_KEY_ID=AKIDTEST"
+set "AWS_SECRET_ACCESS_KEY=test-secret-key"
+set "AWS_SESSION_TOKEN="
+
+@rem Encrypt a file large enough to require several parts and upload it
+echo Encrypted output uploaded in parts
+"%PYTHON%" -c "import os,sys; open(sys.argv[1],'wb').write(os.urandom(12582912))" "%WORKDIR%\input.dat"
+"%AESCRYPT%" -q -e -i 8192 -p password --s3-part-size 5M --s3-connections 2 -o s3://bucket/dir/input.dat.aes "%WORKDIR%\input.dat"
+if errorlevel 1 (
+    echo Error uploading encrypted file
+    set RESULT=1
+    goto :CLEANUP
+)
+"%AESCRYPT%" -q -d -p password -o "%WORKDIR%\output.dat" "%WORKDIR%\store\bucket\dir\input.dat.aes"
+if errorlevel 1 (
+    echo Error decrypting uploaded file
+    set RESULT=1
+    goto :CLEANUP
+)
+fc /B "%WORKDIR%\input.dat" "%WORKDIR%\output.dat" > nul
+if errorlevel 1 (
+    echo Error with uploaded file
+    set RESULT=1
+    goto :CLEANUP
+)
+
+@rem Download the uploaded object in ranges and decrypt it
+echo Object downloaded and decrypted in ranges
+"%AESCRYPT%" -q -d -p password --s3-part-size 5M --s3-connections 3 -o "%WORKDIR%\download.dat" s3://bucket/dir/input.dat.aes
+if errorlevel 1 (
+    echo Error downloading object
+    set RESULT=1
+    goto :CLEANUP
+)
+fc /B "%WORKDIR%\input.dat" "%WORKDIR%\download.dat" > nul
+if errorlevel 1 (
+    echo Error with downloaded object
+    set RESULT=1
+    goto :CLEANUP
+)
+
+@rem Downloading an object that does not exist fails
+echo Missing object reported
+"%AESCRYPT%" -q -d -p password -o "%WORKDIR%\missing.dat" s3://bucket/dir/missing.aes 2> nul
+if not errorlevel 1 (
+    echo Error: download of a missing object should fail
+    set RESULT=1
+    goto :CLEANUP
+)
+
+@rem An upload that fails is aborted
+echo Failed upload aborted
+"%AESCRYPT%" -q -e -i 8192 -p password -o s3://bucket/dir/reject.aes "%WORKDIR%\input.dat" 2> nul
+if not errorlevel 1 (
+    echo Error: upload with rejected parts should fail
+    set RESULT=1
+    goto :CLEANUP
+)
+if not exist "%WORKDIR%\store\aborted" (
+    echo Error: failed upload was not aborted
+    set RESULT=1
+    goto :CLEANUP
+)
+if exist "%WORKDIR%\store\bucket\dir\reject.aes" (
+    echo Error: failed upload created an object
+    set RESULT=1
+    goto :CLEANUP
+)
+
+@rem Requests with an invalid signature are rejected
+echo Invalid credentials rejected
+set "AWS_SECRET_ACCESS_KEY=wrong"
+"%AESCRYPT%" -q -e -i 8192 -p password -o s3://bucket/dir/other.aes "%WORKDIR%\input.dat" 2> nul
+if not errorlevel 1 (
+    echo Error: upload with invalid credentials should fail
+    set RESULT=1
+)
+
+@rem Object storage is not used without an explicit endpoint
+echo Missing endpoint rejected
+set "AWS_ENDPOINT_URL="
+"%AESCRYPT%" -q -e -i 8192 -p password -o s3://bucket/dir/other.aes "%WORKDIR%\input.dat" 2> nul
+if not errorlevel 1 (
+    echo Error: upload without an endpoint should fail
+    set RESULT=1
+)
+
+:CLEANUP
+del "%WORKDIR%\port"
+timeout /T 2 /NOBREAK > nul
+rmdir /S /Q "%WORKDIR%"
+
+:EXIT_RESULT
+exit /B %RESULT%
+endlocal
@@ -0,0 +1,328 @@
+/*
+ *  test_unicode_fast_path.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This program verifies that the vectorized UTF-8 validation and UTF-16
+ *      to UTF-8 conversion functions produce results identical to the scalar
+ *      functions in the Character Utilities library over randomly generated
+ *      (and frequently malformed) input strings.
+ *
+ *  Portability Issues:
+ *      None.
+ */
+
+#include <iostream>
+#include <random>
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <terra/charutil/character_utilities.h>
+#include "unicode_fast_path.h"
+
+namespace
+{
+
+// Number of random strings to test for each function
+constexpr std::size_t Test_Iterations = 200'000;
+
+// Maximum length of a generated string in characters
+constexpr std::size_t Maximum_Characters = 96;
+
+/*
+ *  AppendUTF8()
+ *
+ *  Description:
+ *      Append the UTF-8 encoding of the given code point to the string.  No
+ *      checks are performed, so surrogates and overlong ranges are emitted
+ *      as-is to exercise invalid input.
+ *
+ *  Parameters:
+ *      octets [in/out]
+ *          The string to which the character is appended.
+ *
+ *      code_point [in]
+ *          The code point to encode.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+void AppendUTF8(std::vector<std::uint8_t> &octets, std::uint32_t code_point)
+{
+    if (code_point < 0x80)
+    {
+        octets.push_back(static_cast<std::uint8_t>(code_point));
+    }
+    else if (code_point < 0x800)
+    {
+        octets.push_back(static_cast<std::uint8_t>(0xc0 | (code_point >> 6)));
+        octets.push_back(static_cast<std::uint8_t>(0x80 | (code_point & 0x3f)));
+    }
+    else if (code_point < 0x10000)
+    {
+        octets.push_back(static_cast<std::uint8_t>(0xe0 | (code_point >> 12)));
+        octets.push_back(
+            static_cast<std::uint8_t>(0x80 | ((code_point >> 6) & 0x3f)));
+        octets.push_back(static_cast<std::uint8_t>(0x80 | (code_point & 0x3f)));
+    }
+    else
+    {
+        octets.push_back(static_cast<std::uint8_t>(0xf0 | (code_point >> 18)));
+        octets.push_back(
+            static_cast<std::uint8_t>(0x80 | ((code_point >> 12) & 0x3f)));
+        octets.push_back(
+            static_cast<std::uint8_t>(0x80 | ((code_point >> 6) & 0x3f)));
+        octets.push_back(static_cast<std::uint8_t>(0x80 | (code_point & 0x3f)));
+    }
+}
+
+/*
+ *  RandomCodePoint()
+ *
+ *  Description:
+ *      Produce a random code point, strongly favoring ASCII characters so
+ *      that long ASCII runs exercise the vector paths.
+ *
+ *  Parameters:
+ *      generator [in/out]
+ *          The random number generator.
+ *
+ *  Returns:
+ *      A code point, which may be a surrogate or exceed U+10FFFF.
+ *
+ *  Comments:
+ *      None.
+ */
+std::uint32_t RandomCodePoint(std::mt19937 &generator)
+{
+    switch (std::uniform_int_distribution<int>(0, 15)(generator))
+    {
+        case 0:
+            return std::uniform_int_distribution<std::uint32_t>(
+                0x80, 0x7ff)(generator);
+
+        case 1:
+            return std::uniform_int_distribution<std::uint32_t>(
+                0x800, 0xffff)(generator);
+
+        case 2:
+            return std::uniform_int_distribution<std::uint32_t>(
+                0x10000, 0x10ffff)(generator);
+
+        case 3:
+            return std::uniform_int_distribution<std::uint32_t>(
+                0xd800, 0xdfff)(generator);
+
+        default:
+            return std::uniform_int_distribution<std::uint32_t>(
+                0x00, 0x7f)(generator);
+    }
+}
+
+/*
+ *  Corrupt()
+ *
+ *  Description:
+ *      Randomly corrupt some strings by replacing, truncating, or inserting
+ *      octets so that invalid input is tested as often as valid input.
+ *
+ *  Parameters:
+ *      generator [in/out]
+ *          The random number generator.
+ *
+ *      octets [in/out]
+ *          The string to corrupt.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+void Corrupt(std::mt19937 &generator, std::vector<std::uint8_t> &octets)
+{
+    if (octets.empty()) return;
+
+    std::uniform_int_distribution<std::size_t> position(0, octets.size() - 1);
+    std::uniform_int_distribution<int> octet(0, 255);
+
+    switch (std::uniform_int_distribution<int>(0, 3)(generator))
+    {
+        case 0:
+            octets[position(generator)] =
+                static_cast<std::uint8_t>(octet(generator));
+            break;
+
+        case 1:
+            octets.resize(position(generator));
+            break;
+
+        case 2:
+            octets.insert(octets.begin() +
+                              static_cast<std::ptrdiff_t>(position(generator)),
+                          static_cast<std::uint8_t>(octet(generator)));
+            break;
+
+        default:
+            break;
+    }
+}
+
+/*
+ *  TestUTF8Validation()
+ *
+ *  Description:
+ *      Compare IsUTF8ValidFast() against Terra::CharUtil::IsUTF8Valid().
+ *
+ *  Parameters:
+ *      generator [in/out]
+ *          The random number generator.
+ *
+ *  Returns:
+ *      The number of mismatches observed.
+ *
+ *  Comments:
+ *      None.
+ */
+std::size_t TestUTF8Validation(std::mt19937 &generator)
+{
+    std::size_t failures = 0;
+    std::uniform_int_distribution<std::size_t> characters(0,
+                                                          Maximum_Characters);
+
+    for (std::size_t i = 0; i < Test_Iterations; i++)
+    {
+        std::vector<std::uint8_t> octets;
+
+        // Produce a string of random characters
+        for (std::size_t j = characters(generator); j > 0; j--)
+        {
+            AppendUTF8(octets, RandomCodePoint(generator));
+        }
+        Corrupt(generator, octets);
+
+        if (IsUTF8ValidFast(octets) != Terra::CharUtil::IsUTF8Valid(octets))
+        {
+            std::cerr << "UTF-8 validation mismatch for a string of "
+                      << octets.size() << " octets" << std::endl;
+            failures++;
+        }
+    }
+
+    return failures;
+}
+
+/*
+ *  TestUTF16Conversion()
+ *
+ *  Description:
+ *      Compare ConvertUTF16ToUTF8Fast() against
+ *      Terra::CharUtil::ConvertUTF16ToUTF8() for both byte orders.
+ *
+ *  Parameters:
+ *      generator [in/out]
+ *          The random number generator.
+ *
+ *  Returns:
+ *      The number of mismatches observed.
+ *
+ *  Comments:
+ *      None.
+ */
+std::size_t TestUTF16Conversion(std::mt19937 &generator)
+{
+    std::size_t failures = 0;
+    std::uniform_int_distribution<std::size_t> characters(0,
+                                                          Maximum_Characters);
+
+    for (std::size_t i = 0; i < Test_Iterations; i++)
+    {
+        const bool little_endian = ((i & 0x01) == 0);
+        std::vector<std::uint8_t> octets;
+
+        // Produce a string of random UTF-16 code units
+        for (std::size_t j = characters(generator); j > 0; j--)
+        {
+            std::uint32_t code_point = RandomCodePoint(generator);
+            std::vector<std::uint16_t> units;
+
+            if (code_point >= 0x10000)
+            {
+                code_point -= 0x10000;
+                units.push_back(
+                    static_cast<std::uint16_t>(0xd800 + (code_point >> 10)));
+                units.push_back(
+                    static_cast<std::uint16_t>(0xdc00 + (code_point & 0x3ff)));
+            }
+            else
+            {
+                units.push_back(static_cast<std::uint16_t>(code_point));
+            }
+
+            for (auto unit : units)
+            {
+                const auto high = static_cast<std::uint8_t>(unit >> 8);
+                const auto low = static_cast<std::uint8_t>(unit & 0xff);
+                octets.push_back(little_endian ? low : high);
+                octets.push_back(little_endian ? high : low);
+            }
+        }
+        Corrupt(generator, octets);
+
+        // Occasionally provide an output buffer that is too small
+        std::size_t output_size = octets.size() + (octets.size() >> 1);
+        if ((i % 7) == 0) output_size >>= 1;
+
+        std::vector<std::uint8_t> fast(output_size);
+        std::vector<std::uint8_t> scalar(output_size);
+
+        auto [fast_result, fast_length] =
+            ConvertUTF16ToUTF8Fast(octets, fast, little_endian);
+        auto [scalar_result, scalar_length] =
+            Terra::CharUtil::ConvertUTF16ToUTF8(octets, scalar, little_endian);
+
+        if ((fast_result != scalar_result) ||
+            (fast_result &&
+             ((fast_length != scalar_length) ||
+              !std::equal(fast.begin(),
+                          fast.begin() +
+                              static_cast<std::ptrdiff_t>(fast_length),
+                          scalar.begin()))))
+        {
+            std::cerr << "UTF-16 conversion mismatch for a string of "
+                      << octets.size() << " octets" << std::endl;
+            failures++;
+        }
+    }
+
+    return failures;
+}
+
+} // namespace
+
+int main()
+{
+    std::mt19937 generator(20241230);
+
+    std::size_t failures = TestUTF8Validation(generator);
+    failures += TestUTF16Conversion(generator);
+
+    if (failures > 0)
+    {
+        std::cerr << "Total mismatches: " << failures << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "Fast path results match the scalar functions" << std::endl;
+
+    return EXIT_SUCCESS;
+}